@@ -0,0 +1,281 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/hmac.h>
+#include <emsha/batch.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// hmacBatch runs HMACs through the multi-lane kernel. It's shared by
+// the batch operations, which differ only in which messages and keys
+// go in and what happens to each HMAC as it comes out. The inner
+// hashes go through sha256_lanes; the outer hashes are a single block
+// each, and are compressed a lane group at a time as the inner hashes
+// complete, as in HMACSignMany.
+template <typename Source, typename Sink>
+void
+hmacBatch(const Source& source, std::size_t count, Sink& sink)
+{
+	// inner starts each message from its key's inner midstate,
+	// which covers one block of key.
+	struct inner {
+		const Source&	source;
+
+		const uint8_t *Message(std::size_t i) const { return source.Message(i); }
+		uint64_t MessageLength(std::size_t i) const { return source.MessageLength(i); }
+
+		uint64_t
+		Start(std::size_t i, uint32_t *ih) const
+		{
+			std::copy(source.Key(i).inner, source.Key(i).inner + 8, ih);
+			return HMAC_KEY_LENGTH;
+		}
+	};
+
+	uint8_t		 outer[SHA256_LANES][SHA256_MB_SIZE] = {{0}};
+	const uint8_t	*ptrs[SHA256_LANES];
+	uint32_t	 ih[SHA256_LANES][8];
+	std::size_t	 items[SHA256_LANES];
+	uint8_t		 digest[SHA256_HASH_SIZE];
+	uint32_t	 pending = 0;
+
+	for (uint32_t l = 0; l < SHA256_LANES; l++) {
+		outer[l][SHA256_HASH_SIZE] = 0x80;
+		sha256_write_length(outer[l] + SHA256_MB_SIZE,
+				    HMAC_KEY_LENGTH + SHA256_HASH_SIZE);
+		ptrs[l] = outer[l];
+	}
+
+	auto flush = [&]() {
+		sha256_compress_lanes(ih, ptrs, pending);
+		for (uint32_t l = 0; l < pending; l++) {
+			sha256_store(ih[l], digest);
+			sink(items[l], digest);
+		}
+		pending = 0;
+	};
+
+	auto innerDone = [&](std::size_t i, const uint32_t *innerHash) {
+		sha256_store(innerHash, outer[pending]);
+		std::copy(source.Key(i).outer, source.Key(i).outer + 8, ih[pending]);
+		items[pending++] = i;
+		if (pending == SHA256_LANES) {
+			flush();
+		}
+	};
+
+	inner const	in = {source};
+
+	sha256_lanes(in, count, innerDone);
+	if (pending > 0) {
+		flush();
+	}
+
+	std::fill(digest, digest + SHA256_HASH_SIZE, 0);
+	for (auto& block : outer) {
+		std::fill(block, block + SHA256_HASH_SIZE, 0);
+	}
+}
+
+
+// verifySource feeds the batch's items to hmacBatch in key order, so
+// that consecutive messages share a midstate.
+struct verifySource {
+	const HMACMidstate	*keys;
+	const HMACBatchItem	*items;
+	std::vector<std::size_t> order;
+
+	const HMACMidstate& Key(std::size_t i) const { return keys[items[order[i]].key]; }
+	const uint8_t *Message(std::size_t i) const { return items[order[i]].message; }
+	uint32_t MessageLength(std::size_t i) const { return items[order[i]].messageLength; }
+};
+
+
+// signPass is the number of keys HMACSignMany takes through the
+// message at once; each block's schedule is expanded once per pass.
+constexpr std::size_t	signPass = 8 * SHA256_LANES;
+
+
+} // anonymous namespace
+
+
+EMSHAResult
+HMACVerifyBatch(const HMACMidstate *keys, uint32_t keyCount,
+		const HMACBatchItem *items, std::size_t count, uint64_t *results)
+{
+	if (count == 0) {
+		return EMSHAResult::OK;
+	}
+	if ((items == nullptr) || (results == nullptr)) {
+		return EMSHAResult::NullPointer;
+	}
+	if ((keys == nullptr) && (keyCount != 0)) {
+		return EMSHAResult::NullPointer;
+	}
+
+	verifySource	source;
+
+	source.keys  = keys;
+	source.items = items;
+	source.order.reserve(count);
+
+	for (std::size_t i = 0; i < count; i++) {
+		const HMACBatchItem&	item = items[i];
+
+		if ((item.tag == nullptr) ||
+		    ((item.message == nullptr) && (item.messageLength != 0))) {
+			return EMSHAResult::NullPointer;
+		}
+
+		// Items that can't verify are left out of the batch.
+		if ((item.key < keyCount) &&
+		    (item.tagLength >= HMAC_MIN_TAG_LENGTH) &&
+		    (item.tagLength <= SHA256_HASH_SIZE)) {
+			source.order.push_back(i);
+		}
+	}
+
+	std::stable_sort(source.order.begin(), source.order.end(),
+			 [items](std::size_t a, std::size_t b) {
+				 return items[a].key < items[b].key;
+			 });
+
+	std::fill(results, results + HMACBatchResultWords(count), 0);
+
+	std::size_t	verified = 0;
+	auto check = [&](std::size_t i, const uint8_t *digest) {
+		const HMACBatchItem&	item = items[source.order[i]];
+
+		// Set the bit without branching on the comparison.
+		uint64_t const	ok = static_cast<uint64_t>(
+		    ConstantTimeEqual(digest, item.tag, item.tagLength));
+		std::size_t const	bit = source.order[i];
+		results[bit / 64] |= ok << (bit % 64);
+		verified += static_cast<std::size_t>(ok);
+	};
+
+	hmacBatch(source, source.order.size(), check);
+
+	return (verified == count) ? EMSHAResult::OK : EMSHAResult::VerifyFailed;
+}
+
+
+EMSHAResult
+HMACSignMany(const HMACMidstate *keys, std::size_t keyCount, const uint8_t *m,
+	     uint32_t ml, uint8_t *tags)
+{
+	uint32_t	ih[signPass][8];
+	uint32_t	w[64];
+	uint8_t		tail[2 * SHA256_MB_SIZE] = {0};
+	uint8_t		outer[SHA256_LANES][SHA256_MB_SIZE] = {{0}};
+	const uint8_t	*ptrs[SHA256_LANES];
+
+	if (keyCount == 0) {
+		return EMSHAResult::OK;
+	}
+	if ((keys == nullptr) || (tags == nullptr)) {
+		return EMSHAResult::NullPointer;
+	}
+	if ((m == nullptr) && (ml != 0)) {
+		return EMSHAResult::NullPointer;
+	}
+
+	// The padded message is the same under every key, since the
+	// inner hash always starts after exactly one block of key.
+	uint32_t const	full = ml / SHA256_MB_SIZE;
+	uint32_t const	rest = ml % SHA256_MB_SIZE;
+	uint32_t const	tailBlocks = ((rest + 9) > SHA256_MB_SIZE) ? 2 : 1;
+
+	if (rest != 0) {
+		std::copy(m + (ml - rest), m + ml, tail);
+	}
+	tail[rest] = 0x80;
+	sha256_write_length(tail + (tailBlocks * SHA256_MB_SIZE),
+			    static_cast<uint64_t>(HMAC_KEY_LENGTH) + ml);
+
+	for (uint32_t l = 0; l < SHA256_LANES; l++) {
+		outer[l][SHA256_HASH_SIZE] = 0x80;
+		sha256_write_length(outer[l] + SHA256_MB_SIZE, HMAC_KEY_LENGTH + SHA256_HASH_SIZE);
+		ptrs[l] = outer[l];
+	}
+
+	for (std::size_t first = 0; first < keyCount; first += signPass) {
+		std::size_t const	n = std::min(signPass, keyCount - first);
+
+		for (std::size_t k = 0; k < n; k++) {
+			std::copy(keys[first + k].inner, keys[first + k].inner + 8, ih[k]);
+		}
+
+		for (uint32_t b = 0; b < (full + tailBlocks); b++) {
+			const uint8_t	*block = (b < full) ?
+			    m + (static_cast<std::size_t>(b) * SHA256_MB_SIZE) :
+			    tail + ((b - full) * SHA256_MB_SIZE);
+
+			sha256_schedule(block, w);
+			for (std::size_t k = 0; k < n; k += SHA256_LANES) {
+				sha256_rounds_lanes(ih + k, w,
+						    std::min<std::size_t>(SHA256_LANES, n - k));
+			}
+		}
+
+		for (std::size_t k = 0; k < n; k += SHA256_LANES) {
+			std::size_t const	lanes = std::min<std::size_t>(SHA256_LANES, n - k);
+
+			for (std::size_t l = 0; l < lanes; l++) {
+				sha256_store(ih[k + l], outer[l]);
+				std::copy(keys[first + k + l].outer,
+					  keys[first + k + l].outer + 8, ih[k + l]);
+			}
+
+			sha256_compress_lanes(ih + k, ptrs, lanes);
+			for (std::size_t l = 0; l < lanes; l++) {
+				sha256_store(ih[k + l], tags + ((first + k + l) * SHA256_HASH_SIZE));
+			}
+		}
+	}
+
+	std::fill(tail, tail + sizeof(tail), 0);
+	std::fill(w, w + 64, 0);
+	for (auto& block : outer) {
+		std::fill(block, block + SHA256_HASH_SIZE, 0);
+	}
+	return EMSHAResult::OK;
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,493 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/bloom.h>
+#include <emsha/internal.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define EMSHA_BLOOM_AVX2
+#include <immintrin.h>
+#endif
+
+
+namespace emsha {
+
+
+namespace {
+
+
+constexpr uintptr_t	cacheLine = 64;
+constexpr uint32_t	blockWords = 8;
+constexpr uint32_t	blockBits = blockWords * 64;
+
+// Digest bytes 8-15 select the block, and bytes 16-21 hold the eight
+// 6-bit probe positions, one for each word of the block.
+constexpr uint32_t	blockByte = 8;
+constexpr uint32_t	probeByte = 16;
+
+// Queries in a batch are prefetched this many at a time.
+constexpr std::size_t	batchGroup = 8;
+
+constexpr char		bloomMagic[8] = {'E', 'M', 'S', 'H', 'A', 'B', 'F', '1'};
+
+// forceScalar is set by bloom_force_scalar.
+std::atomic<bool>	forceScalar(false);
+
+
+uint64_t
+loadBE64(const uint8_t *p)
+{
+	uint64_t	w = 0;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		w = (w << 8) | p[i];
+	}
+	return w;
+}
+
+
+uint64_t
+loadLE64(const uint8_t *p)
+{
+	uint64_t	w = 0;
+
+	for (uint32_t i = 8; i > 0; i--) {
+		w = (w << 8) | p[i - 1];
+	}
+	return w;
+}
+
+
+void
+storeLE64(uint64_t w, uint8_t *p)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		p[i] = static_cast<uint8_t>(w >> (8 * i));
+	}
+}
+
+
+// A probe tests a digest's probes against its block, returning true
+// if they are all set.
+using probeFunc = bool (*)(const uint64_t *block, const uint8_t *digest);
+
+
+bool
+probeScalar(const uint64_t *block, const uint8_t *digest)
+{
+	uint64_t const	positions = loadLE64(digest + probeByte);
+	uint64_t	missing = 0;
+
+	for (uint32_t i = 0; i < blockWords; i++) {
+		uint64_t const	mask = static_cast<uint64_t>(1) << ((positions >> (6 * i)) & 63);
+
+		missing |= mask & ~block[i];
+	}
+	return missing == 0;
+}
+
+
+#if defined(EMSHA_BLOOM_AVX2)
+
+// probeAVX2 tests the block as two 256-bit halves: the positions are
+// spread across the lanes with a variable shift, turned into bit
+// masks with another, and tested against the block at once.
+__attribute__((target("avx2")))
+bool
+probeAVX2(const uint64_t *block, const uint8_t *digest)
+{
+	__m256i const	positions = _mm256_set1_epi64x(
+					static_cast<long long>(loadLE64(digest + probeByte)));
+	__m256i const	low = _mm256_set1_epi64x(63);
+	__m256i const	one = _mm256_set1_epi64x(1);
+	__m256i const	shiftLo = _mm256_srlv_epi64(positions, _mm256_set_epi64x(18, 12, 6, 0));
+	__m256i const	shiftHi = _mm256_srlv_epi64(positions, _mm256_set_epi64x(42, 36, 30, 24));
+	__m256i const	maskLo = _mm256_sllv_epi64(one, _mm256_and_si256(shiftLo, low));
+	__m256i const	maskHi = _mm256_sllv_epi64(one, _mm256_and_si256(shiftHi, low));
+
+	// Blocks are cache line aligned.
+	__m256i const	wordsLo = _mm256_load_si256(reinterpret_cast<const __m256i *>(block));
+	__m256i const	wordsHi = _mm256_load_si256(reinterpret_cast<const __m256i *>(block + 4));
+	__m256i const	missing = _mm256_or_si256(_mm256_andnot_si256(wordsLo, maskLo),
+						  _mm256_andnot_si256(wordsHi, maskHi));
+
+	return _mm256_testz_si256(missing, missing) != 0;
+}
+
+
+bool
+haveAVX2()
+{
+	static bool const	avx2 = __builtin_cpu_supports("avx2");
+
+	return avx2;
+}
+
+#else
+
+bool
+probeAVX2(const uint64_t *block, const uint8_t *digest)
+{
+	return probeScalar(block, digest);
+}
+
+
+bool
+haveAVX2()
+{
+	return false;
+}
+
+#endif
+
+
+probeFunc
+selectProbe()
+{
+	if (haveAVX2() && !forceScalar.load(std::memory_order_relaxed)) {
+		return probeAVX2;
+	}
+	return probeScalar;
+}
+
+
+void
+prefetch(const void *p)
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(p);
+#else
+	(void)p;
+#endif
+}
+
+
+} // anonymous namespace
+
+
+bool
+bloom_force_scalar(bool force)
+{
+	return forceScalar.exchange(force);
+}
+
+
+BloomFilter::BloomFilter(uint64_t expected, uint32_t bitsPerDigest)
+    : storage(nullptr), words(nullptr), blocks(0), bits(0)
+{
+	uint64_t const	wanted = std::max<uint64_t>(1, expected) * std::max<uint32_t>(1, bitsPerDigest);
+
+	while (((static_cast<uint64_t>(1) << this->bits) * blockBits) < wanted) {
+		this->bits++;
+	}
+	this->allocate(static_cast<std::size_t>(1) << this->bits);
+}
+
+
+BloomFilter::~BloomFilter()
+{
+	delete[] this->storage;
+}
+
+
+void
+BloomFilter::allocate(std::size_t count)
+{
+	uint8_t	*fresh = new uint8_t[(count * cacheLine) + cacheLine]();
+
+	delete[] this->storage;
+	this->storage = fresh;
+
+	uintptr_t const	aligned = (reinterpret_cast<uintptr_t>(fresh) + cacheLine - 1) &
+				  ~(cacheLine - 1);
+	this->words  = reinterpret_cast<uint64_t *>(aligned);
+	this->blocks = count;
+}
+
+
+std::size_t
+BloomFilter::blockIndex(const uint8_t *digest) const
+{
+	if (this->bits == 0) {
+		return 0;
+	}
+	return static_cast<std::size_t>(loadBE64(digest + blockByte) >> (64 - this->bits));
+}
+
+
+const uint64_t *
+BloomFilter::block(const uint8_t *digest) const
+{
+	return this->words + (this->blockIndex(digest) * blockWords);
+}
+
+
+uint64_t *
+BloomFilter::block(const uint8_t *digest)
+{
+	return this->words + (this->blockIndex(digest) * blockWords);
+}
+
+
+void
+BloomFilter::Add(const uint8_t *digest)
+{
+	EMSHA_CHECK(digest != nullptr, void());
+
+	uint64_t	*b = this->block(digest);
+	uint64_t const	positions = loadLE64(digest + probeByte);
+
+	for (uint32_t i = 0; i < blockWords; i++) {
+		b[i] |= static_cast<uint64_t>(1) << ((positions >> (6 * i)) & 63);
+	}
+}
+
+
+bool
+BloomFilter::MayContain(const uint8_t *digest) const
+{
+	EMSHA_CHECK(digest != nullptr, false);
+
+	return selectProbe()(this->block(digest), digest);
+}
+
+
+std::size_t
+BloomFilter::MayContainMany(const uint8_t *digests, std::size_t count, uint64_t *results) const
+{
+	const uint64_t	*group[batchGroup];
+	probeFunc const	 probe = selectProbe();
+	std::size_t	 found = 0;
+
+	EMSHA_CHECK((digests != nullptr) || (count == 0), 0);
+	EMSHA_CHECK((results != nullptr) || (count == 0), 0);
+
+	std::fill(results, results + BloomResultWords(count), 0);
+
+	for (std::size_t start = 0; start < count; start += batchGroup) {
+		std::size_t const	n = std::min(batchGroup, count - start);
+		const uint8_t		*d = digests + (start * SHA256_HASH_SIZE);
+
+		for (std::size_t i = 0; i < n; i++) {
+			group[i] = this->block(d + (i * SHA256_HASH_SIZE));
+			prefetch(group[i]);
+		}
+
+		for (std::size_t i = 0; i < n; i++) {
+			if (probe(group[i], d + (i * SHA256_HASH_SIZE))) {
+				std::size_t const	j = start + i;
+
+				results[j / 64] |= static_cast<uint64_t>(1) << (j % 64);
+				found++;
+			}
+		}
+	}
+
+	return found;
+}
+
+
+std::size_t
+BloomFilter::MayContainMany(const Digest *digests, std::size_t count, uint64_t *results) const
+{
+	static_assert(sizeof(Digest) == SHA256_HASH_SIZE, "digests are stored back to back");
+
+	return this->MayContainMany(reinterpret_cast<const uint8_t *>(digests), count, results);
+}
+
+
+EMSHAResult
+BloomFilter::Merge(const BloomFilter& other)
+{
+	if (other.blocks != this->blocks) {
+		return EMSHAResult::InvalidState;
+	}
+
+	std::size_t const	n = this->blocks * blockWords;
+	for (std::size_t i = 0; i < n; i++) {
+		this->words[i] |= other.words[i];
+	}
+	return EMSHAResult::OK;
+}
+
+
+void
+BloomFilter::Clear()
+{
+	std::fill(this->words, this->words + (this->blocks * blockWords), 0);
+}
+
+
+std::size_t
+BloomFilter::SerializedSize() const
+{
+	return BLOOM_HEADER_SIZE + (this->blocks * cacheLine) + SHA256_HASH_SIZE;
+}
+
+
+EMSHAResult
+BloomFilter::Serialize(uint8_t *buf, std::size_t length) const
+{
+	if (buf == nullptr) {
+		return EMSHAResult::NullPointer;
+	}
+	if (length < this->SerializedSize()) {
+		return EMSHAResult::NoSpace;
+	}
+
+	std::size_t const	n = this->blocks * blockWords;
+	uint8_t			*p = buf;
+
+	std::memcpy(p, bloomMagic, sizeof(bloomMagic));
+	storeLE64(this->blocks, p + sizeof(bloomMagic));
+	p += BLOOM_HEADER_SIZE;
+
+	for (std::size_t i = 0; i < n; i++, p += 8) {
+		storeLE64(this->words[i], p);
+	}
+
+	sha256_digest(buf, static_cast<std::size_t>(p - buf), p);
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+BloomFilter::Deserialize(const uint8_t *buf, std::size_t length)
+{
+	uint8_t	digest[SHA256_HASH_SIZE];
+
+	if (buf == nullptr) {
+		return EMSHAResult::NullPointer;
+	}
+	if ((length < (BLOOM_HEADER_SIZE + SHA256_HASH_SIZE)) ||
+	    (std::memcmp(buf, bloomMagic, sizeof(bloomMagic)) != 0)) {
+		return EMSHAResult::InvalidState;
+	}
+
+	// The block count has to be a power of two that accounts for
+	// exactly the rest of the buffer.
+	uint64_t const	count = loadLE64(buf + sizeof(bloomMagic));
+	std::size_t const body = length - BLOOM_HEADER_SIZE - SHA256_HASH_SIZE;
+	if ((count == 0) || ((count & (count - 1)) != 0) ||
+	    ((body % cacheLine) != 0) || (count != (body / cacheLine))) {
+		return EMSHAResult::InvalidState;
+	}
+
+	sha256_digest(buf, length - SHA256_HASH_SIZE, digest);
+	if (!HashEqual(digest, buf + length - SHA256_HASH_SIZE)) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	if (count != this->blocks) {
+		this->allocate(static_cast<std::size_t>(count));
+	}
+
+	this->bits = 0;
+	while ((static_cast<uint64_t>(1) << this->bits) < count) {
+		this->bits++;
+	}
+
+	const uint8_t		*p = buf + BLOOM_HEADER_SIZE;
+	std::size_t const	n = this->blocks * blockWords;
+	for (std::size_t i = 0; i < n; i++, p += 8) {
+		this->words[i] = loadLE64(p);
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+BloomFilter::Save(const char *path) const
+{
+	if (path == nullptr) {
+		return EMSHAResult::NullPointer;
+	}
+
+	std::vector<uint8_t>	buf(this->SerializedSize());
+	this->Serialize(buf.data(), buf.size());
+
+	// Write beside the final path and rename into place, so a
+	// reader never loads a partial filter.
+	std::string const	tmp = std::string(path) + ".tmp";
+	FILE			*f = std::fopen(tmp.c_str(), "wb");
+	if (f == nullptr) {
+		return EMSHAResult::IOError;
+	}
+
+	bool const	written = (std::fwrite(buf.data(), 1, buf.size(), f) == buf.size());
+	if ((std::fclose(f) != 0) || !written || (std::rename(tmp.c_str(), path) != 0)) {
+		std::remove(tmp.c_str());
+		return EMSHAResult::IOError;
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+BloomFilter::Load(const char *path)
+{
+	if (path == nullptr) {
+		return EMSHAResult::NullPointer;
+	}
+
+	FILE	*f = std::fopen(path, "rb");
+	if (f == nullptr) {
+		return EMSHAResult::IOError;
+	}
+
+	std::vector<uint8_t>	buf;
+	uint8_t			chunk[4096];
+	std::size_t		n;
+
+	while ((n = std::fread(chunk, 1, sizeof(chunk), f)) != 0) {
+		buf.insert(buf.end(), chunk, chunk + n);
+	}
+
+	bool const	failed = (std::ferror(f) != 0);
+	std::fclose(f);
+	if (failed) {
+		return EMSHAResult::IOError;
+	}
+
+	if (buf.empty()) {
+		return EMSHAResult::InvalidState;
+	}
+	return this->Deserialize(buf.data(), buf.size());
+}
+
+
+} // end of namespace emsha
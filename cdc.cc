@@ -0,0 +1,354 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/digest.h>
+#include <emsha/cdc.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// The gear table maps each byte to a random 64-bit value. It's
+// generated with splitmix64 from a fixed seed, and is part of the
+// chunking format: changing it moves every boundary.
+struct gearTable {
+	uint64_t	g[256];
+
+	gearTable()
+	{
+		uint64_t	x = 0;
+
+		for (uint32_t i = 0; i < 256; i++) {
+			uint64_t	z = (x += 0x9e3779b97f4a7c15ULL);
+
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			g[i] = z ^ (z >> 31);
+		}
+	}
+};
+
+
+const uint64_t *
+gear()
+{
+	static const gearTable	table;
+
+	return table.g;
+}
+
+
+uint64_t
+topBits(uint32_t n)
+{
+	return (n == 0) ? 0 : (~static_cast<uint64_t>(0) << (64 - n));
+}
+
+
+// A job is a chunk lying entirely within a window, to be hashed in
+// place.
+struct job {
+	const uint8_t	*data;
+	uint32_t	 length;
+	std::size_t	 chunk;
+};
+
+
+// jobSource feeds chunks to sha256_lanes.
+struct jobSource {
+	const job	*jobs;
+
+	const uint8_t *Message(std::size_t i) const { return jobs[i].data; }
+	uint64_t MessageLength(std::size_t i) const { return jobs[i].length; }
+
+	uint64_t
+	Start(std::size_t i, uint32_t *ih) const
+	{
+		sha256_init(ih);
+		return 0;
+	}
+};
+
+
+// hashJobs computes the digests of count chunks through the
+// multi-lane kernel.
+void
+hashJobs(const job *jobs, std::size_t count, CDCChunk *chunks)
+{
+	jobSource const	source = {jobs};
+	auto		store = [jobs, chunks](std::size_t i, const uint32_t *ih) {
+		sha256_store(ih, chunks[jobs[i].chunk].digest.bytes);
+	};
+
+	sha256_lanes(source, count, store);
+}
+
+
+} // anonymous namespace
+
+
+CDCChunker::CDCChunker(uint32_t minSz, uint32_t avgSz, uint32_t maxSz, uint32_t nthreads)
+    : minSize(minSz), avgSize(avgSz), maxSize(maxSz), threads(std::max<uint32_t>(nthreads, 1)),
+      maskS(0), maskL(0), position(0), chunkStart(0), chunkLength(0), fp(0), carry()
+{
+	// Sizes that break the constraints would leave the masks
+	// undefined; Update and Finalise refuse to run with them.
+	if (!ValidSizes(minSz, avgSz, maxSz)) {
+		return;
+	}
+
+	uint32_t	avgBits = 0;
+	while ((static_cast<uint64_t>(1) << avgBits) < this->avgSize) {
+		avgBits++;
+	}
+
+	// One bit more than the average before it, and one bit fewer
+	// after.
+	this->maskS = topBits(avgBits + 1);
+	this->maskL = topBits(avgBits - 1);
+}
+
+
+bool
+CDCChunker::ValidSizes(uint32_t minSz, uint32_t avgSz, uint32_t maxSz)
+{
+	return (minSz >= SHA256_MB_SIZE) && (avgSz != 0) && ((avgSz & (avgSz - 1)) == 0) &&
+	       (minSz < avgSz) && (avgSz < maxSz);
+}
+
+
+void
+CDCChunker::Reset()
+{
+	this->position    = 0;
+	this->chunkStart  = 0;
+	this->chunkLength = 0;
+	this->fp          = 0;
+	this->carry.Reset();
+}
+
+
+// scan rolls the gear hash over up to n bytes of the partial chunk,
+// returning the number of bytes that belong to it; found is set if
+// they complete it.
+std::size_t
+CDCChunker::scan(const uint8_t *p, std::size_t n, bool& found)
+{
+	const uint64_t		*g = gear();
+	uint64_t		 h = this->fp;
+	std::size_t const	 have = this->chunkLength;
+	std::size_t const	 room = std::min<std::size_t>(n, this->maxSize - have);
+	std::size_t		 i = 0;
+
+	found = false;
+
+	// The first minSize bytes of a chunk can't end it, so the hash
+	// starts after them.
+	if (have < this->minSize) {
+		i = std::min<std::size_t>(room, this->minSize - have);
+	}
+
+	std::size_t const	normal = ((have + i) < this->avgSize) ?
+				    std::min<std::size_t>(room, this->avgSize - have) : i;
+
+	for (; i < normal; i++) {
+		h = (h << 1) + g[p[i]];
+		if ((h & this->maskS) == 0) {
+			found = true;
+			i++;
+			break;
+		}
+	}
+
+	if (!found) {
+		for (; i < room; i++) {
+			h = (h << 1) + g[p[i]];
+			if ((h & this->maskL) == 0) {
+				found = true;
+				i++;
+				break;
+			}
+		}
+	}
+
+	if (!found && ((have + i) == this->maxSize)) {
+		found = true;
+	}
+
+	if (found) {
+		this->fp          = 0;
+		this->chunkLength = 0;
+	} else {
+		this->fp          = h;
+		this->chunkLength = static_cast<uint32_t>(have + i);
+	}
+	return i;
+}
+
+
+EMSHAResult
+CDCChunker::window(const uint8_t *data, std::size_t n, std::vector<CDCChunk>& chunks)
+{
+	std::vector<job>	jobs;
+	std::size_t		begin = 0;
+	EMSHAResult		res;
+
+	// Find the boundaries in the window. A chunk that started in an
+	// earlier window is finished from its running digest; the rest
+	// are queued to be hashed together.
+	while (begin < n) {
+		bool			found;
+		uint32_t const		had = this->chunkLength;
+		std::size_t const	used = this->scan(data + begin, n - begin, found);
+
+		if (!found) {
+			res = this->carry.Update(data + begin, static_cast<uint32_t>(used));
+			if (res != EMSHAResult::OK) {
+				return res;
+			}
+			break;
+		}
+
+		CDCChunk	chunk;
+		chunk.offset = this->chunkStart;
+		chunk.length = static_cast<uint32_t>(had + used);
+
+		if (had != 0) {
+			res = this->carry.Update(data + begin, static_cast<uint32_t>(used));
+			if (res == EMSHAResult::OK) {
+				res = this->carry.Finalise(chunk.digest.bytes);
+			}
+			if (res != EMSHAResult::OK) {
+				return res;
+			}
+			this->carry.Reset();
+		} else {
+			job	j;
+
+			j.data   = data + begin;
+			j.length = chunk.length;
+			j.chunk  = chunks.size();
+			jobs.push_back(j);
+		}
+
+		chunks.push_back(chunk);
+		begin += used;
+		this->chunkStart = this->position + begin;
+	}
+	this->position += n;
+
+	// Hash the queued chunks, splitting them evenly between the
+	// threads.
+	std::size_t const	workers = std::min<std::size_t>(this->threads,
+								(jobs.size() + SHA256_LANES - 1) / SHA256_LANES);
+
+	if (workers <= 1) {
+		hashJobs(jobs.data(), jobs.size(), chunks.data());
+		return EMSHAResult::OK;
+	}
+
+	std::vector<std::thread>	pool;
+	std::size_t const		per = jobs.size() / workers;
+	std::size_t const		extra = jobs.size() % workers;
+	std::size_t			first = 0;
+
+	for (std::size_t w = 0; w < workers; w++) {
+		std::size_t const	count = per + ((w < extra) ? 1 : 0);
+
+		pool.emplace_back(hashJobs, jobs.data() + first, count, chunks.data());
+		first += count;
+	}
+	for (auto& t : pool) {
+		t.join();
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+CDCChunker::Update(const uint8_t *data, std::size_t length, std::vector<CDCChunk>& chunks)
+{
+	EMSHA_CHECK(ValidSizes(this->minSize, this->avgSize, this->maxSize),
+		    EMSHAResult::InvalidState);
+	if ((data == nullptr) && (length != 0)) {
+		return EMSHAResult::NullPointer;
+	}
+
+	std::size_t const	windowSize = static_cast<std::size_t>(CDC_WINDOW_SIZE) * this->threads;
+
+	while (length > 0) {
+		std::size_t const	n = std::min(length, windowSize);
+		EMSHAResult const	res = this->window(data, n, chunks);
+
+		if (res != EMSHAResult::OK) {
+			return res;
+		}
+		data   += n;
+		length -= n;
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+CDCChunker::Finalise(std::vector<CDCChunk>& chunks)
+{
+	EMSHA_CHECK(ValidSizes(this->minSize, this->avgSize, this->maxSize),
+		    EMSHAResult::InvalidState);
+
+	EMSHAResult	res = EMSHAResult::OK;
+
+	if (this->chunkLength != 0) {
+		CDCChunk	chunk;
+
+		chunk.offset = this->chunkStart;
+		chunk.length = this->chunkLength;
+		res = this->carry.Finalise(chunk.digest.bytes);
+		if (res == EMSHAResult::OK) {
+			chunks.push_back(chunk);
+		}
+	}
+
+	this->Reset();
+	return res;
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,403 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/compact.h>
+#include <emsha/chunked.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+const uint8_t	chunkedMagic[8] = {'E', 'M', 'S', 'H', 'A', 'C', 'K', '2'};
+
+// The header is laid out as
+//
+//	 0	magic
+//	 8	chunk size (big-endian)
+//	12	zero
+//	16	stream identifier
+//	32	data length (big-endian)
+const uint32_t	headerIDOffset = 16;
+const uint32_t	headerLengthOffset = headerIDOffset + CHUNKED_STREAM_ID_SIZE;
+
+// Each tag covers the header and the chunk index ahead of the chunk
+// data.
+const uint32_t	tagPrefixSize = CHUNKED_HEADER_SIZE + 8;
+
+
+void
+put32(uint8_t *p, uint32_t v)
+{
+	for (uint32_t i = 0; i < 4; i++) {
+		p[i] = static_cast<uint8_t>(v >> (24 - (8 * i)));
+	}
+}
+
+
+void
+put64(uint8_t *p, uint64_t v)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		p[i] = static_cast<uint8_t>(v >> (56 - (8 * i)));
+	}
+}
+
+
+uint64_t
+get64(const uint8_t *p)
+{
+	uint64_t	v = 0;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+
+// verifyRun checks count chunks laid out back to back from encoded,
+// the first of which is chunk first, giving up early if another
+// thread has already found a bad chunk.
+void
+verifyRun(const ChunkedStream *cs, const uint8_t *header, uint64_t dataLength,
+	  uint64_t first, uint64_t count, const uint8_t *encoded,
+	  std::atomic<bool> *failed)
+{
+	uint64_t const	nchunks = cs->Chunks(dataLength);
+	uint32_t const	size = cs->ChunkSize();
+	uint8_t		tag[CHUNKED_TAG_SIZE];
+
+	for (uint64_t i = first; i < first + count; i++) {
+		if (failed->load(std::memory_order_relaxed)) {
+			return;
+		}
+
+		bool const	final = (i == (nchunks - 1));
+		uint32_t const	length = final ?
+		    static_cast<uint32_t>(dataLength - (i * size)) : size;
+
+		if ((EMSHAResult::OK != cs->Tag(header, i, encoded, length, tag)) ||
+		    !HashEqual(tag, encoded + length)) {
+			failed->store(true, std::memory_order_relaxed);
+			return;
+		}
+
+		encoded += static_cast<uint64_t>(length) + CHUNKED_TAG_SIZE;
+	}
+}
+
+
+} // anonymous namespace
+
+
+ChunkedStream::ChunkedStream(const uint8_t *k, uint32_t kl, uint32_t cs)
+    : key(), chunkSize((cs == 0) ? CHUNKED_CHUNK_SIZE : cs)
+{
+	HMACPrecompute(k, kl, this->key);
+}
+
+
+ChunkedStream::~ChunkedStream()
+{
+	HMACMidstateWipe(this->key);
+}
+
+
+uint64_t
+ChunkedStream::Chunks(uint64_t dataLength) const
+{
+	// The final chunk is always short, so data that ends on a
+	// chunk boundary is followed by an empty chunk.
+	return (dataLength / this->chunkSize) + 1;
+}
+
+
+uint64_t
+ChunkedStream::EncodedLength(uint64_t dataLength) const
+{
+	return CHUNKED_HEADER_SIZE + dataLength +
+	       (this->Chunks(dataLength) * CHUNKED_TAG_SIZE);
+}
+
+
+uint64_t
+ChunkedStream::ChunkOffset(uint64_t index) const
+{
+	return CHUNKED_HEADER_SIZE +
+	       (index * (static_cast<uint64_t>(this->chunkSize) + CHUNKED_TAG_SIZE));
+}
+
+
+EMSHAResult
+ChunkedStream::EncodedRange(uint64_t dataLength, uint64_t offset, uint64_t length,
+			    uint64_t& first, uint64_t& start, uint64_t& end) const
+{
+	if ((offset > dataLength) || (length > (dataLength - offset))) {
+		return EMSHAResult::InvalidState;
+	}
+
+	uint64_t const	nchunks = this->Chunks(dataLength);
+	uint64_t const	last = (length == 0) ? (offset / this->chunkSize) :
+				((offset + length - 1) / this->chunkSize);
+
+	first = offset / this->chunkSize;
+	start = this->ChunkOffset(first);
+
+	if (last == (nchunks - 1)) {
+		end = this->EncodedLength(dataLength);
+	} else {
+		end = this->ChunkOffset(last + 1);
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+ChunkedStream::WriteHeader(uint8_t *header, const uint8_t *streamID,
+			   uint64_t dataLength) const
+{
+	if ((nullptr == header) || (nullptr == streamID)) { return EMSHAResult::NullPointer; }
+
+	std::copy(chunkedMagic, chunkedMagic + 8, header);
+	put32(header + 8, this->chunkSize);
+	put32(header + 12, 0);
+	std::copy(streamID, streamID + CHUNKED_STREAM_ID_SIZE, header + headerIDOffset);
+	put64(header + headerLengthOffset, dataLength);
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+ChunkedStream::CheckHeader(const uint8_t *header, uint64_t *dataLength) const
+{
+	uint8_t	want[headerIDOffset];
+
+	if (nullptr == header) { return EMSHAResult::NullPointer; }
+
+	std::copy(chunkedMagic, chunkedMagic + 8, want);
+	put32(want + 8, this->chunkSize);
+	put32(want + 12, 0);
+	if (!std::equal(want, want + headerIDOffset, header)) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	// A length whose encoding wouldn't fit in 64 bits can't be
+	// genuine.
+	uint64_t const	length = get64(header + headerLengthOffset);
+	uint64_t const	stride = static_cast<uint64_t>(this->chunkSize) + CHUNKED_TAG_SIZE;
+	if (((length / this->chunkSize) + 1) > ((UINT64_MAX - CHUNKED_HEADER_SIZE) / stride)) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	if (nullptr != dataLength) {
+		*dataLength = length;
+	}
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+ChunkedStream::Tag(const uint8_t *header, uint64_t index, const uint8_t *chunk,
+		   uint32_t length, uint8_t *tag) const
+{
+	if ((nullptr == chunk) && (length != 0)) { return EMSHAResult::NullPointer; }
+	if (nullptr == tag) { return EMSHAResult::NullPointer; }
+
+	uint64_t	dataLength = 0;
+	EMSHAResult	res = this->CheckHeader(header, &dataLength);
+
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	uint64_t const	nchunks = this->Chunks(dataLength);
+	if ((index >= nchunks) ||
+	    (length != ((index == (nchunks - 1)) ?
+			(dataLength - (index * this->chunkSize)) : this->chunkSize))) {
+		return EMSHAResult::InvalidState;
+	}
+
+	uint8_t		prefix[tagPrefixSize];
+	uint8_t		storage[SHA256_MB_SIZE];
+	uint32_t	freeList[1];
+
+	std::copy(header, header + CHUNKED_HEADER_SIZE, prefix);
+	put64(prefix + CHUNKED_HEADER_SIZE, index);
+
+	// A one-block slab on the stack is all a single HMAC needs.
+	BlockSlab	slab(storage, freeList, 1);
+	CompactHMAC	mac(&this->key, slab);
+
+	res = mac.Update(slab, prefix, tagPrefixSize);
+	if (EMSHAResult::OK == res) {
+		res = mac.Update(slab, chunk, length);
+	}
+	if (EMSHAResult::OK == res) {
+		res = mac.Finalise(slab, tag);
+	}
+
+	return res;
+}
+
+
+EMSHAResult
+ChunkedStream::Encode(const uint8_t *data, uint64_t dataLength, uint8_t *encoded) const
+{
+	uint8_t	streamID[CHUNKED_STREAM_ID_SIZE];
+
+	NewStreamID(streamID);
+	return this->Encode(data, dataLength, streamID, encoded);
+}
+
+
+EMSHAResult
+ChunkedStream::Encode(const uint8_t *data, uint64_t dataLength, const uint8_t *streamID,
+		      uint8_t *encoded) const
+{
+	if ((nullptr == data) && (dataLength != 0)) { return EMSHAResult::NullPointer; }
+	if (nullptr == encoded) { return EMSHAResult::NullPointer; }
+
+	EMSHAResult	res = this->WriteHeader(encoded, streamID, dataLength);
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	const uint8_t	*header = encoded;
+	uint64_t const	 nchunks = this->Chunks(dataLength);
+
+	encoded += CHUNKED_HEADER_SIZE;
+	for (uint64_t i = 0; (i < nchunks) && (EMSHAResult::OK == res); i++) {
+		bool const	final = (i == (nchunks - 1));
+		uint32_t const	length = final ?
+		    static_cast<uint32_t>(dataLength - (i * this->chunkSize)) :
+		    this->chunkSize;
+
+		std::copy(data, data + length, encoded);
+		res = this->Tag(header, i, data, length, encoded + length);
+
+		data    += length;
+		encoded += static_cast<uint64_t>(length) + CHUNKED_TAG_SIZE;
+	}
+
+	return res;
+}
+
+
+void
+ChunkedStream::NewStreamID(uint8_t *streamID)
+{
+	std::random_device	rd;
+
+	for (uint32_t i = 0; i < CHUNKED_STREAM_ID_SIZE; i += 4) {
+		put32(streamID + i, static_cast<uint32_t>(rd()));
+	}
+}
+
+
+EMSHAResult
+ChunkedStream::VerifyChunks(const uint8_t *header, uint64_t first,
+			    const uint8_t *encoded, uint64_t encodedLength,
+			    uint32_t threads) const
+{
+	if (nullptr == encoded) { return EMSHAResult::NullPointer; }
+
+	uint64_t	dataLength = 0;
+	EMSHAResult	res = this->CheckHeader(header, &dataLength);
+
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	uint64_t const	nchunks = this->Chunks(dataLength);
+	uint64_t const	stride = static_cast<uint64_t>(this->chunkSize) + CHUNKED_TAG_SIZE;
+
+	// Work out how many chunks there are, and that they are all
+	// there: only the final chunk is allowed to be short.
+	uint64_t	count = 0;
+	uint64_t	pos = 0;
+
+	while (pos < encodedLength) {
+		uint64_t const i = first + count;
+		if (i >= nchunks) {
+			return EMSHAResult::InvalidState;
+		}
+
+		uint64_t const length = (i == (nchunks - 1)) ?
+		    (dataLength - (i * this->chunkSize)) : this->chunkSize;
+		if ((encodedLength - pos) < (length + CHUNKED_TAG_SIZE)) {
+			return EMSHAResult::InvalidState;
+		}
+
+		pos += length + CHUNKED_TAG_SIZE;
+		count++;
+	}
+
+	if (count == 0) {
+		return EMSHAResult::InvalidState;
+	}
+
+	std::atomic<bool>	failed(false);
+	uint64_t const		workers = std::min<uint64_t>(std::max<uint32_t>(threads, 1), count);
+
+	if (workers == 1) {
+		verifyRun(this, header, dataLength, first, count, encoded, &failed);
+	} else {
+		std::vector<std::thread>	pool;
+		uint64_t const			per = count / workers;
+		uint64_t const			extra = count % workers;
+		uint64_t			next = 0;
+
+		for (uint64_t w = 0; w < workers; w++) {
+			uint64_t const n = per + ((w < extra) ? 1 : 0);
+
+			pool.emplace_back(verifyRun, this, header, dataLength, first + next,
+					  n, encoded + (next * stride), &failed);
+			next += n;
+		}
+
+		for (auto& t : pool) {
+			t.join();
+		}
+	}
+
+	return failed.load() ? EMSHAResult::VerifyFailed : EMSHAResult::OK;
+}
+
+
+} // end of namespace emsha
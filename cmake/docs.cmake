@@ -16,6 +16,7 @@ macro(md2man source)
 endmacro()
 
 md2man(docs/emsha.3.md)
+md2man(docs/emsha-sum.1.md)
 
 find_package(Doxygen)
 if (${DOXYGEN_FOUND})
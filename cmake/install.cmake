@@ -17,6 +17,9 @@ configure_file(${PROJECT_NAME}.pc.in ${PROJECT_NAME}.pc @ONLY)
 ### set up installation targets.
 
 install(TARGETS ${PROJECT_NAME} LIBRARY DESTINATION lib)
+if (TARGET emsha-sum)
+	install(TARGETS emsha-sum RUNTIME DESTINATION bin)
+endif ()
 install(FILES ${HEADERS} DESTINATION include/${PROJECT_NAME})
 install(FILES ${CMAKE_CURRENT_BINARY_DIR}/${PROJECT_NAME}.pc
 	DESTINATION lib/pkgconfig)
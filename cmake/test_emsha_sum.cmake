@@ -0,0 +1,71 @@
+# End-to-end test for emsha-sum: generate a manifest over a small tree,
+# check it, and make sure a modified file is caught.
+#
+# Run with cmake -DEMSHA_SUM=/path/to/emsha-sum -P test_emsha_sum.cmake.
+
+set(TREE ${CMAKE_CURRENT_BINARY_DIR}/emsha_sum_tree)
+file(REMOVE_RECURSE ${TREE})
+file(MAKE_DIRECTORY ${TREE}/sub)
+file(WRITE ${TREE}/abc "abc")
+file(WRITE ${TREE}/empty "")
+file(WRITE ${TREE}/sub/hello "hello, world")
+
+# A file large enough to take the mmap path.
+string(REPEAT "0123456789abcdef" 131072 big)
+file(WRITE ${TREE}/sub/big "${big}")
+
+execute_process(COMMAND ${EMSHA_SUM} -r ${TREE}
+	OUTPUT_VARIABLE manifest
+	RESULT_VARIABLE status)
+if (NOT status EQUAL 0)
+	message(FATAL_ERROR "emsha-sum -r failed: ${status}")
+endif ()
+
+set(expected
+"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad  ${TREE}/abc
+e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855  ${TREE}/empty
+")
+string(FIND "${manifest}" "${expected}" pos)
+if (NOT pos EQUAL 0)
+	message(FATAL_ERROR "unexpected emsha-sum output:\n${manifest}")
+endif ()
+string(FIND "${manifest}"
+	"09ca7e4eaa6e8ae9c7d261167129184883644d07dfba7cbfbc4c8a2e08360d5b  ${TREE}/sub/hello"
+	pos)
+if (pos EQUAL -1)
+	message(FATAL_ERROR "missing or wrong digest for sub/hello:\n${manifest}")
+endif ()
+
+find_program(SHA256SUM sha256sum)
+if (SHA256SUM)
+	execute_process(COMMAND ${SHA256SUM} ${TREE}/abc ${TREE}/empty ${TREE}/sub/big ${TREE}/sub/hello
+		OUTPUT_VARIABLE reference)
+	execute_process(COMMAND ${EMSHA_SUM} -j 3 ${TREE}/abc ${TREE}/empty ${TREE}/sub/big ${TREE}/sub/hello
+		OUTPUT_VARIABLE actual)
+	if (NOT actual STREQUAL reference)
+		message(FATAL_ERROR "output differs from sha256sum:\n${actual}\n${reference}")
+	endif ()
+endif ()
+
+file(WRITE ${TREE}.sha256 "${manifest}")
+execute_process(COMMAND ${EMSHA_SUM} -c ${TREE}.sha256
+	OUTPUT_VARIABLE checked
+	RESULT_VARIABLE status)
+if (NOT status EQUAL 0)
+	message(FATAL_ERROR "emsha-sum -c failed on a good manifest:\n${checked}")
+endif ()
+
+file(WRITE ${TREE}/abc "abd")
+execute_process(COMMAND ${EMSHA_SUM} -c ${TREE}.sha256
+	OUTPUT_VARIABLE checked
+	ERROR_VARIABLE warnings
+	RESULT_VARIABLE status)
+if (status EQUAL 0)
+	message(FATAL_ERROR "emsha-sum -c passed a modified file:\n${checked}")
+endif ()
+string(FIND "${checked}" "${TREE}/abc: FAILED" pos)
+if (pos EQUAL -1)
+	message(FATAL_ERROR "modified file not reported:\n${checked}")
+endif ()
+
+file(REMOVE_RECURSE ${TREE} ${TREE}.sha256)
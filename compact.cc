@@ -0,0 +1,352 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/hmac.h>
+#include <emsha/compact.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+// These constants track the state of a compact context.
+
+// The context can be written to.
+constexpr uint8_t COMPACT_OK = 0;
+
+// The context has been finalised (or released).
+constexpr uint8_t COMPACT_FIN = 1;
+
+// Too much data was written to the context.
+constexpr uint8_t COMPACT_INVALID = 2;
+
+
+static constexpr uint8_t ipad = 0x36;
+static constexpr uint8_t opad = 0x5c;
+
+
+EMSHAResult
+HMACPrecompute(const uint8_t *k, uint32_t kl, HMACMidstate& midstate)
+{
+	uint8_t	k0[HMAC_KEY_LENGTH] = {0};
+	uint8_t	block[HMAC_KEY_LENGTH];
+
+	if ((k == nullptr) && (kl != 0)) { return EMSHAResult::NullPointer; }
+
+	// Keys longer than a block are hashed down, as in the HMAC
+	// constructor.
+	if (kl > HMAC_KEY_LENGTH) {
+		SHA256	ctx;
+		ctx.Update(k, kl);
+		ctx.Finalise(k0);
+	} else {
+		std::copy(k, k + kl, k0);
+	}
+
+	for (uint32_t i = 0; i < HMAC_KEY_LENGTH; i++) {
+		block[i] = k0[i] ^ ipad;
+	}
+	sha256_init(midstate.inner);
+	sha256_compress(midstate.inner, block, 1);
+
+	for (uint32_t i = 0; i < HMAC_KEY_LENGTH; i++) {
+		block[i] = k0[i] ^ opad;
+	}
+	sha256_init(midstate.outer);
+	sha256_compress(midstate.outer, block, 1);
+
+	// Both of these are considered sensitive material and should
+	// be wiped.
+	std::fill(k0, k0 + HMAC_KEY_LENGTH, 0);
+	std::fill(block, block + HMAC_KEY_LENGTH, 0);
+
+	EMSHA_STAT_ADD(StatHMACKeySetups, 1);
+	return EMSHAResult::OK;
+}
+
+
+void
+HMACMidstateWipe(HMACMidstate& midstate)
+{
+	volatile uint32_t	*p = midstate.inner;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		p[i] = 0;
+	}
+
+	p = midstate.outer;
+	for (uint32_t i = 0; i < 8; i++) {
+		p[i] = 0;
+	}
+}
+
+
+BlockSlab::BlockSlab(uint32_t cap)
+    : blocks(new uint8_t[static_cast<uint64_t>(cap) * SHA256_MB_SIZE]()),
+      freeList(new uint32_t[cap]), capacity(cap), available(cap), owned(true)
+{
+	for (uint32_t i = 0; i < cap; i++) {
+		this->freeList[i] = cap - 1 - i;
+	}
+}
+
+
+BlockSlab::BlockSlab(uint8_t *storage, uint32_t *fl, uint32_t cap)
+    : blocks(storage), freeList(fl), capacity(cap), available(cap), owned(false)
+{
+	std::fill(this->blocks, this->blocks + (static_cast<uint64_t>(cap) * SHA256_MB_SIZE), 0);
+	for (uint32_t i = 0; i < cap; i++) {
+		this->freeList[i] = cap - 1 - i;
+	}
+}
+
+
+BlockSlab::~BlockSlab()
+{
+	std::fill(this->blocks,
+		  this->blocks + (static_cast<uint64_t>(this->capacity) * SHA256_MB_SIZE), 0);
+
+	if (this->owned) {
+		delete[] this->blocks;
+		delete[] this->freeList;
+	}
+}
+
+
+uint32_t
+BlockSlab::Acquire()
+{
+	if (this->available == 0) {
+		return NO_BLOCK;
+	}
+
+	return this->freeList[--this->available];
+}
+
+
+void
+BlockSlab::Release(uint32_t block)
+{
+	assert(block < this->capacity);
+	assert(this->available < this->capacity);
+
+	uint8_t	*b = this->Block(block);
+	std::fill(b, b + SHA256_MB_SIZE, 0);
+	this->freeList[this->available++] = block;
+}
+
+
+CompactSHA256::CompactSHA256()
+    : i_hash(), mlen(0), block(BlockSlab::NO_BLOCK), state(COMPACT_OK)
+{
+	sha256_init(this->i_hash);
+}
+
+
+void
+CompactSHA256::Reset(BlockSlab& slab)
+{
+	this->Release(slab);
+	sha256_init(this->i_hash);
+	this->state = COMPACT_OK;
+}
+
+
+void
+CompactSHA256::Reset(BlockSlab& slab, const uint32_t *ih, uint64_t length)
+{
+	assert(0 == (length % SHA256_MB_SIZE));
+
+	this->Release(slab);
+	std::copy(ih, ih + 8, this->i_hash);
+	this->mlen  = length;
+	this->state = COMPACT_OK;
+}
+
+
+EMSHAResult
+CompactSHA256::Update(BlockSlab& slab, const uint8_t *message, uint32_t messageLength)
+{
+	if (0 == messageLength) { return EMSHAResult::OK; }
+	if (nullptr == message) { return EMSHAResult::NullPointer; }
+	if (COMPACT_OK != this->state) { return EMSHAResult::InvalidState; }
+
+	// The bit length has to fit in 64 bits.
+	if ((this->mlen + messageLength) > (UINT64_MAX >> 3)) {
+		this->state = COMPACT_INVALID;
+		return EMSHAResult::InputTooLong;
+	}
+
+	uint32_t	plen = static_cast<uint32_t>(this->mlen % SHA256_MB_SIZE);
+	uint32_t const	rest = static_cast<uint32_t>((this->mlen + messageLength) % SHA256_MB_SIZE);
+
+	// Take the block a leftover partial block will need before
+	// touching anything, so that running out of blocks leaves the
+	// context as it was.
+	if ((rest != 0) && (BlockSlab::NO_BLOCK == this->block)) {
+		this->block = slab.Acquire();
+		if (BlockSlab::NO_BLOCK == this->block) {
+			return EMSHAResult::NoSpace;
+		}
+	}
+
+	uint8_t	*pb = (BlockSlab::NO_BLOCK == this->block) ? nullptr : slab.Block(this->block);
+
+	this->mlen += messageLength;
+	EMSHA_STAT_ADD(StatBytesHashed, messageLength);
+
+	if (plen != 0) {
+		uint32_t const fill = std::min(SHA256_MB_SIZE - plen, messageLength);
+
+		std::copy(message, message + fill, pb + plen);
+		plen          += fill;
+		message       += fill;
+		messageLength -= fill;
+
+		if (SHA256_MB_SIZE == plen) {
+			sha256_compress(this->i_hash, pb, 1);
+		}
+	}
+
+	uint32_t const nblocks = messageLength / SHA256_MB_SIZE;
+	sha256_compress(this->i_hash, message, nblocks);
+	message       += nblocks * SHA256_MB_SIZE;
+	messageLength -= nblocks * SHA256_MB_SIZE;
+
+	if (messageLength != 0) {
+		std::copy(message, message + messageLength, pb);
+	}
+
+	if ((rest == 0) && (BlockSlab::NO_BLOCK != this->block)) {
+		slab.Release(this->block);
+		this->block = BlockSlab::NO_BLOCK;
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+CompactSHA256::Finalise(BlockSlab& slab, uint8_t *digest)
+{
+	if (nullptr == digest) { return EMSHAResult::NullPointer; }
+	if (COMPACT_OK != this->state) { return EMSHAResult::InvalidState; }
+
+	uint32_t const	plen = static_cast<uint32_t>(this->mlen % SHA256_MB_SIZE);
+	const uint8_t	*pb = (BlockSlab::NO_BLOCK == this->block) ? nullptr : slab.Block(this->block);
+
+	sha256_pad(this->i_hash, pb, plen, this->mlen << 3);
+	sha256_store(this->i_hash, digest);
+
+	this->Release(slab);
+	return EMSHAResult::OK;
+}
+
+
+void
+CompactSHA256::Release(BlockSlab& slab)
+{
+	if (BlockSlab::NO_BLOCK != this->block) {
+		slab.Release(this->block);
+		this->block = BlockSlab::NO_BLOCK;
+	}
+
+	std::fill(this->i_hash, this->i_hash + 8, 0);
+	this->mlen  = 0;
+	this->state = COMPACT_FIN;
+}
+
+
+CompactHMAC::CompactHMAC(const HMACMidstate *k, BlockSlab& slab)
+    : key(k)
+{
+	this->Reset(slab);
+}
+
+
+void
+CompactHMAC::Reset(BlockSlab& slab)
+{
+	this->inner.Reset(slab, this->key->inner, HMAC_KEY_LENGTH);
+}
+
+
+EMSHAResult
+CompactHMAC::Update(BlockSlab& slab, const uint8_t *message, uint32_t messageLength)
+{
+	return this->inner.Update(slab, message, messageLength);
+}
+
+
+EMSHAResult
+CompactHMAC::Finalise(BlockSlab& slab, uint8_t *digest)
+{
+	uint8_t		innerDigest[SHA256_HASH_SIZE];
+	EMSHAResult	res;
+
+	if (nullptr == digest) { return EMSHAResult::NullPointer; }
+
+	res = this->inner.Finalise(slab, innerDigest);
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	sha256_oneshot(this->key->outer, HMAC_KEY_LENGTH, innerDigest,
+		       SHA256_HASH_SIZE, digest);
+	std::fill(innerDigest, innerDigest + SHA256_HASH_SIZE, 0);
+	return EMSHAResult::OK;
+}
+
+
+void
+CompactHMAC::Release(BlockSlab& slab)
+{
+	this->inner.Release(slab);
+}
+
+
+EMSHAResult
+ComputeHMAC(const HMACMidstate& key, const uint8_t *m, uint32_t ml, uint8_t *d)
+{
+	uint8_t	innerDigest[SHA256_HASH_SIZE];
+
+	if ((nullptr == m) && (ml != 0)) { return EMSHAResult::NullPointer; }
+	if (nullptr == d) { return EMSHAResult::NullPointer; }
+
+	sha256_oneshot(key.inner, HMAC_KEY_LENGTH, m, ml, innerDigest);
+	sha256_oneshot(key.outer, HMAC_KEY_LENGTH, innerDigest, SHA256_HASH_SIZE, d);
+	std::fill(innerDigest, innerDigest + SHA256_HASH_SIZE, 0);
+
+	return EMSHAResult::OK;
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,306 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/crc32c.h>
+#include <emsha/internal.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define EMSHA_CRC32C_X86
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define EMSHA_CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// forceSoftware is set by crc32c_force_software.
+std::atomic<bool>	forceSoftware(false);
+
+// The reflected Castagnoli polynomial.
+constexpr uint32_t	castagnoli = 0x82f63b78;
+
+// SHA256CRC32C takes its data in strips of this size, small enough
+// to stay in L1 between the two passes over it.
+constexpr uint32_t	stripSize = 16 * SHA256_MB_SIZE;
+
+
+// crcTables holds the slicing-by-8 tables: table[0] is the usual
+// byte-at-a-time table, and table[k] advances a byte through k
+// further zero bytes.
+struct crcTables {
+	uint32_t	table[8][256];
+
+	crcTables()
+	{
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t	c = i;
+
+			for (uint32_t j = 0; j < 8; j++) {
+				c = (c >> 1) ^ ((c & 1) ? castagnoli : 0);
+			}
+			table[0][i] = c;
+		}
+
+		for (uint32_t k = 1; k < 8; k++) {
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t const	prev = table[k - 1][i];
+
+				table[k][i] = (prev >> 8) ^ table[0][prev & 0xff];
+			}
+		}
+	}
+};
+
+
+uint32_t
+crcSoftware(uint32_t c, const uint8_t *p, std::size_t n)
+{
+	static const crcTables	tables;
+	const uint32_t		(*t)[256] = tables.table;
+
+	for (; n >= 8; n -= 8, p += 8) {
+		uint32_t const	lo = c ^ (static_cast<uint32_t>(p[0]) |
+					  (static_cast<uint32_t>(p[1]) << 8) |
+					  (static_cast<uint32_t>(p[2]) << 16) |
+					  (static_cast<uint32_t>(p[3]) << 24));
+
+		c = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+		    t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+		    t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+	}
+
+	for (; n > 0; n--, p++) {
+		c = t[0][(c ^ *p) & 0xff] ^ (c >> 8);
+	}
+	return c;
+}
+
+
+#if defined(EMSHA_CRC32C_X86)
+
+__attribute__((target("sse4.2")))
+uint32_t
+crcHardware(uint32_t c, const uint8_t *p, std::size_t n)
+{
+	for (; (n > 0) && ((reinterpret_cast<uintptr_t>(p) & 7) != 0); n--, p++) {
+		c = _mm_crc32_u8(c, *p);
+	}
+
+	uint64_t	c64 = c;
+	for (; n >= 8; n -= 8, p += 8) {
+		uint64_t	w;
+
+		std::memcpy(&w, p, sizeof(w));
+		c64 = _mm_crc32_u64(c64, w);
+	}
+	c = static_cast<uint32_t>(c64);
+
+	for (; n > 0; n--, p++) {
+		c = _mm_crc32_u8(c, *p);
+	}
+	return c;
+}
+
+
+bool
+haveHardware()
+{
+	static bool const	sse42 = __builtin_cpu_supports("sse4.2");
+
+	return sse42;
+}
+
+#elif defined(EMSHA_CRC32C_ARM)
+
+uint32_t
+crcHardware(uint32_t c, const uint8_t *p, std::size_t n)
+{
+	for (; (n > 0) && ((reinterpret_cast<uintptr_t>(p) & 7) != 0); n--, p++) {
+		c = __crc32cb(c, *p);
+	}
+
+	for (; n >= 8; n -= 8, p += 8) {
+		uint64_t	w;
+
+		std::memcpy(&w, p, sizeof(w));
+		c = __crc32cd(c, w);
+	}
+
+	for (; n > 0; n--, p++) {
+		c = __crc32cb(c, *p);
+	}
+	return c;
+}
+
+
+bool
+haveHardware()
+{
+	return true;
+}
+
+#else
+
+uint32_t
+crcHardware(uint32_t c, const uint8_t *p, std::size_t n)
+{
+	return crcSoftware(c, p, n);
+}
+
+
+bool
+haveHardware()
+{
+	return false;
+}
+
+#endif
+
+
+void
+storeCRC(uint32_t crc, uint8_t *p)
+{
+	for (uint32_t i = 0; i < 4; i++) {
+		p[i] = static_cast<uint8_t>(crc >> (24 - (8 * i)));
+	}
+}
+
+
+} // anonymous namespace
+
+
+bool
+crc32c_force_software(bool force)
+{
+	return forceSoftware.exchange(force);
+}
+
+
+uint32_t
+CRC32C(const uint8_t *m, std::size_t ml, uint32_t crc)
+{
+	EMSHA_CHECK((m != nullptr) || (ml == 0), crc);
+
+	uint32_t const	c = ~crc;
+
+	if (haveHardware() && !forceSoftware.load(std::memory_order_relaxed)) {
+		return ~crcHardware(c, m, ml);
+	}
+	return ~crcSoftware(c, m, ml);
+}
+
+
+SHA256CRC32C::SHA256CRC32C()
+    : sha(), crc(0)
+{
+}
+
+
+EMSHAResult
+SHA256CRC32C::Reset()
+{
+	this->crc = 0;
+	return this->sha.Reset();
+}
+
+
+EMSHAResult
+SHA256CRC32C::Update(const uint8_t *message, uint32_t messageLength)
+{
+	if (0 == messageLength) { return EMSHAResult::OK; }
+	if (nullptr == message) { return EMSHAResult::NullPointer; }
+
+	// Each strip is hashed first, and only folded into the CRC once
+	// the hash has taken it, so the two always cover the same data.
+	while (messageLength > 0) {
+		uint32_t const		n = std::min(messageLength, stripSize);
+		EMSHAResult const	res = this->sha.Update(message, n);
+
+		if (EMSHAResult::OK != res) {
+			return res;
+		}
+		this->crc = CRC32C(message, n, this->crc);
+
+		message       += n;
+		messageLength -= n;
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+SHA256CRC32C::Finalise(uint8_t *digest)
+{
+	if (nullptr == digest) { return EMSHAResult::NullPointer; }
+
+	EMSHAResult const	res = this->sha.Finalise(digest);
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	storeCRC(this->crc, digest + SHA256_HASH_SIZE);
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+SHA256CRC32C::Result(uint8_t *digest)
+{
+	if (nullptr == digest) { return EMSHAResult::NullPointer; }
+
+	EMSHAResult const	res = this->sha.Result(digest);
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	storeCRC(this->crc, digest + SHA256_HASH_SIZE);
+	return EMSHAResult::OK;
+}
+
+
+uint32_t
+SHA256CRC32C::Size()
+{
+	return SHA256CRC32C_SIZE;
+}
+
+
+} // end of namespace emsha
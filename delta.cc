@@ -0,0 +1,498 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/digest.h>
+#include <emsha/delta.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// NO_BLOCK ends a chain in the block table.
+constexpr uint32_t	NO_BLOCK = 0xffffffff;
+
+
+// weakSum is rsync's rolling checksum: a is the sum of the bytes in
+// the window and b the sum of the successive values of a, so that
+// moving the window on a byte only needs the bytes leaving and
+// entering it. Only the low 16 bits of each are used, so they are
+// left to wrap.
+struct weakSum {
+	uint32_t	a;
+	uint32_t	b;
+
+	void
+	start(const uint8_t *p, uint32_t n)
+	{
+		this->a = 0;
+		this->b = 0;
+		for (uint32_t i = 0; i < n; i++) {
+			this->a += p[i];
+			this->b += this->a;
+		}
+	}
+
+	void
+	roll(uint8_t out, uint8_t in, uint32_t n)
+	{
+		this->a += static_cast<uint32_t>(in) - out;
+		this->b += this->a - (n * out);
+	}
+
+	uint32_t
+	value() const
+	{
+		return (this->a & 0xffff) | (this->b << 16);
+	}
+};
+
+
+// blockGroup feeds a group of equal-length blocks to sha256_lanes.
+struct blockGroup {
+	const uint8_t *const	*msgs;
+	uint32_t		 length;
+
+	const uint8_t *Message(std::size_t i) const { return msgs[i]; }
+	uint64_t MessageLength(std::size_t i) const { return length; }
+
+	uint64_t
+	Start(std::size_t i, uint32_t *ih) const
+	{
+		sha256_init(ih);
+		return 0;
+	}
+};
+
+
+// hashLanes computes the digests of count messages of the same
+// length side by side.
+void
+hashLanes(const uint8_t *const *msgs, std::size_t count, uint32_t length,
+	  uint8_t *const *digests)
+{
+	blockGroup const	group = {msgs, length};
+	auto			store = [digests](std::size_t i, const uint32_t *ih) {
+		sha256_store(ih, digests[i]);
+	};
+
+	sha256_lanes(group, count, store);
+}
+
+
+// signBlocks signs count full blocks of the base, starting with
+// block first, a lane group at a time.
+void
+signBlocks(const uint8_t *base, uint32_t blockSize, DeltaBlock *blocks,
+	   std::size_t first, std::size_t count)
+{
+	const uint8_t	*msgs[SHA256_LANES];
+	uint8_t		*digests[SHA256_LANES];
+
+	for (std::size_t i = first; i < first + count; i += SHA256_LANES) {
+		std::size_t const	n = std::min<std::size_t>(SHA256_LANES, first + count - i);
+
+		for (std::size_t l = 0; l < n; l++) {
+			DeltaBlock&	block = blocks[i + l];
+			weakSum		w;
+
+			msgs[l] = base + (static_cast<uint64_t>(i + l) * blockSize);
+			w.start(msgs[l], blockSize);
+			block.weak  = w.value();
+			digests[l]  = block.strong.bytes;
+		}
+		hashLanes(msgs, n, blockSize, digests);
+	}
+}
+
+
+// blockTable finds the full blocks of a signature by weak checksum:
+// heads is a power-of-two table of chains through next, which run
+// in base order.
+class blockTable {
+public:
+	blockTable(const DeltaSignature& sig, uint32_t count)
+	    : blocks(sig.blocks.data()), heads(), next(count, NO_BLOCK), shift(28)
+	{
+		uint32_t	size = 16;
+
+		while (size < (2 * static_cast<uint64_t>(count))) {
+			size <<= 1;
+			this->shift--;
+		}
+		this->heads.assign(size, NO_BLOCK);
+
+		for (uint32_t i = count; i > 0; i--) {
+			uint32_t&	head = this->heads[this->slot(this->blocks[i - 1].weak)];
+
+			this->next[i - 1] = head;
+			head = i - 1;
+		}
+	}
+
+	// find reports whether any block has the weak checksum.
+	bool
+	find(uint32_t weak) const
+	{
+		for (uint32_t b = this->heads[this->slot(weak)]; b != NO_BLOCK; b = this->next[b]) {
+			if (this->blocks[b].weak == weak) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// match returns a block with both checksums, preferring
+	// expect, or NO_BLOCK.
+	uint32_t
+	match(uint32_t weak, const uint8_t *strong, uint32_t expect) const
+	{
+		uint32_t	found = NO_BLOCK;
+
+		for (uint32_t b = this->heads[this->slot(weak)]; b != NO_BLOCK; b = this->next[b]) {
+			if ((this->blocks[b].weak != weak) ||
+			    !HashEqual(this->blocks[b].strong.bytes, strong)) {
+				continue;
+			}
+			if (b == expect) {
+				return b;
+			}
+			if (found == NO_BLOCK) {
+				found = b;
+			}
+		}
+		return found;
+	}
+
+private:
+	uint32_t
+	slot(uint32_t weak) const
+	{
+		return (weak * 0x9e3779b1U) >> this->shift;
+	}
+
+	const DeltaBlock	*blocks;
+	std::vector<uint32_t>	 heads;
+	std::vector<uint32_t>	 next;
+	uint32_t		 shift;
+};
+
+
+// deltaWriter appends ops to a delta, merging each with the one
+// before it where they are contiguous.
+class deltaWriter {
+public:
+	deltaWriter(Delta& d, const uint8_t *t)
+	    : delta(d), target(t)
+	{
+	}
+
+	void
+	literal(uint64_t from, uint64_t to)
+	{
+		if (from == to) {
+			return;
+		}
+
+		uint64_t const	offset = this->delta.literals.size();
+
+		this->delta.literals.insert(this->delta.literals.end(),
+					    this->target + from, this->target + to);
+		if (!this->delta.ops.empty() &&
+		    (this->delta.ops.back().kind == DeltaOpKind::Literal)) {
+			this->delta.ops.back().length += to - from;
+			return;
+		}
+		this->delta.ops.push_back({DeltaOpKind::Literal, offset, to - from});
+	}
+
+	void
+	copy(uint64_t offset, uint64_t length)
+	{
+		if (!this->delta.ops.empty()) {
+			DeltaOp&	last = this->delta.ops.back();
+
+			if ((last.kind == DeltaOpKind::Copy) &&
+			    ((last.offset + last.length) == offset)) {
+				last.length += length;
+				return;
+			}
+		}
+		this->delta.ops.push_back({DeltaOpKind::Copy, offset, length});
+	}
+
+private:
+	Delta&		 delta;
+	const uint8_t	*target;
+};
+
+
+// A candidate is a target position whose weak checksum matches a
+// block.
+struct candidate {
+	uint64_t	position;
+	uint32_t	weak;
+};
+
+
+} // anonymous namespace
+
+
+EMSHAResult
+DeltaSign(const uint8_t *base, uint64_t length, uint32_t blockSize,
+	  DeltaSignature& sig, uint32_t threads)
+{
+	if ((base == nullptr) && (length != 0)) {
+		return EMSHAResult::NullPointer;
+	}
+	if (blockSize == 0) {
+		return EMSHAResult::InvalidState;
+	}
+
+	uint64_t const	full = length / blockSize;
+	uint32_t const	tail = static_cast<uint32_t>(length % blockSize);
+
+	if ((full + ((tail != 0) ? 1 : 0)) >= NO_BLOCK) {
+		return EMSHAResult::InputTooLong;
+	}
+
+	sig.blockSize  = blockSize;
+	sig.baseLength = length;
+	sig.blocks.resize(full + ((tail != 0) ? 1 : 0));
+
+	if (tail != 0) {
+		DeltaBlock&	block = sig.blocks[full];
+		const uint8_t	*p = base + (full * blockSize);
+		weakSum		w;
+
+		w.start(p, tail);
+		block.weak = w.value();
+		sha256_digest(p, tail, block.strong.bytes);
+	}
+
+	// Split the full blocks between the threads in whole lane
+	// groups.
+	std::size_t const	groups = (full + SHA256_LANES - 1) / SHA256_LANES;
+	std::size_t const	workers = std::min<std::size_t>(std::max<uint32_t>(threads, 1),
+								groups);
+
+	if (workers <= 1) {
+		signBlocks(base, blockSize, sig.blocks.data(), 0, full);
+		return EMSHAResult::OK;
+	}
+
+	std::vector<std::thread>	pool;
+
+	for (std::size_t w = 0; w < workers; w++) {
+		std::size_t const	first = std::min<std::size_t>(full,
+							 ((groups * w) / workers) * SHA256_LANES);
+		std::size_t const	last = std::min<std::size_t>(full,
+							((groups * (w + 1)) / workers) * SHA256_LANES);
+
+		pool.emplace_back(signBlocks, base, blockSize, sig.blocks.data(),
+				  first, last - first);
+	}
+	for (auto& t : pool) {
+		t.join();
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+DeltaCompute(const DeltaSignature& sig, const uint8_t *target, uint64_t length,
+	     Delta& delta)
+{
+	if ((target == nullptr) && (length != 0)) {
+		return EMSHAResult::NullPointer;
+	}
+
+	uint32_t const	bs = sig.blockSize;
+	if (bs == 0) {
+		return EMSHAResult::InvalidState;
+	}
+
+	uint64_t const	full = sig.baseLength / bs;
+	uint32_t const	tail = static_cast<uint32_t>(sig.baseLength % bs);
+	if (sig.blocks.size() != (full + ((tail != 0) ? 1 : 0))) {
+		return EMSHAResult::InvalidState;
+	}
+
+	delta.ops.clear();
+	delta.literals.clear();
+	delta.targetLength = length;
+	sha256_digest(target, length, delta.digest.bytes);
+
+	blockTable	table(sig, static_cast<uint32_t>(full));
+	deltaWriter	out(delta, target);
+	candidate	cands[SHA256_LANES];
+	Digest		strong[SHA256_LANES];
+	const uint8_t	*msgs[SHA256_LANES];
+	uint8_t		*digests[SHA256_LANES];
+	uint64_t	done = 0;	// Target bytes covered by ops.
+	uint64_t	pos = 0;	// Start of the window.
+	uint32_t	expect = 0;	// The block after the last copy.
+	weakSum		w;
+
+	if ((full > 0) && (length >= bs)) {
+		w.start(target, bs);
+	}
+
+	while ((full > 0) && ((pos + bs) <= length)) {
+		std::size_t	n = 0;
+
+		// Gather candidates, assuming each one matches.
+		while (((pos + bs) <= length) && (n < SHA256_LANES)) {
+			uint32_t const	weak = w.value();
+
+			if (table.find(weak)) {
+				cands[n++] = {pos, weak};
+				pos += bs;
+				if ((pos + bs) <= length) {
+					w.start(target + pos, bs);
+				}
+				continue;
+			}
+
+			if ((pos + bs) < length) {
+				w.roll(target[pos], target[pos + bs], bs);
+			}
+			pos++;
+		}
+		if (n == 0) {
+			break;
+		}
+
+		for (std::size_t l = 0; l < n; l++) {
+			msgs[l]    = target + cands[l].position;
+			digests[l] = strong[l].bytes;
+		}
+		hashLanes(msgs, n, bs, digests);
+
+		// Take the candidates up to the first that doesn't
+		// match, and rescan from the byte after it.
+		for (std::size_t l = 0; l < n; l++) {
+			uint64_t const	at = cands[l].position;
+			uint32_t const	block = table.match(cands[l].weak, strong[l].bytes, expect);
+
+			if (block == NO_BLOCK) {
+				pos = at + 1;
+				if ((pos + bs) <= length) {
+					w.start(target + pos, bs);
+				}
+				break;
+			}
+
+			out.literal(done, at);
+			out.copy(static_cast<uint64_t>(block) * bs, bs);
+			done   = at + bs;
+			expect = block + 1;
+		}
+	}
+
+	// A short last block can only match at the end of the target.
+	if ((tail != 0) && ((length - done) >= tail)) {
+		const uint8_t	*p = target + (length - tail);
+		uint8_t		 d[SHA256_HASH_SIZE];
+
+		w.start(p, tail);
+		if (w.value() == sig.blocks[full].weak) {
+			sha256_digest(p, tail, d);
+			if (HashEqual(d, sig.blocks[full].strong.bytes)) {
+				out.literal(done, length - tail);
+				out.copy(full * bs, tail);
+				done = length;
+			}
+		}
+	}
+
+	out.literal(done, length);
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+DeltaApply(const uint8_t *base, uint64_t baseLength, const Delta& delta,
+	   std::vector<uint8_t>& target)
+{
+	if ((base == nullptr) && (baseLength != 0)) {
+		return EMSHAResult::NullPointer;
+	}
+
+	target.clear();
+
+	// Check every op before allocating anything, as the delta may
+	// have come from elsewhere.
+	uint64_t	total = 0;
+	for (const auto& op : delta.ops) {
+		if ((op.kind != DeltaOpKind::Copy) && (op.kind != DeltaOpKind::Literal)) {
+			return EMSHAResult::InvalidState;
+		}
+
+		uint64_t const	limit = (op.kind == DeltaOpKind::Copy) ?
+					baseLength : delta.literals.size();
+
+		if ((op.offset > limit) || (op.length > (limit - op.offset)) ||
+		    (op.length > (delta.targetLength - total))) {
+			return EMSHAResult::InvalidState;
+		}
+		total += op.length;
+	}
+	if (total != delta.targetLength) {
+		return EMSHAResult::InvalidState;
+	}
+
+	target.reserve(delta.targetLength);
+	for (const auto& op : delta.ops) {
+		const uint8_t	*src = (op.kind == DeltaOpKind::Copy) ?
+				       base : delta.literals.data();
+
+		target.insert(target.end(), src + op.offset, src + op.offset + op.length);
+	}
+
+	uint8_t	d[SHA256_HASH_SIZE];
+	sha256_digest(target.data(), target.size(), d);
+	if (!HashEqual(d, delta.digest.bytes)) {
+		target.clear();
+		return EMSHAResult::VerifyFailed;
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,142 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/hmac.h>
+#include <emsha/compact.h>
+#include <emsha/digest.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+int
+hexValue(char c)
+{
+	if ((c >= '0') && (c <= '9')) {
+		return c - '0';
+	}
+	if ((c >= 'a') && (c <= 'f')) {
+		return c - 'a' + 10;
+	}
+	if ((c >= 'A') && (c <= 'F')) {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+
+} // anonymous namespace
+
+
+void
+Digest::Hex(char *out) const
+{
+	static const char	digits[] = "0123456789abcdef";
+
+	for (std::size_t i = 0; i < SHA256_HASH_SIZE; i++) {
+		out[2 * i]       = digits[this->bytes[i] >> 4];
+		out[(2 * i) + 1] = digits[this->bytes[i] & 0xf];
+	}
+	out[2 * SHA256_HASH_SIZE] = '\0';
+}
+
+
+bool
+Digest::FromHex(const char *hex, std::size_t length, Digest& d)
+{
+	Digest	parsed;
+
+	if ((hex == nullptr) || (length != (2 * SHA256_HASH_SIZE))) {
+		return false;
+	}
+
+	for (std::size_t i = 0; i < SHA256_HASH_SIZE; i++) {
+		int const	hi = hexValue(hex[2 * i]);
+		int const	lo = hexValue(hex[(2 * i) + 1]);
+
+		if ((hi < 0) || (lo < 0)) {
+			return false;
+		}
+		parsed.bytes[i] = static_cast<uint8_t>((hi << 4) | lo);
+	}
+
+	d = parsed;
+	return true;
+}
+
+
+Digest
+SHA256Digest(const uint8_t *m, uint32_t ml)
+{
+	Digest	d;
+	SHA256	h;
+
+	// An empty message may come from an empty container, with a
+	// nullptr for its data.
+	EMSHA_CHECK((m != nullptr) || (ml == 0), Digest());
+	if (ml != 0) {
+		h.Update(m, ml);
+	}
+	h.Finalise(d.bytes);
+	return d;
+}
+
+
+Digest
+ComputeHMAC(const uint8_t *k, uint32_t kl, const uint8_t *m, uint32_t ml)
+{
+	Digest	d;
+	HMAC	h(k, kl);
+
+	EMSHA_CHECK((m != nullptr) || (ml == 0), Digest());
+	if (ml != 0) {
+		h.Update(m, ml);
+	}
+	h.Finalise(d.bytes);
+	return d;
+}
+
+
+Digest
+ComputeHMAC(const HMACMidstate& key, const uint8_t *m, uint32_t ml)
+{
+	Digest	d;
+
+	EMSHA_CHECK((m != nullptr) || (ml == 0), Digest());
+	ComputeHMAC(key, m, ml, d.bytes);
+	return d;
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,480 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <emsha/emsha.h>
+#include <emsha/digestindex.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// The header page.
+constexpr char		indexMagic[8] = {'E', 'M', 'S', 'H', 'A', 'D', 'X', '1'};
+constexpr uint32_t	byteOrderMark = 0x01020304;
+constexpr std::size_t	hdrMagic = 0;
+constexpr std::size_t	hdrByteOrder = 8;
+constexpr std::size_t	hdrBucketBits = 12;
+constexpr std::size_t	hdrBuckets = 16;
+constexpr std::size_t	hdrOverflowPages = 24;
+constexpr std::size_t	hdrOverflowUsed = 32;
+constexpr std::size_t	hdrRecords = 40;
+
+// Each bucket and overflow page starts with its record count and the
+// number of the overflow page it chains to, plus one (zero ends the
+// chain).
+constexpr std::size_t	pageCount = 0;
+constexpr std::size_t	pageNext = 4;
+constexpr std::size_t	pageRecords = 16;
+constexpr std::size_t	recordSize = sizeof(DigestIndexRecord);
+
+static_assert(recordSize == 48, "records are 48 bytes");
+static_assert(pageRecords + (DIGEST_INDEX_BUCKET_RECORDS * recordSize) <= DIGEST_INDEX_PAGE_SIZE,
+	      "a bucket's records fit in a page");
+
+// Buckets are sized for this many records on average, about 70% full.
+constexpr uint64_t	targetLoad = (DIGEST_INDEX_BUCKET_RECORDS * 7) / 10;
+
+// The overflow reserve for appends is a quarter of the number of
+// buckets, and at least this many pages.
+constexpr uint64_t	minOverflowReserve = 16;
+
+
+// The counters in the mapping are read and written as atomics, which
+// needs them to be lock-free so that other processes mapping the same
+// file see the same representation.
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "32-bit atomics must be lock-free");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "64-bit atomics must be lock-free");
+
+
+std::atomic<uint32_t>&
+atomic32(uint8_t *p)
+{
+	return *reinterpret_cast<std::atomic<uint32_t> *>(p);
+}
+
+
+std::atomic<uint64_t>&
+atomic64(uint8_t *p)
+{
+	return *reinterpret_cast<std::atomic<uint64_t> *>(p);
+}
+
+
+uint32_t
+load32(const uint8_t *p)
+{
+	uint32_t	v;
+
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+
+uint64_t
+load64(const uint8_t *p)
+{
+	uint64_t	v;
+
+	std::memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+
+uint64_t
+bucketIndex(const uint8_t *digest, uint32_t bits)
+{
+	uint64_t	w = 0;
+
+	if (bits == 0) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < 8; i++) {
+		w = (w << 8) | digest[i];
+	}
+	return w >> (64 - bits);
+}
+
+
+uint8_t *
+recordAt(uint8_t *pg, uint32_t i)
+{
+	return pg + pageRecords + (static_cast<std::size_t>(i) * recordSize);
+}
+
+
+} // anonymous namespace
+
+
+DigestIndex::DigestIndex()
+    : map(nullptr), mapLength(0), writable(false)
+{
+}
+
+
+DigestIndex::~DigestIndex()
+{
+	this->Close();
+}
+
+
+uint8_t *
+DigestIndex::page(uint64_t n) const
+{
+	return this->map + (n * DIGEST_INDEX_PAGE_SIZE);
+}
+
+
+EMSHAResult
+DigestIndex::Build(const char *path, const DigestIndexRecord *records, std::size_t count,
+		   std::size_t expected)
+{
+	if ((path == nullptr) || ((records == nullptr) && (count != 0))) {
+		return EMSHAResult::NullPointer;
+	}
+
+	for (std::size_t i = 1; i < count; i++) {
+		if (std::memcmp(records[i - 1].digest, records[i].digest, SHA256_HASH_SIZE) >= 0) {
+			return EMSHAResult::InvalidState;
+		}
+	}
+
+	expected = std::max(expected, count);
+
+	uint32_t	bits = 0;
+	while (((static_cast<uint64_t>(1) << bits) * targetLoad) < expected) {
+		bits++;
+	}
+	uint64_t const	buckets = static_cast<uint64_t>(1) << bits;
+
+	// The input is sorted, so each bucket's records are a single
+	// run, and any pages it overflows into can be counted up front.
+	uint64_t	overflow = 0;
+	for (std::size_t i = 0; i < count;) {
+		uint64_t const	b = bucketIndex(records[i].digest, bits);
+		std::size_t	j = i;
+
+		while ((j < count) && (bucketIndex(records[j].digest, bits) == b)) {
+			j++;
+		}
+		overflow += (j - i - 1) / DIGEST_INDEX_BUCKET_RECORDS;
+		i = j;
+	}
+	uint64_t const	reserve = std::max(minOverflowReserve, buckets / 4);
+	uint64_t const	pages = 1 + buckets + overflow + reserve;
+	std::size_t const length = static_cast<std::size_t>(pages * DIGEST_INDEX_PAGE_SIZE);
+
+	// The index is built beside its final path and renamed into
+	// place, so readers never see a partial one.
+	std::string const	tmp = std::string(path) + ".tmp";
+	int const		fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return EMSHAResult::IOError;
+	}
+
+	if (ftruncate(fd, static_cast<off_t>(length)) != 0) {
+		close(fd);
+		unlink(tmp.c_str());
+		return EMSHAResult::IOError;
+	}
+
+	void	*m = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (m == MAP_FAILED) {
+		close(fd);
+		unlink(tmp.c_str());
+		return EMSHAResult::IOError;
+	}
+
+	uint8_t	*base = static_cast<uint8_t *>(m);
+	auto	pageAt = [base](uint64_t n) {
+		return base + (n * DIGEST_INDEX_PAGE_SIZE);
+	};
+
+	std::memcpy(base + hdrMagic, indexMagic, sizeof(indexMagic));
+	std::memcpy(base + hdrByteOrder, &byteOrderMark, sizeof(byteOrderMark));
+	std::memcpy(base + hdrBucketBits, &bits, sizeof(bits));
+	std::memcpy(base + hdrBuckets, &buckets, sizeof(buckets));
+	uint64_t const	overflowPages = overflow + reserve;
+	std::memcpy(base + hdrOverflowPages, &overflowPages, sizeof(overflowPages));
+
+	uint64_t	used = 0;
+	for (std::size_t i = 0; i < count;) {
+		uint64_t const	b = bucketIndex(records[i].digest, bits);
+		uint8_t		*pg = pageAt(1 + b);
+		uint32_t	n = 0;
+
+		for (; (i < count) && (bucketIndex(records[i].digest, bits) == b); i++) {
+			if (n == DIGEST_INDEX_BUCKET_RECORDS) {
+				uint32_t const	next = static_cast<uint32_t>(used + 1);
+
+				std::memcpy(pg + pageCount, &n, sizeof(n));
+				std::memcpy(pg + pageNext, &next, sizeof(next));
+				pg = pageAt(1 + buckets + used++);
+				n  = 0;
+			}
+			std::memcpy(recordAt(pg, n++), &records[i], recordSize);
+		}
+		std::memcpy(pg + pageCount, &n, sizeof(n));
+	}
+
+	uint64_t const	total = count;
+	std::memcpy(base + hdrOverflowUsed, &used, sizeof(used));
+	std::memcpy(base + hdrRecords, &total, sizeof(total));
+
+	bool const	synced = (msync(m, length, MS_SYNC) == 0);
+	munmap(m, length);
+	if (!synced || (close(fd) != 0) || (rename(tmp.c_str(), path) != 0)) {
+		unlink(tmp.c_str());
+		return EMSHAResult::IOError;
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+DigestIndex::Open(const char *path, bool forWriting)
+{
+	struct stat	st;
+
+	if (path == nullptr) {
+		return EMSHAResult::NullPointer;
+	}
+	this->Close();
+
+	int const	fd = open(path, forWriting ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
+		return EMSHAResult::IOError;
+	}
+
+	if ((fstat(fd, &st) != 0) || (st.st_size < static_cast<off_t>(DIGEST_INDEX_PAGE_SIZE))) {
+		close(fd);
+		return EMSHAResult::IOError;
+	}
+
+	std::size_t const	length = static_cast<std::size_t>(st.st_size);
+	int const		prot = forWriting ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	void			*m = mmap(nullptr, length, prot, MAP_SHARED, fd, 0);
+
+	close(fd);
+	if (m == MAP_FAILED) {
+		return EMSHAResult::IOError;
+	}
+
+	// The header has to describe exactly this file.
+	const uint8_t	*hdr = static_cast<const uint8_t *>(m);
+	uint32_t const	bits = load32(hdr + hdrBucketBits);
+	uint64_t const	buckets = load64(hdr + hdrBuckets);
+	uint64_t const	overflowPages = load64(hdr + hdrOverflowPages);
+
+	if ((std::memcmp(hdr + hdrMagic, indexMagic, sizeof(indexMagic)) != 0) ||
+	    (load32(hdr + hdrByteOrder) != byteOrderMark) ||
+	    (bits > 40) || (buckets != (static_cast<uint64_t>(1) << bits)) ||
+	    (overflowPages > UINT32_MAX) ||
+	    ((1 + buckets + overflowPages) * DIGEST_INDEX_PAGE_SIZE != length)) {
+		munmap(m, length);
+		return EMSHAResult::IOError;
+	}
+
+	this->map       = static_cast<uint8_t *>(m);
+	this->mapLength = length;
+	this->writable  = forWriting;
+	return EMSHAResult::OK;
+}
+
+
+void
+DigestIndex::Close()
+{
+	if (this->map != nullptr) {
+		munmap(this->map, this->mapLength);
+		this->map       = nullptr;
+		this->mapLength = 0;
+		this->writable  = false;
+	}
+}
+
+
+bool
+DigestIndex::Lookup(const uint8_t *digest, uint64_t& offset, uint64_t& length) const
+{
+	if ((this->map == nullptr) || (digest == nullptr)) {
+		return false;
+	}
+
+	uint32_t const	bits = load32(this->map + hdrBucketBits);
+	uint64_t const	buckets = load64(this->map + hdrBuckets);
+	uint64_t const	overflowPages = load64(this->map + hdrOverflowPages);
+	uint8_t		*pg = this->page(1 + bucketIndex(digest, bits));
+
+	// The file may be shared with other processes, so the counts
+	// and links are checked before they're used: a count is
+	// clamped to a page, a link must stay within the reserve, and
+	// a chain can't be longer than the reserve, which ends a cycle.
+	for (uint64_t steps = 0; steps <= overflowPages; steps++) {
+		uint32_t const	n = std::min(atomic32(pg + pageCount).load(std::memory_order_acquire),
+					     static_cast<uint32_t>(DIGEST_INDEX_BUCKET_RECORDS));
+
+		for (uint32_t i = 0; i < n; i++) {
+			const uint8_t	*rec = recordAt(pg, i);
+
+			if (std::memcmp(rec, digest, SHA256_HASH_SIZE) == 0) {
+				offset = load64(rec + SHA256_HASH_SIZE);
+				length = load64(rec + SHA256_HASH_SIZE + 8);
+				return true;
+			}
+		}
+
+		uint32_t const	next = atomic32(pg + pageNext).load(std::memory_order_acquire);
+		if ((next == 0) || (next > overflowPages)) {
+			return false;
+		}
+		pg = this->page(1 + buckets + next - 1);
+	}
+
+	return false;
+}
+
+
+EMSHAResult
+DigestIndex::Append(const DigestIndexRecord& record)
+{
+	std::lock_guard<std::mutex>	lock(this->writer);
+
+	if ((this->map == nullptr) || !this->writable) {
+		return EMSHAResult::InvalidState;
+	}
+
+	uint32_t const	bits = load32(this->map + hdrBucketBits);
+	uint64_t const	buckets = load64(this->map + hdrBuckets);
+	uint64_t const	overflowPages = load64(this->map + hdrOverflowPages);
+	uint8_t		*pg = this->page(1 + bucketIndex(record.digest, bits));
+
+	// Walk to the end of the chain, checking for the digest on the
+	// way. Only this writer changes the counts, so plain loads see
+	// its own earlier stores. As in Lookup, the chain is checked
+	// as it is walked, and a damaged one isn't appended to.
+	uint32_t	n;
+	uint64_t	steps = 0;
+	for (;;) {
+		n = atomic32(pg + pageCount).load(std::memory_order_relaxed);
+		if (n > DIGEST_INDEX_BUCKET_RECORDS) {
+			return EMSHAResult::IOError;
+		}
+
+		for (uint32_t i = 0; i < n; i++) {
+			if (std::memcmp(recordAt(pg, i), record.digest, SHA256_HASH_SIZE) == 0) {
+				return EMSHAResult::OK;
+			}
+		}
+
+		uint32_t const	next = atomic32(pg + pageNext).load(std::memory_order_relaxed);
+		if (next == 0) {
+			break;
+		}
+		if ((next > overflowPages) || (++steps > overflowPages)) {
+			return EMSHAResult::IOError;
+		}
+		pg = this->page(1 + buckets + next - 1);
+	}
+
+	std::atomic<uint64_t>&	records = atomic64(this->map + hdrRecords);
+
+	if (n < DIGEST_INDEX_BUCKET_RECORDS) {
+		std::memcpy(recordAt(pg, n), &record, recordSize);
+		atomic32(pg + pageCount).store(n + 1, std::memory_order_release);
+		records.fetch_add(1, std::memory_order_relaxed);
+		return EMSHAResult::OK;
+	}
+
+	std::atomic<uint64_t>&	used = atomic64(this->map + hdrOverflowUsed);
+	uint64_t const		idx = used.load(std::memory_order_relaxed);
+	if (idx >= overflowPages) {
+		return EMSHAResult::NoSpace;
+	}
+
+	// The new page is filled in before it is linked, so a reader
+	// either doesn't reach it or sees its record.
+	uint8_t	*fresh = this->page(1 + buckets + idx);
+	std::memcpy(recordAt(fresh, 0), &record, recordSize);
+	atomic32(fresh + pageNext).store(0, std::memory_order_relaxed);
+	atomic32(fresh + pageCount).store(1, std::memory_order_relaxed);
+	used.store(idx + 1, std::memory_order_relaxed);
+	atomic32(pg + pageNext).store(static_cast<uint32_t>(idx + 1), std::memory_order_release);
+	records.fetch_add(1, std::memory_order_relaxed);
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+DigestIndex::Sync()
+{
+	if (this->map == nullptr) {
+		return EMSHAResult::InvalidState;
+	}
+	if (msync(this->map, this->mapLength, MS_SYNC) != 0) {
+		return EMSHAResult::IOError;
+	}
+	return EMSHAResult::OK;
+}
+
+
+uint64_t
+DigestIndex::Size() const
+{
+	if (this->map == nullptr) {
+		return 0;
+	}
+	return atomic64(this->map + hdrRecords).load(std::memory_order_relaxed);
+}
+
+
+uint64_t
+DigestIndex::Buckets() const
+{
+	if (this->map == nullptr) {
+		return 0;
+	}
+	return load64(this->map + hdrBuckets);
+}
+
+
+} // end of namespace emsha
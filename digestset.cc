@@ -0,0 +1,336 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <emsha/emsha.h>
+#include <emsha/digestset.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+constexpr uint32_t	slotsPerBucket = 7;
+constexpr uintptr_t	cacheLine = 64;
+
+// The control word holds the number of claimed slots in its low bits
+// and a ready bit for each slot from readyShift up. Slots are claimed
+// in order, so a bucket with a free slot ends every probe sequence
+// that reaches it.
+constexpr uint32_t	claimMask = 0x7;
+constexpr uint32_t	readyShift = 8;
+
+// The byte after the ones used for the bucket index is kept as a tag,
+// so that most mismatches are settled without touching the slot.
+constexpr uint32_t	tagByte = 8;
+
+
+uint64_t
+leadingWord(const uint8_t *d)
+{
+	uint64_t	w = 0;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		w = (w << 8) | d[i];
+	}
+	return w;
+}
+
+
+std::size_t
+bucketIndex(const uint8_t *d, uint32_t bits)
+{
+	return static_cast<std::size_t>(leadingWord(d) >> (64 - bits));
+}
+
+
+} // anonymous namespace
+
+
+struct DigestSet::bucket {
+	std::atomic<uint32_t>	ctrl;
+	uint8_t			tags[slotsPerBucket];
+	uint8_t			pad[32 - sizeof(std::atomic<uint32_t>) - slotsPerBucket];
+	uint8_t			slots[slotsPerBucket][SHA256_HASH_SIZE];
+};
+
+
+DigestSet::bucket *
+DigestSet::allocate(uint32_t bits, uint8_t *&storage)
+{
+	static_assert(sizeof(bucket) == (4 * cacheLine), "a bucket is four cache lines");
+
+	std::size_t const	count = static_cast<std::size_t>(1) << bits;
+
+	storage = new uint8_t[(count * sizeof(bucket)) + cacheLine];
+
+	uintptr_t const	aligned = (reinterpret_cast<uintptr_t>(storage) + cacheLine - 1) &
+				  ~(cacheLine - 1);
+	bucket		*table = reinterpret_cast<bucket *>(aligned);
+
+	for (std::size_t i = 0; i < count; i++) {
+		new (&table[i].ctrl) std::atomic<uint32_t>(0);
+	}
+	return table;
+}
+
+
+DigestSet::DigestSet(std::size_t capacity)
+    : storage(nullptr), table(nullptr), bits(1), size(0), active(0), resizing(false)
+{
+	while (this->limit() < capacity) {
+		this->bits++;
+	}
+	this->table = allocate(this->bits, this->storage);
+}
+
+
+DigestSet::~DigestSet()
+{
+	delete[] this->storage;
+}
+
+
+std::size_t
+DigestSet::limit() const
+{
+	std::size_t const	slots = (static_cast<std::size_t>(1) << this->bits) * slotsPerBucket;
+
+	return (slots / 4) * 3;
+}
+
+
+std::size_t
+DigestSet::Capacity() const
+{
+	this->enter();
+	std::size_t const	n = this->limit();
+	this->leave();
+	return n;
+}
+
+
+// enter and leave bracket every insert and lookup. The resizer raises
+// its flag and then waits for the count of operations in progress to
+// reach zero; an operation counts itself in and then checks the flag.
+// With both sides using sequentially consistent operations, at least
+// one of them sees the other, so no operation overlaps a resize.
+void
+DigestSet::enter() const
+{
+	for (;;) {
+		this->active.fetch_add(1);
+		if (!this->resizing.load()) {
+			return;
+		}
+
+		this->active.fetch_sub(1);
+		while (this->resizing.load()) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+
+void
+DigestSet::leave() const
+{
+	this->active.fetch_sub(1);
+}
+
+
+// place inserts a digest into a table, returning 1 if it was added, 0
+// if it was already present, or -1 if every bucket was full.
+int
+DigestSet::place(bucket *table, uint32_t bits, const uint8_t *digest)
+{
+	std::size_t const	mask = (static_cast<std::size_t>(1) << bits) - 1;
+	std::size_t		idx = bucketIndex(digest, bits);
+	uint8_t const		tag = digest[tagByte];
+
+	for (std::size_t n = 0; n <= mask; n++, idx = (idx + 1) & mask) {
+		bucket&		b = table[idx];
+		uint32_t	ctrl = b.ctrl.load(std::memory_order_acquire);
+		uint32_t	checked = 0;
+
+		for (;;) {
+			uint32_t	claimed = ctrl & claimMask;
+
+			// Every claimed slot has to be checked, including
+			// ones still being written, as another thread may
+			// be inserting this same digest. Waiting reloads the
+			// control word, so the claim count is refreshed
+			// with it.
+			while (checked < claimed) {
+				if ((ctrl & (1U << (readyShift + checked))) == 0) {
+					std::this_thread::yield();
+					ctrl    = b.ctrl.load(std::memory_order_acquire);
+					claimed = ctrl & claimMask;
+					continue;
+				}
+
+				if ((b.tags[checked] == tag) &&
+				    (std::memcmp(b.slots[checked], digest, SHA256_HASH_SIZE) == 0)) {
+					return 0;
+				}
+				checked++;
+			}
+
+			if (claimed == slotsPerBucket) {
+				break;
+			}
+
+			// On failure, ctrl is reloaded and any slots
+			// claimed in the meantime are checked first.
+			if (b.ctrl.compare_exchange_weak(ctrl, ctrl + 1,
+							 std::memory_order_acq_rel,
+							 std::memory_order_acquire)) {
+				std::memcpy(b.slots[claimed], digest, SHA256_HASH_SIZE);
+				b.tags[claimed] = tag;
+				b.ctrl.fetch_or(1U << (readyShift + claimed),
+						std::memory_order_release);
+				return 1;
+			}
+		}
+	}
+
+	return -1;
+}
+
+
+bool
+DigestSet::Insert(const uint8_t *digest)
+{
+	for (;;) {
+		this->enter();
+
+		uint32_t const	seen = this->bits;
+		int		added = -1;
+
+		if (this->size.load(std::memory_order_relaxed) < this->limit()) {
+			added = place(this->table, this->bits, digest);
+		}
+		this->leave();
+
+		if (added >= 0) {
+			if (added == 1) {
+				this->size.fetch_add(1, std::memory_order_relaxed);
+			}
+			return added == 1;
+		}
+
+		this->grow(seen);
+	}
+}
+
+
+bool
+DigestSet::Contains(const uint8_t *digest) const
+{
+	this->enter();
+
+	std::size_t const	mask = (static_cast<std::size_t>(1) << this->bits) - 1;
+	std::size_t		idx = bucketIndex(digest, this->bits);
+	uint8_t const		tag = digest[tagByte];
+	bool			found = false;
+
+	for (std::size_t n = 0; n <= mask; n++, idx = (idx + 1) & mask) {
+		const bucket&	b = this->table[idx];
+		uint32_t const	ctrl = b.ctrl.load(std::memory_order_acquire);
+		uint32_t const	claimed = ctrl & claimMask;
+
+		for (uint32_t s = 0; s < claimed; s++) {
+			if (((ctrl & (1U << (readyShift + s))) != 0) &&
+			    (b.tags[s] == tag) &&
+			    (std::memcmp(b.slots[s], digest, SHA256_HASH_SIZE) == 0)) {
+				found = true;
+				break;
+			}
+		}
+
+		if (found || (claimed < slotsPerBucket)) {
+			break;
+		}
+	}
+
+	this->leave();
+	return found;
+}
+
+
+void
+DigestSet::grow(uint32_t fromBits)
+{
+	bool	expected = false;
+
+	if (!this->resizing.compare_exchange_strong(expected, true)) {
+		// Another thread is resizing; the caller retries once
+		// it's done.
+		while (this->resizing.load()) {
+			std::this_thread::yield();
+		}
+		return;
+	}
+
+	while (this->active.load() != 0) {
+		std::this_thread::yield();
+	}
+
+	// Another thread may have grown the table between this one
+	// seeing it full and getting here.
+	if (this->bits == fromBits) {
+		uint32_t const	newBits = this->bits + 1;
+		uint8_t		*newStorage = nullptr;
+		bucket		*newTable = allocate(newBits, newStorage);
+		std::size_t const count = static_cast<std::size_t>(1) << this->bits;
+
+		for (std::size_t i = 0; i < count; i++) {
+			const bucket&	b = this->table[i];
+			uint32_t const	claimed = b.ctrl.load(std::memory_order_relaxed) & claimMask;
+
+			for (uint32_t s = 0; s < claimed; s++) {
+				place(newTable, newBits, b.slots[s]);
+			}
+		}
+
+		delete[] this->storage;
+		this->storage = newStorage;
+		this->table   = newTable;
+		this->bits    = newBits;
+	}
+
+	this->resizing.store(false);
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,763 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/digest.h>
+#include <emsha/digestsort.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// Buckets this small are finished with a comparison sort.
+constexpr std::size_t	smallSort = 64;
+
+// Below this many digests per thread, a sort runs on one thread.
+constexpr std::size_t	parallelMin = 1 << 16;
+
+// The most runs merged at once, which bounds the number of files
+// open in each merge.
+constexpr std::size_t	mergeFanIn = 64;
+
+// The number of digests buffered for each file being streamed.
+constexpr std::size_t	streamDigests = 4096;
+
+// Runs are never smaller than this, whatever the memory limit.
+constexpr std::size_t	minRun = 1024;
+
+
+int
+compare(const Digest& a, const Digest& b)
+{
+	for (std::size_t i = 0; i < 4; i++) {
+		uint64_t const	x = a.Word(i);
+		uint64_t const	y = b.Word(i);
+
+		if (x != y) {
+			return (x < y) ? -1 : 1;
+		}
+	}
+	return 0;
+}
+
+
+// finish sorts a small bucket whose digests share their first byte
+// bytes. Moving 32-byte digests around in a comparison sort is slow,
+// so it sorts keys and indices instead: the key is the eight bytes
+// from byte onwards, which almost always settles the order, with
+// ties broken on the whole digest. The digests are then gathered
+// into other, and copied back if they belong in from.
+void
+finish(Digest *from, Digest *other, std::size_t n, uint32_t byte, bool toOther)
+{
+	struct keyed {
+		uint64_t	key;
+		uint32_t	index;
+	};
+
+	keyed			keys[smallSort];
+	uint32_t const		at = std::min<uint32_t>(byte, SHA256_HASH_SIZE - 8);
+
+	for (std::size_t i = 0; i < n; i++) {
+		uint64_t	w = 0;
+
+		for (uint32_t j = 0; j < 8; j++) {
+			w = (w << 8) | from[i].bytes[at + j];
+		}
+		keys[i].key   = w;
+		keys[i].index = static_cast<uint32_t>(i);
+	}
+
+	std::sort(keys, keys + n, [from](const keyed& a, const keyed& b) {
+		if (a.key != b.key) {
+			return a.key < b.key;
+		}
+		return compare(from[a.index], from[b.index]) < 0;
+	});
+
+	for (std::size_t i = 0; i < n; i++) {
+		other[i] = from[keys[i].index];
+	}
+	if (!toOther) {
+		std::copy(other, other + n, from);
+	}
+}
+
+
+// msd sorts the n digests in from on their bytes from byte onwards,
+// using other (of the same size) as scratch. The sorted digests end
+// up in other if toOther is set, or back in from otherwise; each
+// scatter swaps the roles of the two arrays, so recursing with
+// toOther flipped lands the result in the right place.
+void
+msd(Digest *from, Digest *other, std::size_t n, uint32_t byte, bool toOther)
+{
+	while ((n > smallSort) && (byte < SHA256_HASH_SIZE)) {
+		std::size_t	count[256] = {0};
+		std::size_t	offset[256];
+
+		for (std::size_t i = 0; i < n; i++) {
+			count[from[i].bytes[byte]]++;
+		}
+
+		// If every digest shares this byte, there is nothing to
+		// scatter.
+		if (count[from[0].bytes[byte]] == n) {
+			byte++;
+			continue;
+		}
+
+		std::size_t	start = 0;
+		for (uint32_t b = 0; b < 256; b++) {
+			offset[b] = start;
+			start += count[b];
+		}
+
+		for (std::size_t i = 0; i < n; i++) {
+			other[offset[from[i].bytes[byte]]++] = from[i];
+		}
+
+		start = 0;
+		for (uint32_t b = 0; b < 256; b++) {
+			if (count[b] != 0) {
+				msd(other + start, from + start, count[b], byte + 1, !toOther);
+				start += count[b];
+			}
+		}
+		return;
+	}
+
+	// A bucket that is still large has run out of bytes, so all of
+	// its digests are the same.
+	if (n > smallSort) {
+		if (toOther) {
+			std::copy(from, from + n, other);
+		}
+		return;
+	}
+
+	finish(from, other, n, byte, toOther);
+}
+
+
+// runWorkers runs fn(w) for each of workers workers, on their own
+// threads, and waits for them.
+void
+runWorkers(uint32_t workers, const std::function<void(uint32_t)>& fn)
+{
+	std::vector<std::thread>	pool;
+
+	for (uint32_t w = 0; w < workers; w++) {
+		pool.emplace_back(fn, w);
+	}
+	for (auto& t : pool) {
+		t.join();
+	}
+}
+
+
+void
+parallelSort(Digest *digests, Digest *scratch, std::size_t count, uint32_t workers)
+{
+	std::vector<std::size_t>	hist(static_cast<std::size_t>(workers) * 256, 0);
+	std::size_t			start[256];
+	std::size_t			length[256];
+	std::size_t const		per = (count + workers - 1) / workers;
+
+	// Each worker counts its share of the first bytes...
+	runWorkers(workers, [&](uint32_t w) {
+		std::size_t const	lo = std::min(count, w * per);
+		std::size_t const	hi = std::min(count, lo + per);
+		std::size_t		*h = hist.data() + (w * 256);
+
+		for (std::size_t i = lo; i < hi; i++) {
+			h[digests[i].bytes[0]]++;
+		}
+	});
+
+	// ...is given its own range within each bucket...
+	std::size_t	pos = 0;
+	for (uint32_t b = 0; b < 256; b++) {
+		start[b] = pos;
+		for (uint32_t w = 0; w < workers; w++) {
+			std::size_t const	n = hist[(w * 256) + b];
+
+			hist[(w * 256) + b] = pos;
+			pos += n;
+		}
+		length[b] = pos - start[b];
+	}
+
+	// ...and scatters its share into them.
+	runWorkers(workers, [&](uint32_t w) {
+		std::size_t const	lo = std::min(count, w * per);
+		std::size_t const	hi = std::min(count, lo + per);
+		std::size_t		*h = hist.data() + (w * 256);
+
+		for (std::size_t i = lo; i < hi; i++) {
+			scratch[h[digests[i].bytes[0]]++] = digests[i];
+		}
+	});
+
+	// The buckets are then sorted back into place independently.
+	std::atomic<uint32_t>	next(0);
+	runWorkers(workers, [&](uint32_t) {
+		uint32_t	b;
+
+		while ((b = next.fetch_add(1)) < 256) {
+			msd(scratch + start[b], digests + start[b], length[b], 1, true);
+		}
+	});
+}
+
+
+// digestReader streams the digests in a file, checking that the file
+// holds whole digests and, if asked, that they are in order.
+class digestReader {
+public:
+	explicit digestReader(bool sorted = false)
+	    : f(nullptr), buf(streamDigests), pos(0), len(0), last(),
+	      status(EMSHAResult::OK), started(false), checkOrder(sorted)
+	{
+	}
+
+	~digestReader() { this->close(); }
+
+	bool
+	open(const char *path)
+	{
+		this->f = std::fopen(path, "rb");
+		if (this->f == nullptr) {
+			this->status = EMSHAResult::IOError;
+			return false;
+		}
+		return true;
+	}
+
+	void
+	close()
+	{
+		if (this->f != nullptr) {
+			std::fclose(this->f);
+			this->f = nullptr;
+		}
+	}
+
+	// next returns false at the end of the file or on an error,
+	// which is left in status.
+	bool
+	next(Digest& d)
+	{
+		if ((this->pos == this->len) && !this->fill()) {
+			return false;
+		}
+
+		d = this->buf[this->pos++];
+		if (this->checkOrder) {
+			if (this->started && (d < this->last)) {
+				this->status = EMSHAResult::InvalidState;
+				return false;
+			}
+			this->last    = d;
+			this->started = true;
+		}
+		return true;
+	}
+
+	EMSHAResult	Status() const { return this->status; }
+
+private:
+	bool
+	fill()
+	{
+		if ((this->f == nullptr) || (this->status != EMSHAResult::OK)) {
+			return false;
+		}
+
+		uint8_t		*p = reinterpret_cast<uint8_t *>(this->buf.data());
+		std::size_t const n = std::fread(p, 1, this->buf.size() * sizeof(Digest), this->f);
+
+		if (std::ferror(this->f) != 0) {
+			this->status = EMSHAResult::IOError;
+			return false;
+		}
+		if ((n % sizeof(Digest)) != 0) {
+			this->status = EMSHAResult::InvalidState;
+			return false;
+		}
+
+		this->pos = 0;
+		this->len = n / sizeof(Digest);
+		return this->len != 0;
+	}
+
+	FILE			*f;
+	std::vector<Digest>	 buf;
+	std::size_t		 pos;
+	std::size_t		 len;
+	Digest			 last;
+	EMSHAResult		 status;
+	bool			 started;
+	bool			 checkOrder;
+};
+
+
+class digestWriter {
+public:
+	digestWriter() : f(nullptr), failed(false), written(0) {}
+	~digestWriter() { this->close(); }
+
+	bool
+	open(const char *path)
+	{
+		this->f = std::fopen(path, "wb");
+		this->failed = (this->f == nullptr);
+		return !this->failed;
+	}
+
+	void
+	put(const Digest& d)
+	{
+		this->buf.push_back(d);
+		if (this->buf.size() == streamDigests) {
+			this->flush();
+		}
+	}
+
+	void
+	write(const Digest *d, std::size_t n)
+	{
+		this->flush();
+		this->emit(d, n);
+	}
+
+	// close flushes and closes the file, returning false if any
+	// write failed.
+	bool
+	close()
+	{
+		if (this->f != nullptr) {
+			this->flush();
+			if (std::fclose(this->f) != 0) {
+				this->failed = true;
+			}
+			this->f = nullptr;
+		}
+		return !this->failed;
+	}
+
+	uint64_t	Written() const { return this->written; }
+
+private:
+	void
+	flush()
+	{
+		this->emit(this->buf.data(), this->buf.size());
+		this->buf.clear();
+	}
+
+	void
+	emit(const Digest *d, std::size_t n)
+	{
+		if (this->failed || (n == 0)) {
+			return;
+		}
+		if (std::fwrite(d, sizeof(Digest), n, this->f) != n) {
+			this->failed = true;
+		}
+		this->written += n;
+	}
+
+	FILE			*f;
+	std::vector<Digest>	 buf;
+	bool			 failed;
+	uint64_t		 written;
+};
+
+
+std::string
+runName(const char *output, std::size_t n)
+{
+	return std::string(output) + ".run" + std::to_string(n);
+}
+
+
+// mergeRuns merges sorted run files into one, optionally dropping
+// duplicates.
+EMSHAResult
+mergeRuns(const std::vector<std::string>& inputs, const std::string& output, bool unique)
+{
+	typedef std::pair<Digest, std::size_t>	head;
+
+	std::vector<std::unique_ptr<digestReader>>			readers;
+	std::priority_queue<head, std::vector<head>, std::greater<head>>	heap;
+	digestWriter							out;
+	Digest								d;
+
+	for (std::size_t i = 0; i < inputs.size(); i++) {
+		readers.emplace_back(new digestReader);
+		if (!readers[i]->open(inputs[i].c_str())) {
+			return EMSHAResult::IOError;
+		}
+		if (readers[i]->next(d)) {
+			heap.push(head(d, i));
+		}
+	}
+
+	if (!out.open(output.c_str())) {
+		return EMSHAResult::IOError;
+	}
+
+	bool	any = false;
+	Digest	prev;
+	while (!heap.empty()) {
+		head const	h = heap.top();
+
+		heap.pop();
+		if (!unique || !any || !(h.first == prev)) {
+			out.put(h.first);
+			prev = h.first;
+			any  = true;
+		}
+		if (readers[h.second]->next(d)) {
+			heap.push(head(d, h.second));
+		}
+	}
+
+	for (auto& r : readers) {
+		if (r->Status() != EMSHAResult::OK) {
+			return r->Status();
+		}
+	}
+	return out.close() ? EMSHAResult::OK : EMSHAResult::IOError;
+}
+
+
+void
+removeAll(const std::vector<std::string>& paths)
+{
+	for (auto& p : paths) {
+		std::remove(p.c_str());
+	}
+}
+
+
+EMSHAResult
+mergeFiles(const char *a, const char *b, const char *output, uint64_t *count, bool intersect)
+{
+	digestReader	ra(true);
+	digestReader	rb(true);
+	digestWriter	out;
+	Digest		da, db;
+
+	if ((a == nullptr) || (b == nullptr) || (output == nullptr)) {
+		return EMSHAResult::NullPointer;
+	}
+	if (!ra.open(a) || !rb.open(b)) {
+		return EMSHAResult::IOError;
+	}
+
+	std::string const	tmp = std::string(output) + ".tmp";
+	if (!out.open(tmp.c_str())) {
+		return EMSHAResult::IOError;
+	}
+
+	bool	haveA = ra.next(da);
+	bool	haveB = rb.next(db);
+	while (haveA && haveB) {
+		int const	c = compare(da, db);
+
+		if (c < 0) {
+			if (!intersect) {
+				out.put(da);
+			}
+			haveA = ra.next(da);
+		} else if (c > 0) {
+			haveB = rb.next(db);
+		} else {
+			if (intersect) {
+				out.put(da);
+			}
+			haveA = ra.next(da);
+			haveB = rb.next(db);
+		}
+	}
+
+	// Whatever is left of a is not in b. The rest of b is still
+	// read, so that an unsorted or damaged b is always reported.
+	while (haveA) {
+		if (!intersect) {
+			out.put(da);
+		}
+		haveA = ra.next(da);
+	}
+	while (haveB) {
+		haveB = rb.next(db);
+	}
+
+	EMSHAResult	res = EMSHAResult::OK;
+	if (ra.Status() != EMSHAResult::OK) {
+		res = ra.Status();
+	} else if (rb.Status() != EMSHAResult::OK) {
+		res = rb.Status();
+	} else if (!out.close() || (std::rename(tmp.c_str(), output) != 0)) {
+		res = EMSHAResult::IOError;
+	}
+
+	if (res != EMSHAResult::OK) {
+		out.close();
+		std::remove(tmp.c_str());
+		return res;
+	}
+
+	if (count != nullptr) {
+		*count = out.Written();
+	}
+	return EMSHAResult::OK;
+}
+
+
+} // anonymous namespace
+
+
+void
+SortDigests(Digest *digests, std::size_t count, uint32_t threads)
+{
+	if (count < 2) {
+		return;
+	}
+
+	std::unique_ptr<Digest[]>	scratch(new Digest[count]);
+	std::size_t const		workers = std::min<std::size_t>(std::max<uint32_t>(threads, 1),
+									  count / parallelMin);
+
+	if (workers <= 1) {
+		msd(digests, scratch.get(), count, 0, false);
+	} else {
+		parallelSort(digests, scratch.get(), count, static_cast<uint32_t>(workers));
+	}
+}
+
+
+std::size_t
+UniqueDigests(Digest *digests, std::size_t count)
+{
+	std::size_t	n = 0;
+
+	for (std::size_t i = 0; i < count; i++) {
+		if ((n == 0) || !(digests[i] == digests[n - 1])) {
+			digests[n++] = digests[i];
+		}
+	}
+	return n;
+}
+
+
+std::size_t
+IntersectDigests(const Digest *a, std::size_t na, const Digest *b, std::size_t nb, Digest *out)
+{
+	std::size_t	i = 0, j = 0, n = 0;
+
+	while ((i < na) && (j < nb)) {
+		int const	c = compare(a[i], b[j]);
+
+		if (c < 0) {
+			i++;
+		} else if (c > 0) {
+			j++;
+		} else {
+			out[n++] = a[i];
+			i++;
+			j++;
+		}
+	}
+	return n;
+}
+
+
+std::size_t
+DifferenceDigests(const Digest *a, std::size_t na, const Digest *b, std::size_t nb, Digest *out)
+{
+	std::size_t	i = 0, j = 0, n = 0;
+
+	while ((i < na) && (j < nb)) {
+		int const	c = compare(a[i], b[j]);
+
+		if (c < 0) {
+			out[n++] = a[i++];
+		} else if (c > 0) {
+			j++;
+		} else {
+			i++;
+			j++;
+		}
+	}
+	while (i < na) {
+		out[n++] = a[i++];
+	}
+	return n;
+}
+
+
+EMSHAResult
+SortDigestFile(const char *input, const char *output, std::size_t memoryLimit, bool unique,
+	       uint32_t threads)
+{
+	if ((input == nullptr) || (output == nullptr)) {
+		return EMSHAResult::NullPointer;
+	}
+
+	FILE	*in = std::fopen(input, "rb");
+	if (in == nullptr) {
+		return EMSHAResult::IOError;
+	}
+
+	// Half of the memory holds the run, and the other half is the
+	// sort's scratch space.
+	std::size_t const		runDigests = std::max(minRun, memoryLimit / (2 * sizeof(Digest)));
+	std::vector<Digest>		run(runDigests);
+	std::vector<std::string>	runs;
+	std::size_t			named = 0;
+	EMSHAResult			res = EMSHAResult::OK;
+
+	for (;;) {
+		uint8_t		*p = reinterpret_cast<uint8_t *>(run.data());
+		std::size_t const got = std::fread(p, 1, runDigests * sizeof(Digest), in);
+
+		if (std::ferror(in) != 0) {
+			res = EMSHAResult::IOError;
+			break;
+		}
+		if ((got % sizeof(Digest)) != 0) {
+			res = EMSHAResult::InvalidState;
+			break;
+		}
+
+		std::size_t	n = got / sizeof(Digest);
+		if ((n == 0) && !runs.empty()) {
+			break;
+		}
+
+		SortDigests(run.data(), n, threads);
+		if (unique) {
+			n = UniqueDigests(run.data(), n);
+		}
+
+		digestWriter	out;
+		runs.push_back(runName(output, named++));
+		if (!out.open(runs.back().c_str())) {
+			res = EMSHAResult::IOError;
+			break;
+		}
+		out.write(run.data(), n);
+		if (!out.close()) {
+			res = EMSHAResult::IOError;
+			break;
+		}
+
+		if (got < (runDigests * sizeof(Digest))) {
+			break;
+		}
+	}
+	std::fclose(in);
+	std::vector<Digest>().swap(run);
+
+	// Merge the runs in passes of up to mergeFanIn at a time; the
+	// merges in a pass are independent, so they are shared between
+	// the threads.
+	while ((res == EMSHAResult::OK) && (runs.size() > 1)) {
+		std::size_t const		groups = (runs.size() + mergeFanIn - 1) / mergeFanIn;
+		std::vector<std::string>	merged;
+		std::vector<EMSHAResult>	results(groups, EMSHAResult::OK);
+		std::atomic<std::size_t>	next(0);
+
+		for (std::size_t g = 0; g < groups; g++) {
+			merged.push_back(runName(output, named++));
+		}
+
+		uint32_t const	workers = static_cast<uint32_t>(
+		    std::min<std::size_t>(std::max<uint32_t>(threads, 1), groups));
+		runWorkers(workers, [&](uint32_t) {
+			std::size_t	g;
+
+			while ((g = next.fetch_add(1)) < groups) {
+				std::size_t const lo = g * mergeFanIn;
+				std::size_t const hi = std::min(runs.size(), lo + mergeFanIn);
+				std::vector<std::string> const	group(runs.begin() + lo,
+								      runs.begin() + hi);
+
+				results[g] = mergeRuns(group, merged[g], unique);
+			}
+		});
+
+		removeAll(runs);
+		runs.swap(merged);
+		for (auto r : results) {
+			if (r != EMSHAResult::OK) {
+				res = r;
+			}
+		}
+	}
+
+	if ((res == EMSHAResult::OK) && (std::rename(runs[0].c_str(), output) != 0)) {
+		res = EMSHAResult::IOError;
+	}
+	if (res != EMSHAResult::OK) {
+		removeAll(runs);
+	}
+	return res;
+}
+
+
+EMSHAResult
+IntersectDigestFiles(const char *a, const char *b, const char *output, uint64_t *count)
+{
+	return mergeFiles(a, b, output, count, true);
+}
+
+
+EMSHAResult
+DifferenceDigestFiles(const char *a, const char *b, const char *output, uint64_t *count)
+{
+	return mergeFiles(a, b, output, count, false);
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,867 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// emsha-sum is a sha256sum(1)-compatible checksum tool that hashes
+// files in parallel. Large files are mapped into memory and hashed in
+// place; small files are handed out to the workers in batches so that
+// trees of many tiny files don't spend their time on the work queue.
+// Output is always printed in the order the files were named.
+
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csetjmp>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/file.h>
+
+
+namespace {
+
+
+const char		*progname = "emsha-sum";
+
+// Files at least this large are mmap'd; anything smaller is read
+// into a per-worker buffer.
+constexpr uint64_t	MMAP_THRESHOLD = 1024 * 1024;
+
+// Consecutive small files are grouped into a single task until their
+// combined size reaches SMALL_BATCH_BYTES or SMALL_BATCH_FILES.
+constexpr uint64_t	SMALL_BATCH_BYTES = 4 * 1024 * 1024;
+constexpr std::size_t	SMALL_BATCH_FILES = 64;
+
+// mmap'd files are fed to the hash in pieces, as SHA256::Update takes
+// a 32-bit length.
+constexpr uint64_t	MAP_UPDATE_SIZE = 1024 * 1024 * 1024;
+
+
+struct job {
+	std::string	path;
+
+	// size is from stat(2) when the file was listed, and is only
+	// used to batch small files; the file may change before it is
+	// hashed.
+	uint64_t	size;
+
+	// expected is only used in check mode.
+	uint8_t		expected[emsha::SHA256_HASH_SIZE];
+	uint8_t		digest[emsha::SHA256_HASH_SIZE];
+
+	// err is the errno from a failed open or read, or 0.
+	int		err;
+
+	// hashed is set for jobs whose digest was computed up front,
+	// i.e. standard input.
+	bool		hashed;
+	bool		done;
+};
+
+
+// task is a run of jobs [first, last) that a worker hashes in one go.
+struct task {
+	std::size_t	first;
+	std::size_t	last;
+};
+
+
+struct options {
+	bool		check;
+	bool		recursive;
+	bool		direct;
+	bool		quiet;
+	bool		status;
+	bool		warn;
+	bool		strict;
+	unsigned	threads;
+};
+
+
+class workQueue {
+public:
+	workQueue(std::vector<job>& j, const std::vector<task>& t, bool d)
+	    : jobs(j), tasks(t), next(0), direct(d)
+	{
+	}
+
+	void
+	run(unsigned nthreads)
+	{
+		for (unsigned i = 0; i < nthreads; i++) {
+			this->workers.emplace_back(&workQueue::worker, this);
+		}
+	}
+
+	// wait blocks until job i has been hashed.
+	void
+	wait(std::size_t i)
+	{
+		std::unique_lock<std::mutex>	lock(this->mtx);
+
+		this->cv.wait(lock, [this, i] { return this->jobs[i].done; });
+	}
+
+	// drain blocks until every worker has exited.
+	void
+	drain()
+	{
+		for (auto& w : this->workers) {
+			w.join();
+		}
+		this->workers.clear();
+	}
+
+private:
+	std::vector<job>&		jobs;
+	const std::vector<task>&	tasks;
+	std::atomic<std::size_t>	next;
+	bool				direct;
+	std::vector<std::thread>	workers;
+	std::mutex			mtx;
+	std::condition_variable		cv;
+
+	void	worker();
+	void	hashJob(job& j, std::vector<uint8_t>& buf);
+	int	hashMapped(int fd, std::uint64_t size, job& j, std::vector<uint8_t>& buf);
+	int	hashSmall(int fd, job& j, std::vector<uint8_t>& buf);
+};
+
+
+void
+workQueue::worker()
+{
+	std::vector<uint8_t>	buf(MMAP_THRESHOLD);
+
+	for (;;) {
+		std::size_t const t = this->next.fetch_add(1);
+		if (t >= this->tasks.size()) {
+			break;
+		}
+
+		for (std::size_t i = this->tasks[t].first; i < this->tasks[t].last; i++) {
+			this->hashJob(this->jobs[i], buf);
+
+			std::lock_guard<std::mutex>	lock(this->mtx);
+			this->jobs[i].done = true;
+			this->cv.notify_all();
+		}
+	}
+}
+
+
+// A file that is truncated while it is mapped raises SIGBUS when the
+// missing pages are touched. Each worker arms busJump around its
+// reads of a mapping, and the handler jumps back so that the file is
+// reported as an I/O error instead of killing the process.
+thread_local sigjmp_buf	*busJump = nullptr;
+
+
+void
+busHandler(int sig)
+{
+	if (busJump != nullptr) {
+		siglongjmp(*busJump, 1);
+	}
+
+	std::signal(sig, SIG_DFL);
+	std::raise(sig);
+}
+
+
+void
+installBusHandler()
+{
+	struct sigaction	sa{};
+
+	sa.sa_handler = busHandler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGBUS, &sa, nullptr);
+}
+
+
+// readRest hashes everything left in fd, up to EOF.
+int
+readRest(int fd, emsha::SHA256& ctx, std::vector<uint8_t>& buf)
+{
+	for (;;) {
+		ssize_t const n = read(fd, buf.data(), buf.size());
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return errno;
+		}
+		if (n == 0) {
+			return 0;
+		}
+		if (emsha::EMSHAResult::OK !=
+		    ctx.Update(buf.data(), static_cast<uint32_t>(n))) {
+			return EIO;
+		}
+	}
+}
+
+
+int
+workQueue::hashMapped(int fd, uint64_t size, job& j, std::vector<uint8_t>& buf)
+{
+	void	*p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// Files that can't be mapped are still hashed, just by reading
+	// them.
+	if (p == MAP_FAILED) {
+		return this->hashSmall(fd, j, buf);
+	}
+	(void)madvise(p, size, MADV_SEQUENTIAL);
+
+	emsha::SHA256	 ctx;
+	const uint8_t	*data = static_cast<const uint8_t *>(p);
+	sigjmp_buf	 jump;
+
+	if (sigsetjmp(jump, 1) != 0) {
+		busJump = nullptr;
+		munmap(p, size);
+		return EIO;
+	}
+
+	emsha::EMSHAResult	res = emsha::EMSHAResult::OK;
+
+	busJump = &jump;
+	for (uint64_t off = 0; (off < size) && (emsha::EMSHAResult::OK == res);) {
+		uint64_t const n = std::min(MAP_UPDATE_SIZE, size - off);
+		res = ctx.Update(data + off, static_cast<uint32_t>(n));
+		off += n;
+	}
+	busJump = nullptr;
+	munmap(p, size);
+
+	if (emsha::EMSHAResult::OK != res) {
+		return EIO;
+	}
+
+	// Anything appended since the fstat is read normally, so the
+	// digest covers the whole file as it is now.
+	if (lseek(fd, static_cast<off_t>(size), SEEK_SET) == -1) {
+		return errno;
+	}
+	int const err = readRest(fd, ctx, buf);
+	if (err != 0) {
+		return err;
+	}
+
+	return (emsha::EMSHAResult::OK == ctx.Finalise(j.digest)) ? 0 : EIO;
+}
+
+
+int
+workQueue::hashSmall(int fd, job& j, std::vector<uint8_t>& buf)
+{
+	emsha::SHA256	ctx;
+
+	// The size from stat(2) is only a hint; read until EOF, as the
+	// file may have changed in the meantime.
+	int const err = readRest(fd, ctx, buf);
+	if (err != 0) {
+		return err;
+	}
+
+	return (emsha::EMSHAResult::OK == ctx.Finalise(j.digest)) ? 0 : EIO;
+}
+
+
+void
+workQueue::hashJob(job& j, std::vector<uint8_t>& buf)
+{
+	if (j.err != 0 || j.hashed) {
+		return;
+	}
+
+	int const fd = open(j.path.c_str(), O_RDONLY);
+	if (fd == -1) {
+		j.err = errno;
+		return;
+	}
+
+	if (this->direct) {
+		emsha::EMSHAResult const res =
+		    emsha::SHA256FileDescriptor(fd, j.digest, emsha::FileMode::Direct);
+		j.err = (emsha::EMSHAResult::OK == res) ? 0 : EIO;
+	} else {
+		// The size seen when the files were listed may be stale;
+		// only the open file's size is safe to map.
+		struct stat	st{};
+
+		if (fstat(fd, &st) == -1) {
+			j.err = errno;
+		} else if (S_ISREG(st.st_mode) &&
+			   (static_cast<uint64_t>(st.st_size) >= MMAP_THRESHOLD)) {
+			j.err = this->hashMapped(fd, static_cast<uint64_t>(st.st_size), j, buf);
+		} else {
+			j.err = this->hashSmall(fd, j, buf);
+		}
+	}
+
+	close(fd);
+}
+
+
+void
+usage(int status)
+{
+	std::FILE	*out = (status == 0) ? stdout : stderr;
+
+	std::fprintf(out,
+	    "Usage: %s [OPTION]... [FILE]...\n"
+	    "Print or check SHA256 (256-bit) checksums.\n\n"
+	    "With no FILE, or when FILE is -, read standard input.\n\n"
+	    "  -b, --binary    read in binary mode (the default; accepted for compatibility)\n"
+	    "  -t, --text      read in text mode (identical to binary mode)\n"
+	    "  -c, --check     read checksums from the FILEs and check them\n"
+	    "  -r, --recursive hash the files in any directories named, recursively\n"
+	    "  -j, --jobs N    hash with N threads (default: one per CPU)\n"
+	    "      --direct    bypass the page cache when reading files\n\n"
+	    "The following options are useful only when verifying checksums:\n"
+	    "      --quiet     don't print OK for each successfully verified file\n"
+	    "      --status    don't output anything, status code shows success\n"
+	    "      --strict    exit non-zero for improperly formatted checksum lines\n"
+	    "  -w, --warn      warn about improperly formatted checksum lines\n"
+	    "  -h, --help      display this help and exit\n",
+	    progname);
+	std::exit(status);
+}
+
+
+// escapeName applies sha256sum's filename escaping, returning true
+// if the name needed it (and so the line needs a leading backslash).
+bool
+escapeName(const std::string& name, std::string& out)
+{
+	bool	escaped = false;
+
+	out.clear();
+	for (char const c : name) {
+		if (c == '\\') {
+			out += "\\\\";
+			escaped = true;
+		} else if (c == '\n') {
+			out += "\\n";
+			escaped = true;
+		} else if (c == '\r') {
+			out += "\\r";
+			escaped = true;
+		} else {
+			out += c;
+		}
+	}
+
+	return escaped;
+}
+
+
+bool
+unescapeName(const std::string& name, std::string& out)
+{
+	out.clear();
+	for (std::size_t i = 0; i < name.size(); i++) {
+		if (name[i] != '\\') {
+			out += name[i];
+			continue;
+		}
+
+		if (++i == name.size()) {
+			return false;
+		}
+
+		switch (name[i]) {
+		case '\\':
+			out += '\\';
+			break;
+		case 'n':
+			out += '\n';
+			break;
+		case 'r':
+			out += '\r';
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+int
+hexValue(char c)
+{
+	if (c >= '0' && c <= '9') { return c - '0'; }
+	if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+	if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+	return -1;
+}
+
+
+// parseManifestLine parses a line of sha256sum output into a job.
+bool
+parseManifestLine(std::string line, job& j)
+{
+	constexpr std::size_t	hexLength = 2 * emsha::SHA256_HASH_SIZE;
+	bool			escaped = false;
+
+	if (!line.empty() && line.back() == '\r') {
+		line.pop_back();
+	}
+
+	if (!line.empty() && line[0] == '\\') {
+		escaped = true;
+		line.erase(0, 1);
+	}
+
+	// <digest><space><space or *><name>
+	if (line.size() < hexLength + 3 || line[hexLength] != ' ' ||
+	    (line[hexLength + 1] != ' ' && line[hexLength + 1] != '*')) {
+		return false;
+	}
+
+	for (std::size_t i = 0; i < emsha::SHA256_HASH_SIZE; i++) {
+		int const hi = hexValue(line[2 * i]);
+		int const lo = hexValue(line[(2 * i) + 1]);
+		if (hi < 0 || lo < 0) {
+			return false;
+		}
+		j.expected[i] = static_cast<uint8_t>((hi << 4) | lo);
+	}
+
+	std::string const name = line.substr(hexLength + 2);
+	if (escaped) {
+		return unescapeName(name, j.path);
+	}
+
+	j.path = name;
+	return true;
+}
+
+
+void
+addFile(std::vector<job>& jobs, const std::string& path)
+{
+	job		j{};
+	struct stat	st{};
+
+	j.path = path;
+	if (stat(path.c_str(), &st) == -1) {
+		j.err = errno;
+	} else if (S_ISDIR(st.st_mode)) {
+		j.err = EISDIR;
+	} else {
+		j.size = static_cast<uint64_t>(st.st_size);
+	}
+
+	jobs.push_back(j);
+}
+
+
+// walk adds every regular file under dir, in sorted order. Symbolic
+// links to directories are not followed, which keeps cycles out of
+// the walk.
+void
+walk(std::vector<job>& jobs, const std::string& dir)
+{
+	DIR				*d = opendir(dir.c_str());
+	std::vector<std::string>	 names;
+
+	if (d == nullptr) {
+		addFile(jobs, dir);
+		return;
+	}
+
+	struct dirent	*ent = nullptr;
+	while ((ent = readdir(d)) != nullptr) {
+		if (std::strcmp(ent->d_name, ".") == 0 ||
+		    std::strcmp(ent->d_name, "..") == 0) {
+			continue;
+		}
+		names.emplace_back(ent->d_name);
+	}
+	closedir(d);
+	std::sort(names.begin(), names.end());
+
+	std::string const prefix = (dir.back() == '/') ? dir : dir + "/";
+	for (const auto& name : names) {
+		std::string const	path = prefix + name;
+		struct stat		st{};
+
+		if (lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+			walk(jobs, path);
+		} else {
+			addFile(jobs, path);
+		}
+	}
+}
+
+
+void
+addPath(std::vector<job>& jobs, const std::string& path, bool recursive)
+{
+	struct stat	st{};
+
+	if (recursive && stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+		walk(jobs, path);
+		return;
+	}
+
+	addFile(jobs, path);
+}
+
+
+std::vector<task>
+planTasks(const std::vector<job>& jobs)
+{
+	std::vector<task>	tasks;
+	std::size_t		i = 0;
+
+	while (i < jobs.size()) {
+		task		t{i, i + 1};
+		uint64_t	batch = jobs[i].size;
+
+		if (jobs[i].size < MMAP_THRESHOLD) {
+			while (t.last < jobs.size() &&
+			       (t.last - t.first) < SMALL_BATCH_FILES &&
+			       jobs[t.last].size < MMAP_THRESHOLD &&
+			       batch + jobs[t.last].size <= SMALL_BATCH_BYTES) {
+				batch += jobs[t.last].size;
+				t.last++;
+			}
+		}
+
+		tasks.push_back(t);
+		i = t.last;
+	}
+
+	return tasks;
+}
+
+
+// hashAll hashes every job, calling emit on each in order as soon as
+// it and everything before it are done.
+template <typename Emit>
+void
+hashAll(std::vector<job>& jobs, const options& opts, Emit emit)
+{
+	std::vector<task> const	tasks = planTasks(jobs);
+	unsigned const		nthreads = std::max(1U,
+					std::min(opts.threads,
+						 static_cast<unsigned>(tasks.size())));
+	workQueue		queue(jobs, tasks, opts.direct);
+
+	installBusHandler();
+	queue.run(nthreads);
+	for (std::size_t i = 0; i < jobs.size(); i++) {
+		queue.wait(i);
+		emit(jobs[i]);
+	}
+	queue.drain();
+}
+
+
+std::string
+hexDigest(const uint8_t *digest)
+{
+	char	buf[(2 * emsha::SHA256_HASH_SIZE) + 1];
+
+	for (uint32_t i = 0; i < emsha::SHA256_HASH_SIZE; i++) {
+		std::snprintf(buf + (2 * i), 3, "%02x", digest[i]);
+	}
+
+	return std::string(buf);
+}
+
+
+void
+printSum(const uint8_t *digest, const std::string& name)
+{
+	std::string	escaped;
+	bool const	needsEscape = escapeName(name, escaped);
+
+	std::cout << (needsEscape ? "\\" : "") << hexDigest(digest)
+		  << "  " << escaped << "\n";
+}
+
+
+void
+reportError(const std::string& path, int err)
+{
+	std::cout.flush();
+	std::cerr << progname << ": " << path << ": " << std::strerror(err) << "\n";
+}
+
+
+bool
+hashStdin(uint8_t *digest)
+{
+	return emsha::EMSHAResult::OK ==
+	       emsha::SHA256FileDescriptor(STDIN_FILENO, digest, emsha::FileMode::Buffered);
+}
+
+
+int
+generate(const std::vector<std::string>& paths, const options& opts)
+{
+	std::vector<job>	jobs;
+	int			status = 0;
+
+	for (const auto& path : paths) {
+		if (path == "-") {
+			job	j{};
+			j.path = "-";
+			j.hashed = true;
+			if (!hashStdin(j.digest)) {
+				j.err = errno ? errno : EIO;
+			}
+			jobs.push_back(j);
+			continue;
+		}
+		addPath(jobs, path, opts.recursive);
+	}
+
+	hashAll(jobs, opts, [&status](const job& j) {
+		if (j.err != 0) {
+			reportError(j.path, j.err);
+			status = 1;
+			return;
+		}
+		printSum(j.digest, j.path);
+	});
+
+	return status;
+}
+
+
+bool
+readManifest(const std::string& path, std::vector<job>& jobs,
+	     const options& opts, std::size_t& malformed)
+{
+	std::FILE	*f = (path == "-") ? stdin : std::fopen(path.c_str(), "r");
+	std::string	 line;
+	std::size_t	 lineno = 0;
+	int		 c;
+
+	if (f == nullptr) {
+		reportError(path, errno);
+		return false;
+	}
+
+	for (;;) {
+		c = std::fgetc(f);
+		if (c != EOF && c != '\n') {
+			line += static_cast<char>(c);
+			continue;
+		}
+
+		if (!line.empty()) {
+			job	j{};
+
+			lineno++;
+			if (parseManifestLine(line, j)) {
+				addFile(jobs, j.path);
+				std::memcpy(jobs.back().expected, j.expected,
+					    emsha::SHA256_HASH_SIZE);
+			} else {
+				malformed++;
+				if (opts.warn) {
+					std::cerr << progname << ": " << path << ": "
+						  << lineno
+						  << ": improperly formatted SHA256 checksum line\n";
+				}
+			}
+		}
+		line.clear();
+
+		if (c == EOF) {
+			break;
+		}
+	}
+
+	if (f != stdin) {
+		std::fclose(f);
+	}
+
+	return true;
+}
+
+
+int
+check(const std::vector<std::string>& manifests, const options& opts)
+{
+	std::vector<job>	jobs;
+	std::size_t		malformed = 0;
+	std::size_t		mismatched = 0;
+	std::size_t		unreadable = 0;
+	int			status = 0;
+
+	for (const auto& manifest : manifests) {
+		if (!readManifest(manifest, jobs, opts, malformed)) {
+			status = 1;
+		}
+	}
+
+	if (jobs.empty() && malformed > 0) {
+		std::cerr << progname << ": no properly formatted SHA256 checksum lines found\n";
+		return 1;
+	}
+
+	hashAll(jobs, opts, [&](const job& j) {
+		std::string	escaped;
+		bool const	needsEscape = escapeName(j.path, escaped);
+		const char	*prefix = needsEscape ? "\\" : "";
+
+		if (j.err != 0) {
+			unreadable++;
+			if (!opts.status) {
+				reportError(j.path, j.err);
+				std::cout << prefix << escaped << ": FAILED open or read\n";
+			}
+			return;
+		}
+
+		if (!emsha::HashEqual(j.expected, j.digest)) {
+			mismatched++;
+			if (!opts.status) {
+				std::cout << prefix << escaped << ": FAILED\n";
+			}
+			return;
+		}
+
+		if (!opts.quiet && !opts.status) {
+			std::cout << prefix << escaped << ": OK\n";
+		}
+	});
+
+	if (!opts.status) {
+		std::cout.flush();
+		if (malformed > 0) {
+			std::cerr << progname << ": WARNING: " << malformed
+				  << (malformed == 1 ? " line is" : " lines are")
+				  << " improperly formatted\n";
+		}
+		if (unreadable > 0) {
+			std::cerr << progname << ": WARNING: " << unreadable
+				  << (unreadable == 1 ? " listed file" : " listed files")
+				  << " could not be read\n";
+		}
+		if (mismatched > 0) {
+			std::cerr << progname << ": WARNING: " << mismatched
+				  << (mismatched == 1 ? " computed checksum did" :
+							" computed checksums did")
+				  << " NOT match\n";
+		}
+	}
+
+	if (mismatched > 0 || unreadable > 0 || (opts.strict && malformed > 0)) {
+		status = 1;
+	}
+
+	return status;
+}
+
+
+} // anonymous namespace
+
+
+int
+main(int argc, char *argv[])
+{
+	options				opts{};
+	std::vector<std::string>	paths;
+	bool				endOfOptions = false;
+
+	opts.threads = std::max(1U, std::thread::hardware_concurrency());
+
+	for (int i = 1; i < argc; i++) {
+		std::string const arg = argv[i];
+
+		if (endOfOptions || arg == "-" || arg[0] != '-') {
+			paths.push_back(arg);
+		} else if (arg == "--") {
+			endOfOptions = true;
+		} else if (arg == "-b" || arg == "--binary" || arg == "-t" || arg == "--text") {
+			continue;
+		} else if (arg == "-c" || arg == "--check") {
+			opts.check = true;
+		} else if (arg == "-r" || arg == "--recursive") {
+			opts.recursive = true;
+		} else if (arg == "--direct") {
+			opts.direct = true;
+		} else if (arg == "--quiet") {
+			opts.quiet = true;
+		} else if (arg == "--status") {
+			opts.status = true;
+		} else if (arg == "--strict") {
+			opts.strict = true;
+		} else if (arg == "-w" || arg == "--warn") {
+			opts.warn = true;
+		} else if (arg == "-j" || arg == "--jobs") {
+			if (++i == argc) {
+				usage(1);
+			}
+			opts.threads = static_cast<unsigned>(std::strtoul(argv[i], nullptr, 10));
+			if (opts.threads == 0) {
+				usage(1);
+			}
+		} else if (arg == "-h" || arg == "--help") {
+			usage(0);
+		} else {
+			std::cerr << progname << ": unrecognised option '" << arg << "'\n";
+			usage(1);
+		}
+	}
+
+	if (paths.empty()) {
+		paths.emplace_back("-");
+	}
+
+	if (opts.check) {
+		return check(paths, opts);
+	}
+
+	return generate(paths, opts);
+}
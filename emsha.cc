@@ -23,7 +23,9 @@
  */
 
 
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -38,19 +40,133 @@ using std::uint32_t;
 namespace emsha {
 
 
+namespace {
+
+
+// ctWords is the number of 64-bit words compared per step.
+constexpr std::size_t	ctWords = 4;
+constexpr std::size_t	ctStep = ctWords * 8;
+
+
+inline uint64_t
+loadWord(const uint8_t *p)
+{
+	uint64_t	w;
+
+	std::memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+
+// ctDiff returns the OR of a ^ b over length bytes: zero if and only
+// if they match. The main loop keeps a separate accumulator per word
+// so that the steps are independent, and has no data-dependent exit.
+uint64_t
+ctDiff(const uint8_t *a, const uint8_t *b, std::size_t length)
+{
+	uint64_t	acc[ctWords] = {0};
+	std::size_t	i = 0;
+
+	for (; (i + ctStep) <= length; i += ctStep) {
+		for (std::size_t j = 0; j < ctWords; j++) {
+			acc[j] |= loadWord(a + i + (8 * j)) ^ loadWord(b + i + (8 * j));
+		}
+	}
+
+	uint64_t	diff = 0;
+	for (std::size_t j = 0; j < ctWords; j++) {
+		diff |= acc[j];
+	}
+
+	for (; i < length; i++) {
+		diff |= static_cast<uint64_t>(a[i] ^ b[i]);
+	}
+
+	return diff;
+}
+
+
+// isZero returns 1 if x is zero and 0 otherwise, without a branch.
+inline uint64_t
+isZero(uint64_t x)
+{
+	return ((x | (0 - x)) >> 63) ^ 1;
+}
+
+
+} // anonymous namespace
+
+
 bool
 HashEqual(const uint8_t *a, const uint8_t *b)
 {
-	uint8_t	res = 0;
+	EMSHA_CHECK(a != nullptr, false);
+	EMSHA_CHECK(b != nullptr, false);
+
+	return ctDiff(a, b, SHA256_HASH_SIZE) == 0;
+}
+
 
+bool
+ConstantTimeEqual(const uint8_t *a, const uint8_t *b, std::size_t length)
+{
 	EMSHA_CHECK(a != nullptr, false);
 	EMSHA_CHECK(b != nullptr, false);
 
-	for (uint32_t i = 0; i < SHA256_HASH_SIZE; i++) {
-		res += a[i] ^ b[i];
+	return ctDiff(a, b, length) == 0;
+}
+
+
+std::size_t
+ConstantTimeEqualMany(const uint8_t *value, const uint8_t *candidates,
+		      std::size_t length, std::size_t count, uint64_t *results)
+{
+	std::size_t	matches = 0;
+
+	EMSHA_CHECK(value != nullptr, 0);
+	EMSHA_CHECK((candidates != nullptr) || (count == 0), 0);
+
+	if (results != nullptr) {
+		std::fill(results, results + ((count + 63) / 64), 0);
+	}
+
+	// Digest-sized values are held in registers across the whole
+	// array.
+	if (length == SHA256_HASH_SIZE) {
+		uint64_t	v[ctWords];
+
+		for (std::size_t j = 0; j < ctWords; j++) {
+			v[j] = loadWord(value + (8 * j));
+		}
+
+		for (std::size_t i = 0; i < count; i++) {
+			const uint8_t	*c = candidates + (i * SHA256_HASH_SIZE);
+			uint64_t	diff = 0;
+
+			for (std::size_t j = 0; j < ctWords; j++) {
+				diff |= v[j] ^ loadWord(c + (8 * j));
+			}
+
+			uint64_t const	eq = isZero(diff);
+			if (results != nullptr) {
+				results[i / 64] |= eq << (i % 64);
+			}
+			matches += static_cast<std::size_t>(eq);
+		}
+
+		return matches;
+	}
+
+	for (std::size_t i = 0; i < count; i++) {
+		uint64_t const	eq = isZero(ctDiff(value, candidates + (i * length), length));
+
+		if (results != nullptr) {
+			results[i / 64] |= eq << (i % 64);
+		}
+		matches += static_cast<std::size_t>(eq);
 	}
 
-	return res == 0;
+	return matches;
 }
 
 
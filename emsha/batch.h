@@ -0,0 +1,133 @@
+///
+/// \file emsha/batch.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares batched HMAC-SHA-256 operations over many messages
+///        and keys.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_BATCH_H
+#define EMSHA_BATCH_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/compact.h>
+
+
+namespace emsha {
+
+
+/// HMAC_MIN_TAG_LENGTH is the shortest truncated tag accepted by
+/// HMACVerifyBatch: half of the HMAC output, as RFC 2104 recommends.
+const std::uint32_t HMAC_MIN_TAG_LENGTH = 16;
+
+
+/// \brief HMACBatchItem is one message and tag to verify.
+struct HMACBatchItem {
+	/// Index of the message's key in the keys array.
+	std::uint32_t		 key;
+
+	/// The message, which may be a nullptr if it is empty.
+	const std::uint8_t	*message;
+	std::uint32_t		 messageLength;
+
+	/// The expected tag: the first tagLength bytes of the HMAC,
+	/// where tagLength is from HMAC_MIN_TAG_LENGTH to
+	/// SHA256_HASH_SIZE.
+	const std::uint8_t	*tag;
+	std::uint32_t		 tagLength;
+};
+
+
+/// \brief Return the number of 64-bit words needed for the result
+///        bitmap of a batch of count items.
+inline std::size_t
+HMACBatchResultWords(std::size_t count)
+{
+	return (count + 63) / 64;
+}
+
+
+/// \brief Verify the tags on a batch of messages.
+///
+/// Each key's midstates are computed once, by HMACPrecompute (or a
+/// key store), rather than once per message. The messages are
+/// grouped by key and run through the multi-lane kernel: each lane
+/// works through one message's blocks and then its outer hash, and
+/// takes the next message as soon as it finishes, so messages of
+/// different lengths keep every lane busy. Tags are compared in
+/// constant time.
+///
+/// \param keys The precomputed keys.
+/// \param keyCount The number of keys.
+/// \param items The messages and tags to verify.
+/// \param count The number of items.
+/// \param results Receives a bitmap of HMACBatchResultWords(count)
+///        words, with bit (i % 64) of word (i / 64) set if item i
+///        verified. Items with an out-of-range key index or tag
+///        length never verify.
+/// \return An ::EMSHAResult describing the result of the operation.
+///
+///         - EMSHAResult::NullPointer is returned if keys, items
+///           or results is a nullptr when it is needed, or if an
+///           item has a nullptr tag or a nullptr message with a
+///           nonzero length; results is not written.
+///         - EMSHAResult::VerifyFailed is returned if any item
+///           failed to verify.
+///         - EMSHAResult::OK is returned if every item verified.
+EMSHAResult	HMACVerifyBatch(const HMACMidstate *keys, std::uint32_t keyCount,
+				const HMACBatchItem *items, std::size_t count,
+				std::uint64_t *results);
+
+
+/// \brief Compute the HMAC of one message under many keys.
+///
+/// For fan-out signing, where the same payload goes out under each
+/// subscriber's key. Every key's inner hash runs over the same
+/// message blocks, and the message schedule of a block depends only
+/// on the block, so each block is expanded once for a pass over up
+/// to 64 keys and only the rounds are run per key, SHA256_LANES keys
+/// at a time.
+///
+/// \param keys The precomputed keys.
+/// \param keyCount The number of keys.
+/// \param m The message, which may be a nullptr if it is empty.
+/// \param ml The length of the message.
+/// \param tags Receives keyCount * SHA256_HASH_SIZE bytes: the HMAC
+///        under each key, in order.
+/// \return EMSHAResult::NullPointer if a pointer argument is a
+///         nullptr when it is needed, or EMSHAResult::OK.
+EMSHAResult	HMACSignMany(const HMACMidstate *keys, std::size_t keyCount,
+			     const std::uint8_t *m, std::uint32_t ml,
+			     std::uint8_t *tags);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_BATCH_H
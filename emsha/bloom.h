@@ -0,0 +1,198 @@
+///
+/// \file emsha/bloom.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares a blocked Bloom filter over SHA-256 digests.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_BLOOM_H
+#define EMSHA_BLOOM_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/digest.h>
+
+
+namespace emsha {
+
+
+/// BLOOM_BITS_PER_DIGEST is the default filter size per expected
+/// digest, which gives a false positive rate of about 0.1%.
+const std::uint32_t BLOOM_BITS_PER_DIGEST = 16;
+
+/// BLOOM_HEADER_SIZE is the size of a serialised filter's header:
+/// an eight-byte magic number and the number of blocks.
+const std::uint32_t BLOOM_HEADER_SIZE = 16;
+
+
+/// \brief Return the number of 64-bit words needed for the result
+///        bitmap of a batch query of count digests.
+inline std::size_t
+BloomResultWords(std::size_t count)
+{
+	return (count + 63) / 64;
+}
+
+
+/// \brief BloomFilter is a Bloom filter for SHA-256 digests, for
+///        ruling out lookups before they reach a slower index.
+///
+/// Digests are already uniform, so the filter never hashes: it
+/// slices the digest into its probes. Bits 64-127 of the digest pick
+/// a 64-byte block, which is one cache line, and bits 128-175 give
+/// eight 6-bit positions, one in each of the block's eight 64-bit
+/// words. Every query touches one cache line, and tests the whole
+/// block as eight independent word masks: on x86-64 CPUs with AVX2,
+/// chosen at run time, as two 256-bit vectors, and otherwise as a
+/// fixed loop over the eight words with no early exit.
+///
+/// The leading 64 bits of the digest are left alone, as DigestSet
+/// and DigestIndex bucket on them; a filter in front of either
+/// doesn't correlate with its buckets.
+///
+/// Adds aren't synchronised; queries may run concurrently with each
+/// other, but not with Add, Merge, Clear or Deserialize.
+class BloomFilter {
+public:
+	/// \brief Create an empty filter sized for the expected number
+	///        of digests.
+	///
+	/// The number of blocks is rounded up to a power of two, so
+	/// the filter may be up to twice the requested size.
+	///
+	/// \param expected The number of digests expected.
+	/// \param bitsPerDigest The filter bits to allocate for each.
+	explicit BloomFilter(std::uint64_t expected = 1024,
+			     std::uint32_t bitsPerDigest = BLOOM_BITS_PER_DIGEST);
+	~BloomFilter();
+
+	BloomFilter(const BloomFilter&) = delete;
+	BloomFilter& operator=(const BloomFilter&) = delete;
+
+	/// \brief Add a digest to the filter.
+	///
+	/// \param digest SHA256_HASH_SIZE bytes.
+	void		Add(const std::uint8_t *digest);
+	void		Add(const Digest& digest) { this->Add(digest.bytes); }
+
+	/// \brief Report whether a digest may have been added.
+	///
+	/// \return False if the digest was certainly never added.
+	bool		MayContain(const std::uint8_t *digest) const;
+	bool		MayContain(const Digest& digest) const
+	{
+		return this->MayContain(digest.bytes);
+	}
+
+	/// \brief Query a batch of digests.
+	///
+	/// The blocks for a group of digests are prefetched together
+	/// before any of them are tested, so the cache misses of a
+	/// large filter overlap instead of being taken one at a time.
+	///
+	/// \param digests count digests, SHA256_HASH_SIZE bytes each,
+	///        stored back to back.
+	/// \param count The number of digests.
+	/// \param results Receives a bitmap of BloomResultWords(count)
+	///        words, with bit (i % 64) of word (i / 64) set if
+	///        digest i may have been added.
+	/// \return The number of digests that may have been added.
+	std::size_t	MayContainMany(const std::uint8_t *digests, std::size_t count,
+				       std::uint64_t *results) const;
+	std::size_t	MayContainMany(const Digest *digests, std::size_t count,
+				       std::uint64_t *results) const;
+
+	/// \brief Add every digest in another filter to this one.
+	///
+	/// \return EMSHAResult::InvalidState if the filters have a
+	///         different number of blocks, or EMSHAResult::OK.
+	EMSHAResult	Merge(const BloomFilter& other);
+
+	/// \brief Remove every digest from the filter.
+	void		Clear();
+
+	/// \brief The number of 64-byte blocks in the filter.
+	std::size_t	Blocks() const { return this->blocks; }
+
+	/// \brief The size of the filter once serialised: the header,
+	///        the blocks and a trailing SHA-256 digest of both.
+	std::size_t	SerializedSize() const;
+
+	/// \brief Serialise the filter, with its words in little-endian
+	///        byte order.
+	///
+	/// \param buf Receives SerializedSize() bytes.
+	/// \param length The size of buf.
+	/// \return EMSHAResult::NullPointer, EMSHAResult::NoSpace if buf
+	///         is too small, or EMSHAResult::OK.
+	EMSHAResult	Serialize(std::uint8_t *buf, std::size_t length) const;
+
+	/// \brief Replace the filter with a serialised one, resizing it
+	///        as needed.
+	///
+	/// \return An ::EMSHAResult describing the result of the
+	///         operation; the filter is unchanged on failure.
+	///
+	///         - EMSHAResult::NullPointer is returned if buf is a
+	///           nullptr.
+	///         - EMSHAResult::InvalidState is returned if buf isn't a
+	///           serialised filter.
+	///         - EMSHAResult::VerifyFailed is returned if its
+	///           trailing digest doesn't match.
+	///         - EMSHAResult::OK is returned otherwise.
+	EMSHAResult	Deserialize(const std::uint8_t *buf, std::size_t length);
+
+	/// \brief Write the serialised filter to a file, replacing it.
+	///
+	/// \return EMSHAResult::NullPointer, EMSHAResult::IOError or
+	///         EMSHAResult::OK.
+	EMSHAResult	Save(const char *path) const;
+
+	/// \brief Replace the filter with one read from a file.
+	///
+	/// \return EMSHAResult::IOError if the file can't be read, or
+	///         a result from Deserialize.
+	EMSHAResult	Load(const char *path);
+
+private:
+	void		allocate(std::size_t count);
+	std::size_t		 blockIndex(const std::uint8_t *digest) const;
+	const std::uint64_t	*block(const std::uint8_t *digest) const;
+	std::uint64_t		*block(const std::uint8_t *digest);
+
+	std::uint8_t	*storage;
+	std::uint64_t	*words;
+	std::size_t	 blocks;
+	std::uint32_t	 bits;
+};
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_BLOOM_H
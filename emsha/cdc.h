@@ -0,0 +1,167 @@
+///
+/// \file emsha/cdc.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares a content-defined chunker that hashes its chunks
+///        as it finds them.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_CDC_H
+#define EMSHA_CDC_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/digest.h>
+
+
+namespace emsha {
+
+
+/// CDC_MIN_SIZE is the default smallest chunk, other than the last
+/// chunk of a stream.
+const std::uint32_t CDC_MIN_SIZE = 2048;
+
+/// CDC_AVG_SIZE is the default target average chunk size.
+const std::uint32_t CDC_AVG_SIZE = 8192;
+
+/// CDC_MAX_SIZE is the default largest chunk.
+const std::uint32_t CDC_MAX_SIZE = 65536;
+
+/// CDC_WINDOW_SIZE is how much input each thread scans for boundaries
+/// before the chunks found in it are hashed, sized so that the
+/// window is still in cache when it is hashed.
+const std::uint32_t CDC_WINDOW_SIZE = 1024 * 1024;
+
+
+/// \brief CDCChunk describes one chunk of a stream.
+struct CDCChunk {
+	/// The offset of the chunk in the stream.
+	std::uint64_t	offset;
+
+	/// The length of the chunk.
+	std::uint32_t	length;
+
+	/// The SHA-256 digest of the chunk.
+	Digest		digest;
+};
+
+
+/// \brief CDCChunker splits a stream into content-defined chunks
+///        and computes the SHA-256 digest of each one.
+///
+/// Boundaries are found with FastCDC: a gear hash is rolled over the
+/// stream, skipping the first minSize bytes of each chunk, and a
+/// boundary is declared where its top bits are zero. Until a chunk
+/// reaches avgSize, more bits have to be zero than afterwards, which
+/// pulls chunk sizes towards the average. As boundaries depend only
+/// on nearby content, an insertion or deletion only changes the
+/// chunks around it.
+///
+/// Input is taken a window at a time: the window is scanned for
+/// boundaries, and the chunks that end in it are then hashed while
+/// it is still in cache, rather than in a second pass over the whole
+/// stream. Chunks that lie entirely within a window are hashed
+/// several at a time through the multi-lane SHA-256 kernel, with the
+/// window's chunks split between threads; a chunk that spans Update
+/// calls is hashed as its bytes arrive, so the input never has to
+/// be kept or copied.
+///
+/// The chunks found don't depend on how the stream is divided
+/// between calls to Update, or on the number of threads.
+class CDCChunker {
+public:
+	/// \brief Create a chunker.
+	///
+	/// \param minSize The smallest chunk; at least 64 bytes.
+	/// \param avgSize The target average chunk size, a power of
+	///        two greater than minSize.
+	/// \param maxSize The largest chunk, greater than avgSize.
+	/// \param threads The number of threads that hash chunks.
+	///
+	/// The sizes should be checked with ValidSizes first: a
+	/// chunker built with sizes that don't meet these conditions
+	/// can't be used, and its Update and Finalise fail the
+	/// EMSHA_CHECK that they are valid.
+	explicit CDCChunker(std::uint32_t minSize = CDC_MIN_SIZE,
+			    std::uint32_t avgSize = CDC_AVG_SIZE,
+			    std::uint32_t maxSize = CDC_MAX_SIZE,
+			    std::uint32_t threads = 1);
+
+	/// \brief Chunk more of the stream.
+	///
+	/// \param data The next part of the stream.
+	/// \param length The length of data.
+	/// \param chunks The chunks that end in data are appended to
+	///        chunks, in stream order.
+	/// \return EMSHAResult::InvalidState if the chunker's sizes
+	///         aren't valid, EMSHAResult::NullPointer if data is a
+	///         nullptr and length is nonzero, or EMSHAResult::OK.
+	EMSHAResult	Update(const std::uint8_t *data, std::size_t length,
+			       std::vector<CDCChunk>& chunks);
+
+	/// \brief End the stream, appending its last chunk to chunks
+	///        if there is one, and reset the chunker.
+	///
+	/// \return EMSHAResult::InvalidState if the chunker's sizes
+	///         aren't valid, or EMSHAResult::OK.
+	EMSHAResult	Finalise(std::vector<CDCChunk>& chunks);
+
+	/// \brief Discard any partial chunk and start a new stream.
+	void		Reset();
+
+	/// \brief Report whether a chunker can be built with the
+	///        given sizes, as described for the constructor.
+	static bool	ValidSizes(std::uint32_t minSize, std::uint32_t avgSize,
+				   std::uint32_t maxSize);
+
+private:
+	std::size_t	scan(const std::uint8_t *p, std::size_t n, bool& found);
+	EMSHAResult	window(const std::uint8_t *data, std::size_t n,
+			       std::vector<CDCChunk>& chunks);
+
+	std::uint32_t	minSize;
+	std::uint32_t	avgSize;
+	std::uint32_t	maxSize;
+	std::uint32_t	threads;
+	std::uint64_t	maskS;		// Boundary mask below avgSize.
+	std::uint64_t	maskL;		// Boundary mask from avgSize on.
+
+	std::uint64_t	position;	// Stream bytes taken so far.
+	std::uint64_t	chunkStart;	// Offset of the partial chunk.
+	std::uint32_t	chunkLength;	// Bytes in the partial chunk.
+	std::uint64_t	fp;		// Gear hash of the partial chunk.
+	SHA256		carry;		// Digest of the partial chunk.
+};
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_CDC_H
@@ -0,0 +1,251 @@
+///
+/// \file emsha/chunked.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares a chunked, authenticated stream format whose byte
+///        ranges can be verified independently.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_CHUNKED_H
+#define EMSHA_CHUNKED_H
+
+
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/compact.h>
+
+
+namespace emsha {
+
+
+/// CHUNKED_HEADER_SIZE is the size of the header at the start of an
+/// encoded stream.
+const std::uint32_t CHUNKED_HEADER_SIZE = 40;
+
+/// CHUNKED_STREAM_ID_SIZE is the size of the random identifier each
+/// stream carries in its header.
+const std::uint32_t CHUNKED_STREAM_ID_SIZE = 16;
+
+/// CHUNKED_CHUNK_SIZE is the chunk size used when a chunk size of
+/// zero is asked for.
+const std::uint32_t CHUNKED_CHUNK_SIZE = 65536;
+
+/// CHUNKED_TAG_SIZE is the size of the HMAC-SHA-256 tag following
+/// each chunk.
+const std::uint32_t CHUNKED_TAG_SIZE = SHA256_HASH_SIZE;
+
+
+/// \brief ChunkedStream encodes and verifies chunked authenticated
+///        streams under a single HMAC key.
+///
+/// An encoded stream is a header followed by the data, split into
+/// fixed-size chunks, with each chunk followed by its tag:
+///
+/// ```
+///     header | chunk 0 | tag 0 | chunk 1 | tag 1 | ... | chunk n | tag n
+/// ```
+///
+/// The header holds a magic number, the chunk size, a random stream
+/// identifier and the length of the data. Each tag is the
+/// HMAC-SHA-256 of the header, the chunk's index and the chunk data,
+/// so chunks can't be reordered, spliced in from another stream
+/// under the same key, or dropped from the end, and the header can't
+/// be changed. Every chunk but the last is exactly the chunk size;
+/// an empty stream still has one (empty) final chunk.
+///
+/// As the data length is part of every tag, it has to be known
+/// before the first chunk is tagged.
+///
+/// Because chunks sit at fixed offsets, a reader that wants a byte
+/// range fetches only the chunks covering it (see #EncodedRange) and
+/// verifies them with #VerifyChunks, without seeing any other part
+/// of the stream.
+///
+/// The key is precomputed once into an HMACMidstate. All of the
+/// methods are const, so one ChunkedStream can be shared between
+/// threads.
+class ChunkedStream {
+public:
+	/// \brief Set up a stream format with the given key and chunk
+	///        size.
+	///
+	/// \param k The HMAC key.
+	/// \param kl The length of the HMAC key.
+	/// \param chunkSize The size of each chunk; zero selects
+	///        CHUNKED_CHUNK_SIZE. A multiple of SHA256_MB_SIZE keeps
+	///        the tags cheapest.
+	ChunkedStream(const std::uint8_t *k, std::uint32_t kl,
+		      std::uint32_t chunkSize);
+
+	/// The key is wiped when the ChunkedStream is destroyed.
+	~ChunkedStream();
+
+	ChunkedStream(const ChunkedStream&) = delete;
+	ChunkedStream& operator=(const ChunkedStream&) = delete;
+
+	/// \brief Return the chunk size.
+	std::uint32_t	ChunkSize() const { return this->chunkSize; }
+
+	/// \brief Return the number of chunks needed for dataLength
+	///        bytes of data.
+	std::uint64_t	Chunks(std::uint64_t dataLength) const;
+
+	/// \brief Return the size of the encoding of dataLength bytes
+	///        of data.
+	std::uint64_t	EncodedLength(std::uint64_t dataLength) const;
+
+	/// \brief Return the offset of a chunk in the encoded stream.
+	std::uint64_t	ChunkOffset(std::uint64_t index) const;
+
+	/// \brief Work out which part of an encoded stream covers a
+	///        range of the data.
+	///
+	/// \param dataLength The total length of the data.
+	/// \param offset The offset of the first byte wanted.
+	/// \param length The number of bytes wanted.
+	/// \param first Receives the index of the first chunk.
+	/// \param start Receives the offset in the encoded stream of
+	///        the first chunk.
+	/// \param end Receives the offset in the encoded stream just
+	///        past the last chunk's tag.
+	/// \return EMSHAResult::InvalidState if the range doesn't lie
+	///         within the data, or EMSHAResult::OK.
+	EMSHAResult	EncodedRange(std::uint64_t dataLength,
+				     std::uint64_t offset, std::uint64_t length,
+				     std::uint64_t& first, std::uint64_t& start,
+				     std::uint64_t& end) const;
+
+	/// \brief Write the stream header.
+	///
+	/// \param header Buffer of CHUNKED_HEADER_SIZE bytes.
+	/// \param streamID CHUNKED_STREAM_ID_SIZE bytes identifying the
+	///        stream, which must not be reused under the same key;
+	///        see #NewStreamID.
+	/// \param dataLength The length of the data in the stream.
+	/// \return EMSHAResult::NullPointer or EMSHAResult::OK.
+	EMSHAResult	WriteHeader(std::uint8_t *header, const std::uint8_t *streamID,
+				    std::uint64_t dataLength) const;
+
+	/// \brief Check a stream header against this format.
+	///
+	/// The header is only authenticated along with the chunks, by
+	/// #VerifyChunks; this checks that it describes a stream this
+	/// ChunkedStream can read.
+	///
+	/// \param header The CHUNKED_HEADER_SIZE byte header.
+	/// \param dataLength If not a nullptr, receives the length of
+	///        the data in the stream.
+	/// \return EMSHAResult::NullPointer, EMSHAResult::VerifyFailed
+	///         if the header isn't for a stream with this chunk
+	///         size, or EMSHAResult::OK.
+	EMSHAResult	CheckHeader(const std::uint8_t *header,
+				    std::uint64_t *dataLength = nullptr) const;
+
+	/// \brief Compute the tag for one chunk.
+	///
+	/// This is the building block for encoders that see their
+	/// input a chunk at a time. The header says how long the data
+	/// is, and so how long each chunk has to be: the final chunk
+	/// is the first one shorter than the chunk size, or an empty
+	/// chunk if the data ends on a chunk boundary.
+	///
+	/// \param header The stream's header.
+	/// \param index The chunk's index.
+	/// \param chunk The chunk data.
+	/// \param length The length of the chunk.
+	/// \param tag Buffer of CHUNKED_TAG_SIZE bytes.
+	/// \return EMSHAResult::NullPointer, EMSHAResult::VerifyFailed
+	///         if the header isn't for this format,
+	///         EMSHAResult::InvalidState if the index or length is
+	///         wrong for the stream, or EMSHAResult::OK.
+	EMSHAResult	Tag(const std::uint8_t *header, std::uint64_t index,
+			    const std::uint8_t *chunk, std::uint32_t length,
+			    std::uint8_t *tag) const;
+
+	/// \brief Encode a complete message in one pass, under a new
+	///        random stream identifier.
+	///
+	/// \param data The data to encode.
+	/// \param dataLength The length of the data.
+	/// \param encoded Buffer of #EncodedLength(dataLength) bytes.
+	/// \return An ::EMSHAResult describing the result of the
+	///         operation.
+	EMSHAResult	Encode(const std::uint8_t *data, std::uint64_t dataLength,
+			       std::uint8_t *encoded) const;
+
+	/// \brief Encode a complete message in one pass, under the
+	///        given stream identifier.
+	EMSHAResult	Encode(const std::uint8_t *data, std::uint64_t dataLength,
+			       const std::uint8_t *streamID,
+			       std::uint8_t *encoded) const;
+
+	/// \brief Generate a random stream identifier.
+	///
+	/// \param streamID Buffer of CHUNKED_STREAM_ID_SIZE bytes.
+	static void	NewStreamID(std::uint8_t *streamID);
+
+	/// \brief Verify a run of consecutive chunks.
+	///
+	/// The encoded bytes are the part of an encoded stream between
+	/// the start and end returned by #EncodedRange: whole chunks
+	/// with their tags, starting at chunk first. The work is split
+	/// across up to threads threads; verification is constant-time
+	/// per tag, but stops scheduling new chunks once one fails.
+	///
+	/// \param header The stream's header, which gives the length
+	///        of the data and so where the final chunk is.
+	/// \param first The index of the first chunk.
+	/// \param encoded The encoded chunks.
+	/// \param encodedLength The length of encoded.
+	/// \param threads The number of threads to use.
+	/// \return An ::EMSHAResult describing the result of the
+	///         operation.
+	///
+	///         - EMSHAResult::NullPointer is returned if header or
+	///           encoded is a nullptr.
+	///         - EMSHAResult::InvalidState is returned if the
+	///           encoded bytes aren't whole chunks of the stream.
+	///         - EMSHAResult::VerifyFailed is returned if the
+	///           header isn't for this format, or any tag doesn't
+	///           match.
+	///         - EMSHAResult::OK is returned if every chunk is
+	///           authentic.
+	EMSHAResult	VerifyChunks(const std::uint8_t *header, std::uint64_t first,
+				     const std::uint8_t *encoded,
+				     std::uint64_t encodedLength,
+				     std::uint32_t threads = 1) const;
+
+private:
+	HMACMidstate	key;
+	std::uint32_t	chunkSize;
+};
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_CHUNKED_H
@@ -0,0 +1,260 @@
+///
+/// \file emsha/compact.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares compact SHA-256 and HMAC contexts for keeping very
+///        many streams open at once.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_COMPACT_H
+#define EMSHA_COMPACT_H
+
+
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+
+
+namespace emsha {
+
+
+/// \brief HMACMidstate is a precomputed HMAC-SHA-256 key.
+///
+/// Every HMAC under a given key starts by hashing the same two
+/// blocks, k0 ⊕ ipad and k0 ⊕ opad. The midstate holds the SHA-256
+/// intermediate hashes after each of them, which is all that is
+/// needed to compute HMACs under that key: it never holds the key
+/// itself, and it replaces the key setup (including hashing keys
+/// longer than a block) on every use with a 64-byte copy.
+///
+/// Midstates are key material, and should be wiped with
+/// HMACMidstateWipe when they are no longer needed.
+struct HMACMidstate {
+	/// Intermediate hash after the k0 ⊕ ipad block.
+	std::uint32_t	inner[8];
+
+	/// Intermediate hash after the k0 ⊕ opad block.
+	std::uint32_t	outer[8];
+};
+
+
+/// \brief Precompute the HMAC midstates for a key.
+///
+/// \param k The HMAC key.
+/// \param kl The length of the HMAC key.
+/// \param midstate Receives the midstates.
+/// \return EMSHAResult::NullPointer if k is a nullptr and kl is
+///         nonzero, or EMSHAResult::OK.
+EMSHAResult	HMACPrecompute(const std::uint8_t *k, std::uint32_t kl,
+			       HMACMidstate& midstate);
+
+
+/// \brief Zeroise a midstate.
+void		HMACMidstateWipe(HMACMidstate& midstate);
+
+
+/// \brief BlockSlab is a fixed-size pool of message blocks shared
+///        between compact contexts.
+///
+/// A compact context only holds a message block while it has a
+/// partial block pending; the block is borrowed from a slab and
+/// returned as soon as it is filled and compressed, so a slab only
+/// needs to be as large as the number of streams expected to be
+/// mid-block at once.
+///
+/// A slab is not synchronised; share one between the contexts owned
+/// by a single thread (or shard), not between threads.
+class BlockSlab {
+public:
+	/// NO_BLOCK marks a context without a block.
+	static const std::uint32_t NO_BLOCK = 0xffffffff;
+
+	/// \brief Create a slab of capacity blocks, allocated once
+	///        up front.
+	explicit BlockSlab(std::uint32_t capacity);
+
+	/// \brief Create a slab over caller-provided storage, for
+	///        systems that don't allocate.
+	///
+	/// \param storage capacity * SHA256_MB_SIZE bytes of storage.
+	/// \param freeList capacity words of bookkeeping storage.
+	/// \param capacity The number of blocks.
+	BlockSlab(std::uint8_t *storage, std::uint32_t *freeList,
+		  std::uint32_t capacity);
+
+	/// Blocks are wiped when the slab is destroyed.
+	~BlockSlab();
+
+	BlockSlab(const BlockSlab&) = delete;
+	BlockSlab& operator=(const BlockSlab&) = delete;
+
+	/// \brief The number of blocks in the slab.
+	std::uint32_t	Capacity() const { return this->capacity; }
+
+	/// \brief The number of blocks not currently held by a
+	///        context.
+	std::uint32_t	Available() const { return this->available; }
+
+	/// \brief Take a block from the slab.
+	///
+	/// \return The block's index, or NO_BLOCK if the slab is
+	///         empty.
+	std::uint32_t	Acquire();
+
+	/// \brief Wipe a block and return it to the slab.
+	void		Release(std::uint32_t block);
+
+	/// \brief Return the storage for a block.
+	std::uint8_t	*Block(std::uint32_t block)
+	{
+		return this->blocks + (static_cast<std::uint64_t>(block) * SHA256_MB_SIZE);
+	}
+
+private:
+	std::uint8_t	*blocks;
+	std::uint32_t	*freeList;
+	std::uint32_t	 capacity;
+	std::uint32_t	 available;
+	bool		 owned;
+};
+
+
+/// \brief CompactSHA256 is a SHA-256 context that keeps only the
+///        intermediate hash and length in the object.
+///
+/// Any partial message block is held in a block borrowed from a
+/// BlockSlab, which must be passed to every call. A compact context
+/// doesn't need a destructor call to release its block, so it can
+/// live in arrays of plain structs; use #Release to give the block
+/// back when a stream is abandoned mid-message.
+///
+/// \note The Hash interface isn't implemented, as every operation
+///       takes the slab.
+class CompactSHA256 {
+public:
+	/// A new context is ready to use, and holds no block.
+	CompactSHA256();
+
+	/// \brief Return the context to its initial state, releasing
+	///        any block it holds.
+	void		Reset(BlockSlab& slab);
+
+	/// \brief Start the context from an intermediate hash, as if
+	///        length bytes (a multiple of SHA256_MB_SIZE) had
+	///        already been written.
+	///
+	/// This is how CompactHMAC starts from an HMACMidstate.
+	void		Reset(BlockSlab& slab, const std::uint32_t *ih,
+			      std::uint64_t length);
+
+	/// \brief Write data into the context.
+	///
+	/// \return An ::EMSHAResult describing the result of the
+	///         operation.
+	///
+	///         - EMSHAResult::NullPointer is returned if message
+	///           is a nullptr and messageLength is nonzero.
+	///         - EMSHAResult::InvalidState is returned if the
+	///           context was finalised or is in an error state.
+	///         - EMSHAResult::NoSpace is returned if a partial
+	///           block needs to be kept but the slab is empty. The
+	///           context is unchanged, and the update can be
+	///           retried once blocks have been released.
+	///         - EMSHAResult::InputTooLong is returned if too much
+	///           data has been written to the context.
+	///         - EMSHAResult::OK is returned otherwise.
+	EMSHAResult	Update(BlockSlab& slab, const std::uint8_t *message,
+			       std::uint32_t messageLength);
+
+	/// \brief Complete the digest and release any block held.
+	///
+	/// \param slab The slab the context's blocks come from.
+	/// \param digest Buffer of at least SHA256_HASH_SIZE bytes.
+	/// \return EMSHAResult::NullPointer, EMSHAResult::InvalidState
+	///         or EMSHAResult::OK, as for SHA256::Finalise.
+	EMSHAResult	Finalise(BlockSlab& slab, std::uint8_t *digest);
+
+	/// \brief Give back any block held and wipe the context.
+	void		Release(BlockSlab& slab);
+
+private:
+	std::uint32_t	i_hash[8];
+	std::uint64_t	mlen;		// Bytes written so far.
+	std::uint32_t	block;		// Slab block, or NO_BLOCK.
+	std::uint8_t	state;
+};
+
+
+/// \brief CompactHMAC is an HMAC-SHA-256 context that refers to a
+///        shared, precomputed key.
+///
+/// The midstate is not copied: it must outlive the context, and any
+/// number of contexts may share one. For a million connections
+/// sharing a handful of keys, each stream costs sizeof(CompactHMAC)
+/// plus a slab block while it has a partial block pending, compared
+/// to sizeof(HMAC), which embeds a SHA256 context, the padded key and
+/// a result buffer.
+class CompactHMAC {
+public:
+	/// \brief Start an HMAC under the given key.
+	CompactHMAC(const HMACMidstate *key, BlockSlab& slab);
+
+	/// \brief Restart the HMAC under the same key.
+	void		Reset(BlockSlab& slab);
+
+	/// \brief Write data into the HMAC; see CompactSHA256::Update.
+	EMSHAResult	Update(BlockSlab& slab, const std::uint8_t *message,
+			       std::uint32_t messageLength);
+
+	/// \brief Complete the HMAC, writing SHA256_HASH_SIZE bytes to
+	///        digest; see CompactSHA256::Finalise.
+	EMSHAResult	Finalise(BlockSlab& slab, std::uint8_t *digest);
+
+	/// \brief Give back any block held and wipe the context.
+	void		Release(BlockSlab& slab);
+
+private:
+	const HMACMidstate	*key;
+	CompactSHA256		 inner;
+};
+
+
+/// \brief Perform a single-pass HMAC computation with a precomputed
+///        key.
+///
+/// \param key The precomputed key.
+/// \param m The message data over which the HMAC is to be computed.
+/// \param ml The length of the message.
+/// \param d Buffer of SHA256_HASH_SIZE bytes for the HMAC.
+/// \return An ::EMSHAResult describing the result of the operation.
+EMSHAResult	ComputeHMAC(const HMACMidstate& key, const std::uint8_t *m,
+			    std::uint32_t ml, std::uint8_t *d);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_COMPACT_H
@@ -0,0 +1,108 @@
+///
+/// \file emsha/crc32c.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares CRC32C and a context computing CRC32C and SHA-256
+///        over the same data in one pass.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_CRC32C_H
+#define EMSHA_CRC32C_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+
+
+namespace emsha {
+
+
+/// SHA256CRC32C_SIZE is the size of a SHA256CRC32C result: the
+/// SHA-256 digest followed by the big-endian CRC32C.
+const std::uint32_t SHA256CRC32C_SIZE = SHA256_HASH_SIZE + 4;
+
+
+/// \brief Compute or continue a CRC32C (Castagnoli) checksum.
+///
+/// On x86 processors with SSE4.2, detected at run time, and on ARMv8
+/// builds with the CRC extension, this uses the processor's crc32
+/// instructions; elsewhere it uses slicing-by-8 tables.
+///
+/// \param m The data.
+/// \param ml The length of the data.
+/// \param crc The CRC32C of any preceding data, so that
+///        CRC32C(b, bl, CRC32C(a, al)) is the CRC32C of a followed
+///        by b.
+/// \return The CRC32C.
+std::uint32_t	CRC32C(const std::uint8_t *m, std::size_t ml, std::uint32_t crc = 0);
+
+
+/// \brief SHA256CRC32C computes a CRC32C and a SHA-256 digest of the
+///        same data in a single pass.
+///
+/// Data is taken a strip at a time: each strip is hashed and the CRC
+/// is then run over it while it is still in L1, so the data is only
+/// read from memory once. The result is SHA256CRC32C_SIZE
+/// bytes, the digest followed by the big-endian CRC; #CRC gives the
+/// CRC on its own.
+class SHA256CRC32C : public Hash {
+public:
+	SHA256CRC32C();
+	~SHA256CRC32C() override = default;
+
+	/// \brief Return the context to its initial state.
+	EMSHAResult	Reset() override;
+
+	/// \brief Write data into the context; see SHA256::Update.
+	EMSHAResult	Update(const std::uint8_t *message,
+			       std::uint32_t messageLength) override;
+
+	/// \brief Complete the digest, writing SHA256CRC32C_SIZE
+	///        bytes to digest; see SHA256::Finalise.
+	EMSHAResult	Finalise(std::uint8_t *digest) override;
+
+	/// \brief Copy out the result, finalising the context if
+	///        needed; see SHA256::Result.
+	EMSHAResult	Result(std::uint8_t *digest) override;
+
+	/// \brief Returns SHA256CRC32C_SIZE.
+	std::uint32_t	Size() override;
+
+	/// \brief The CRC32C of the data written so far.
+	std::uint32_t	CRC() const { return this->crc; }
+
+private:
+	SHA256		sha;
+	std::uint32_t	crc;
+};
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_CRC32C_H
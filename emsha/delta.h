@@ -0,0 +1,195 @@
+///
+/// \file emsha/delta.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares an rsync-style delta engine, built on rolling
+///        weak checksums and SHA-256 block digests.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_DELTA_H
+#define EMSHA_DELTA_H
+
+
+#include <cstdint>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/digest.h>
+
+
+namespace emsha {
+
+
+/// DELTA_BLOCK_SIZE is the default signature block size.
+const std::uint32_t DELTA_BLOCK_SIZE = 2048;
+
+
+/// \brief DeltaBlock is the signature of one block of the base.
+struct DeltaBlock {
+	/// The rolling weak checksum of the block.
+	std::uint32_t	weak;
+
+	/// The SHA-256 digest of the block.
+	Digest		strong;
+};
+
+
+/// \brief DeltaSignature describes a base file as a series of
+///        fixed-size blocks.
+///
+/// The last block is shorter than blockSize if the base length isn't
+/// a multiple of it.
+struct DeltaSignature {
+	/// The size of every block but the last.
+	std::uint32_t		blockSize;
+
+	/// The length of the base.
+	std::uint64_t		baseLength;
+
+	/// The block signatures, in base order.
+	std::vector<DeltaBlock>	blocks;
+};
+
+
+/// \brief DeltaOpKind says where the bytes of a DeltaOp come from.
+enum class DeltaOpKind : std::uint8_t {
+	/// The bytes are copied from the base.
+	Copy = 0,
+
+	/// The bytes are taken from the delta's literal data.
+	Literal = 1,
+};
+
+
+/// \brief DeltaOp is one step in rebuilding the target.
+struct DeltaOp {
+	/// Where the bytes come from.
+	DeltaOpKind	kind;
+
+	/// The offset of the bytes in the base for a copy, or in the
+	/// delta's literal data for a literal.
+	std::uint64_t	offset;
+
+	/// The number of bytes.
+	std::uint64_t	length;
+};
+
+
+/// \brief Delta rebuilds a target from a base.
+struct Delta {
+	/// Applied in order, each op appends its bytes to the target.
+	std::vector<DeltaOp>		ops;
+
+	/// The bytes of the target not found in the base.
+	std::vector<std::uint8_t>	literals;
+
+	/// The length of the target.
+	std::uint64_t			targetLength;
+
+	/// The SHA-256 digest of the whole target, checked when the
+	/// delta is applied.
+	Digest				digest;
+};
+
+
+/// \brief Compute the signature of a base.
+///
+/// Each block's weak checksum and SHA-256 digest are computed in the
+/// same pass, the digests several blocks at a time through the
+/// multi-lane kernel, with the blocks split evenly between threads.
+///
+/// \param base The base data.
+/// \param length The length of the base.
+/// \param blockSize The block size; larger blocks give a smaller
+///        signature but find fewer matches.
+/// \param sig Receives the signature.
+/// \param threads The number of threads to hash with.
+/// \return An ::EMSHAResult describing the result of the operation.
+///
+///         - EMSHAResult::NullPointer is returned if base is a
+///           nullptr and length is nonzero.
+///         - EMSHAResult::InvalidState is returned if blockSize is
+///           zero.
+///         - EMSHAResult::InputTooLong is returned if the base has
+///           more than 2^32 - 2 blocks.
+///         - EMSHAResult::OK is returned otherwise.
+EMSHAResult	DeltaSign(const std::uint8_t *base, std::uint64_t length,
+			  std::uint32_t blockSize, DeltaSignature& sig,
+			  std::uint32_t threads = 1);
+
+
+/// \brief Compute the delta that turns the signed base into target.
+///
+/// A weak checksum is rolled over the target a byte at a time, and
+/// looked up in a hash table of the signature's weak checksums.
+/// Positions whose weak checksum matches a block become candidates;
+/// as most of them are real matches, the scan carries on from the
+/// end of each candidate as if it had matched, and the candidates'
+/// SHA-256 digests are computed SHA256_LANES at a time through the
+/// multi-lane kernel. A candidate that turns out not to match sends
+/// the scan back to the byte after it, so the result is the same as
+/// checking each candidate as soon as it is found, as rsync does.
+///
+/// Consecutive matching blocks are merged into a single copy, and a
+/// block that follows the previous copy in the base is preferred
+/// over an identical block elsewhere.
+///
+/// \param sig The signature of the base.
+/// \param target The target data.
+/// \param length The length of the target.
+/// \param delta Receives the delta.
+/// \return EMSHAResult::NullPointer if target is a nullptr and
+///         length is nonzero, EMSHAResult::InvalidState if the
+///         signature's block size is zero, or EMSHAResult::OK.
+EMSHAResult	DeltaCompute(const DeltaSignature& sig, const std::uint8_t *target,
+			     std::uint64_t length, Delta& delta);
+
+
+/// \brief Rebuild a target from its base and a delta.
+///
+/// \param base The base data the delta was computed against.
+/// \param baseLength The length of the base.
+/// \param delta The delta.
+/// \param target Receives the target.
+/// \return An ::EMSHAResult describing the result of the operation.
+///
+///         - EMSHAResult::NullPointer is returned if base is a
+///           nullptr and baseLength is nonzero.
+///         - EMSHAResult::InvalidState is returned if an op refers
+///           to bytes outside the base or the literal data, or the
+///           ops don't add up to the target length.
+///         - EMSHAResult::VerifyFailed is returned if the rebuilt
+///           target doesn't match the delta's digest, as when the
+///           delta is applied to the wrong base. target is cleared.
+///         - EMSHAResult::OK is returned otherwise.
+EMSHAResult	DeltaApply(const std::uint8_t *base, std::uint64_t baseLength,
+			   const Delta& delta, std::vector<std::uint8_t>& target);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_DELTA_H
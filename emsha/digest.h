@@ -0,0 +1,221 @@
+///
+/// \file emsha/digest.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares Digest, a SHA-256 digest value type.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_DIGEST_H
+#define EMSHA_DIGEST_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#include <emsha/emsha.h>
+#include <emsha/compact.h>
+
+
+namespace emsha {
+
+
+/// DIGEST_HEX_SIZE is the size of the buffer Digest::Hex writes: two
+/// hex digits per byte and a terminating NUL.
+const std::size_t DIGEST_HEX_SIZE = (2 * SHA256_HASH_SIZE) + 1;
+
+
+/// \brief Digest is a SHA-256 digest held by value.
+///
+/// A Digest is a plain 32-byte array that can be copied, compared,
+/// ordered and used as a key in standard containers without going
+/// through raw pointers or hex strings. Comparisons work on 64-bit
+/// words rather than bytes; equality is branch-free, so it is safe
+/// for comparing secrets such as HMAC tags.
+struct Digest {
+	/// The digest bytes.
+	std::uint8_t	bytes[SHA256_HASH_SIZE];
+
+	/// A default-constructed digest is all zeroes.
+	constexpr Digest() : bytes{} {}
+
+	/// \brief Construct a digest from its 32 bytes, at compile
+	///        time if needed, for known-answer constants.
+	template <typename... Bytes>
+	constexpr explicit Digest(std::uint8_t b0, Bytes... rest)
+	    : bytes{b0, static_cast<std::uint8_t>(rest)...}
+	{
+		static_assert(sizeof...(rest) == (SHA256_HASH_SIZE - 1),
+			      "a Digest needs exactly 32 bytes");
+	}
+
+	/// \brief Construct a digest by copying SHA256_HASH_SIZE
+	///        bytes.
+	explicit Digest(const std::uint8_t *d)
+	{
+		std::memcpy(this->bytes, d, SHA256_HASH_SIZE);
+	}
+
+	std::uint8_t		*data() { return this->bytes; }
+	const std::uint8_t	*data() const { return this->bytes; }
+	static constexpr std::size_t size() { return SHA256_HASH_SIZE; }
+
+	/// \brief Return word i (0 to 3) of the digest, in big-endian
+	///        order, so that comparing words compares bytes
+	///        lexicographically.
+	std::uint64_t
+	Word(std::size_t i) const
+	{
+		const std::uint8_t	*p = this->bytes + (8 * i);
+		std::uint64_t		 w = 0;
+
+		for (std::size_t j = 0; j < 8; j++) {
+			w = (w << 8) | p[j];
+		}
+		return w;
+	}
+
+	/// \brief Write the digest as lowercase hex.
+	///
+	/// \param out Buffer of DIGEST_HEX_SIZE bytes, which receives
+	///        64 hex digits and a NUL.
+	void		Hex(char *out) const;
+
+	/// \brief Parse a digest from hex.
+	///
+	/// \param hex 64 hex digits, in either case.
+	/// \param length The length of hex, which must be 64.
+	/// \param d Receives the digest; unchanged on failure.
+	/// \return True if hex is a valid digest.
+	static bool	FromHex(const char *hex, std::size_t length, Digest& d);
+};
+
+
+/// Equality compares all four words, without a data-dependent branch.
+inline bool
+operator==(const Digest& a, const Digest& b)
+{
+	std::uint64_t	diff = 0;
+
+	for (std::size_t i = 0; i < 4; i++) {
+		std::uint64_t	x;
+		std::uint64_t	y;
+
+		std::memcpy(&x, a.bytes + (8 * i), sizeof(x));
+		std::memcpy(&y, b.bytes + (8 * i), sizeof(y));
+		diff |= x ^ y;
+	}
+	return diff == 0;
+}
+
+
+inline bool
+operator!=(const Digest& a, const Digest& b)
+{
+	return !(a == b);
+}
+
+
+/// Digests are ordered as byte strings.
+inline bool
+operator<(const Digest& a, const Digest& b)
+{
+	for (std::size_t i = 0; i < 4; i++) {
+		std::uint64_t const	x = a.Word(i);
+		std::uint64_t const	y = b.Word(i);
+
+		if (x != y) {
+			return x < y;
+		}
+	}
+	return false;
+}
+
+
+inline bool operator>(const Digest& a, const Digest& b) { return b < a; }
+inline bool operator<=(const Digest& a, const Digest& b) { return !(b < a); }
+inline bool operator>=(const Digest& a, const Digest& b) { return !(a < b); }
+
+
+/// \brief Hash a message, returning the digest by value.
+///
+/// There is no ::EMSHAResult to report a bad argument, so passing a
+/// nullptr for m with a nonzero ml is a precondition violation: it
+/// fails an assertion, or with NDEBUG defined returns an all-zero
+/// Digest.
+///
+/// \param m The message; it may only be a nullptr if ml is zero.
+/// \param ml The length of the message.
+/// \return The SHA-256 digest of m.
+Digest		SHA256Digest(const std::uint8_t *m, std::uint32_t ml);
+
+
+/// \brief Compute an HMAC, returning the tag by value.
+///
+/// As with SHA256Digest, m may only be a nullptr if ml is zero;
+/// otherwise the call fails an assertion, or with NDEBUG defined
+/// returns an all-zero Digest.
+///
+/// \return The HMAC-SHA-256 of m under k, as for the ComputeHMAC
+///         in emsha/hmac.h.
+Digest		ComputeHMAC(const std::uint8_t *k, std::uint32_t kl,
+			    const std::uint8_t *m, std::uint32_t ml);
+
+
+/// \brief Compute an HMAC with a precomputed key, returning the tag
+///        by value.
+///
+/// m may only be a nullptr if ml is zero, as for the other by-value
+/// ComputeHMAC.
+Digest		ComputeHMAC(const HMACMidstate& key, const std::uint8_t *m,
+			    std::uint32_t ml);
+
+
+} // end of namespace emsha
+
+
+namespace std {
+
+
+/// Digests are already uniformly distributed, so hashing one for an
+/// unordered container just takes its first word.
+template <>
+struct hash<emsha::Digest> {
+	std::size_t
+	operator()(const emsha::Digest& d) const
+	{
+		std::uint64_t	w;
+
+		std::memcpy(&w, d.bytes, sizeof(w));
+		return static_cast<std::size_t>(w);
+	}
+};
+
+
+} // end of namespace std
+
+
+#endif // EMSHA_DIGEST_H
@@ -0,0 +1,182 @@
+///
+/// \file emsha/digestindex.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares a memory-mapped on-disk index of SHA-256 digests
+///        for content-addressed storage.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_DIGESTINDEX_H
+#define EMSHA_DIGESTINDEX_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <emsha/emsha.h>
+
+
+namespace emsha {
+
+
+/// DIGEST_INDEX_PAGE_SIZE is the size of each bucket, and the unit
+/// the index file is laid out in.
+const std::uint32_t DIGEST_INDEX_PAGE_SIZE = 4096;
+
+/// DIGEST_INDEX_BUCKET_RECORDS is the number of records that fit in
+/// a bucket page after its 16-byte header.
+const std::uint32_t DIGEST_INDEX_BUCKET_RECORDS = 85;
+
+
+/// \brief DigestIndexRecord is one entry in a DigestIndex: where the
+///        content with a given digest is stored.
+struct DigestIndexRecord {
+	std::uint8_t	digest[SHA256_HASH_SIZE];
+	std::uint64_t	offset;
+	std::uint64_t	length;
+};
+
+
+/// \brief DigestIndex maps SHA-256 digests to (offset, length)
+///        records in a memory-mapped file.
+///
+/// Digests are uniform, so the index is bucketed directly on their
+/// leading bits: the file is a header page followed by one 4 KiB
+/// page per bucket, each holding up to 85 fixed-size records, and a
+/// lookup reads a single page. Buckets are sized for about 70% of
+/// their capacity when the index is built; a bucket that fills up
+/// chains to an overflow page from a reserve at the end of the file,
+/// which is left sparse until it is used.
+///
+/// An index is built in one pass from records sorted by digest,
+/// and can then be appended to by one writer while any number of
+/// readers, in the same or other processes, look digests up without
+/// locking: a record is written before the count that covers it is
+/// published, and an overflow page is filled before it is linked. The
+/// file is in the host's byte order, and opening it on a host with
+/// the other byte order fails.
+class DigestIndex {
+public:
+	DigestIndex();
+	~DigestIndex();
+
+	DigestIndex(const DigestIndex&) = delete;
+	DigestIndex& operator=(const DigestIndex&) = delete;
+
+	/// \brief Build an index file from sorted records.
+	///
+	/// \param path The index file to create; an existing file is
+	///        replaced.
+	/// \param records The records, in strictly increasing order of
+	///        digest.
+	/// \param count The number of records.
+	/// \param expected The number of records the index is expected
+	///        to hold once appends are included, which sets the
+	///        number of buckets; if it is less than count, count is
+	///        used.
+	/// \return An ::EMSHAResult describing the result of the
+	///         operation.
+	///
+	///         - EMSHAResult::NullPointer is returned if path is a
+	///           nullptr, or records is a nullptr and count is
+	///           nonzero.
+	///         - EMSHAResult::InvalidState is returned if the
+	///           records aren't sorted or contain duplicates.
+	///         - EMSHAResult::IOError is returned if the file can't
+	///           be written.
+	///         - EMSHAResult::OK is returned otherwise.
+	static EMSHAResult	Build(const char *path, const DigestIndexRecord *records,
+				      std::size_t count, std::size_t expected = 0);
+
+	/// \brief Map an index file.
+	///
+	/// \param path The index file.
+	/// \param writable Whether Append may be used.
+	/// \return EMSHAResult::NullPointer, EMSHAResult::IOError if the
+	///         file can't be opened and mapped or isn't a valid
+	///         index, or EMSHAResult::OK.
+	EMSHAResult	Open(const char *path, bool writable = false);
+
+	/// \brief Unmap the index.
+	void		Close();
+
+	/// \brief Look up a digest.
+	///
+	/// \param digest SHA256_HASH_SIZE bytes.
+	/// \param offset Receives the record's offset.
+	/// \param length Receives the record's length.
+	/// \return True if the digest is in the index. A damaged
+	///         bucket chain ends the lookup, rather than leading
+	///         it outside the file.
+	bool		Lookup(const std::uint8_t *digest, std::uint64_t& offset,
+			       std::uint64_t& length) const;
+
+	/// \brief Add a record to the index.
+	///
+	/// Appends are serialised within a process; only one process
+	/// should have the index open for writing. Adding a digest
+	/// that is already present leaves the existing record in
+	/// place.
+	///
+	/// \return An ::EMSHAResult describing the result of the
+	///         operation.
+	///
+	///         - EMSHAResult::InvalidState is returned if the index
+	///           isn't open for writing.
+	///         - EMSHAResult::IOError is returned if the record's
+	///           bucket chain is damaged.
+	///         - EMSHAResult::NoSpace is returned if the record's
+	///           bucket is full and the overflow reserve is used
+	///           up; the index should be rebuilt larger.
+	///         - EMSHAResult::OK is returned otherwise.
+	EMSHAResult	Append(const DigestIndexRecord& record);
+
+	/// \brief Flush appended records to the file.
+	///
+	/// \return EMSHAResult::IOError if the flush fails, or
+	///         EMSHAResult::OK.
+	EMSHAResult	Sync();
+
+	/// \brief The number of records in the index.
+	std::uint64_t	Size() const;
+
+	/// \brief The number of buckets, excluding overflow pages.
+	std::uint64_t	Buckets() const;
+
+private:
+	std::uint8_t	*page(std::uint64_t n) const;
+
+	std::uint8_t	*map;
+	std::size_t	 mapLength;
+	bool		 writable;
+	std::mutex	 writer;
+};
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_DIGESTINDEX_H
@@ -0,0 +1,124 @@
+///
+/// \file emsha/digestset.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares a concurrent set of SHA-256 digests for
+///        deduplication.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_DIGESTSET_H
+#define EMSHA_DIGESTSET_H
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/digest.h>
+
+
+namespace emsha {
+
+
+/// \brief DigestSet is a set of SHA-256 digests that many threads
+///        can insert into and query at once.
+///
+/// Digests are uniformly distributed, so the table is indexed
+/// directly by a digest's leading bits, with no further hashing.
+/// Doubling the table splits each bucket into two neighbours, which
+/// keeps resizing a straight copy.
+///
+/// A bucket is four cache lines: a control line, holding a claim
+/// count, a ready mask and a one-byte tag for each slot, and seven
+/// 32-byte digest slots stored flat. A lookup reads the control line
+/// and only touches the slots whose tags match. An insert claims a
+/// slot by compare-and-swap on the control word, writes the digest
+/// and then marks it ready; a thread inserting the same digest at
+/// the same time waits for the slot to become ready and finds it
+/// there, so every digest is reported as new exactly once.
+///
+/// When the table is three-quarters full, the inserting thread that
+/// notices doubles it. Inserts and lookups announce themselves on a
+/// shared counter so that the resize can wait for them to drain;
+/// they wait out the resize, and otherwise never block each other.
+///
+/// Digests can't be removed.
+class DigestSet {
+public:
+	/// \brief Create a set sized for capacity digests before its
+	///        first resize.
+	explicit DigestSet(std::size_t capacity = 1024);
+	~DigestSet();
+
+	DigestSet(const DigestSet&) = delete;
+	DigestSet& operator=(const DigestSet&) = delete;
+
+	/// \brief Add a digest to the set.
+	///
+	/// \param digest SHA256_HASH_SIZE bytes.
+	/// \return True if the digest was added, false if it was
+	///         already present.
+	bool		Insert(const std::uint8_t *digest);
+	bool		Insert(const Digest& digest) { return this->Insert(digest.bytes); }
+
+	/// \brief Report whether a digest is in the set.
+	///
+	/// A digest whose insert is still in progress may not be
+	/// found yet.
+	bool		Contains(const std::uint8_t *digest) const;
+	bool		Contains(const Digest& digest) const { return this->Contains(digest.bytes); }
+
+	/// \brief The number of digests in the set.
+	std::size_t	Size() const { return this->size.load(); }
+
+	/// \brief The number of digests the set holds before it next
+	///        resizes.
+	std::size_t	Capacity() const;
+private:
+	struct bucket;
+
+	static int	place(bucket *table, std::uint32_t bits,
+			      const std::uint8_t *digest);
+	static bucket	*allocate(std::uint32_t bits, std::uint8_t *&storage);
+
+	void		enter() const;
+	void		leave() const;
+	void		grow(std::uint32_t fromBits);
+	std::size_t	limit() const;
+
+	std::uint8_t			*storage;
+	bucket				*table;
+	std::uint32_t			 bits;
+	std::atomic<std::size_t>	 size;
+	mutable std::atomic<std::size_t> active;
+	mutable std::atomic<bool>	 resizing;
+};
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_DIGESTSET_H
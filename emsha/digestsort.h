@@ -0,0 +1,136 @@
+///
+/// \file emsha/digestsort.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares bulk operations on arrays and files of digests:
+///        sorting, deduplication, intersection and difference.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_DIGESTSORT_H
+#define EMSHA_DIGESTSORT_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/digest.h>
+
+
+namespace emsha {
+
+
+/// \brief Sort an array of digests into ascending order.
+///
+/// This is an MSD radix sort on the digests' leading bytes. Digests
+/// are uniform, so two byte-wide passes leave buckets small enough to
+/// finish with a comparison sort that compares eight bytes at a time.
+/// With more than one thread, the first pass is split across the
+/// threads, which then take the 256 top-level buckets from a shared
+/// counter.
+///
+/// The sort needs scratch space for another count digests.
+///
+/// \param digests The digests to sort.
+/// \param count The number of digests.
+/// \param threads The number of threads to use.
+void		SortDigests(Digest *digests, std::size_t count, std::uint32_t threads = 1);
+
+/// \brief Remove adjacent duplicates from a sorted array of
+///        digests, in place.
+///
+/// \return The number of distinct digests, which are moved to the
+///         front of the array.
+std::size_t	UniqueDigests(Digest *digests, std::size_t count);
+
+/// \brief Write the digests in both of two sorted arrays to out.
+///
+/// As with std::set_intersection, a digest that appears m times in
+/// a and n times in b appears min(m, n) times in the output.
+///
+/// \param out Receives up to min(na, nb) digests; it may be a, as
+///        the output never overtakes the input.
+/// \return The number of digests written.
+std::size_t	IntersectDigests(const Digest *a, std::size_t na,
+				 const Digest *b, std::size_t nb, Digest *out);
+
+/// \brief Write the digests in sorted array a but not in sorted
+///        array b to out.
+///
+/// \param out Receives up to na digests; it may be a.
+/// \return The number of digests written.
+std::size_t	DifferenceDigests(const Digest *a, std::size_t na,
+				  const Digest *b, std::size_t nb, Digest *out);
+
+
+/// \brief Sort a file of digests that may be larger than memory.
+///
+/// The file is a flat array of SHA256_HASH_SIZE-byte digests. It is
+/// read in runs that fit in memoryLimit, each of which is sorted with
+/// SortDigests and written to a temporary file beside output; the runs
+/// are then merged, up to 64 at a time, with independent merges of
+/// the same pass running on separate threads.
+///
+/// \param input The file to sort.
+/// \param output The sorted file, which is replaced; it may be the
+///        same as input.
+/// \param memoryLimit The memory to use for each run, including
+///        the sort's scratch space.
+/// \param unique Whether to drop duplicate digests.
+/// \param threads The number of threads to use.
+/// \return An ::EMSHAResult describing the result of the operation.
+///
+///         - EMSHAResult::NullPointer is returned if input or
+///           output is a nullptr.
+///         - EMSHAResult::InvalidState is returned if the input
+///           isn't a whole number of digests.
+///         - EMSHAResult::IOError is returned if a file can't be
+///           read or written.
+///         - EMSHAResult::OK is returned otherwise.
+EMSHAResult	SortDigestFile(const char *input, const char *output,
+			       std::size_t memoryLimit, bool unique = true,
+			       std::uint32_t threads = 1);
+
+/// \brief Write the digests in both of two sorted digest files to
+///        output, streaming both inputs.
+///
+/// \param count If not a nullptr, receives the number of digests
+///        written.
+/// \return EMSHAResult::NullPointer, EMSHAResult::IOError,
+///         EMSHAResult::InvalidState if an input isn't a sorted
+///         array of digests, or EMSHAResult::OK.
+EMSHAResult	IntersectDigestFiles(const char *a, const char *b, const char *output,
+				     std::uint64_t *count = nullptr);
+
+/// \brief Write the digests in sorted digest file a but not in b
+///        to output; see IntersectDigestFiles.
+EMSHAResult	DifferenceDigestFiles(const char *a, const char *b, const char *output,
+				      std::uint64_t *count = nullptr);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_DIGESTSORT_H
@@ -32,6 +32,7 @@
 #define EMSHA_EMSHA_H
 
 
+#include <cstddef>
 #include <cstdint>
 
 
@@ -84,7 +85,18 @@ typedef enum class EMSHAResult : std::uint8_t {
 
 	/// The self tests have been disabled, but a self-test function
 	/// was called.
-	SelfTestDisabled = 6
+	SelfTestDisabled = 6,
+
+	/// An I/O operation, such as reading a file, failed.
+	IOError = 7,
+
+	/// A fixed-size pool or table the operation needed to
+	/// allocate from is full.
+	NoSpace = 8,
+
+	/// A MAC, digest or proof did not match the data it was
+	/// checked against.
+	VerifyFailed = 9
 } ;
 
 
@@ -176,6 +188,43 @@ public:
 /// \return True if both byte arrays match.
 bool		HashEqual(const std::uint8_t *a, const std::uint8_t *b);
 
+/// \brief Constant-time comparison of two byte strings of any
+///        length.
+///
+/// This generalises HashEqual to truncated tags and concatenated
+/// digests. The time taken depends only on the length, never on the
+/// contents. The bytes are compared eight at a time, four words to a
+/// step, in a loop that compilers turn into vector instructions.
+///
+/// \param a A byte buffer of length bytes.
+/// \param b A byte buffer of length bytes.
+/// \param length The number of bytes to compare.
+/// \return True if both byte arrays match.
+bool		ConstantTimeEqual(const std::uint8_t *a, const std::uint8_t *b,
+				  std::size_t length);
+
+/// \brief Constant-time comparison of one value against many
+///        candidates.
+///
+/// Every candidate is compared in full, whether or not an earlier
+/// one matched. The value is loaded once, and for digest-sized
+/// values the comparison of each candidate is a fixed four-word
+/// step.
+///
+/// \param value A byte buffer of length bytes.
+/// \param candidates count candidates of length bytes each, stored
+///        contiguously.
+/// \param length The length of the value and of each candidate.
+/// \param count The number of candidates.
+/// \param results If not a nullptr, receives a bitmap of
+///        (count + 63) / 64 words, with bit (i % 64) of word (i / 64)
+///        set if candidate i matches.
+/// \return The number of candidates that match.
+std::size_t	ConstantTimeEqualMany(const std::uint8_t *value,
+				      const std::uint8_t *candidates,
+				      std::size_t length, std::size_t count,
+				      std::uint64_t *results);
+
 
 #ifndef EMSHA_NO_HEXSTRING
 /// \brief Write a hex-encoded version of a byte string.
@@ -0,0 +1,152 @@
+///
+/// \file emsha/file.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares an interface for hashing files.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_FILE_H
+#define EMSHA_FILE_H
+
+
+#include <cstdint>
+
+#include <emsha/emsha.h>
+
+
+namespace emsha {
+
+
+/// FILE_ALIGNMENT is the buffer and offset alignment used for
+/// cache-bypassing reads. It covers both 512-byte and 4K logical
+/// block devices.
+const std::uint32_t FILE_ALIGNMENT = 4096;
+
+/// FILE_BUFFER_SIZE is the size of the read buffer used when hashing
+/// files; it is a multiple of both FILE_ALIGNMENT and the SHA-256
+/// message block size.
+const std::uint32_t FILE_BUFFER_SIZE = 1024 * 1024;
+
+/// SIDECAR_SIZE is the size of the record written by
+/// SHA256FileIncremental.
+const std::uint32_t SIDECAR_SIZE = 152;
+
+
+/// \brief FileMode selects how file data is read.
+enum class FileMode : std::uint8_t {
+	/// Read through the page cache.
+	Buffered = 0,
+
+	/// Bypass the page cache (O_DIRECT on Linux, F_NOCACHE on
+	/// macOS). This is intended for one-pass scans of very large
+	/// files, such as nightly scrubs, where pulling the file
+	/// through the page cache would evict everybody else's
+	/// working set.
+	///
+	/// If the filesystem refuses direct I/O, the data is read
+	/// through the page cache instead and the pages are dropped
+	/// again afterwards with posix_fadvise(2).
+	Direct = 1
+};
+
+
+/// \brief Compute the SHA-256 digest of everything readable from a
+///        file descriptor.
+///
+/// Reading starts at the descriptor's current offset; in
+/// FileMode::Direct mode, that offset should be FILE_ALIGNMENT
+/// aligned (a freshly opened file always is), otherwise the
+/// read falls back to buffered I/O. Any file status flags changed
+/// to bypass the cache are restored before returning.
+///
+/// \param fd An open, readable file descriptor. It is not closed.
+/// \param digest Byte buffer of at least emsha::SHA256_HASH_SIZE
+///        bytes that receives the digest.
+/// \param mode How the file should be read.
+/// \return An ::EMSHAResult describing the result of the operation.
+///
+///         - EMSHAResult::NullPointer is returned if digest is a
+///           nullptr.
+///         - EMSHAResult::IOError is returned if the descriptor is
+///           invalid, its offset can't be read, or a read fails.
+///         - EMSHAResult::OK is returned if the digest was written
+///           to digest.
+EMSHAResult	SHA256FileDescriptor(int fd, std::uint8_t *digest,
+				     FileMode mode = FileMode::Buffered);
+
+/// \brief Compute the SHA-256 digest of the file at path.
+///
+/// \param path The path to the file to hash.
+/// \param digest Byte buffer of at least emsha::SHA256_HASH_SIZE
+///        bytes that receives the digest.
+/// \param mode How the file should be read.
+/// \return An ::EMSHAResult describing the result of the operation;
+///         see SHA256FileDescriptor. EMSHAResult::IOError is also
+///         returned if the file can't be opened.
+EMSHAResult	SHA256File(const char *path, std::uint8_t *digest,
+			   FileMode mode = FileMode::Buffered);
+
+/// \brief Compute the SHA-256 digest of an append-only file, only
+///        hashing what was appended since the last call.
+///
+/// The sidecar file records the SHA-256 intermediate hash at the
+/// last message block boundary reached, along with the file's size,
+/// device, inode and modification time. If the sidecar still matches
+/// the file, hashing picks up from that boundary, so a log or WAL
+/// segment that has grown by a few kilobytes costs a few kilobytes
+/// of reading rather than the whole file.
+///
+/// The file is hashed from the start instead if the sidecar is
+/// missing or damaged, if the file is a different file, has shrunk,
+/// or was modified without growing, or if the last block covered by
+/// the sidecar has changed. These checks catch truncation and
+/// replacement, but not an in-place rewrite of earlier data that
+/// also appends; files that may be rewritten need SHA256File.
+///
+/// The sidecar is rewritten (atomically, by renaming a temporary
+/// file into place) after every successful hash.
+///
+/// \param path The path to the file to hash.
+/// \param sidecarPath The path to the sidecar; it will be created if
+///        it doesn't exist.
+/// \param digest Byte buffer of at least emsha::SHA256_HASH_SIZE
+///        bytes that receives the digest.
+/// \param mode How the file should be read.
+/// \param bytesRead If not a nullptr, receives the number of bytes
+///        of the file that were hashed by this call.
+/// \return An ::EMSHAResult describing the result of the operation;
+///         see SHA256File. EMSHAResult::IOError is also returned if
+///         the sidecar can't be written, in which case the digest
+///         is still valid.
+EMSHAResult	SHA256FileIncremental(const char *path, const char *sidecarPath,
+				      std::uint8_t *digest,
+				      FileMode mode = FileMode::Buffered,
+				      std::uint64_t *bytesRead = nullptr);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_FILE_H
@@ -135,6 +135,24 @@ public:
 	EMSHAResult Result(std::uint8_t *digest) override;
 
 
+	/// \brief Copy this HMAC's state, including its key, into
+	///        another HMAC.
+	///
+	/// As with SHA256::Fork, this is used to authenticate many
+	/// messages with a common prefix without rewriting the prefix
+	/// for each one. The child takes the parent's key along with
+	/// the inner hash state, so it can be any HMAC context,
+	/// regardless of the key it was constructed with.
+	///
+	/// \param child The HMAC to overwrite.
+	/// \return This should always return EMSHAResult::OK.
+	EMSHAResult Fork(HMAC& child) const;
+
+	/// \brief Copy data to another buffer and write it into the
+	///        HMAC in the same pass; see SHA256::CopyAndUpdate.
+	EMSHAResult CopyAndUpdate(std::uint8_t *dst, const std::uint8_t *src,
+				  std::uint32_t length, bool streaming = false);
+
 	/// \brief Returns the output size of HMAC-SHA-256.
 	///
 	/// The buffers passed to #Update and #Finalise should be at
@@ -155,7 +173,10 @@ private:
 	uint8_t	buf[SHA256_HASH_SIZE];
 
 	EMSHAResult reset();
+	EMSHAResult update(const std::uint8_t *message,
+			   std::uint32_t messageLength);
 	inline EMSHAResult	finalResult(uint8_t *d);
+	EMSHAResult		finish(uint8_t *d);
 };
 
 
@@ -31,7 +31,22 @@
 #define EMSHA_INTERNAL_H
 
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <utility>
+
+#ifdef EMSHA_STATS
+#include <atomic>
+#endif
+
+#ifdef EMSHA_USDT
+#include <sys/sdt.h>
+#endif
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/stats.h>
 
 using std::uint8_t;
 using std::uint32_t;
@@ -89,6 +104,305 @@ sha_sigma1(uint32_t x)
 }
 
 
+/// sha256_compress runs the SHA-256 compression function over count
+/// consecutive 64-byte message blocks, updating the intermediate hash
+/// ih in place. The blocks do not need any particular alignment.
+void	sha256_compress(uint32_t *ih, const uint8_t *blocks, std::size_t count);
+
+/// sha256_init loads the SHA-256 initial hash value into ih.
+void	sha256_init(uint32_t *ih);
+
+/// sha256_pad completes a hash: it appends the padding and message
+/// length to the plen (< 64) bytes of the trailing partial block and
+/// compresses the result into ih. bitLength is the length of the
+/// whole message in bits.
+void	sha256_pad(uint32_t *ih, const uint8_t *partial, uint32_t plen,
+		   uint64_t bitLength);
+
+/// sha256_store writes the intermediate hash out as a big-endian
+/// digest.
+void	sha256_store(const uint32_t *ih, uint8_t *digest);
+
+/// sha256_oneshot hashes a complete message starting from the
+/// intermediate hash start, which must be the state after prefix
+/// bytes (a multiple of the block size) of the message; start itself
+/// isn't modified. With the initial hash value and a zero prefix,
+/// this is plain SHA-256.
+void	sha256_oneshot(const uint32_t *start, uint64_t prefix,
+		       const uint8_t *m, uint64_t ml, uint8_t *digest);
+
+/// sha256_digest is plain SHA-256 of a complete message: sha256_oneshot
+/// from the initial hash value.
+void	sha256_digest(const uint8_t *m, uint64_t ml, uint8_t *digest);
+
+/// sha256_write_length stores the big-endian bit length of a message
+/// of bytes bytes in the eight bytes before blockEnd, the end of its
+/// last padded block.
+void	sha256_write_length(uint8_t *blockEnd, uint64_t bytes);
+
+/// sha256_checkpoint copies out a SHA256 context's state: the
+/// intermediate hash after its last whole block, the number of bytes
+/// written, and the partial block pending after them (length modulo
+/// SHA256_MB_SIZE bytes, written to partial).
+void	sha256_checkpoint(const SHA256& ctx, uint32_t *ih, uint64_t& length,
+			  uint8_t *partial);
+
+/// sha256_resume resets ctx to carry on from an intermediate hash
+/// taken after length bytes, a multiple of the block size.
+void	sha256_resume(SHA256& ctx, const uint32_t *ih, uint64_t length);
+
+/// SHA256_LANES is the number of independent blocks the multi-lane
+/// kernel compresses side by side.
+const uint32_t SHA256_LANES = 8;
+
+/// sha256_compress_lanes compresses one block into each of up to
+/// SHA256_LANES independent intermediate hashes. The lanes are laid
+/// out side by side (one array element per lane for each working
+/// variable), so that every step of a round is the same operation
+/// across all of the lanes, which compilers can turn into SIMD
+/// instructions without any target-specific code.
+void	sha256_compress_lanes(uint32_t (*ih)[8], const uint8_t *const *blocks,
+			      std::size_t lanes);
+
+/// sha256_schedule expands a message block into its 64-word message
+/// schedule, which depends only on the block.
+void	sha256_schedule(const uint8_t *block, uint32_t *w);
+
+/// sha256_rounds_lanes compresses the same block, given as its
+/// schedule w, into each of up to SHA256_LANES intermediate hashes,
+/// so that a block shared by many hashes is only expanded once.
+void	sha256_rounds_lanes(uint32_t (*ih)[8], const uint32_t *w,
+			    std::size_t lanes);
+
+/// sha256_node hashes the 65-byte message prefix || left || right,
+/// where left and right are digests, as used for Merkle tree nodes.
+/// The two padded blocks are laid out directly, rather than going
+/// through a context.
+void	sha256_node(uint8_t prefix, const uint8_t *left, const uint8_t *right,
+		    uint8_t *digest);
+
+/// sha256_node_lanes computes count node hashes as sha256_node does,
+/// SHA256_LANES at a time through sha256_compress_lanes.
+void	sha256_node_lanes(std::size_t count, uint8_t prefix,
+			  const uint8_t *const *lefts, const uint8_t *const *rights,
+			  uint8_t *const *digests);
+
+
+/// crc32c_force_software makes CRC32C, and so SHA256CRC32C, use the
+/// table-driven CRC even where the CPU has a CRC32C instruction, so
+/// that the tests can check it on any host. It returns the previous
+/// setting.
+bool	crc32c_force_software(bool force);
+
+/// bloom_force_scalar makes BloomFilter queries use the portable
+/// probe even where the CPU has AVX2, so that the tests can check
+/// both on the same host. It returns the previous setting.
+bool	bloom_force_scalar(bool force);
+
+/// sha256_lane is one message's progress through sha256_lanes: its
+/// full blocks are read in place, and its padded tail is built in
+/// the lane.
+struct sha256_lane {
+	std::size_t	 item;
+	const uint8_t	*next;		// Next full block.
+	uint64_t	 full;		// Full blocks left.
+	uint32_t	 tail;		// Tail blocks in use (1 or 2).
+	uint32_t	 tailNext;	// Next tail block.
+	uint8_t		 tailBlocks[2 * SHA256_MB_SIZE];
+};
+
+
+/// sha256_lanes hashes count messages, each read in place, through
+/// sha256_compress_lanes, starting a new message in a lane as soon as
+/// the one before it completes. For message i, source supplies
+/// Message(i) and MessageLength(i), and Start(i, ih), which loads
+/// the intermediate hash to start from into ih and returns the number
+/// of bytes, a multiple of the block size, that it already covers;
+/// for plain SHA-256 that's sha256_init and zero. done(i, ih) is
+/// called with each message's final intermediate hash, in the order
+/// they complete.
+template <typename Source, typename Done>
+void
+sha256_lanes(const Source& source, std::size_t count, Done& done)
+{
+	sha256_lane	 lanes[SHA256_LANES];
+	uint32_t	 slot[SHA256_LANES];	// Lane storage for each position.
+	const uint8_t	*ptrs[SHA256_LANES];
+	uint32_t	 ih[SHA256_LANES][8];
+	std::size_t	 next = 0;
+	uint32_t	 active = 0;
+
+	for (uint32_t l = 0; l < SHA256_LANES; l++) {
+		slot[l] = l;
+	}
+
+	auto nextBlock = [&](uint32_t pos) -> const uint8_t * {
+		sha256_lane&	lane = lanes[slot[pos]];
+
+		if (lane.full > 0) {
+			const uint8_t	*p = lane.next;
+
+			lane.next += SHA256_MB_SIZE;
+			lane.full--;
+			return p;
+		}
+		if (lane.tailNext < lane.tail) {
+			return lane.tailBlocks + (SHA256_MB_SIZE * lane.tailNext++);
+		}
+		return nullptr;
+	};
+
+	auto load = [&](uint32_t pos) {
+		if (next == count) {
+			return false;
+		}
+
+		sha256_lane&		lane = lanes[slot[pos]];
+		std::size_t const	item = next++;
+		const uint8_t		*m = source.Message(item);
+		uint64_t const		ml = source.MessageLength(item);
+		uint32_t const		rest = static_cast<uint32_t>(ml % SHA256_MB_SIZE);
+		uint64_t const		prefix = source.Start(item, ih[pos]);
+
+		lane.item     = item;
+		lane.next     = m;
+		lane.full     = ml / SHA256_MB_SIZE;
+		lane.tail     = ((rest + 9) > SHA256_MB_SIZE) ? 2 : 1;
+		lane.tailNext = 0;
+
+		uint8_t *const	tail = lane.tailBlocks;
+		uint8_t *const	tailEnd = tail + (SHA256_MB_SIZE * lane.tail);
+
+		std::fill(tail, tailEnd, 0);
+		if (rest != 0) {
+			std::copy(m + (ml - rest), m + ml, tail);
+		}
+		tail[rest] = 0x80;
+		sha256_write_length(tailEnd, prefix + ml);
+
+		ptrs[pos] = nextBlock(pos);
+		return true;
+	};
+
+	while ((active < SHA256_LANES) && load(active)) {
+		active++;
+	}
+
+	while (active > 0) {
+		sha256_compress_lanes(ih, ptrs, active);
+
+		uint32_t	pos = 0;
+		while (pos < active) {
+			ptrs[pos] = nextBlock(pos);
+			if (ptrs[pos] != nullptr) {
+				pos++;
+				continue;
+			}
+
+			done(lanes[slot[pos]].item, ih[pos]);
+			if (load(pos)) {
+				pos++;
+				continue;
+			}
+
+			// Nothing left to start: move the last active lane
+			// down into this position. It hasn't been advanced
+			// yet, so it's handled on this pass too.
+			active--;
+			if (pos != active) {
+				std::swap(slot[pos], slot[active]);
+				std::copy(ih[active], ih[active] + 8, ih[pos]);
+				ptrs[pos] = ptrs[active];
+			}
+		}
+	}
+
+	for (auto& lane : lanes) {
+		std::fill(lane.tailBlocks, lane.tailBlocks + sizeof(lane.tailBlocks), 0);
+	}
+}
+
+
+// Usage counters; see emsha/stats.h. Each thread has its own set,
+// which only that thread writes, so the counters are bumped with
+// plain relaxed loads and stores rather than locked read-modify-write
+// instructions.
+enum StatsCounter : uint32_t {
+	StatBytesHashed = 0,
+	StatBlocksCompressed,
+	StatUpdateCalls,
+	StatFinaliseCalls,
+	StatHMACKeySetups,
+	StatLaneBlocks,
+	StatResults,
+};
+
+
+#ifdef EMSHA_STATS
+const uint32_t STATS_COUNTERS = StatResults + STATS_RESULT_CODES;
+
+
+// statsCounters is padded out to whole cache lines on both sides so
+// that no two threads' counters ever share a line.
+struct statsCounters {
+	uint8_t				pad0[64];
+	std::atomic<std::uint64_t>	c[STATS_COUNTERS];
+	uint8_t				pad1[64];
+};
+
+
+extern thread_local statsCounters	*statsLocal;
+statsCounters				*statsRegister();
+
+
+static inline void
+stats_add(uint32_t counter, std::uint64_t n)
+{
+	statsCounters	*sc = statsLocal;
+
+	if (sc == nullptr) {
+		sc = statsRegister();
+	}
+
+	std::atomic<std::uint64_t>& c = sc->c[counter];
+	c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+
+static inline EMSHAResult
+stats_result(EMSHAResult res)
+{
+	uint32_t code = static_cast<uint32_t>(res);
+
+	if (code >= (STATS_COUNTERS - StatResults)) {
+		code = static_cast<uint32_t>(EMSHAResult::Unknown);
+	}
+
+	stats_add(StatResults + code, 1);
+	return res;
+}
+
+
+#define EMSHA_STAT_ADD(counter, n)	emsha::stats_add((counter), (n))
+#define EMSHA_STAT_RESULT(res)		emsha::stats_result((res))
+#else
+#define EMSHA_STAT_ADD(counter, n)	do {} while (0)
+#define EMSHA_STAT_RESULT(res)		(res)
+#endif // EMSHA_STATS
+
+
+// USDT (SystemTap/DTrace-style) static probes, for bpftrace, perf and
+// friends. An unattached probe is a single nop; the probe names use
+// the usual double underscore, which tools show as a dash, e.g.
+// usdt:libemsha:emsha:sha256-update-start.
+#ifdef EMSHA_USDT
+#define EMSHA_PROBE1(name, a)		DTRACE_PROBE1(emsha, name, a)
+#define EMSHA_PROBE2(name, a, b)	DTRACE_PROBE2(emsha, name, a, b)
+#else
+#define EMSHA_PROBE1(name, a)		do {} while (0)
+#define EMSHA_PROBE2(name, a, b)	do {} while (0)
+#endif // EMSHA_USDT
+
 
 } // end of namespace emsha
 
@@ -0,0 +1,206 @@
+///
+/// \file emsha/keystore.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares a store of precomputed HMAC keys looked up by key
+///        ID.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_KEYSTORE_H
+#define EMSHA_KEYSTORE_H
+
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <emsha/emsha.h>
+#include <emsha/compact.h>
+
+
+namespace emsha {
+
+
+/// \brief KeyStore maps key IDs to precomputed HMAC keys.
+///
+/// Keys are held as HMACMidstate pairs, so a lookup costs a probe
+/// and a 64-byte copy, however long the original key was. The table
+/// is open-addressed with linear probing: the IDs are kept in their
+/// own array, eight to a cache line, and only the matching entry's
+/// midstates are touched.
+///
+/// Lookups don't take a lock. Each entry is guarded by a sequence
+/// counter that writers bump around every change, and a reader that
+/// sees it change retries, so lookups never see a half-written key.
+/// Writers (Add, Rotate, Retire and Remove) are serialised by a
+/// mutex. The table doesn't grow; its capacity is fixed when it is
+/// constructed.
+///
+/// Remove leaves no tombstone: the entries after the removed one
+/// in its cluster are shifted back to close the gap, so probe
+/// lengths depend only on the IDs present, however many have come
+/// and gone. A table-wide counter is bumped around each shift, and
+/// a lookup that overlaps one retries, as an entry it was looking
+/// for may have moved behind it.
+///
+/// Each ID can hold a current key and, during a rotation, the key it
+/// replaced. Tags are signed with the current key and verified
+/// against either until the previous key is retired. Keys are wiped
+/// from the table as they are retired, removed or replaced, and when
+/// the store is destroyed.
+class KeyStore {
+public:
+	/// NO_KEY_ID is reserved to mark unused slots, and can't be
+	/// used as a key ID.
+	static const std::uint64_t NO_KEY_ID = UINT64_MAX;
+
+	/// MAX_CAPACITY is the largest capacity a store can have.
+	static const std::uint32_t MAX_CAPACITY = 1U << 30;
+
+	/// \brief Create a store that holds up to capacity key IDs.
+	///
+	/// A capacity over MAX_CAPACITY is rejected: the store is
+	/// created with a capacity of zero, so every Add returns
+	/// EMSHAResult::NoSpace.
+	explicit KeyStore(std::uint32_t capacity);
+
+	/// All keys are wiped when the store is destroyed.
+	~KeyStore();
+
+	KeyStore(const KeyStore&) = delete;
+	KeyStore& operator=(const KeyStore&) = delete;
+
+	/// \brief Set the key for an ID, replacing any keys it had.
+	///
+	/// \return An ::EMSHAResult describing the result of the
+	///         operation.
+	///
+	///         - EMSHAResult::NullPointer is returned if k is a
+	///           nullptr and kl is nonzero.
+	///         - EMSHAResult::InvalidState is returned if id is
+	///           NO_KEY_ID.
+	///         - EMSHAResult::NoSpace is returned if the store is
+	///           full.
+	///         - EMSHAResult::OK is returned otherwise.
+	EMSHAResult	Add(std::uint64_t id, const std::uint8_t *k, std::uint32_t kl);
+
+	/// \brief Start a rotation: make k the current key for an ID
+	///        and keep its current key as the previous key.
+	///
+	/// Any previous key is wiped. Rotating an ID that isn't in the
+	/// store adds it.
+	///
+	/// \return As for #Add.
+	EMSHAResult	Rotate(std::uint64_t id, const std::uint8_t *k, std::uint32_t kl);
+
+	/// \brief Finish a rotation, wiping an ID's previous key.
+	///
+	/// \return True if the ID had a previous key.
+	bool		Retire(std::uint64_t id);
+
+	/// \brief Remove an ID, wiping its keys.
+	///
+	/// \return True if the ID was in the store.
+	bool		Remove(std::uint64_t id);
+
+	/// \brief Look up the current key for an ID.
+	///
+	/// \param id The key ID.
+	/// \param key Receives the key. It is key material, and should
+	///        be wiped with HMACMidstateWipe after use.
+	/// \return True if the ID is in the store.
+	bool		Lookup(std::uint64_t id, HMACMidstate& key) const;
+
+	/// \brief Look up both keys for an ID.
+	///
+	/// \param id The key ID.
+	/// \param current Receives the current key.
+	/// \param previous Receives the previous key, if there is one.
+	/// \param hasPrevious Set to whether there is a previous key.
+	/// \return True if the ID is in the store.
+	bool		Lookup(std::uint64_t id, HMACMidstate& current,
+			       HMACMidstate& previous, bool& hasPrevious) const;
+
+	/// \brief Verify a tag against an ID's keys.
+	///
+	/// The tag is checked against both the current and the
+	/// previous key, if there is one, in constant time.
+	///
+	/// \param id The key ID.
+	/// \param m The message.
+	/// \param ml The length of the message.
+	/// \param tag The tag: the first tl bytes of the HMAC.
+	/// \param tl The length of the tag, from HMAC_MIN_TAG_LENGTH
+	///        (see emsha/batch.h) to SHA256_HASH_SIZE.
+	/// \return An ::EMSHAResult describing the result of the
+	///         operation.
+	///
+	///         - EMSHAResult::NullPointer is returned if m is a
+	///           nullptr and ml is nonzero, or tag is a nullptr.
+	///         - EMSHAResult::VerifyFailed is returned if the ID
+	///           isn't in the store, the tag length is out of
+	///           range, or the tag doesn't match.
+	///         - EMSHAResult::OK is returned otherwise.
+	EMSHAResult	Verify(std::uint64_t id, const std::uint8_t *m, std::uint32_t ml,
+			       const std::uint8_t *tag, std::uint32_t tl) const;
+
+	/// \brief The number of IDs in the store.
+	std::uint32_t	Size() const { return this->size.load(); }
+
+	/// \brief The number of IDs the store can hold.
+	std::uint32_t	Capacity() const { return this->capacity; }
+
+	/// \brief The number of slots a lookup for id examines,
+	///        including the one that ends it.
+	///
+	/// This is for checking the health of the table, as with
+	/// linear probing a lookup for an absent ID runs to the end of
+	/// its cluster.
+	std::uint32_t	Probes(std::uint64_t id) const;
+
+private:
+	struct entry;
+
+	std::uint32_t	find(std::uint64_t id) const;
+	std::uint32_t	home(std::uint64_t id) const;
+	void		copyEntry(std::uint32_t from, std::uint32_t to);
+	EMSHAResult	set(std::uint64_t id, const std::uint8_t *k,
+			    std::uint32_t kl, bool rotate);
+
+	std::atomic<std::uint64_t>	*ids;
+	entry				*entries;
+	std::uint32_t			 mask;
+	std::uint32_t			 capacity;
+	std::atomic<std::uint32_t>	 size;
+	std::atomic<std::uint32_t>	 moves;	// Odd while entries move.
+	std::mutex			 writer;
+};
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_KEYSTORE_H
@@ -0,0 +1,99 @@
+///
+/// \file emsha/lms.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares LMS and HSS hash-based signature verification
+///        (RFC 8554).
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_LMS_H
+#define EMSHA_LMS_H
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+
+
+namespace emsha {
+
+
+/// LMS_PUBLIC_KEY_SIZE is the size of an LMS public key with SHA-256
+/// and 32-byte hashes.
+const std::uint32_t LMS_PUBLIC_KEY_SIZE = 56;
+
+
+/// \brief Verify an LMS signature.
+///
+/// The SHA-256 parameter sets of RFC 8554 are supported: the
+/// LMS_SHA256_M32_H5 to H25 tree types with the LMOTS_SHA256_N32_W1
+/// to W8 one-time signature types.
+///
+/// Verification is almost entirely short, fixed-format hashes. Each
+/// Winternitz chain step and each leaf hash is a single SHA-256
+/// block and each interior node is two, so these are laid out
+/// directly rather than going through a context, and the chains,
+/// which are independent of each other, are advanced side by side
+/// through the multi-lane kernel. The chain ends are collected on
+/// the stack before the public key is hashed, which takes a little
+/// under 9 KB with W1 and proportionally less with wider chains.
+///
+/// \param publicKey The LMS public key.
+/// \param publicKeyLength The length of the public key.
+/// \param message The signed message.
+/// \param messageLength The length of the message.
+/// \param signature The LMS signature.
+/// \param signatureLength The length of the signature.
+/// \return An ::EMSHAResult describing the result of the operation.
+///
+///         - EMSHAResult::NullPointer is returned if a pointer
+///           argument is a nullptr.
+///         - EMSHAResult::VerifyFailed is returned if the
+///           signature is invalid, including if it or the key is
+///           malformed or uses an unsupported parameter set.
+///         - EMSHAResult::OK is returned if the signature is valid.
+EMSHAResult	LMSVerify(const std::uint8_t *publicKey, std::size_t publicKeyLength,
+			  const std::uint8_t *message, std::size_t messageLength,
+			  const std::uint8_t *signature, std::size_t signatureLength);
+
+
+/// \brief Verify an HSS signature.
+///
+/// The public key is the number of levels followed by the top-level
+/// LMS public key; the signature carries a signed public key for
+/// each lower level and the bottom level's signature of the message.
+///
+/// \return An ::EMSHAResult describing the result of the operation,
+///         as for LMSVerify.
+EMSHAResult	HSSVerify(const std::uint8_t *publicKey, std::size_t publicKeyLength,
+			  const std::uint8_t *message, std::size_t messageLength,
+			  const std::uint8_t *signature, std::size_t signatureLength);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_LMS_H
@@ -0,0 +1,169 @@
+///
+/// \file emsha/merkle.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares Merkle tree hashing, inclusion and consistency
+///        proofs for append-only logs.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_MERKLE_H
+#define EMSHA_MERKLE_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <emsha/emsha.h>
+
+
+namespace emsha {
+
+
+// The tree follows RFC 9162 (Certificate Transparency version 2.0),
+// section 2.1: leaves are hashed as SHA-256(0x00 || data) and interior
+// nodes as SHA-256(0x01 || left || right); a tree of n leaves is split
+// into a left subtree of the largest power of two smaller than n and a
+// right subtree of the rest. Leaf hashes are passed around as arrays of
+// SHA256_HASH_SIZE-byte hashes laid end to end, and proofs as arrays
+// of SHA256_HASH_SIZE-byte node hashes, in the order RFC 9162 gives.
+
+
+/// \brief Compute the hash of a leaf.
+///
+/// \param data The leaf data.
+/// \param length The length of the leaf data.
+/// \param hash Buffer of SHA256_HASH_SIZE bytes.
+/// \return An ::EMSHAResult describing the result of the operation.
+EMSHAResult	MerkleLeafHash(const std::uint8_t *data, std::uint32_t length,
+			       std::uint8_t *hash);
+
+/// \brief Compute the root hash of a tree.
+///
+/// The tree is hashed a level at a time, with each level's nodes
+/// going through the multi-lane kernel.
+///
+/// \param leaves size leaf hashes.
+/// \param size The number of leaves; the root of an empty tree is
+///        the hash of the empty string.
+/// \param root Buffer of SHA256_HASH_SIZE bytes.
+/// \return An ::EMSHAResult describing the result of the operation.
+EMSHAResult	MerkleRoot(const std::uint8_t *leaves, std::uint64_t size,
+			   std::uint8_t *root);
+
+/// \brief Produce the inclusion proof (audit path) for a leaf.
+///
+/// \param leaves size leaf hashes.
+/// \param size The number of leaves in the tree.
+/// \param index The index of the leaf.
+/// \param proof Receives the proof.
+/// \return EMSHAResult::NullPointer, EMSHAResult::InvalidState if
+///         index isn't a leaf of the tree, or EMSHAResult::OK.
+EMSHAResult	MerkleInclusionProof(const std::uint8_t *leaves, std::uint64_t size,
+				     std::uint64_t index,
+				     std::vector<std::uint8_t>& proof);
+
+/// \brief Produce the consistency proof between an earlier tree of
+///        oldSize leaves and the current tree of size leaves.
+///
+/// \return EMSHAResult::NullPointer, EMSHAResult::InvalidState if
+///         oldSize is zero or larger than size, or EMSHAResult::OK.
+EMSHAResult	MerkleConsistencyProof(const std::uint8_t *leaves, std::uint64_t size,
+				       std::uint64_t oldSize,
+				       std::vector<std::uint8_t>& proof);
+
+/// \brief Check an inclusion proof.
+///
+/// \param leafHash The hash of the leaf.
+/// \param index The index of the leaf.
+/// \param size The number of leaves in the tree.
+/// \param proof The proof.
+/// \param proofLength The length of the proof in bytes.
+/// \param root The root hash of the tree.
+/// \return An ::EMSHAResult describing the result of the operation.
+///
+///         - EMSHAResult::NullPointer is returned if a pointer
+///           argument is a nullptr.
+///         - EMSHAResult::VerifyFailed is returned if the proof is
+///           the wrong shape for the leaf's position, or doesn't
+///           lead to root.
+///         - EMSHAResult::OK is returned if the proof is valid.
+EMSHAResult	MerkleVerifyInclusion(const std::uint8_t *leafHash,
+				      std::uint64_t index, std::uint64_t size,
+				      const std::uint8_t *proof,
+				      std::size_t proofLength,
+				      const std::uint8_t *root);
+
+/// \brief Check a consistency proof between two tree heads.
+///
+/// \return An ::EMSHAResult describing the result of the operation,
+///         as for MerkleVerifyInclusion.
+EMSHAResult	MerkleVerifyConsistency(std::uint64_t oldSize, std::uint64_t size,
+					const std::uint8_t *oldRoot,
+					const std::uint8_t *root,
+					const std::uint8_t *proof,
+					std::size_t proofLength);
+
+
+/// \brief MerkleInclusion describes one inclusion proof in a batch.
+struct MerkleInclusion {
+	/// The hash of the leaf.
+	const std::uint8_t	*leafHash;
+
+	/// The index of the leaf.
+	std::uint64_t		 index;
+
+	/// The proof, and its length in bytes.
+	const std::uint8_t	*proof;
+	std::size_t		 proofLength;
+};
+
+
+/// \brief Check a batch of inclusion proofs against one tree head.
+///
+/// All of the proofs are walked towards the root together, one level
+/// per round; the node hashes each round needs are computed through
+/// the multi-lane kernel, and a node that several proofs reach from
+/// the same two children (such as the upper part of the audit paths
+/// of neighbouring leaves) is only hashed once.
+///
+/// \param size The number of leaves in the tree.
+/// \param root The root hash of the tree.
+/// \param proofs The proofs to check.
+/// \param count The number of proofs.
+/// \param results If not a nullptr, receives the result for each
+///        proof, as MerkleVerifyInclusion would return it.
+/// \return EMSHAResult::NullPointer if root or proofs is a nullptr,
+///         EMSHAResult::VerifyFailed if any proof failed, or
+///         EMSHAResult::OK if all of them are valid.
+EMSHAResult	MerkleVerifyInclusionBatch(std::uint64_t size, const std::uint8_t *root,
+					   const MerkleInclusion *proofs,
+					   std::size_t count, EMSHAResult *results);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_MERKLE_H
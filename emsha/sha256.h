@@ -128,6 +128,49 @@ public:
 	///           digest.
 	EMSHAResult Result(std::uint8_t *digest) override;
 
+	/// \brief Copy this context's state into another context.
+	///
+	/// Forking lets a shared prefix be hashed once and then
+	/// continued along several paths: write the prefix, fork a
+	/// child for each message, and update and finalise the
+	/// children independently of the parent and of each other.
+	/// It is also how an intermediate digest of a running
+	/// transcript is taken without disturbing it.
+	///
+	/// Only the live state is copied: the intermediate hash,
+	/// the message length, the status and the part of the
+	/// message block that holds pending data. Whatever the
+	/// child held before is discarded; a finalised or failed
+	/// parent produces a finalised or failed child.
+	///
+	/// \param child The context to overwrite.
+	/// \return This should always return EMSHAResult::OK.
+	EMSHAResult Fork(SHA256& child) const;
+
+	/// \brief Copy data to another buffer and write it into the
+	///        context in the same pass.
+	///
+	/// The data is taken a strip at a time: each strip is copied
+	/// and then hashed straight out of the source while it is
+	/// still in cache, so the source is read from memory once
+	/// rather than once for the copy and again for the hash.
+	///
+	/// With streaming set, the copy uses non-temporal stores
+	/// where the target has them (SSE2), so that a large
+	/// destination goes straight to memory instead of evicting
+	/// the data being hashed; elsewhere it is an ordinary copy.
+	///
+	/// \param dst The destination, at least length bytes; it
+	///        must not overlap src.
+	/// \param src The data to copy and hash.
+	/// \param length The length of the data.
+	/// \param streaming Whether to bypass the cache for dst.
+	/// \return As for #Update. Nothing is copied if the context
+	///         can't be updated, and EMSHAResult::NullPointer is
+	///         also returned if dst is a nullptr.
+	EMSHAResult CopyAndUpdate(std::uint8_t *dst, const std::uint8_t *src,
+				  std::uint32_t length, bool streaming = false);
+
 	/// \brief Returns the output size of SHA-256.
 	///
 	/// The buffers passed to #Update and #Finalise should be at
@@ -138,7 +181,14 @@ public:
 	std::uint32_t Size() override;
 
 private:
-	uint64_t mlen; // Current message length.
+	// The sidecar code in file.cc checkpoints and resumes contexts
+	// through these; see emsha/internal.h.
+	friend void	sha256_checkpoint(const SHA256& ctx, std::uint32_t *ih,
+					  std::uint64_t& length, std::uint8_t *partial);
+	friend void	sha256_resume(SHA256& ctx, const std::uint32_t *ih,
+				      std::uint64_t length);
+
+	uint64_t mlen; // Current message length, in bits.
 	uint32_t i_hash[8]; // The intermediate hash is 8x 32-bit blocks.
 
 	// hStatus is the hash status, and hComplete indicates
@@ -153,10 +203,13 @@ private:
 
 	inline EMSHAResult	addLength(const uint32_t);
 	inline void  		updateMessageBlock(void);
-	inline void  		padMessage(uint8_t pc);
-	uint32_t     		chunkToUint32(uint32_t offset);
-	uint32_t     		uint32ToChunk(uint32_t offset);
 	EMSHAResult		reset();
+	EMSHAResult		update(const std::uint8_t *message,
+				       std::uint32_t messageLength);
+	EMSHAResult		copyAndUpdate(std::uint8_t *dst, const std::uint8_t *src,
+					      std::uint32_t length, bool streaming);
+	EMSHAResult		finalise(std::uint8_t *digest);
+	EMSHAResult		result(std::uint8_t *digest);
 }; // end class SHA256
 
 
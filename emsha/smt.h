@@ -0,0 +1,224 @@
+///
+/// \file emsha/smt.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares a sparse Merkle tree keyed by SHA-256 digests.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_SMT_H
+#define EMSHA_SMT_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <emsha/emsha.h>
+
+
+namespace emsha {
+
+
+/// SMT_DEPTH is the depth of a sparse Merkle tree: one level per bit
+/// of a SHA-256 key.
+const std::uint32_t SMT_DEPTH = 256;
+
+
+/// \brief SMTUpdate describes one change in a batch of updates to a
+///        sparse Merkle tree.
+struct SMTUpdate {
+	/// The SHA256_HASH_SIZE-byte key.
+	const std::uint8_t	*key;
+
+	/// The SHA256_HASH_SIZE-byte value to store under the key, or
+	/// a nullptr to remove the key.
+	const std::uint8_t	*value;
+};
+
+
+/// \brief SMTProof is a compressed inclusion or non-inclusion proof.
+///
+/// A proof lists the sibling of every node on the path from the leaf
+/// to the root, but nearly all of those siblings are empty subtrees
+/// whose hashes are fixed; the bitmap records which siblings are not
+/// empty, and only those are carried.
+struct SMTProof {
+	/// Bit i (most significant bit first) is set if the sibling
+	/// at depth i + 1 is not an empty subtree.
+	std::uint8_t			bitmap[SMT_DEPTH / 8];
+
+	/// The non-empty siblings, SHA256_HASH_SIZE bytes each,
+	/// starting nearest the leaf.
+	std::vector<std::uint8_t>	siblings;
+};
+
+
+/// \brief SparseMerkleTree is an in-memory sparse Merkle tree with
+///        SMT_DEPTH levels.
+///
+/// Each key's leaf sits at the end of the path spelled out by the
+/// key's bits, most significant bit first, with 0 for the left child.
+/// Hashes are domain-separated:
+///
+/// ```
+///     leaf  = SHA-256(0x00 || key || value)
+///     node  = SHA-256(0x01 || left || right)
+///     empty = 32 zero bytes for an empty leaf, and the node hash of
+///             two empty children above it
+/// ```
+///
+/// The empty subtree hash at every depth is computed once per
+/// process and shared. Only branch nodes, where both children are
+/// non-empty, are stored, each with the hashes of its two children;
+/// a subtree holding a single key is represented by that key's leaf,
+/// and its hash is rebuilt from the leaf and the empty hashes when
+/// it is needed. A tree of n keys therefore holds n - 1 branches, of
+/// around 200 bytes each with the hash table's overhead, besides the
+/// keys and values themselves.
+///
+/// Changing a key still hashes its path up to the nearest branch,
+/// as every level's hash depends on the leaf, but those levels are
+/// neither stored nor looked up; above it, each branch on the path
+/// costs one lookup and a hash or two.
+///
+/// A tree is not synchronised; concurrent readers are fine, but
+/// updates need exclusive access.
+class SparseMerkleTree {
+public:
+	/// A new tree is empty.
+	SparseMerkleTree();
+
+	/// \brief Copy out the root hash.
+	///
+	/// \param root Buffer of SHA256_HASH_SIZE bytes.
+	void		Root(std::uint8_t *root) const;
+
+	/// \brief Set or remove a single key.
+	///
+	/// \param key The SHA256_HASH_SIZE-byte key.
+	/// \param value The SHA256_HASH_SIZE-byte value, or a nullptr
+	///        to remove the key.
+	/// \return EMSHAResult::NullPointer if key is a nullptr, or
+	///         EMSHAResult::OK.
+	EMSHAResult	Update(const std::uint8_t *key, const std::uint8_t *value);
+
+	/// \brief Apply a batch of updates, rehashing each node they
+	///        touch only once.
+	///
+	/// Updates are applied in order, so a later update to the same
+	/// key wins.
+	///
+	/// \return EMSHAResult::NullPointer if any key is a nullptr
+	///         (in which case nothing is changed), or
+	///         EMSHAResult::OK.
+	EMSHAResult	UpdateBatch(const SMTUpdate *updates, std::size_t count);
+
+	/// \brief Look up the value stored under a key.
+	///
+	/// \param key The SHA256_HASH_SIZE-byte key.
+	/// \param value Buffer of SHA256_HASH_SIZE bytes that receives
+	///        the value, if there is one.
+	/// \return True if the key is present.
+	bool		Lookup(const std::uint8_t *key, std::uint8_t *value) const;
+
+	/// \brief Return the number of keys in the tree.
+	std::size_t	Size() const { return this->values.size(); }
+
+	/// \brief Produce a proof for a key: of inclusion if the key is
+	///        present, otherwise of non-inclusion.
+	///
+	/// \return EMSHAResult::NullPointer if key is a nullptr, or
+	///         EMSHAResult::OK.
+	EMSHAResult	Prove(const std::uint8_t *key, SMTProof& proof) const;
+
+	/// \brief Return the hash of an empty subtree whose root is at
+	///        depth (0 being the root of the tree, SMT_DEPTH a
+	///        leaf).
+	static const std::uint8_t	*EmptyHash(std::uint32_t depth);
+
+private:
+	struct nodeID {
+		std::uint8_t	path[SMT_DEPTH / 8];
+		std::uint16_t	depth;
+
+		bool operator==(const nodeID& other) const;
+	};
+
+	struct nodeIDHash {
+		std::size_t operator()(const nodeID& id) const;
+	};
+
+	struct digest {
+		std::uint8_t	d[SHA256_HASH_SIZE];
+	};
+
+	// A branch is a node with two non-empty children. Each side
+	// refers to the next branch down it, or to its only leaf,
+	// with the side's hash at the branch's depth + 1.
+	struct branch {
+		nodeID	kids[2];
+		digest	hashes[2];
+		bool	stale[2];	// Hash needs rebuilding.
+	};
+
+	// The branches, and each key's value; top is the highest
+	// branch, or the only leaf, when the tree isn't empty.
+	std::unordered_map<nodeID, branch, nodeIDHash>	branches;
+	std::unordered_map<nodeID, digest, nodeIDHash>	values;
+	nodeID		top;
+	digest		rootHash;
+
+	void		set(const nodeID& leaf, std::vector<nodeID>& dirty);
+	void		remove(const nodeID& leaf, std::vector<nodeID>& dirty);
+	void		subtreeHash(const nodeID& id, std::uint32_t depth,
+				    std::uint8_t *h) const;
+};
+
+
+/// \brief Check an SMTProof against a root hash.
+///
+/// \param root The SHA256_HASH_SIZE-byte root hash.
+/// \param key The SHA256_HASH_SIZE-byte key.
+/// \param value The value the key should have, or a nullptr to check
+///        that the key is absent.
+/// \param proof The proof.
+/// \return An ::EMSHAResult describing the result of the operation.
+///
+///         - EMSHAResult::NullPointer is returned if root or key is
+///           a nullptr.
+///         - EMSHAResult::InvalidState is returned if the proof is
+///           malformed.
+///         - EMSHAResult::VerifyFailed is returned if the proof
+///           doesn't lead to the root.
+///         - EMSHAResult::OK is returned if the proof is valid.
+EMSHAResult	SMTVerify(const std::uint8_t *root, const std::uint8_t *key,
+			  const std::uint8_t *value, const SMTProof& proof);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_SMT_H
@@ -0,0 +1,105 @@
+///
+/// \file emsha/stats.h
+/// \author K. Isom <kyle@imap.cc>
+/// \date 2026-10-18
+/// \brief Declares an interface for reading the library's usage counters.
+///
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// copy of this  software and associated documentation  files (the "Software"),
+/// to deal  in the Software  without restriction, including  without limitation
+/// the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+/// and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+/// Software is furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+/// LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+/// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+/// IN THE SOFTWARE.
+///
+
+#ifndef EMSHA_STATS_H
+#define EMSHA_STATS_H
+
+
+#include <cstdint>
+
+#include <emsha/emsha.h>
+
+
+namespace emsha {
+
+
+/// STATS_RESULT_CODES is the number of ::EMSHAResult values that
+/// are counted individually; Stats::results is indexed by the
+/// numeric value of the result.
+const std::uint32_t STATS_RESULT_CODES = 10;
+
+
+/// \brief Stats is a snapshot of the library's usage counters.
+///
+/// The counters are kept at the SHA-256 layer, so HMAC traffic is
+/// also counted there: an HMAC update shows up as both an HMAC and
+/// a SHA-256 update, and the HMAC pads are included in the bytes
+/// hashed.
+struct Stats {
+	/// Bytes written into SHA-256 contexts.
+	std::uint64_t	bytesHashed;
+
+	/// Message blocks run through the compression function.
+	std::uint64_t	blocksCompressed;
+
+	/// Calls to SHA256::Update and HMAC::Update.
+	std::uint64_t	updateCalls;
+
+	/// Calls to SHA256::Finalise and HMAC::Finalise.
+	std::uint64_t	finaliseCalls;
+
+	/// HMAC keys set up, i.e. HMAC contexts constructed.
+	std::uint64_t	hmacKeySetups;
+
+	/// Of the blocks compressed, how many went through the
+	/// multi-lane kernel used for batches of Merkle tree nodes.
+	std::uint64_t	laneBlocks;
+
+	/// How many times each ::EMSHAResult was returned from the
+	/// SHA256 and HMAC Update, Finalise and Result methods.
+	std::uint64_t	results[STATS_RESULT_CODES];
+};
+
+
+/// \brief Report whether the library was built with counters.
+///
+/// Counters are only compiled in when the library is built with
+/// EMSHA_STATS defined (the EMSHA_STATS CMake option); otherwise
+/// they cost nothing and every snapshot is zero.
+///
+/// \return True if the counters are being kept.
+bool	StatsEnabled();
+
+
+/// \brief Take a snapshot of the library's usage counters.
+///
+/// Each thread counts into its own cache line-padded set of
+/// counters, so hashing threads never contend with each other; a
+/// snapshot adds up every thread's counters, including those of
+/// threads that have exited. The snapshot is not atomic with
+/// respect to other threads, but each counter only ever increases.
+///
+/// \param stats Receives the totals.
+void	StatsSnapshot(Stats& stats);
+
+
+} // end of namespace emsha
+
+
+#endif // EMSHA_STATS_H
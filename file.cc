@@ -0,0 +1,619 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/file.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// alignedBuffer owns a FILE_ALIGNMENT-aligned read buffer, as
+// required for O_DIRECT reads.
+class alignedBuffer {
+public:
+	alignedBuffer() : buf(nullptr)
+	{
+		void	*p = nullptr;
+
+		if (0 == posix_memalign(&p, FILE_ALIGNMENT, FILE_BUFFER_SIZE)) {
+			this->buf = static_cast<uint8_t *>(p);
+		}
+	}
+
+	~alignedBuffer() { free(this->buf); }
+
+	alignedBuffer(const alignedBuffer&) = delete;
+	alignedBuffer& operator=(const alignedBuffer&) = delete;
+
+	uint8_t	*buf;
+};
+
+
+// enableDirect attempts to switch fd over to cache-bypassing reads,
+// returning true if it did.
+bool
+enableDirect(int fd, int flags)
+{
+#if defined(O_DIRECT)
+	return 0 == fcntl(fd, F_SETFL, flags | O_DIRECT);
+#elif defined(F_NOCACHE)
+	return 0 == fcntl(fd, F_NOCACHE, 1);
+#else
+	return false;
+#endif
+}
+
+
+// disableDirect puts fd back to reading through the page cache.
+void
+disableDirect(int fd, int flags)
+{
+#if defined(O_DIRECT)
+	(void)fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+#elif defined(F_NOCACHE)
+	(void)fcntl(fd, F_NOCACHE, 0);
+#endif
+}
+
+
+// dropCache asks the kernel to drop any pages of fd that were read
+// through the cache while in FileMode::Direct.
+void
+dropCache(int fd)
+{
+#if defined(POSIX_FADV_DONTNEED)
+	(void)posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+}
+
+
+// readFile reads everything from fd, starting at offset, into sink,
+// which only needs an Update(const uint8_t *, uint32_t) method
+// returning an EMSHAResult.
+template <typename Sink>
+EMSHAResult
+readFile(int fd, FileMode mode, uint64_t offset, Sink& sink)
+{
+	int const flags = fcntl(fd, F_GETFL);
+	if (flags == -1) { return EMSHAResult::IOError; }
+
+	alignedBuffer	buffer;
+	if (nullptr == buffer.buf) { return EMSHAResult::IOError; }
+
+	EMSHAResult	res = EMSHAResult::OK;
+	bool		direct = false;
+	bool		cached = false;
+
+	if (FileMode::Direct == mode) {
+		if ((offset % FILE_ALIGNMENT) == 0) {
+			direct = enableDirect(fd, flags);
+		}
+		cached = !direct;
+	}
+
+	while (EMSHAResult::OK == res) {
+		ssize_t const n = read(fd, buffer.buf, FILE_BUFFER_SIZE);
+		if (n < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+
+			// Some filesystems only reject direct I/O at
+			// read time, or refuse the short read at the
+			// end of the file; finish the file through
+			// the cache instead.
+			if (direct && (EINVAL == errno)) {
+				disableDirect(fd, flags);
+				direct = false;
+				cached = true;
+				continue;
+			}
+
+			res = EMSHAResult::IOError;
+			break;
+		}
+
+		if (0 == n) {
+			break;
+		}
+
+		res = sink.Update(buffer.buf, static_cast<uint32_t>(n));
+		offset += static_cast<uint64_t>(n);
+
+		// A short read leaves the offset unaligned, which
+		// direct I/O can't continue from. This is normally
+		// the tail of the file, but pipes and some network
+		// filesystems can return short reads anywhere.
+		if (direct && ((offset % FILE_ALIGNMENT) != 0)) {
+			disableDirect(fd, flags);
+			direct = false;
+			cached = true;
+		}
+	}
+
+	if (direct) {
+		disableDirect(fd, flags);
+	}
+
+	if (cached) {
+		dropCache(fd);
+	}
+
+	return res;
+}
+
+
+// midstate hashes through a SHA256 context, and also keeps a copy of
+// the last block the context has compressed, as the sidecar records
+// its digest.
+struct midstate {
+	SHA256		ctx;
+	uint64_t	length;			// Bytes written.
+	uint8_t		last[SHA256_MB_SIZE];	// Last block compressed.
+
+	EMSHAResult	Update(const uint8_t *m, uint32_t ml);
+};
+
+
+EMSHAResult
+midstate::Update(const uint8_t *m, uint32_t ml)
+{
+	uint64_t const	end = this->length + ml;
+	uint64_t const	boundary = end - (end % SHA256_MB_SIZE);
+
+	// If this update completes a block, the last one it completes
+	// starts either in m or in the context's pending partial block.
+	if (boundary > this->length) {
+		uint64_t const	start = boundary - SHA256_MB_SIZE;
+
+		if (start >= this->length) {
+			const uint8_t	*p = m + (start - this->length);
+
+			std::copy(p, p + SHA256_MB_SIZE, this->last);
+		} else {
+			uint32_t	ih[8];
+			uint64_t	length;
+			uint32_t const	head = static_cast<uint32_t>(this->length - start);
+
+			sha256_checkpoint(this->ctx, ih, length, this->last);
+			std::copy(m, m + (SHA256_MB_SIZE - head), this->last + head);
+		}
+	}
+
+	this->length = end;
+	return this->ctx.Update(m, ml);
+}
+
+
+// The sidecar is a fixed-size record of big-endian fields:
+//
+//	 0	magic
+//	 8	device
+//	16	inode
+//	24	mtime seconds
+//	32	mtime nanoseconds
+//	40	bytes hashed
+//	48	bytes covered by the midstate (a multiple of 64)
+//	56	midstate
+//	88	SHA-256 of the last block covered by the midstate
+//	120	SHA-256 of all of the above
+const uint8_t	sidecarMagic[8] = {'E', 'M', 'S', 'H', 'A', 'S', 'C', '1'};
+const uint32_t	sidecarBody = 120;
+
+
+struct sidecar {
+	uint64_t	device;
+	uint64_t	inode;
+	uint64_t	mtimeSec;
+	uint64_t	mtimeNsec;
+	uint64_t	size;
+	uint64_t	prefix;
+	uint32_t	ih[8];
+	uint8_t		guard[SHA256_HASH_SIZE];
+};
+
+
+void
+put64(uint8_t *p, uint64_t v)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		p[i] = static_cast<uint8_t>(v >> (56 - (8 * i)));
+	}
+}
+
+
+uint64_t
+get64(const uint8_t *p)
+{
+	uint64_t	v = 0;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		v = (v << 8) | p[i];
+	}
+	return v;
+}
+
+
+void
+encodeSidecar(const sidecar& sc, uint8_t *rec)
+{
+	std::copy(sidecarMagic, sidecarMagic + 8, rec);
+	put64(rec + 8, sc.device);
+	put64(rec + 16, sc.inode);
+	put64(rec + 24, sc.mtimeSec);
+	put64(rec + 32, sc.mtimeNsec);
+	put64(rec + 40, sc.size);
+	put64(rec + 48, sc.prefix);
+	sha256_store(sc.ih, rec + 56);
+	std::copy(sc.guard, sc.guard + SHA256_HASH_SIZE, rec + 88);
+	SHA256Digest(rec, sidecarBody, rec + sidecarBody);
+}
+
+
+bool
+decodeSidecar(const uint8_t *rec, sidecar& sc)
+{
+	uint8_t	check[SHA256_HASH_SIZE];
+
+	if (!std::equal(sidecarMagic, sidecarMagic + 8, rec)) {
+		return false;
+	}
+
+	SHA256Digest(rec, sidecarBody, check);
+	if (!HashEqual(check, rec + sidecarBody)) {
+		return false;
+	}
+
+	sc.device    = get64(rec + 8);
+	sc.inode     = get64(rec + 16);
+	sc.mtimeSec  = get64(rec + 24);
+	sc.mtimeNsec = get64(rec + 32);
+	sc.size      = get64(rec + 40);
+	sc.prefix    = get64(rec + 48);
+	for (uint32_t i = 0; i < 8; i++) {
+		const uint8_t *w = rec + 56 + (4 * i);
+		sc.ih[i] = (static_cast<uint32_t>(w[0]) << 24) |
+			   (static_cast<uint32_t>(w[1]) << 16) |
+			   (static_cast<uint32_t>(w[2]) << 8) |
+			   static_cast<uint32_t>(w[3]);
+	}
+	std::copy(rec + 88, rec + 88 + SHA256_HASH_SIZE, sc.guard);
+
+	return (sc.prefix % SHA256_MB_SIZE) == 0 && sc.prefix <= sc.size;
+}
+
+
+bool
+readExactly(int fd, uint8_t *buf, size_t n, off_t offset)
+{
+	while (n > 0) {
+		ssize_t const r = pread(fd, buf, n, offset);
+		if (r < 0 && EINTR == errno) {
+			continue;
+		}
+		if (r <= 0) {
+			return false;
+		}
+
+		buf    += r;
+		n      -= static_cast<size_t>(r);
+		offset += r;
+	}
+
+	return true;
+}
+
+
+bool
+loadSidecar(const char *path, sidecar& sc)
+{
+	uint8_t		rec[SIDECAR_SIZE];
+	int const	fd = open(path, O_RDONLY);
+
+	if (fd == -1) {
+		return false;
+	}
+
+	bool const ok = readExactly(fd, rec, SIDECAR_SIZE, 0) && decodeSidecar(rec, sc);
+	close(fd);
+	return ok;
+}
+
+
+// syncDirectory flushes the directory holding path, so that a rename
+// into it survives a crash.
+bool
+syncDirectory(const char *path)
+{
+	std::string		dir(path);
+	std::string::size_type	slash = dir.rfind('/');
+
+	if (slash == std::string::npos) {
+		dir = ".";
+	} else {
+		dir.resize((slash == 0) ? 1 : slash);
+	}
+
+	int const fd = open(dir.c_str(), O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+
+	bool const ok = (0 == fsync(fd));
+	close(fd);
+	return ok;
+}
+
+
+// saveSidecar writes the record to a temporary file next to the
+// sidecar, syncs it and renames it into place, then syncs the
+// directory, so that a crash leaves either the old record or the new
+// one, never a torn or empty one.
+bool
+saveSidecar(const char *path, const sidecar& sc)
+{
+	uint8_t			rec[SIDECAR_SIZE];
+	std::string const	tmp = std::string(path) + ".tmp";
+
+	encodeSidecar(sc, rec);
+
+	int const fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		return false;
+	}
+
+	const uint8_t	*p = rec;
+	size_t		 n = SIDECAR_SIZE;
+	bool		 ok = true;
+
+	while (ok && (n > 0)) {
+		ssize_t const w = write(fd, p, n);
+		if (w < 0 && EINTR == errno) {
+			continue;
+		}
+
+		ok = (w > 0);
+		if (ok) {
+			p += w;
+			n -= static_cast<size_t>(w);
+		}
+	}
+
+	ok = ok && (0 == fsync(fd));
+	ok = (0 == close(fd)) && ok;
+	if (ok) {
+		ok = (0 == rename(tmp.c_str(), path)) && syncDirectory(path);
+	}
+
+	if (!ok) {
+		unlink(tmp.c_str());
+	}
+	return ok;
+}
+
+
+void
+mtime(const struct stat& st, uint64_t& sec, uint64_t& nsec)
+{
+#if defined(__APPLE__)
+	sec  = static_cast<uint64_t>(st.st_mtimespec.tv_sec);
+	nsec = static_cast<uint64_t>(st.st_mtimespec.tv_nsec);
+#else
+	sec  = static_cast<uint64_t>(st.st_mtim.tv_sec);
+	nsec = static_cast<uint64_t>(st.st_mtim.tv_nsec);
+#endif
+}
+
+
+// canResume decides whether the recorded midstate still describes
+// the start of the file. Appending moves the size and mtime forward;
+// anything else (a different file, truncation, an in-place rewrite
+// or a changed block at the boundary) means starting again.
+bool
+canResume(int fd, const struct stat& st, const sidecar& sc)
+{
+	if ((sc.device != static_cast<uint64_t>(st.st_dev)) ||
+	    (sc.inode != static_cast<uint64_t>(st.st_ino))) {
+		return false;
+	}
+
+	uint64_t const	size = static_cast<uint64_t>(st.st_size);
+	uint64_t	sec;
+	uint64_t	nsec;
+
+	mtime(st, sec, nsec);
+
+	if (size < sc.size) {
+		return false;
+	}
+
+	if ((sec < sc.mtimeSec) || ((sec == sc.mtimeSec) && (nsec < sc.mtimeNsec))) {
+		return false;
+	}
+
+	if ((size == sc.size) && ((sec != sc.mtimeSec) || (nsec != sc.mtimeNsec))) {
+		return false;
+	}
+
+	if (sc.prefix == 0) {
+		return true;
+	}
+
+	uint8_t	block[SHA256_MB_SIZE];
+	uint8_t	guard[SHA256_HASH_SIZE];
+
+	if (!readExactly(fd, block, SHA256_MB_SIZE,
+			 static_cast<off_t>(sc.prefix - SHA256_MB_SIZE))) {
+		return false;
+	}
+
+	SHA256Digest(block, SHA256_MB_SIZE, guard);
+	return HashEqual(guard, sc.guard);
+}
+
+
+} // anonymous namespace
+
+
+EMSHAResult
+SHA256FileDescriptor(int fd, std::uint8_t *digest, FileMode mode)
+{
+	if (nullptr == digest) { return EMSHAResult::NullPointer; }
+
+	// Pipes and sockets have no offset to start from, and can't
+	// be read directly anyway; anything else that can't report
+	// its offset is an error.
+	off_t		start = lseek(fd, 0, SEEK_CUR);
+	if (start == -1) {
+		if (ESPIPE != errno) {
+			return EMSHAResult::IOError;
+		}
+		start = 0;
+	}
+
+	SHA256		ctx;
+	EMSHAResult	res = readFile(fd, mode,
+				       static_cast<uint64_t>(start), ctx);
+
+	if (EMSHAResult::OK == res) {
+		res = ctx.Finalise(digest);
+	}
+
+	return res;
+}
+
+
+EMSHAResult
+SHA256File(const char *path, std::uint8_t *digest, FileMode mode)
+{
+	if (nullptr == path) { return EMSHAResult::NullPointer; }
+	if (nullptr == digest) { return EMSHAResult::NullPointer; }
+
+	int const fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return EMSHAResult::IOError;
+	}
+
+	EMSHAResult const res = SHA256FileDescriptor(fd, digest, mode);
+	close(fd);
+
+	return res;
+}
+
+
+EMSHAResult
+SHA256FileIncremental(const char *path, const char *sidecarPath,
+		      std::uint8_t *digest, FileMode mode,
+		      std::uint64_t *bytesRead)
+{
+	if (nullptr == path) { return EMSHAResult::NullPointer; }
+	if (nullptr == sidecarPath) { return EMSHAResult::NullPointer; }
+	if (nullptr == digest) { return EMSHAResult::NullPointer; }
+
+	int const fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		return EMSHAResult::IOError;
+	}
+
+	struct stat	st;
+	if (-1 == fstat(fd, &st)) {
+		close(fd);
+		return EMSHAResult::IOError;
+	}
+
+	sidecar		sc{};
+	midstate	ms{};
+
+	if (loadSidecar(sidecarPath, sc) && canResume(fd, st, sc)) {
+		sha256_resume(ms.ctx, sc.ih, sc.prefix);
+		ms.length = sc.prefix;
+	} else {
+		sc = sidecar{};
+		ms.length = 0;
+	}
+
+	uint64_t const	start = ms.length;
+	EMSHAResult	res = EMSHAResult::IOError;
+
+	if (static_cast<off_t>(start) == lseek(fd, static_cast<off_t>(start), SEEK_SET)) {
+		res = readFile(fd, mode, start, ms);
+	}
+	close(fd);
+
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	if (nullptr != bytesRead) {
+		*bytesRead = ms.length - start;
+	}
+
+	// Record the midstate before finalising destroys it.
+	uint8_t		partial[SHA256_MB_SIZE];
+	uint64_t	length;
+
+	sha256_checkpoint(ms.ctx, sc.ih, length, partial);
+	sc.device    = static_cast<uint64_t>(st.st_dev);
+	sc.inode     = static_cast<uint64_t>(st.st_ino);
+	mtime(st, sc.mtimeSec, sc.mtimeNsec);
+	sc.size      = length;
+	sc.prefix    = length - (length % SHA256_MB_SIZE);
+
+	// A resumed run that didn't reach another block boundary never
+	// saw the guard block; it is unchanged.
+	if (sc.prefix != start) {
+		SHA256Digest(ms.last, SHA256_MB_SIZE, sc.guard);
+	}
+
+	res = ms.ctx.Finalise(digest);
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	if (!saveSidecar(sidecarPath, sc)) {
+		return EMSHAResult::IOError;
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+} // end of namespace emsha
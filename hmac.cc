@@ -31,6 +31,7 @@
 #include <emsha/emsha.h>
 #include <emsha/sha256.h>
 #include <emsha/hmac.h>
+#include <emsha/internal.h>
 
 
 namespace emsha {
@@ -63,6 +64,7 @@ static constexpr uint8_t opad = 0x5c;
 HMAC::HMAC(const uint8_t *ik, uint32_t ikl)
     : hstate(HMAC_INIT), k{0}, buf{0}
 {
+	EMSHA_STAT_ADD(StatHMACKeySetups, 1);
 	std::fill(this->k, this->k+HMAC_KEY_LENGTH, 0);
 
 	if (ikl < HMAC_KEY_LENGTH) {
@@ -108,6 +110,8 @@ HMAC::reset()
 {
 	EMSHAResult res;
 
+	EMSHA_PROBE1(hmac__reset, this);
+
 	// Following a reset, both SHA-256 contexts and result buffer should be
 	// zero'd out for a clean slate. The HMAC state should be reset
 	// accordingly.
@@ -137,6 +141,19 @@ HMAC::reset()
 
 EMSHAResult
 HMAC::Update(const std::uint8_t *message, std::uint32_t messageLength)
+{
+	EMSHA_PROBE2(hmac__update__start, this, messageLength);
+	EMSHA_STAT_ADD(StatUpdateCalls, 1);
+
+	EMSHAResult const res = this->update(message, messageLength);
+
+	EMSHA_PROBE2(hmac__update__done, this, static_cast<int>(res));
+	return EMSHA_STAT_RESULT(res);
+}
+
+
+EMSHAResult
+HMAC::update(const std::uint8_t *message, std::uint32_t messageLength)
 {
 	EMSHAResult res;
 	SHA256      &hctx = this->ctx;
@@ -156,8 +173,42 @@ HMAC::Update(const std::uint8_t *message, std::uint32_t messageLength)
 }
 
 
+EMSHAResult
+HMAC::CopyAndUpdate(uint8_t *dst, const uint8_t *src, uint32_t length, bool streaming)
+{
+	EMSHAResult res;
+
+	EMSHA_PROBE2(hmac__update__start, this, length);
+	EMSHA_STAT_ADD(StatUpdateCalls, 1);
+
+	if (HMAC_IPAD != this->hstate) {
+		res = EMSHAResult::InvalidState;
+	} else {
+		res = this->ctx.CopyAndUpdate(dst, src, length, streaming);
+		if ((EMSHAResult::OK != res) && (EMSHAResult::NullPointer != res)) {
+			this->hstate = HMAC_INVALID;
+		}
+	}
+
+	EMSHA_PROBE2(hmac__update__done, this, static_cast<int>(res));
+	return EMSHA_STAT_RESULT(res);
+}
+
+
 inline EMSHAResult
 HMAC::finalResult(uint8_t *d)
+{
+	EMSHA_PROBE1(hmac__final__start, this);
+
+	EMSHAResult const res = this->finish(d);
+
+	EMSHA_PROBE2(hmac__final__done, this, static_cast<int>(res));
+	return res;
+}
+
+
+EMSHAResult
+HMAC::finish(uint8_t *d)
 {
 	if (nullptr == d) {
 		return EMSHAResult::NullPointer;
@@ -229,14 +280,38 @@ HMAC::finalResult(uint8_t *d)
 EMSHAResult
 HMAC::Finalise(std::uint8_t *digest)
 {
-	return this->finalResult(digest);
+	EMSHA_STAT_ADD(StatFinaliseCalls, 1);
+	return EMSHA_STAT_RESULT(this->finalResult(digest));
 }
 
 
 EMSHAResult
 HMAC::Result(std::uint8_t *digest)
 {
-	return this->finalResult(digest);
+	return EMSHA_STAT_RESULT(this->finalResult(digest));
+}
+
+
+EMSHAResult
+HMAC::Fork(HMAC& child) const
+{
+	if (&child == this) {
+		return EMSHAResult::OK;
+	}
+
+	this->ctx.Fork(child.ctx);
+	std::copy(this->k, this->k + HMAC_KEY_LENGTH, child.k);
+
+	// The result buffer only holds anything once the HMAC is
+	// finished.
+	if (HMAC_FIN == this->hstate) {
+		std::copy(this->buf, this->buf + SHA256_HASH_SIZE, child.buf);
+	} else {
+		std::fill(child.buf, child.buf + SHA256_HASH_SIZE, 0);
+	}
+	child.hstate = this->hstate;
+
+	return EMSHAResult::OK;
 }
 
 
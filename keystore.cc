@@ -0,0 +1,500 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/compact.h>
+#include <emsha/batch.h>
+#include <emsha/keystore.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// Each entry holds the current key's inner and outer midstates,
+// then the previous key's.
+constexpr uint32_t	currentWords = 0;
+constexpr uint32_t	previousWords = 16;
+constexpr uint32_t	entryWords = 32;
+
+constexpr uint32_t	flagLive = 1;
+constexpr uint32_t	flagPrevious = 2;
+
+constexpr uint32_t	noSlot = UINT32_MAX;
+
+
+// mix spreads key IDs over the table, which matters for IDs that are
+// sequential or share their low bits (the splitmix64 finaliser).
+uint64_t
+mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+
+void
+storeMidstate(std::atomic<uint32_t> *words, const HMACMidstate& key)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		words[i].store(key.inner[i], std::memory_order_relaxed);
+		words[8 + i].store(key.outer[i], std::memory_order_relaxed);
+	}
+}
+
+
+void
+loadMidstate(const std::atomic<uint32_t> *words, HMACMidstate& key)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		key.inner[i] = words[i].load(std::memory_order_relaxed);
+		key.outer[i] = words[8 + i].load(std::memory_order_relaxed);
+	}
+}
+
+
+void
+wipeWords(std::atomic<uint32_t> *words, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		words[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+
+} // anonymous namespace
+
+
+// An entry is only written between two increments of its sequence
+// counter, so the counter is odd while a write is in progress.
+// Everything in it is atomic, so a reader racing a writer reads stale
+// or mixed words rather than undefined ones, and then discards them
+// when it sees the counter has moved.
+struct KeyStore::entry {
+	std::atomic<uint32_t>	seq;
+	std::atomic<uint32_t>	flags;
+	std::atomic<uint64_t>	id;
+	std::atomic<uint32_t>	words[entryWords];
+
+	// Writers hold the store's mutex.
+	void
+	beginWrite()
+	{
+		this->seq.store(this->seq.load(std::memory_order_relaxed) + 1,
+				std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+
+	void
+	endWrite()
+	{
+		this->seq.store(this->seq.load(std::memory_order_relaxed) + 1,
+				std::memory_order_release);
+	}
+};
+
+
+KeyStore::KeyStore(uint32_t cap)
+    : ids(nullptr), entries(nullptr), mask(0),
+      capacity((cap > MAX_CAPACITY) ? 0 : cap), size(0), moves(0)
+{
+	// Keep the table at most half full, so that probe sequences
+	// stay short.
+	uint32_t	slots = 2;
+
+	while (slots < (2 * static_cast<uint64_t>(this->capacity))) {
+		slots <<= 1;
+	}
+	this->mask = slots - 1;
+
+	this->ids = new std::atomic<uint64_t>[slots];
+	this->entries = new entry[slots];
+	for (uint32_t i = 0; i < slots; i++) {
+		this->ids[i].store(NO_KEY_ID, std::memory_order_relaxed);
+		this->entries[i].seq.store(0, std::memory_order_relaxed);
+		this->entries[i].flags.store(0, std::memory_order_relaxed);
+		this->entries[i].id.store(NO_KEY_ID, std::memory_order_relaxed);
+		wipeWords(this->entries[i].words, entryWords);
+	}
+}
+
+
+KeyStore::~KeyStore()
+{
+	for (uint32_t i = 0; i <= this->mask; i++) {
+		wipeWords(this->entries[i].words, entryWords);
+	}
+
+	delete[] this->entries;
+	delete[] this->ids;
+}
+
+
+uint32_t
+KeyStore::home(uint64_t id) const
+{
+	return static_cast<uint32_t>(mix(id)) & this->mask;
+}
+
+
+// find returns the slot holding id, or noSlot.
+uint32_t
+KeyStore::find(uint64_t id) const
+{
+	uint32_t	slot = this->home(id);
+
+	for (uint32_t n = 0; n <= this->mask; n++) {
+		uint64_t const	cur = this->ids[slot].load(std::memory_order_acquire);
+
+		if (cur == id) {
+			return slot;
+		}
+		if (cur == NO_KEY_ID) {
+			break;
+		}
+		slot = (slot + 1) & this->mask;
+	}
+
+	return noSlot;
+}
+
+
+EMSHAResult
+KeyStore::set(uint64_t id, const uint8_t *k, uint32_t kl, bool rotate)
+{
+	HMACMidstate	key;
+	EMSHAResult	res;
+
+	if (id == NO_KEY_ID) {
+		return EMSHAResult::InvalidState;
+	}
+
+	// The key setup doesn't need the lock.
+	res = HMACPrecompute(k, kl, key);
+	if (EMSHAResult::OK != res) {
+		return res;
+	}
+
+	std::lock_guard<std::mutex>	lock(this->writer);
+
+	uint32_t	slot = this->find(id);
+	bool		live = (slot != noSlot) &&
+			       ((this->entries[slot].flags.load(std::memory_order_relaxed) & flagLive) != 0);
+
+	if (!live && (this->size.load(std::memory_order_relaxed) == this->capacity)) {
+		HMACMidstateWipe(key);
+		return EMSHAResult::NoSpace;
+	}
+
+	// A new ID takes the first free slot on its probe sequence;
+	// there is always one, as the table is never more than half
+	// full.
+	if (slot == noSlot) {
+		slot = this->home(id);
+		while (this->ids[slot].load(std::memory_order_relaxed) != NO_KEY_ID) {
+			slot = (slot + 1) & this->mask;
+		}
+	}
+
+	entry&	e = this->entries[slot];
+
+	e.beginWrite();
+	e.id.store(id, std::memory_order_relaxed);
+	if (rotate && live) {
+		for (uint32_t i = 0; i < 16; i++) {
+			e.words[previousWords + i].store(
+			    e.words[currentWords + i].load(std::memory_order_relaxed),
+			    std::memory_order_relaxed);
+		}
+		e.flags.store(flagLive | flagPrevious, std::memory_order_relaxed);
+	} else {
+		wipeWords(e.words + previousWords, 16);
+		e.flags.store(flagLive, std::memory_order_relaxed);
+	}
+	storeMidstate(e.words + currentWords, key);
+	e.endWrite();
+
+	// Publishing the ID after the entry is complete means that a
+	// reader that finds it also finds the entry written.
+	this->ids[slot].store(id, std::memory_order_release);
+	if (!live) {
+		this->size.fetch_add(1);
+	}
+
+	HMACMidstateWipe(key);
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+KeyStore::Add(uint64_t id, const uint8_t *k, uint32_t kl)
+{
+	return this->set(id, k, kl, false);
+}
+
+
+EMSHAResult
+KeyStore::Rotate(uint64_t id, const uint8_t *k, uint32_t kl)
+{
+	return this->set(id, k, kl, true);
+}
+
+
+bool
+KeyStore::Retire(uint64_t id)
+{
+	std::lock_guard<std::mutex>	lock(this->writer);
+
+	uint32_t const	slot = this->find(id);
+	if (slot == noSlot) {
+		return false;
+	}
+
+	entry&		e = this->entries[slot];
+	uint32_t const	flags = e.flags.load(std::memory_order_relaxed);
+	if ((flags & flagPrevious) == 0) {
+		return false;
+	}
+
+	e.beginWrite();
+	e.flags.store(flags & ~flagPrevious, std::memory_order_relaxed);
+	wipeWords(e.words + previousWords, 16);
+	e.endWrite();
+	return true;
+}
+
+
+// copyEntry copies the entry in one slot to another, then publishes
+// its ID there, so that for a moment it is in both.
+void
+KeyStore::copyEntry(uint32_t from, uint32_t to)
+{
+	entry&	src = this->entries[from];
+	entry&	dst = this->entries[to];
+
+	dst.beginWrite();
+	dst.flags.store(src.flags.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	dst.id.store(src.id.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	for (uint32_t i = 0; i < entryWords; i++) {
+		dst.words[i].store(src.words[i].load(std::memory_order_relaxed),
+				   std::memory_order_relaxed);
+	}
+	dst.endWrite();
+
+	this->ids[to].store(this->ids[from].load(std::memory_order_relaxed),
+			    std::memory_order_release);
+}
+
+
+bool
+KeyStore::Remove(uint64_t id)
+{
+	std::lock_guard<std::mutex>	lock(this->writer);
+
+	uint32_t	hole = this->find(id);
+	if (hole == noSlot) {
+		return false;
+	}
+
+	this->moves.store(this->moves.load(std::memory_order_relaxed) + 1,
+			  std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	entry&	e = this->entries[hole];
+	e.beginWrite();
+	e.flags.store(0, std::memory_order_relaxed);
+	e.id.store(NO_KEY_ID, std::memory_order_relaxed);
+	wipeWords(e.words, entryWords);
+	e.endWrite();
+
+	// Close the gap: walk the rest of the cluster, moving back each
+	// entry whose home slot doesn't lie between the hole and it,
+	// as its probe sequence would otherwise stop at the hole.
+	for (uint32_t slot = (hole + 1) & this->mask;; slot = (slot + 1) & this->mask) {
+		uint64_t const	cur = this->ids[slot].load(std::memory_order_relaxed);
+
+		if (cur == NO_KEY_ID) {
+			break;
+		}
+
+		uint32_t const	fromHome = (slot - this->home(cur)) & this->mask;
+		uint32_t const	fromHole = (slot - hole) & this->mask;
+
+		if (fromHome >= fromHole) {
+			this->copyEntry(slot, hole);
+			hole = slot;
+		}
+	}
+
+	entry&	last = this->entries[hole];
+	this->ids[hole].store(NO_KEY_ID, std::memory_order_release);
+	last.beginWrite();
+	last.flags.store(0, std::memory_order_relaxed);
+	last.id.store(NO_KEY_ID, std::memory_order_relaxed);
+	wipeWords(last.words, entryWords);
+	last.endWrite();
+
+	this->moves.store(this->moves.load(std::memory_order_relaxed) + 1,
+			  std::memory_order_release);
+	this->size.fetch_sub(1);
+	return true;
+}
+
+
+bool
+KeyStore::Lookup(uint64_t id, HMACMidstate& key) const
+{
+	HMACMidstate	previous;
+	bool		hasPrevious;
+	bool const	found = this->Lookup(id, key, previous, hasPrevious);
+
+	HMACMidstateWipe(previous);
+	return found;
+}
+
+
+bool
+KeyStore::Lookup(uint64_t id, HMACMidstate& current, HMACMidstate& previous,
+		 bool& hasPrevious) const
+{
+	uint32_t	flags = 0;
+	uint64_t	entryID = NO_KEY_ID;
+	uint32_t	moved;
+
+	// Retry if a Remove moved entries while the probe ran, as the
+	// entry might have moved to a slot the probe had passed.
+	do {
+		moved = this->moves.load(std::memory_order_acquire);
+		if (moved & 1) {
+			continue;
+		}
+
+		uint32_t const	slot = this->find(id);
+		if (slot == noSlot) {
+			entryID = NO_KEY_ID;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			continue;
+		}
+
+		const entry&	e = this->entries[slot];
+		uint32_t	before;
+
+		do {
+			before = e.seq.load(std::memory_order_acquire);
+			if (before & 1) {
+				continue;
+			}
+
+			flags   = e.flags.load(std::memory_order_relaxed);
+			entryID = e.id.load(std::memory_order_relaxed);
+			loadMidstate(e.words + currentWords, current);
+			loadMidstate(e.words + previousWords, previous);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+		} while ((before & 1) || (before != e.seq.load(std::memory_order_relaxed)));
+	} while ((moved & 1) || (moved != this->moves.load(std::memory_order_relaxed)));
+
+	// The slot may have been given to another ID since the probe
+	// found it, which can only happen once this ID was removed.
+	if ((entryID != id) || ((flags & flagLive) == 0)) {
+		HMACMidstateWipe(current);
+		HMACMidstateWipe(previous);
+		return false;
+	}
+
+	hasPrevious = (flags & flagPrevious) != 0;
+	return true;
+}
+
+
+uint32_t
+KeyStore::Probes(uint64_t id) const
+{
+	uint32_t	slot = this->home(id);
+	uint32_t	n = 1;
+
+	for (; n <= this->mask; n++) {
+		uint64_t const	cur = this->ids[slot].load(std::memory_order_acquire);
+
+		if ((cur == id) || (cur == NO_KEY_ID)) {
+			break;
+		}
+		slot = (slot + 1) & this->mask;
+	}
+
+	return n;
+}
+
+
+EMSHAResult
+KeyStore::Verify(uint64_t id, const uint8_t *m, uint32_t ml, const uint8_t *tag,
+		 uint32_t tl) const
+{
+	HMACMidstate	current;
+	HMACMidstate	previous;
+	bool		hasPrevious = false;
+	uint8_t		digest[SHA256_HASH_SIZE];
+
+	if (((m == nullptr) && (ml != 0)) || (tag == nullptr)) {
+		return EMSHAResult::NullPointer;
+	}
+	if ((tl < HMAC_MIN_TAG_LENGTH) || (tl > SHA256_HASH_SIZE)) {
+		return EMSHAResult::VerifyFailed;
+	}
+	if (!this->Lookup(id, current, previous, hasPrevious)) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	// Both keys are always tried, so the time taken doesn't show
+	// which of them matched.
+	ComputeHMAC(current, m, ml, digest);
+	bool const	matchCurrent = ConstantTimeEqual(digest, tag, tl);
+
+	ComputeHMAC(previous, m, ml, digest);
+	bool const	matchPrevious = ConstantTimeEqual(digest, tag, tl);
+
+	HMACMidstateWipe(current);
+	HMACMidstateWipe(previous);
+	std::fill(digest, digest + SHA256_HASH_SIZE, 0);
+
+	if (matchCurrent || (hasPrevious && matchPrevious)) {
+		return EMSHAResult::OK;
+	}
+	return EMSHAResult::VerifyFailed;
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,510 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/lms.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+// Hash and identifier sizes; only the 32-byte SHA-256 parameter sets
+// are supported.
+constexpr uint32_t	lmsN = SHA256_HASH_SIZE;
+constexpr uint32_t	lmsIDSize = 16;
+
+// Domain separation values from RFC 8554 section 3.
+constexpr uint16_t	dPBLC = 0x8080;
+constexpr uint16_t	dMESG = 0x8181;
+constexpr uint16_t	dLEAF = 0x8282;
+constexpr uint16_t	dINTR = 0x8383;
+
+// Byte offsets into a one-block Winternitz chain step, which hashes
+// I || u32str(q) || u16str(i) || u8str(j) || tmp: 55 bytes, which
+// leaves exactly enough room for the padding.
+constexpr uint32_t	chainIndex = lmsIDSize + 4;
+constexpr uint32_t	chainStep = chainIndex + 2;
+constexpr uint32_t	chainValue = chainStep + 1;
+constexpr uint32_t	chainLength = chainValue + lmsN;
+
+
+struct otsParams {
+	uint32_t	type;
+	uint32_t	w;	// Winternitz parameter, in bits.
+	uint32_t	p;	// Number of chains.
+	uint32_t	ls;	// Left shift for the checksum.
+};
+
+
+const otsParams	otsTypes[] = {
+	{1, 1, 265, 7},		// LMOTS_SHA256_N32_W1
+	{2, 2, 133, 6},		// LMOTS_SHA256_N32_W2
+	{3, 4,  67, 4},		// LMOTS_SHA256_N32_W4
+	{4, 8,  34, 0},		// LMOTS_SHA256_N32_W8
+};
+
+
+// The LMS_SHA256_M32 types run from H5 (type 5) to H25 (type 9).
+constexpr uint32_t	lmsTypeFirst = 5;
+constexpr uint32_t	lmsTypeLast = 9;
+
+
+uint32_t
+readU32(const uint8_t *p)
+{
+	return (static_cast<uint32_t>(p[0]) << 24) |
+	       (static_cast<uint32_t>(p[1]) << 16) |
+	       (static_cast<uint32_t>(p[2]) << 8) |
+	       static_cast<uint32_t>(p[3]);
+}
+
+
+void
+writeU32(uint8_t *p, uint32_t v)
+{
+	p[0] = static_cast<uint8_t>(v >> 24);
+	p[1] = static_cast<uint8_t>(v >> 16);
+	p[2] = static_cast<uint8_t>(v >> 8);
+	p[3] = static_cast<uint8_t>(v);
+}
+
+
+void
+writeU16(uint8_t *p, uint16_t v)
+{
+	p[0] = static_cast<uint8_t>(v >> 8);
+	p[1] = static_cast<uint8_t>(v);
+}
+
+
+const otsParams *
+lookupOTS(uint32_t type)
+{
+	for (const auto& params : otsTypes) {
+		if (params.type == type) {
+			return &params;
+		}
+	}
+	return nullptr;
+}
+
+
+uint32_t
+lookupHeight(uint32_t type)
+{
+	if ((type < lmsTypeFirst) || (type > lmsTypeLast)) {
+		return 0;
+	}
+	return 5 * (type - lmsTypeFirst + 1);
+}
+
+
+std::size_t
+otsSignatureLength(const otsParams& params)
+{
+	return 4 + (static_cast<std::size_t>(lmsN) * (params.p + 1));
+}
+
+
+// coef returns the i'th w-bit coefficient of S, as in RFC 8554
+// section 3.1.3.
+uint32_t
+coef(const uint8_t *S, uint32_t i, uint32_t w)
+{
+	uint32_t const	mask = (1U << w) - 1;
+	uint32_t const	shift = 8 - ((w * (i % (8 / w))) + w);
+
+	return (S[(i * w) / 8] >> shift) & mask;
+}
+
+
+// hashLong runs a message of any size_t length through a context,
+// which only takes 32-bit lengths.
+void
+hashLong(SHA256& ctx, const uint8_t *m, std::size_t ml)
+{
+	while (ml > 0) {
+		uint32_t const	n = static_cast<uint32_t>(std::min<std::size_t>(ml, 0x40000000));
+
+		ctx.Update(m, n);
+		m  += n;
+		ml -= n;
+	}
+}
+
+
+// hashBlock hashes a message of at most 55 bytes that has already been
+// laid out, padding included, in a single block.
+void
+hashBlock(const uint8_t *block, uint8_t *digest)
+{
+	uint32_t	ih[8];
+
+	sha256_init(ih);
+	sha256_compress(ih, block, 1);
+	sha256_store(ih, digest);
+}
+
+
+// padBlocks writes the SHA-256 padding for a length-byte message laid
+// out in a buffer of whole blocks ending at end.
+void
+padBlocks(uint8_t *block, uint32_t length, uint8_t *end)
+{
+	uint64_t const	bits = static_cast<uint64_t>(length) << 3;
+
+	block[length] = 0x80;
+	for (uint32_t i = 0; i < 8; i++) {
+		end[-1 - static_cast<int>(i)] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+}
+
+
+// advanceChains runs each of the p Winternitz chains in z from step
+// start[i] up to 2^w - 1, in place. The chains are independent, so
+// they are spread over the lanes of the multi-lane kernel: each lane
+// works through one chain, and picks up the next waiting chain as
+// soon as its own is finished, keeping the lanes full despite the
+// chains being of different lengths. The active lanes are always the
+// first few, so a lane that runs out of work swaps with the last.
+void
+advanceChains(const uint8_t *I, const uint8_t *q, const otsParams& params,
+	      const uint8_t *start, uint8_t *z)
+{
+	uint8_t		blocks[SHA256_LANES][SHA256_MB_SIZE] = {{0}};
+	const uint8_t	*ptrs[SHA256_LANES];
+	uint32_t	ih[SHA256_LANES][8];
+	uint32_t	chain[SHA256_LANES];
+	uint32_t const	last = (1U << params.w) - 1;
+	uint32_t	next = 0;
+	uint32_t	active = 0;
+
+	for (uint32_t l = 0; l < SHA256_LANES; l++) {
+		std::copy(I, I + lmsIDSize, blocks[l]);
+		std::copy(q, q + 4, blocks[l] + lmsIDSize);
+		padBlocks(blocks[l], chainLength, blocks[l] + SHA256_MB_SIZE);
+		ptrs[l] = blocks[l];
+	}
+
+	// load starts the next chain that has any steps left in lane
+	// l, returning false if there are none.
+	auto load = [&](uint32_t l) {
+		while ((next < params.p) && (start[next] == last)) {
+			next++;
+		}
+		if (next == params.p) {
+			return false;
+		}
+
+		chain[l] = next;
+		writeU16(blocks[l] + chainIndex, static_cast<uint16_t>(next));
+		blocks[l][chainStep] = start[next];
+		std::copy(z + (next * lmsN), z + ((next + 1) * lmsN),
+			  blocks[l] + chainValue);
+		next++;
+		return true;
+	};
+
+	while ((active < SHA256_LANES) && load(active)) {
+		active++;
+	}
+
+	while (active > 0) {
+		for (uint32_t l = 0; l < active; l++) {
+			sha256_init(ih[l]);
+		}
+		sha256_compress_lanes(ih, ptrs, active);
+
+		uint32_t	l = 0;
+		while (l < active) {
+			sha256_store(ih[l], blocks[l] + chainValue);
+			if (++blocks[l][chainStep] < last) {
+				l++;
+				continue;
+			}
+
+			uint8_t	*out = z + (chain[l] * lmsN);
+			std::copy(blocks[l] + chainValue,
+				  blocks[l] + chainValue + lmsN, out);
+			if (load(l)) {
+				l++;
+				continue;
+			}
+
+			// Nothing left to start: move the last active lane
+			// down into this one. Its result hasn't been
+			// stored yet, so it's handled on this pass too.
+			active--;
+			if (l != active) {
+				std::copy(blocks[active], blocks[active] + SHA256_MB_SIZE,
+					  blocks[l]);
+				std::copy(ih[active], ih[active] + 8, ih[l]);
+				chain[l] = chain[active];
+			}
+		}
+	}
+}
+
+
+// otsCandidate computes the candidate LM-OTS public key Kc from a
+// signature (RFC 8554 algorithm 4b). The signature's length and type
+// have already been checked.
+void
+otsCandidate(const otsParams& params, const uint8_t *I, const uint8_t *q,
+	     const uint8_t *message, std::size_t messageLength,
+	     const uint8_t *sig, uint8_t *Kc)
+{
+	uint8_t		prefix[lmsIDSize + 4 + 2];
+	uint8_t		Q[lmsN + 2];
+	uint8_t		start[265];
+	uint8_t		z[265 * lmsN];
+	const uint8_t	*C = sig + 4;
+	const uint8_t	*y = C + lmsN;
+	SHA256		ctx;
+
+	std::copy(I, I + lmsIDSize, prefix);
+	std::copy(q, q + 4, prefix + lmsIDSize);
+
+	writeU16(prefix + lmsIDSize + 4, dMESG);
+	ctx.Update(prefix, sizeof(prefix));
+	ctx.Update(C, lmsN);
+	hashLong(ctx, message, messageLength);
+	ctx.Finalise(Q);
+
+	uint32_t const	u = (8 * lmsN) / params.w;
+	uint32_t const	max = (1U << params.w) - 1;
+	uint32_t	sum = 0;
+
+	for (uint32_t i = 0; i < u; i++) {
+		sum += max - coef(Q, i, params.w);
+	}
+	writeU16(Q + lmsN, static_cast<uint16_t>(sum << params.ls));
+
+	for (uint32_t i = 0; i < params.p; i++) {
+		start[i] = static_cast<uint8_t>(coef(Q, i, params.w));
+	}
+
+	std::copy(y, y + (params.p * lmsN), z);
+	advanceChains(I, q, params, start, z);
+
+	ctx.Reset();
+	writeU16(prefix + lmsIDSize + 4, dPBLC);
+	ctx.Update(prefix, sizeof(prefix));
+	ctx.Update(z, params.p * lmsN);
+	ctx.Finalise(Kc);
+}
+
+
+// lmsVerify checks an LMS signature (RFC 8554 algorithm 6a). The
+// public key has already been checked for length.
+EMSHAResult
+lmsVerify(const uint8_t *pub, const uint8_t *message, std::size_t messageLength,
+	  const uint8_t *sig, std::size_t sigLength)
+{
+	uint8_t		leaf[SHA256_MB_SIZE] = {0};
+	uint8_t		node[2 * SHA256_MB_SIZE] = {0};
+	uint8_t		tmp[lmsN];
+	uint32_t	ih[8];
+
+	uint32_t const	 height = lookupHeight(readU32(pub));
+	const otsParams	*params = lookupOTS(readU32(pub + 4));
+	const uint8_t	*I = pub + 8;
+	const uint8_t	*T1 = I + lmsIDSize;
+
+	if ((height == 0) || (params == nullptr)) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	std::size_t const otsLength = otsSignatureLength(*params);
+	if (sigLength != (4 + otsLength + 4 + (static_cast<std::size_t>(lmsN) * height))) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	uint32_t const	q = readU32(sig);
+	const uint8_t	*ots = sig + 4;
+	const uint8_t	*path = ots + otsLength + 4;
+
+	if ((readU32(ots) != params->type) ||
+	    (readU32(ots + otsLength) != readU32(pub)) ||
+	    (q >= (1U << height))) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	// The candidate OTS public key is hashed straight into the
+	// leaf block.
+	std::copy(I, I + lmsIDSize, leaf);
+	uint32_t	nodeNum = (1U << height) + q;
+	writeU32(leaf + lmsIDSize, nodeNum);
+	writeU16(leaf + lmsIDSize + 4, dLEAF);
+	otsCandidate(*params, I, sig, message, messageLength, ots,
+		     leaf + lmsIDSize + 6);
+	padBlocks(leaf, lmsIDSize + 6 + lmsN, leaf + SHA256_MB_SIZE);
+	hashBlock(leaf, tmp);
+
+	// Interior nodes are I || u32str(r) || u16str(D_INTR) || left ||
+	// right, 86 bytes in two blocks.
+	uint8_t *const	left = node + lmsIDSize + 6;
+	uint8_t *const	right = left + lmsN;
+
+	std::copy(I, I + lmsIDSize, node);
+	writeU16(node + lmsIDSize + 4, dINTR);
+	padBlocks(node, lmsIDSize + 6 + (2 * lmsN), node + sizeof(node));
+
+	for (uint32_t i = 0; nodeNum > 1; i++, nodeNum >>= 1) {
+		const uint8_t	*sibling = path + (i * lmsN);
+
+		writeU32(node + lmsIDSize, nodeNum >> 1);
+		if (nodeNum & 1) {
+			std::copy(sibling, sibling + lmsN, left);
+			std::copy(tmp, tmp + lmsN, right);
+		} else {
+			std::copy(tmp, tmp + lmsN, left);
+			std::copy(sibling, sibling + lmsN, right);
+		}
+
+		sha256_init(ih);
+		sha256_compress(ih, node, 2);
+		sha256_store(ih, tmp);
+	}
+
+	if (!HashEqual(tmp, T1)) {
+		return EMSHAResult::VerifyFailed;
+	}
+	return EMSHAResult::OK;
+}
+
+
+// lmsSignatureLength returns the length of the LMS signature at the
+// start of sig, or zero if it can't be an LMS signature.
+std::size_t
+lmsSignatureLength(const uint8_t *sig, std::size_t available)
+{
+	if (available < 8) {
+		return 0;
+	}
+
+	const otsParams	*params = lookupOTS(readU32(sig + 4));
+	if (params == nullptr) {
+		return 0;
+	}
+
+	std::size_t const	typeOffset = 4 + otsSignatureLength(*params);
+	if (available < (typeOffset + 4)) {
+		return 0;
+	}
+
+	uint32_t const	height = lookupHeight(readU32(sig + typeOffset));
+	if (height == 0) {
+		return 0;
+	}
+
+	std::size_t const	length = typeOffset + 4 + (static_cast<std::size_t>(lmsN) * height);
+	return (length <= available) ? length : 0;
+}
+
+
+} // anonymous namespace
+
+
+EMSHAResult
+LMSVerify(const uint8_t *publicKey, std::size_t publicKeyLength,
+	  const uint8_t *message, std::size_t messageLength,
+	  const uint8_t *signature, std::size_t signatureLength)
+{
+	if ((publicKey == nullptr) || (signature == nullptr)) {
+		return EMSHAResult::NullPointer;
+	}
+	if ((message == nullptr) && (messageLength != 0)) {
+		return EMSHAResult::NullPointer;
+	}
+
+	if (publicKeyLength != LMS_PUBLIC_KEY_SIZE) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	return lmsVerify(publicKey, message, messageLength, signature, signatureLength);
+}
+
+
+EMSHAResult
+HSSVerify(const uint8_t *publicKey, std::size_t publicKeyLength,
+	  const uint8_t *message, std::size_t messageLength,
+	  const uint8_t *signature, std::size_t signatureLength)
+{
+	if ((publicKey == nullptr) || (signature == nullptr)) {
+		return EMSHAResult::NullPointer;
+	}
+	if ((message == nullptr) && (messageLength != 0)) {
+		return EMSHAResult::NullPointer;
+	}
+
+	// RFC 8554 allows from one to eight levels.
+	if ((publicKeyLength != (4 + LMS_PUBLIC_KEY_SIZE)) || (signatureLength < 4)) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	uint32_t const	levels = readU32(publicKey);
+	if ((levels < 1) || (levels > 8) || (readU32(signature) != (levels - 1))) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	const uint8_t	*key = publicKey + 4;
+	const uint8_t	*sig = signature + 4;
+	std::size_t	 rest = signatureLength - 4;
+
+	// Each level above the bottom signs the public key of the level
+	// below it, which follows its signature.
+	for (uint32_t i = 0; i + 1 < levels; i++) {
+		std::size_t const	sigLength = lmsSignatureLength(sig, rest);
+
+		if ((sigLength == 0) || ((rest - sigLength) < LMS_PUBLIC_KEY_SIZE)) {
+			return EMSHAResult::VerifyFailed;
+		}
+
+		const uint8_t	*next = sig + sigLength;
+		if (EMSHAResult::OK != lmsVerify(key, next, LMS_PUBLIC_KEY_SIZE,
+						 sig, sigLength)) {
+			return EMSHAResult::VerifyFailed;
+		}
+
+		key   = next;
+		sig   = next + LMS_PUBLIC_KEY_SIZE;
+		rest -= sigLength + LMS_PUBLIC_KEY_SIZE;
+	}
+
+	return lmsVerify(key, message, messageLength, sig, rest);
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,509 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/merkle.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+constexpr uint8_t	leafPrefix = 0x00;
+constexpr uint8_t	nodePrefix = 0x01;
+
+
+// largestPowerOfTwoBelow returns the largest power of two strictly
+// less than n, for n > 1.
+uint64_t
+largestPowerOfTwoBelow(uint64_t n)
+{
+	uint64_t	k = 1;
+
+	while ((k << 1) < n) {
+		k <<= 1;
+	}
+	return k;
+}
+
+
+// subtreeRoot computes the root of the leaves in [lo, hi).
+void
+subtreeRoot(const uint8_t *leaves, uint64_t lo, uint64_t hi, std::vector<uint8_t>& out)
+{
+	uint8_t	root[SHA256_HASH_SIZE];
+
+	MerkleRoot(leaves + (lo * SHA256_HASH_SIZE), hi - lo, root);
+	out.insert(out.end(), root, root + SHA256_HASH_SIZE);
+}
+
+
+// inclusionPath is PATH(m, D[lo:hi]) from RFC 9162, section 2.1.3.1.
+void
+inclusionPath(const uint8_t *leaves, uint64_t m, uint64_t lo, uint64_t hi,
+	      std::vector<uint8_t>& proof)
+{
+	if ((hi - lo) <= 1) {
+		return;
+	}
+
+	uint64_t const k = largestPowerOfTwoBelow(hi - lo);
+	if (m < k) {
+		inclusionPath(leaves, m, lo, lo + k, proof);
+		subtreeRoot(leaves, lo + k, hi, proof);
+	} else {
+		inclusionPath(leaves, m - k, lo + k, hi, proof);
+		subtreeRoot(leaves, lo, lo + k, proof);
+	}
+}
+
+
+// consistencyPath is SUBPROOF(m, D[lo:hi], b) from RFC 9162, section
+// 2.1.4.1.
+void
+consistencyPath(const uint8_t *leaves, uint64_t m, uint64_t lo, uint64_t hi,
+		bool b, std::vector<uint8_t>& proof)
+{
+	uint64_t const n = hi - lo;
+
+	if (m == n) {
+		if (!b) {
+			subtreeRoot(leaves, lo, hi, proof);
+		}
+		return;
+	}
+
+	uint64_t const k = largestPowerOfTwoBelow(n);
+	if (m <= k) {
+		consistencyPath(leaves, m, lo, lo + k, b, proof);
+		subtreeRoot(leaves, lo + k, hi, proof);
+	} else {
+		consistencyPath(leaves, m - k, lo + k, hi, false, proof);
+		subtreeRoot(leaves, lo, lo + k, proof);
+	}
+}
+
+
+// A walk is one inclusion proof in a batch, partway to the root.
+// fn and sn are as in RFC 9162, section 2.1.3.2; level counts the
+// right shifts applied so far, which together with fn names the node
+// the walk has reached.
+struct walk {
+	uint64_t	fn;
+	uint64_t	sn;
+	uint32_t	level;
+	std::size_t	next;
+	uint8_t		r[SHA256_HASH_SIZE];
+	struct node	*pending;
+};
+
+
+// A node is one interior node hash needed in a batch.
+struct node {
+	uint8_t	left[SHA256_HASH_SIZE];
+	uint8_t	right[SHA256_HASH_SIZE];
+	uint8_t	hash[SHA256_HASH_SIZE];
+};
+
+
+struct nodeKey {
+	uint64_t	fn;
+	uint32_t	level;
+
+	bool operator==(const nodeKey& other) const
+	{
+		return (this->fn == other.fn) && (this->level == other.level);
+	}
+};
+
+
+struct nodeKeyHash {
+	std::size_t operator()(const nodeKey& k) const
+	{
+		return static_cast<std::size_t>(k.fn * 0x9e3779b97f4a7c15ULL) ^ k.level;
+	}
+};
+
+
+// hashNodes runs the node hashes through the multi-lane kernel.
+void
+hashNodes(std::vector<node *>& nodes)
+{
+	std::vector<const uint8_t *>	lefts(nodes.size());
+	std::vector<const uint8_t *>	rights(nodes.size());
+	std::vector<uint8_t *>		hashes(nodes.size());
+
+	for (std::size_t i = 0; i < nodes.size(); i++) {
+		lefts[i]  = nodes[i]->left;
+		rights[i] = nodes[i]->right;
+		hashes[i] = nodes[i]->hash;
+	}
+
+	sha256_node_lanes(nodes.size(), nodePrefix, lefts.data(), rights.data(), hashes.data());
+}
+
+
+} // anonymous namespace
+
+
+EMSHAResult
+MerkleLeafHash(const uint8_t *data, uint32_t length, uint8_t *hash)
+{
+	SHA256		ctx;
+	EMSHAResult	res;
+
+	if ((nullptr == data) && (length != 0)) { return EMSHAResult::NullPointer; }
+	if (nullptr == hash) { return EMSHAResult::NullPointer; }
+
+	res = ctx.Update(&leafPrefix, 1);
+	if (EMSHAResult::OK == res) {
+		res = ctx.Update(data, length);
+	}
+	if (EMSHAResult::OK == res) {
+		res = ctx.Finalise(hash);
+	}
+
+	return res;
+}
+
+
+EMSHAResult
+MerkleRoot(const uint8_t *leaves, uint64_t size, uint8_t *root)
+{
+	if ((nullptr == leaves) && (size != 0)) { return EMSHAResult::NullPointer; }
+	if (nullptr == root) { return EMSHAResult::NullPointer; }
+
+	if (size == 0) {
+		return SHA256Digest(nullptr, 0, root);
+	}
+
+	// Pairing up each level and carrying an odd node up unchanged
+	// gives the same tree as RFC 9162's recursive split. Each level
+	// is written over the start of the one below it; node i only
+	// reads nodes 2i and 2i + 1, and the multi-lane kernel reads all
+	// of its inputs before writing any output.
+	std::vector<uint8_t>		level(leaves, leaves + (size * SHA256_HASH_SIZE));
+	std::vector<const uint8_t *>	lefts;
+	std::vector<const uint8_t *>	rights;
+	std::vector<uint8_t *>		hashes;
+	uint64_t			n = size;
+
+	while (n > 1) {
+		uint64_t const	pairs = n / 2;
+		uint8_t		*base = level.data();
+
+		lefts.resize(pairs);
+		rights.resize(pairs);
+		hashes.resize(pairs);
+		for (uint64_t i = 0; i < pairs; i++) {
+			lefts[i]  = base + ((2 * i) * SHA256_HASH_SIZE);
+			rights[i] = base + (((2 * i) + 1) * SHA256_HASH_SIZE);
+			hashes[i] = base + (i * SHA256_HASH_SIZE);
+		}
+
+		// Within a group of lanes the outputs can overlap the
+		// inputs of the same group, so hash one group at a time.
+		for (uint64_t i = 0; i < pairs; i += SHA256_LANES) {
+			std::size_t const lanes = std::min<uint64_t>(SHA256_LANES, pairs - i);
+			sha256_node_lanes(lanes, nodePrefix, lefts.data() + i,
+					  rights.data() + i, hashes.data() + i);
+		}
+
+		if ((n % 2) != 0) {
+			std::copy(base + ((n - 1) * SHA256_HASH_SIZE), base + (n * SHA256_HASH_SIZE),
+				  base + (pairs * SHA256_HASH_SIZE));
+		}
+		n = pairs + (n % 2);
+	}
+
+	std::copy(level.begin(), level.begin() + SHA256_HASH_SIZE, root);
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+MerkleInclusionProof(const uint8_t *leaves, uint64_t size, uint64_t index,
+		     std::vector<uint8_t>& proof)
+{
+	if (nullptr == leaves) { return EMSHAResult::NullPointer; }
+	if (index >= size) { return EMSHAResult::InvalidState; }
+
+	proof.clear();
+	inclusionPath(leaves, index, 0, size, proof);
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+MerkleConsistencyProof(const uint8_t *leaves, uint64_t size, uint64_t oldSize,
+		       std::vector<uint8_t>& proof)
+{
+	if (nullptr == leaves) { return EMSHAResult::NullPointer; }
+	if ((oldSize == 0) || (oldSize > size)) { return EMSHAResult::InvalidState; }
+
+	proof.clear();
+	consistencyPath(leaves, oldSize, 0, size, true, proof);
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+MerkleVerifyInclusion(const uint8_t *leafHash, uint64_t index, uint64_t size,
+		      const uint8_t *proof, std::size_t proofLength, const uint8_t *root)
+{
+	MerkleInclusion const	p = {leafHash, index, proof, proofLength};
+	EMSHAResult		res;
+
+	if (nullptr == root) { return EMSHAResult::NullPointer; }
+
+	MerkleVerifyInclusionBatch(size, root, &p, 1, &res);
+	return res;
+}
+
+
+EMSHAResult
+MerkleVerifyConsistency(uint64_t oldSize, uint64_t size, const uint8_t *oldRoot,
+			const uint8_t *root, const uint8_t *proof, std::size_t proofLength)
+{
+	if ((nullptr == oldRoot) || (nullptr == root)) { return EMSHAResult::NullPointer; }
+	if ((nullptr == proof) && (proofLength != 0)) { return EMSHAResult::NullPointer; }
+
+	if ((oldSize == 0) || (oldSize > size) || ((proofLength % SHA256_HASH_SIZE) != 0)) {
+		return EMSHAResult::VerifyFailed;
+	}
+
+	if (oldSize == size) {
+		if ((proofLength == 0) && HashEqual(oldRoot, root)) {
+			return EMSHAResult::OK;
+		}
+		return EMSHAResult::VerifyFailed;
+	}
+
+	// This follows RFC 9162, section 2.1.4.2. If the old tree is a
+	// complete subtree of the new one, its root is the implied
+	// first entry of the proof.
+	std::size_t const	count = proofLength / SHA256_HASH_SIZE;
+	bool const		implied = (oldSize & (oldSize - 1)) == 0;
+	std::size_t		next = 0;
+	uint8_t			fr[SHA256_HASH_SIZE];
+	uint8_t			sr[SHA256_HASH_SIZE];
+
+	if (implied) {
+		std::copy(oldRoot, oldRoot + SHA256_HASH_SIZE, fr);
+	} else if (count == 0) {
+		return EMSHAResult::VerifyFailed;
+	} else {
+		std::copy(proof, proof + SHA256_HASH_SIZE, fr);
+		next = 1;
+	}
+	std::copy(fr, fr + SHA256_HASH_SIZE, sr);
+
+	uint64_t	fn = oldSize - 1;
+	uint64_t	sn = size - 1;
+
+	while ((fn & 1) != 0) {
+		fn >>= 1;
+		sn >>= 1;
+	}
+
+	for (; next < count; next++) {
+		const uint8_t *c = proof + (next * SHA256_HASH_SIZE);
+
+		if (sn == 0) {
+			return EMSHAResult::VerifyFailed;
+		}
+
+		if (((fn & 1) != 0) || (fn == sn)) {
+			sha256_node(nodePrefix, c, fr, fr);
+			sha256_node(nodePrefix, c, sr, sr);
+			while (((fn & 1) == 0) && (fn != 0)) {
+				fn >>= 1;
+				sn >>= 1;
+			}
+		} else {
+			sha256_node(nodePrefix, sr, c, sr);
+		}
+
+		fn >>= 1;
+		sn >>= 1;
+	}
+
+	if ((sn == 0) && HashEqual(fr, oldRoot) && HashEqual(sr, root)) {
+		return EMSHAResult::OK;
+	}
+	return EMSHAResult::VerifyFailed;
+}
+
+
+EMSHAResult
+MerkleVerifyInclusionBatch(uint64_t size, const uint8_t *root, const MerkleInclusion *proofs,
+			   std::size_t count, EMSHAResult *results)
+{
+	if ((nullptr == root) || ((nullptr == proofs) && (count != 0))) {
+		return EMSHAResult::NullPointer;
+	}
+
+	std::vector<EMSHAResult>	res(count, EMSHAResult::OK);
+	std::vector<walk>		walks(count);
+	std::vector<std::size_t>	active;
+
+	for (std::size_t i = 0; i < count; i++) {
+		const MerkleInclusion&	p = proofs[i];
+		walk&			w = walks[i];
+
+		if ((nullptr == p.leafHash) || ((nullptr == p.proof) && (p.proofLength != 0))) {
+			res[i] = EMSHAResult::NullPointer;
+			continue;
+		}
+
+		if ((p.index >= size) || ((p.proofLength % SHA256_HASH_SIZE) != 0)) {
+			res[i] = EMSHAResult::VerifyFailed;
+			continue;
+		}
+
+		w.fn      = p.index;
+		w.sn      = size - 1;
+		w.level   = 0;
+		w.next    = 0;
+		w.pending = nullptr;
+		std::copy(p.leafHash, p.leafHash + SHA256_HASH_SIZE, w.r);
+
+		// Only a single-leaf tree has an empty proof.
+		if (p.proofLength == 0) {
+			if ((w.sn != 0) || !HashEqual(w.r, root)) {
+				res[i] = EMSHAResult::VerifyFailed;
+			}
+			continue;
+		}
+		active.push_back(i);
+	}
+
+	// Every node hashed in the batch, by position in the tree. A
+	// walk reuses a node only if it reaches it from the same two
+	// children; a walk with different inputs (a bad proof, or a
+	// different leaf at the same index) gets a node of its own.
+	std::unordered_map<nodeKey, node, nodeKeyHash>	known;
+	std::deque<node>				unshared;
+	std::vector<node *>				toHash;
+
+	while (!active.empty()) {
+		toHash.clear();
+		unshared.clear();
+
+		for (auto const i : active) {
+			walk&		w = walks[i];
+			const uint8_t	*p = proofs[i].proof + (w.next * SHA256_HASH_SIZE);
+			bool const	onLeft = ((w.fn & 1) != 0) || (w.fn == w.sn);
+
+			if (w.sn == 0) {
+				res[i] = EMSHAResult::VerifyFailed;
+				continue;
+			}
+
+			// A node on the right edge of the tree with no
+			// sibling at this level is carried up until it
+			// becomes a right child.
+			if (onLeft) {
+				while (((w.fn & 1) == 0) && (w.fn != 0)) {
+					w.fn >>= 1;
+					w.sn >>= 1;
+					w.level++;
+				}
+			}
+
+			node		in;
+			nodeKey const	key = {w.fn >> 1, w.level + 1};
+
+			std::copy(onLeft ? p : w.r, (onLeft ? p : w.r) + SHA256_HASH_SIZE, in.left);
+			std::copy(onLeft ? w.r : p, (onLeft ? w.r : p) + SHA256_HASH_SIZE, in.right);
+
+			auto const	found = known.find(key);
+			if (found == known.end()) {
+				node&	n = known[key];
+				std::copy(in.left, in.left + SHA256_HASH_SIZE, n.left);
+				std::copy(in.right, in.right + SHA256_HASH_SIZE, n.right);
+				toHash.push_back(&n);
+				w.pending = &n;
+			} else if ((0 == std::memcmp(found->second.left, in.left, SHA256_HASH_SIZE)) &&
+				   (0 == std::memcmp(found->second.right, in.right, SHA256_HASH_SIZE))) {
+				w.pending = &found->second;
+			} else {
+				unshared.push_back(in);
+				toHash.push_back(&unshared.back());
+				w.pending = &unshared.back();
+			}
+		}
+
+		hashNodes(toHash);
+
+		std::vector<std::size_t>	still;
+		for (auto const i : active) {
+			walk&	w = walks[i];
+
+			if (EMSHAResult::OK != res[i]) {
+				continue;
+			}
+
+			std::copy(w.pending->hash, w.pending->hash + SHA256_HASH_SIZE, w.r);
+			w.fn >>= 1;
+			w.sn >>= 1;
+			w.level++;
+			w.next++;
+
+			if (w.next < (proofs[i].proofLength / SHA256_HASH_SIZE)) {
+				still.push_back(i);
+			} else if ((w.sn != 0) || !HashEqual(w.r, root)) {
+				res[i] = EMSHAResult::VerifyFailed;
+			}
+		}
+		active.swap(still);
+	}
+
+	EMSHAResult	overall = EMSHAResult::OK;
+	for (std::size_t i = 0; i < count; i++) {
+		if (nullptr != results) {
+			results[i] = res[i];
+		}
+		if (EMSHAResult::OK != res[i]) {
+			overall = EMSHAResult::VerifyFailed;
+		}
+	}
+
+	return overall;
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,61 @@
+#!/usr/bin/env sh
+
+######################################################################
+# @file        : footprint
+# @description : Build each SHA-256 compression configuration as a
+#                release build and report code size, static stack
+#                usage (from -fstack-usage) and measured peak stack.
+#
+# usage: footprint.sh [source dir] [work dir]
+######################################################################
+
+set -e
+
+SOURCE_DIR="$(cd "${1:-.}" && pwd)"
+WORK_DIR="${2:-${SOURCE_DIR}/footprint}"
+CONFIGS="default small-stack"
+
+build_config () {
+	config="$1"
+	dir="${WORK_DIR}/${config}"
+	small_stack=OFF
+
+	if [ "${config}" = "small-stack" ]
+	then
+		small_stack=ON
+	fi
+
+	cmake -S "${SOURCE_DIR}" -B "${dir}" \
+		-DCMAKE_BUILD_TYPE=Release \
+		-DCMAKE_CXX_FLAGS="-fstack-usage" \
+		-DEMSHA_SMALL_STACK=${small_stack} > /dev/null
+	cmake --build "${dir}" --target emsha test_stack > /dev/null
+}
+
+report_config () {
+	config="$1"
+	dir="${WORK_DIR}/${config}"
+
+	echo "=== ${config} ==="
+	echo "[+] code size (text/data/bss):"
+	size -t "${dir}/libemsha.a" | awk '$6 ~ /(sha256|hmac)\.cc\.o/ || $6 == "(TOTALS)" { printf "\t%-24s %8s %6s %6s\n", $6, $1, $2, $3 }'
+
+	echo "[+] static stack usage (bytes):"
+	find "${dir}" -name 'sha256.cc.su' -o -name 'hmac.cc.su' | xargs cat |
+		sed -E 's/^[^:]*:[0-9]+:[0-9]+://' |
+		sort -t "$(printf '\t')" -k2 -n -r | head -8 |
+		awk -F'\t' '{ printf "\t%6s %-8s %s\n", $2, $3, $1 }'
+
+	echo "[+] measured peak stack:"
+	"${dir}/test_stack" | grep 'peak stack' | sed 's/^/\t/'
+}
+
+for config in ${CONFIGS}
+do
+	build_config "${config}"
+done
+
+for config in ${CONFIGS}
+do
+	report_config "${config}"
+done
@@ -33,6 +33,10 @@
 #include <algorithm>
 #include <iostream>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 namespace emsha {
 
@@ -98,19 +102,19 @@ SHA256::~SHA256()
 }
 
 
+// addLength records l more bytes of message; the message length is
+// kept in bits, as it is written into the padding.
 EMSHAResult
 SHA256::addLength(const uint32_t l)
 {
-	EMSHAResult res = EMSHAResult::InputTooLong;;
+	uint64_t const bits = static_cast<uint64_t>(l) << 3;
 
-	uint32_t const tmp = static_cast<uint32_t>(this->mlen) + l;
-	if (tmp >= this->mlen) {
-		this->mlen = tmp;
-		assert(this->mlen > 0);
-		res = EMSHAResult::OK;
+	if ((this->mlen + bits) < this->mlen) {
+		return EMSHAResult::InputTooLong;
 	}
 
-	return res;
+	this->mlen += bits;
+	return EMSHAResult::OK;
 }
 
 
@@ -124,14 +128,7 @@ EMSHAResult
 SHA256::reset()
 {
 	// The message block is set to the initial hash vector.
-	this->i_hash[0] = emsha256H0[0];
-	this->i_hash[1] = emsha256H0[1];
-	this->i_hash[2] = emsha256H0[2];
-	this->i_hash[3] = emsha256H0[3];
-	this->i_hash[4] = emsha256H0[4];
-	this->i_hash[5] = emsha256H0[5];
-	this->i_hash[6] = emsha256H0[6];
-	this->i_hash[7] = emsha256H0[7];
+	sha256_init(this->i_hash);
 
 	this->mbi       = 0;
 	this->hStatus   = EMSHAResult::OK;
@@ -144,32 +141,13 @@ SHA256::reset()
 }
 
 
-uint32_t
-SHA256::chunkToUint32(uint32_t offset)
-{
-	uint32_t chunk = 0;
-
-	for (uint32_t i = offset; i < offset+4; i++) {
-		chunk <<= 8;
-		chunk += static_cast<uint32_t>(this->mb[i]);
-	}
-
-	return chunk;
-}
-
-
-uint32_t
-SHA256::uint32ToChunk(uint32_t offset)
+static inline uint32_t
+loadUint32(const uint8_t *chunk)
 {
-	uint32_t chunk = 0;
-
-	for (uint32_t i = offset; i < offset+4; i++) {
-		chunk <<= 8;
-		chunk += static_cast<uint32_t>(this->mb[i]);
-	}
-
-	return chunk;
-
+	return (static_cast<uint32_t>(chunk[0]) << 24) |
+	       (static_cast<uint32_t>(chunk[1]) << 16) |
+	       (static_cast<uint32_t>(chunk[2]) << 8) |
+	       static_cast<uint32_t>(chunk[3]);
 }
 
 
@@ -183,70 +161,168 @@ uint32ToChunkInPlace(uint32_t x, uint8_t *chunk)
 }
 
 
+#ifndef EMSHA_SMALL_STACK
 // FIPS 180-4, page 22.
 void
-SHA256::updateMessageBlock()
+sha256_compress(uint32_t *ih, const uint8_t *blocks, std::size_t count)
 {
 	uint32_t w[64];
-	uint32_t i     = 0;
-	uint32_t chunk = 0;
-	uint32_t a     = 0;
-	uint32_t b     = 0;
-	uint32_t c     = 0;
-	uint32_t d     = 0;
-	uint32_t e     = 0;
-	uint32_t f     = 0;
-	uint32_t g     = 0;
-	uint32_t h     = 0;
-
-	while (i < 16) {
-		w[i++] = this->chunkToUint32(chunk);
-		chunk += 4;
-	}
-	this->mbi = 0;
+	uint32_t i = 0;
+	uint32_t a = 0;
+	uint32_t b = 0;
+	uint32_t c = 0;
+	uint32_t d = 0;
+	uint32_t e = 0;
+	uint32_t f = 0;
+	uint32_t g = 0;
+	uint32_t h = 0;
+
+	EMSHA_PROBE2(sha256__compress, ih, count);
+	EMSHA_STAT_ADD(StatBlocksCompressed, count);
+
+	for (std::size_t n = 0; n < count; n++) {
+		const uint8_t *block = blocks + (n * SHA256_MB_SIZE);
+
+		for (i = 0; i < 16; i++) {
+			w[i] = loadUint32(block + (i * 4));
+		}
 
-	for (i = 16; i < 64; i++) {
-		w[i] = sha_sigma1(w[i - 2]) + w[i - 7] +
-		       sha_sigma0(w[i - 15]) + w[i - 16];
+		for (i = 16; i < 64; i++) {
+			w[i] = sha_sigma1(w[i - 2]) + w[i - 7] +
+			       sha_sigma0(w[i - 15]) + w[i - 16];
+		}
+
+		a = ih[0];
+		b = ih[1];
+		c = ih[2];
+		d = ih[3];
+		e = ih[4];
+		f = ih[5];
+		g = ih[6];
+		h = ih[7];
+
+		for (i = 0; i < 64; i++) {
+			uint32_t t1 = 0;
+			uint32_t t2 = 0;
+			t1 = h + sha_Sigma1(e) + sha_ch(e, f, g) + sha256K[i] + w[i];
+			t2 = sha_Sigma0(a) + sha_maj(a, b, c);
+			h  = g;
+			g  = f;
+			f  = e;
+			e  = d + t1;
+			d  = c;
+			c  = b;
+			b  = a;
+			a  = t1 + t2;
+		}
+
+		ih[0] += a;
+		ih[1] += b;
+		ih[2] += c;
+		ih[3] += d;
+		ih[4] += e;
+		ih[5] += f;
+		ih[6] += g;
+		ih[7] += h;
 	}
+}
+#else // #ifndef EMSHA_SMALL_STACK
+// FIPS 180-4, page 22, with the message schedule kept in a rolling
+// 16-word window: W[t] only depends on W[t-2], W[t-7], W[t-15] and
+// W[t-16], so each new word can overwrite W[t-16]. This trades the
+// 256-byte schedule for 64 bytes of stack, at the cost of some index
+// masking in the round loop.
+void
+sha256_compress(uint32_t *ih, const uint8_t *blocks, std::size_t count)
+{
+	uint32_t w[16];
+	uint32_t i = 0;
+	uint32_t a = 0;
+	uint32_t b = 0;
+	uint32_t c = 0;
+	uint32_t d = 0;
+	uint32_t e = 0;
+	uint32_t f = 0;
+	uint32_t g = 0;
+	uint32_t h = 0;
+
+	EMSHA_PROBE2(sha256__compress, ih, count);
+	EMSHA_STAT_ADD(StatBlocksCompressed, count);
+
+	for (std::size_t n = 0; n < count; n++) {
+		const uint8_t *block = blocks + (n * SHA256_MB_SIZE);
+
+		for (i = 0; i < 16; i++) {
+			w[i] = loadUint32(block + (i * 4));
+		}
 
-	a = this->i_hash[0];
-	b = this->i_hash[1];
-	c = this->i_hash[2];
-	d = this->i_hash[3];
-	e = this->i_hash[4];
-	f = this->i_hash[5];
-	g = this->i_hash[6];
-	h = this->i_hash[7];
-
-	for (i = 0; i < 64; i++) {
-		uint32_t t1 = 0;
-		uint32_t t2 = 0;
-		t1 = h + sha_Sigma1(e) + sha_ch(e, f, g) + sha256K[i] + w[i];
-		t2 = sha_Sigma0(a) + sha_maj(a, b, c);
-		h  = g;
-		g  = f;
-		f  = e;
-		e  = d + t1;
-		d  = c;
-		c  = b;
-		b  = a;
-		a  = t1 + t2;
+		a = ih[0];
+		b = ih[1];
+		c = ih[2];
+		d = ih[3];
+		e = ih[4];
+		f = ih[5];
+		g = ih[6];
+		h = ih[7];
+
+		for (i = 0; i < 64; i++) {
+			uint32_t t1 = 0;
+			uint32_t t2 = 0;
+
+			if (i >= 16) {
+				w[i & 15] += sha_sigma1(w[(i - 2) & 15]) +
+					     w[(i - 7) & 15] +
+					     sha_sigma0(w[(i - 15) & 15]);
+			}
+
+			t1 = h + sha_Sigma1(e) + sha_ch(e, f, g) + sha256K[i] + w[i & 15];
+			t2 = sha_Sigma0(a) + sha_maj(a, b, c);
+			h  = g;
+			g  = f;
+			f  = e;
+			e  = d + t1;
+			d  = c;
+			c  = b;
+			b  = a;
+			a  = t1 + t2;
+		}
+
+		ih[0] += a;
+		ih[1] += b;
+		ih[2] += c;
+		ih[3] += d;
+		ih[4] += e;
+		ih[5] += f;
+		ih[6] += g;
+		ih[7] += h;
 	}
+}
+#endif // #ifndef EMSHA_SMALL_STACK
+
 
-	this->i_hash[0] += a;
-	this->i_hash[1] += b;
-	this->i_hash[2] += c;
-	this->i_hash[3] += d;
-	this->i_hash[4] += e;
-	this->i_hash[5] += f;
-	this->i_hash[6] += g;
-	this->i_hash[7] += h;
+void
+SHA256::updateMessageBlock()
+{
+	sha256_compress(this->i_hash, this->mb.data(), 1);
+	this->mbi = 0;
 }
 
 
 EMSHAResult
 SHA256::Update(const std::uint8_t *message, std::uint32_t messageLength)
+{
+	EMSHA_PROBE2(sha256__update__start, this, messageLength);
+	EMSHA_STAT_ADD(StatUpdateCalls, 1);
+
+	EMSHAResult const res = this->update(message, messageLength);
+
+	EMSHA_PROBE2(sha256__update__done, this, static_cast<int>(res));
+	return EMSHA_STAT_RESULT(res);
+}
+
+
+EMSHAResult
+SHA256::update(const std::uint8_t *message, std::uint32_t messageLength)
 {
 	// Checking invariants:
 	// If the message length is zero, there's nothing to be done.
@@ -263,89 +339,404 @@ SHA256::Update(const std::uint8_t *message, std::uint32_t messageLength)
 	if (this->hComplete != static_cast<uint8_t>(0)) { return EMSHAResult::InvalidState; }
 	// Invariants satisfied by here.
 
-	for (uint32_t i = 0; i < messageLength; i++) {
-		this->mb[this->mbi] = *(message + i);
-		mbi++;
+	if (EMSHAResult::OK != this->addLength(messageLength)) {
+		this->hStatus = EMSHAResult::InputTooLong;
+		return this->hStatus;
+	}
+	EMSHA_STAT_ADD(StatBytesHashed, messageLength);
 
-		if (EMSHAResult::OK == this->addLength(8)) {
-			if (SHA256_MB_SIZE == this->mbi) {
-				this->updateMessageBlock();
+	// Top up a partially-filled message block first.
+	if (this->mbi != 0) {
+		uint32_t fill = SHA256_MB_SIZE - this->mbi;
+		if (fill > messageLength) {
+			fill = messageLength;
+		}
 
-				// Assumption: following the message block
-				// write, the context should still be in a good
-				// state.
-				assert(EMSHAResult::OK == this->hStatus);
-			}
+		std::copy(message, message + fill, this->mb.begin() + this->mbi);
+		this->mbi     += static_cast<uint8_t>(fill);
+		message       += fill;
+		messageLength -= fill;
+
+		if (SHA256_MB_SIZE == this->mbi) {
+			this->updateMessageBlock();
 		}
 	}
 
+	// Whole blocks are compressed straight out of the caller's
+	// buffer, skipping the copy through the message block.
+	uint32_t const nblocks = messageLength / SHA256_MB_SIZE;
+	if (nblocks > 0) {
+		sha256_compress(this->i_hash, message, nblocks);
+		message       += nblocks * SHA256_MB_SIZE;
+		messageLength -= nblocks * SHA256_MB_SIZE;
+	}
+
+	// Whatever is left is less than a block; hold onto it.
+	std::copy(message, message + messageLength, this->mb.begin() + this->mbi);
+	this->mbi += static_cast<uint8_t>(messageLength);
+
+	// Assumption: following the message block writes, the context
+	// should still be in a good state.
+	assert(EMSHAResult::OK == this->hStatus);
 	return this->hStatus;
 }
 
 
-inline void
-SHA256::padMessage(uint8_t pc)
+// copyStripSize is how much CopyAndUpdate copies before hashing what
+// it copied; it's small enough that the strip is still in L1.
+static constexpr uint32_t copyStripSize = 16 * SHA256_MB_SIZE;
+
+
+// copyStrip copies one strip for CopyAndUpdate. A streaming copy
+// writes the 16-byte aligned part of dst with non-temporal stores
+// when the target has them.
+static void
+copyStrip(uint8_t *dst, const uint8_t *src, uint32_t length, bool streaming)
 {
-	// Assumption: the context is not in a corrupted state.
-	assert(EMSHAResult::OK == this->hStatus);
+#if defined(__SSE2__)
+	if (streaming) {
+		uint32_t const	head = std::min<uint32_t>(length,
+		    (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15);
+
+		std::memcpy(dst, src, head);
+		dst    += head;
+		src    += head;
+		length -= head;
+
+		for (; length >= 16; length -= 16, dst += 16, src += 16) {
+			_mm_stream_si128(reinterpret_cast<__m128i *>(dst),
+					 _mm_loadu_si128(reinterpret_cast<const __m128i *>(src)));
+		}
+	}
+#else
+	(void)streaming;
+#endif
+	std::memcpy(dst, src, length);
+}
+
+
+EMSHAResult
+SHA256::CopyAndUpdate(uint8_t *dst, const uint8_t *src, uint32_t length, bool streaming)
+{
+	EMSHA_PROBE2(sha256__update__start, this, length);
+	EMSHA_STAT_ADD(StatUpdateCalls, 1);
+
+	EMSHAResult const res = this->copyAndUpdate(dst, src, length, streaming);
+
+	EMSHA_PROBE2(sha256__update__done, this, static_cast<int>(res));
+	return EMSHA_STAT_RESULT(res);
+}
+
+
+EMSHAResult
+SHA256::copyAndUpdate(uint8_t *dst, const uint8_t *src, uint32_t length, bool streaming)
+{
+	if (0 == length) { return EMSHAResult::OK; }
+	if ((dst == nullptr) || (src == nullptr)) { return EMSHAResult::NullPointer; }
+	if (this->hStatus != EMSHAResult::OK) { return this->hStatus; }
+	if (this->hComplete != static_cast<uint8_t>(0)) { return EMSHAResult::InvalidState; }
+
+	EMSHAResult	res = EMSHAResult::OK;
+
+	// The first strip tops up any pending partial block, so that
+	// the rest start on block boundaries and are hashed in place.
+	uint32_t	n = std::min(length, copyStripSize - this->mbi);
+
+	while ((length > 0) && (EMSHAResult::OK == res)) {
+		copyStrip(dst, src, n, streaming);
+		res = this->update(src, n);
+
+		dst    += n;
+		src    += n;
+		length -= n;
+		n       = std::min(length, copyStripSize);
+	}
+
+#if defined(__SSE2__)
+	// Non-temporal stores aren't ordered with other stores, so
+	// fence them before anything else sees the destination.
+	if (streaming) {
+		_mm_sfence();
+	}
+#endif
+
+	return res;
+}
+
+
+void
+sha256_init(uint32_t *ih)
+{
+	std::copy(emsha256H0, emsha256H0 + 8, ih);
+}
+
+
+void
+sha256_pad(uint32_t *ih, const uint8_t *partial, uint32_t plen, uint64_t bitLength)
+{
+	uint8_t	block[2 * SHA256_MB_SIZE];
+
+	// Assumption: the partial block really is partial.
+	assert(plen < SHA256_MB_SIZE);
+
+	// The padding is a single 1 bit followed by zeroes, up to the
+	// 64-bit message length at the end of the last block; if the
+	// length doesn't fit after the 1 bit, it spills into a second
+	// block.
+	uint32_t const blocks = (plen < (SHA256_MB_SIZE - 8)) ? 1 : 2;
+	uint32_t const lstart = (blocks * SHA256_MB_SIZE) - 8;
+
+	std::copy(partial, partial + plen, block);
+	block[plen] = 0x80;
+	std::fill(block + plen + 1, block + lstart, 0);
+	for (uint32_t i = 0; i < 8; i++) {
+		block[lstart + i] = static_cast<uint8_t>(bitLength >> (56 - (8 * i)));
+	}
+
+	sha256_compress(ih, block, blocks);
+	std::fill(block, block + sizeof(block), 0);
+}
+
+
+void
+sha256_store(const uint32_t *ih, uint8_t *digest)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		uint32ToChunkInPlace(ih[i], digest + (4 * i));
+	}
+}
+
+
+void
+sha256_digest(const uint8_t *m, uint64_t ml, uint8_t *digest)
+{
+	uint32_t	ih[8];
+
+	sha256_init(ih);
+	sha256_oneshot(ih, 0, m, ml, digest);
+}
 
-	if (this->mbi < (SHA256_MB_SIZE - 8)) {
-		this->mb[this->mbi++] = pc;
-	} else {
-		bool pc_add = false;
 
-		if (this->mbi < SHA256_MB_SIZE - 1) {
-			this->mb[this->mbi++] = pc;
-			pc_add = true;
+void
+sha256_write_length(uint8_t *blockEnd, uint64_t bytes)
+{
+	uint64_t const	bits = bytes << 3;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		blockEnd[-1 - static_cast<int>(i)] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+}
+
+
+void
+sha256_oneshot(const uint32_t *start, uint64_t prefix,
+	       const uint8_t *m, uint64_t ml, uint8_t *digest)
+{
+	uint32_t	ih[8];
+	uint64_t const	whole = ml / SHA256_MB_SIZE;
+
+	std::copy(start, start + 8, ih);
+	sha256_compress(ih, m, whole);
+	sha256_pad(ih, m + (whole * SHA256_MB_SIZE),
+		   static_cast<uint32_t>(ml % SHA256_MB_SIZE),
+		   (prefix + ml) << 3);
+	sha256_store(ih, digest);
+}
+
+
+// The multi-lane kernel always runs SHA256_LANES lanes, so the loop
+// bounds are constants the compiler can vectorise; lanes beyond the
+// ones asked for repeat the first lane's block and are thrown away.
+//
+// lanes_rounds runs the 64 rounds over the lane states in s, taking
+// the schedule word for round i and lane l from w(i, l).
+template <typename Schedule>
+static inline void
+lanes_rounds(uint32_t (*s)[SHA256_LANES], const Schedule& w)
+{
+	for (uint32_t i = 0; i < 64; i++) {
+		for (uint32_t l = 0; l < SHA256_LANES; l++) {
+			uint32_t const t1 = s[7][l] + sha_Sigma1(s[4][l]) +
+					    sha_ch(s[4][l], s[5][l], s[6][l]) +
+					    sha256K[i] + w(i, l);
+			uint32_t const t2 = sha_Sigma0(s[0][l]) +
+					    sha_maj(s[0][l], s[1][l], s[2][l]);
+
+			s[7][l] = s[6][l];
+			s[6][l] = s[5][l];
+			s[5][l] = s[4][l];
+			s[4][l] = s[3][l] + t1;
+			s[3][l] = s[2][l];
+			s[2][l] = s[1][l];
+			s[1][l] = s[0][l];
+			s[0][l] = t1 + t2;
 		}
+	}
+}
+
+
+static inline void
+lanes_load(uint32_t (*s)[SHA256_LANES], uint32_t (*ih)[8], std::size_t lanes)
+{
+	for (uint32_t l = 0; l < SHA256_LANES; l++) {
+		const uint32_t	*state = ih[(l < lanes) ? l : 0];
 
-		while (this->mbi < SHA256_MB_SIZE) {
-			this->mb[this->mbi++] = 0;
+		for (uint32_t i = 0; i < 8; i++) {
+			s[i][l] = state[i];
 		}
+	}
+}
+
 
-		this->updateMessageBlock();
-		if (!pc_add) {
-			this->mb[this->mbi++] = pc;
+static inline void
+lanes_store(uint32_t (*s)[SHA256_LANES], uint32_t (*ih)[8], std::size_t lanes)
+{
+	for (uint32_t l = 0; l < lanes; l++) {
+		for (uint32_t i = 0; i < 8; i++) {
+			ih[l][i] += s[i][l];
 		}
+	}
+}
 
-		// Assumption: updating the message block has not left the
-		// context in a corrupted state.
-		assert(EMSHAResult::OK == this->hStatus);
+
+void
+sha256_compress_lanes(uint32_t (*ih)[8], const uint8_t *const *blocks, std::size_t lanes)
+{
+	uint32_t	w[64][SHA256_LANES];
+	uint32_t	s[8][SHA256_LANES];
+	uint32_t	i = 0;
+	uint32_t	l = 0;
+
+	assert((lanes > 0) && (lanes <= SHA256_LANES));
+
+	EMSHA_STAT_ADD(StatBlocksCompressed, lanes);
+	EMSHA_STAT_ADD(StatLaneBlocks, lanes);
+
+	for (l = 0; l < SHA256_LANES; l++) {
+		const uint8_t	*block = blocks[(l < lanes) ? l : 0];
+
+		for (i = 0; i < 16; i++) {
+			w[i][l] = loadUint32(block + (i * 4));
+		}
 	}
 
-	while (this->mbi < (SHA256_MB_SIZE - 8)) {
-		this->mb[this->mbi++] = 0;
+	for (i = 16; i < 64; i++) {
+		for (l = 0; l < SHA256_LANES; l++) {
+			w[i][l] = sha_sigma1(w[i - 2][l]) + w[i - 7][l] +
+				  sha_sigma0(w[i - 15][l]) + w[i - 16][l];
+		}
 	}
 
-	// lstart marks the starting point for the length packing.
-	uint32_t const lstart = SHA256_MB_SIZE - 8;
-
-	this->mb[lstart] = static_cast<uint8_t>(this->mlen >> 56);
-	this->mb[lstart + 1] =
-	    static_cast<uint8_t>((this->mlen & 0x00ff000000000000L) >> 48);
-	this->mb[lstart + 2] =
-	    static_cast<uint8_t>((this->mlen & 0x0000ff0000000000L) >> 40);
-	this->mb[lstart + 3] =
-	    static_cast<uint8_t>((this->mlen & 0x000000ff00000000L) >> 32);
-	this->mb[lstart + 4] =
-	    static_cast<uint8_t>((this->mlen & 0x00000000ff000000L) >> 24);
-	this->mb[lstart + 5] =
-	    static_cast<uint8_t>((this->mlen & 0x0000000000ff0000L) >> 16);
-	this->mb[lstart + 6] =
-	    static_cast<uint8_t>((this->mlen & 0x000000000000ff00L) >> 8);
-	this->mb[lstart + 7] =
-	    static_cast<uint8_t>(this->mlen & 0x00000000000000ffL);
-
-	this->updateMessageBlock();
-
-	// Assumption: updating the message block has not left the context in a
-	// corrupted state.
-	assert(EMSHAResult::OK == this->hStatus);
+	lanes_load(s, ih, lanes);
+	lanes_rounds(s, [&w](uint32_t r, uint32_t c) { return w[r][c]; });
+	lanes_store(s, ih, lanes);
+}
+
+
+void
+sha256_schedule(const uint8_t *block, uint32_t *w)
+{
+	for (uint32_t i = 0; i < 16; i++) {
+		w[i] = loadUint32(block + (i * 4));
+	}
+
+	for (uint32_t i = 16; i < 64; i++) {
+		w[i] = sha_sigma1(w[i - 2]) + w[i - 7] + sha_sigma0(w[i - 15]) + w[i - 16];
+	}
+}
+
+
+void
+sha256_rounds_lanes(uint32_t (*ih)[8], const uint32_t *w, std::size_t lanes)
+{
+	uint32_t	s[8][SHA256_LANES];
+
+	assert((lanes > 0) && (lanes <= SHA256_LANES));
+
+	EMSHA_STAT_ADD(StatBlocksCompressed, lanes);
+	EMSHA_STAT_ADD(StatLaneBlocks, lanes);
+
+	lanes_load(s, ih, lanes);
+	lanes_rounds(s, [w](uint32_t r, uint32_t) { return w[r]; });
+	lanes_store(s, ih, lanes);
+}
+
+
+void
+sha256_node(uint8_t prefix, const uint8_t *left, const uint8_t *right, uint8_t *digest)
+{
+	uint8_t		block[2 * SHA256_MB_SIZE] = {0};
+	uint32_t	ih[8];
+
+	block[0] = prefix;
+	std::copy(left, left + SHA256_HASH_SIZE, block + 1);
+	std::copy(right, right + SHA256_HASH_SIZE, block + 1 + SHA256_HASH_SIZE);
+	block[1 + (2 * SHA256_HASH_SIZE)] = 0x80;
+
+	// 65 bytes is 520 bits.
+	block[(2 * SHA256_MB_SIZE) - 2] = 0x02;
+	block[(2 * SHA256_MB_SIZE) - 1] = 0x08;
+
+	sha256_init(ih);
+	sha256_compress(ih, block, 2);
+	sha256_store(ih, digest);
+}
+
+
+void
+sha256_node_lanes(std::size_t count, uint8_t prefix, const uint8_t *const *lefts,
+		  const uint8_t *const *rights, uint8_t *const *digests)
+{
+	uint8_t		blocks[SHA256_LANES][2 * SHA256_MB_SIZE] = {{0}};
+	const uint8_t	*first[SHA256_LANES];
+	const uint8_t	*second[SHA256_LANES];
+	uint32_t	ih[SHA256_LANES][8];
+
+	for (uint32_t l = 0; l < SHA256_LANES; l++) {
+		blocks[l][0] = prefix;
+		blocks[l][1 + (2 * SHA256_HASH_SIZE)] = 0x80;
+		blocks[l][(2 * SHA256_MB_SIZE) - 2] = 0x02;
+		blocks[l][(2 * SHA256_MB_SIZE) - 1] = 0x08;
+		first[l]  = blocks[l];
+		second[l] = blocks[l] + SHA256_MB_SIZE;
+	}
+
+	for (std::size_t n = 0; n < count; n += SHA256_LANES) {
+		std::size_t const lanes = std::min<std::size_t>(SHA256_LANES, count - n);
+
+		for (std::size_t l = 0; l < lanes; l++) {
+			std::copy(lefts[n + l], lefts[n + l] + SHA256_HASH_SIZE,
+				  blocks[l] + 1);
+			std::copy(rights[n + l], rights[n + l] + SHA256_HASH_SIZE,
+				  blocks[l] + 1 + SHA256_HASH_SIZE);
+			sha256_init(ih[l]);
+		}
+
+		sha256_compress_lanes(ih, first, lanes);
+		sha256_compress_lanes(ih, second, lanes);
+
+		for (std::size_t l = 0; l < lanes; l++) {
+			sha256_store(ih[l], digests[n + l]);
+		}
+	}
 }
 
 
 EMSHAResult
 SHA256::Finalise(std::uint8_t *digest)
+{
+	EMSHA_PROBE2(sha256__finalise__start, this, this->mlen >> 3);
+	EMSHA_STAT_ADD(StatFinaliseCalls, 1);
+
+	EMSHAResult const res = this->finalise(digest);
+
+	EMSHA_PROBE2(sha256__finalise__done, this, static_cast<int>(res));
+	return EMSHA_STAT_RESULT(res);
+}
+
+
+EMSHAResult
+SHA256::finalise(std::uint8_t *digest)
 {
 	// Check invariants.
 	// The digest cannot be a null pointer; this library allocates
@@ -359,31 +750,31 @@ SHA256::Finalise(std::uint8_t *digest)
 	if (0 != this->hComplete) { return EMSHAResult::InvalidState; }
 	// Invariants satisfied by here.
 
-	this->padMessage(0x80);
+	sha256_pad(this->i_hash, this->mb.data(), this->mbi, this->mlen);
 
 	// Assumption: padding the message block has not left the context in a
 	// corrupted state.
 	assert(EMSHAResult::OK == this->hStatus);
 	std::fill(this->mb.begin(), this->mb.end(), 0);
 
+	this->mbi       = 0;
 	this->hComplete = 1;
 	this->mlen      = 0;
 
-	uint32ToChunkInPlace(this->i_hash[0], digest);
-	uint32ToChunkInPlace(this->i_hash[1], digest + 4);
-	uint32ToChunkInPlace(this->i_hash[2], digest + 8);
-	uint32ToChunkInPlace(this->i_hash[3], digest + 12);
-	uint32ToChunkInPlace(this->i_hash[4], digest + 16);
-	uint32ToChunkInPlace(this->i_hash[5], digest + 20);
-	uint32ToChunkInPlace(this->i_hash[6], digest + 24);
-	uint32ToChunkInPlace(this->i_hash[7], digest + 28);
-
+	sha256_store(this->i_hash, digest);
 	return EMSHAResult::OK;
 }
 
 
 EMSHAResult
 SHA256::Result(std::uint8_t *digest)
+{
+	return EMSHA_STAT_RESULT(this->result(digest));
+}
+
+
+EMSHAResult
+SHA256::result(std::uint8_t *digest)
 {
 	// Check invariants.
 
@@ -397,22 +788,52 @@ SHA256::Result(std::uint8_t *digest)
 	// Invariants satisfied by here.
 
 	if (this->hComplete == 0U) {
-		return this->Finalise(digest);
+		return this->finalise(digest);
+	}
+
+	sha256_store(this->i_hash, digest);
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+SHA256::Fork(SHA256& child) const
+{
+	if (&child == this) {
+		return EMSHAResult::OK;
 	}
 
-	uint32ToChunkInPlace(this->i_hash[0], digest);
-	uint32ToChunkInPlace(this->i_hash[1], digest + 4);
-	uint32ToChunkInPlace(this->i_hash[2], digest + 8);
-	uint32ToChunkInPlace(this->i_hash[3], digest + 12);
-	uint32ToChunkInPlace(this->i_hash[4], digest + 16);
-	uint32ToChunkInPlace(this->i_hash[5], digest + 20);
-	uint32ToChunkInPlace(this->i_hash[6], digest + 24);
-	uint32ToChunkInPlace(this->i_hash[7], digest + 28);
+	std::copy(this->i_hash, this->i_hash + 8, child.i_hash);
+	std::copy(this->mb.begin(), this->mb.begin() + this->mbi, child.mb.begin());
+	child.mlen      = this->mlen;
+	child.mbi       = this->mbi;
+	child.hStatus   = this->hStatus;
+	child.hComplete = this->hComplete;
 
 	return EMSHAResult::OK;
 }
 
 
+void
+sha256_checkpoint(const SHA256& ctx, uint32_t *ih, uint64_t& length, uint8_t *partial)
+{
+	std::copy(ctx.i_hash, ctx.i_hash + 8, ih);
+	std::copy(ctx.mb.begin(), ctx.mb.begin() + ctx.mbi, partial);
+	length = ctx.mlen >> 3;
+}
+
+
+void
+sha256_resume(SHA256& ctx, const uint32_t *ih, uint64_t length)
+{
+	assert(0 == (length % SHA256_MB_SIZE));
+
+	ctx.reset();
+	std::copy(ih, ih + 8, ctx.i_hash);
+	ctx.mlen = length << 3;
+}
+
+
 std::uint32_t
 SHA256::Size()
 {
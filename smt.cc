@@ -0,0 +1,474 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/smt.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+namespace {
+
+
+constexpr uint8_t	leafPrefix = 0x00;
+constexpr uint8_t	nodePrefix = 0x01;
+
+
+// emptyTable holds the hash of an empty subtree rooted at each depth.
+struct emptyTable {
+	uint8_t	h[SMT_DEPTH + 1][SHA256_HASH_SIZE];
+
+	emptyTable()
+	{
+		std::fill(this->h[SMT_DEPTH], this->h[SMT_DEPTH] + SHA256_HASH_SIZE, 0);
+		for (uint32_t d = SMT_DEPTH; d > 0; d--) {
+			sha256_node(nodePrefix, this->h[d], this->h[d], this->h[d - 1]);
+		}
+	}
+};
+
+
+const emptyTable&
+empties()
+{
+	static const emptyTable	table;
+
+	return table;
+}
+
+
+inline uint8_t
+pathBit(const uint8_t *path, uint32_t i)
+{
+	return (path[i / 8] >> (7 - (i % 8))) & 1;
+}
+
+
+// truncatePath clears every bit of path from bit depth onwards.
+inline void
+truncatePath(uint8_t *path, uint32_t depth)
+{
+	uint32_t const	byte = depth / 8;
+
+	if (byte >= (SMT_DEPTH / 8)) {
+		return;
+	}
+
+	path[byte] &= static_cast<uint8_t>(0xff00 >> (depth % 8));
+	std::fill(path + byte + 1, path + (SMT_DEPTH / 8), 0);
+}
+
+
+// firstDiff returns the first bit from bit `from` onwards, and
+// before bit `to`, at which a and b differ, or `to` if they agree.
+uint32_t
+firstDiff(const uint8_t *a, const uint8_t *b, uint32_t from, uint32_t to)
+{
+	for (uint32_t i = from / 8; (i * 8) < to; i++) {
+		uint8_t	x = a[i] ^ b[i];
+
+		if (i == (from / 8)) {
+			x &= static_cast<uint8_t>(0xff >> (from % 8));
+		}
+		if (x == 0) {
+			continue;
+		}
+
+		uint32_t	bit = i * 8;
+		while ((x & 0x80) == 0) {
+			x <<= 1;
+			bit++;
+		}
+		return std::min(bit, to);
+	}
+	return to;
+}
+
+
+} // anonymous namespace
+
+
+bool
+SparseMerkleTree::nodeID::operator==(const nodeID& other) const
+{
+	return (this->depth == other.depth) &&
+	       (0 == std::memcmp(this->path, other.path, sizeof(this->path)));
+}
+
+
+std::size_t
+SparseMerkleTree::nodeIDHash::operator()(const nodeID& id) const
+{
+	// Keys are digests, so the leading bits of a path are already
+	// well mixed; only the depth needs folding in.
+	uint64_t	h = 0;
+
+	std::memcpy(&h, id.path, sizeof(h));
+	return static_cast<std::size_t>(h ^ (static_cast<uint64_t>(id.depth) * 0x9e3779b97f4a7c15ULL));
+}
+
+
+SparseMerkleTree::SparseMerkleTree()
+    : top()
+{
+	// Build the empty hashes now rather than on the first update.
+	const uint8_t	*empty = EmptyHash(0);
+
+	std::copy(empty, empty + SHA256_HASH_SIZE, this->rootHash.d);
+}
+
+
+const uint8_t *
+SparseMerkleTree::EmptyHash(uint32_t depth)
+{
+	assert(depth <= SMT_DEPTH);
+	return empties().h[depth];
+}
+
+
+// subtreeHash writes the hash of the subtree at depth that holds id,
+// the branch or leaf at the top of it, into h. Levels between the
+// two have one empty child each, so they are rebuilt from id's own
+// hash and the empty hashes.
+void
+SparseMerkleTree::subtreeHash(const nodeID& id, uint32_t depth, uint8_t *h) const
+{
+	if (id.depth == SMT_DEPTH) {
+		sha256_node(leafPrefix, id.path, this->values.find(id)->second.d, h);
+	} else {
+		const branch&	b = this->branches.find(id)->second;
+
+		sha256_node(nodePrefix, b.hashes[0].d, b.hashes[1].d, h);
+	}
+
+	for (uint32_t d = id.depth; d > depth; d--) {
+		if (pathBit(id.path, d - 1)) {
+			sha256_node(nodePrefix, EmptyHash(d), h, h);
+		} else {
+			sha256_node(nodePrefix, h, EmptyHash(d), h);
+		}
+	}
+}
+
+
+void
+SparseMerkleTree::Root(uint8_t *root) const
+{
+	std::copy(this->rootHash.d, this->rootHash.d + SHA256_HASH_SIZE, root);
+}
+
+
+EMSHAResult
+SparseMerkleTree::Update(const uint8_t *key, const uint8_t *value)
+{
+	SMTUpdate const u = {key, value};
+
+	return this->UpdateBatch(&u, 1);
+}
+
+
+// set links a leaf whose value has just been stored into the tree,
+// marking the side of each branch on its path as stale and adding
+// the branch to dirty.
+void
+SparseMerkleTree::set(const nodeID& leaf, std::vector<nodeID>& dirty)
+{
+	if (this->values.size() == 1) {
+		this->top = leaf;
+		return;
+	}
+
+	nodeID		*ref = &this->top;
+	uint32_t	 level = 0;
+
+	for (;;) {
+		uint32_t const	depth = ref->depth;
+		uint32_t const	split = firstDiff(leaf.path, ref->path, level, depth);
+
+		if (split == SMT_DEPTH) {
+			// The key was already present.
+			return;
+		}
+
+		if (split < depth) {
+			// The key leaves the subtree under ref above its
+			// top, so a new branch joins the two there.
+			nodeID	id = leaf;
+
+			truncatePath(id.path, split);
+			id.depth = static_cast<uint16_t>(split);
+
+			branch&		b = this->branches[id];
+			uint8_t const	side = pathBit(leaf.path, split);
+
+			b.kids[side]     = leaf;
+			b.kids[side ^ 1] = *ref;
+			b.stale[0]       = true;
+			b.stale[1]       = true;
+			*ref = id;
+			dirty.push_back(id);
+			return;
+		}
+
+		branch&		b = this->branches.find(*ref)->second;
+		uint8_t const	side = pathBit(leaf.path, depth);
+
+		b.stale[side] = true;
+		dirty.push_back(*ref);
+		ref   = &b.kids[side];
+		level = depth + 1;
+	}
+}
+
+
+// remove unlinks a leaf whose value has just been erased, replacing
+// its parent branch with the leaf's sibling.
+void
+SparseMerkleTree::remove(const nodeID& leaf, std::vector<nodeID>& dirty)
+{
+	if (this->values.empty()) {
+		return;
+	}
+
+	nodeID	*ref = &this->top;
+
+	for (;;) {
+		branch&		b = this->branches.find(*ref)->second;
+		uint8_t const	side = pathBit(leaf.path, ref->depth);
+
+		if (b.kids[side] == leaf) {
+			nodeID const	sibling = b.kids[side ^ 1];
+
+			this->branches.erase(*ref);
+			*ref = sibling;
+			return;
+		}
+
+		b.stale[side] = true;
+		dirty.push_back(*ref);
+		ref = &b.kids[side];
+	}
+}
+
+
+EMSHAResult
+SparseMerkleTree::UpdateBatch(const SMTUpdate *updates, std::size_t count)
+{
+	if ((nullptr == updates) && (count != 0)) { return EMSHAResult::NullPointer; }
+	for (std::size_t i = 0; i < count; i++) {
+		if (nullptr == updates[i].key) { return EMSHAResult::NullPointer; }
+	}
+
+	std::vector<nodeID>	dirty;
+
+	for (std::size_t i = 0; i < count; i++) {
+		nodeID	id;
+
+		std::copy(updates[i].key, updates[i].key + SHA256_HASH_SIZE, id.path);
+		id.depth = SMT_DEPTH;
+
+		if (nullptr == updates[i].value) {
+			if (this->values.erase(id) != 0) {
+				this->remove(id, dirty);
+			}
+			continue;
+		}
+
+		digest&	v = this->values[id];
+
+		std::copy(updates[i].value, updates[i].value + SHA256_HASH_SIZE, v.d);
+		this->set(id, dirty);
+	}
+
+	if (count == 0) {
+		return EMSHAResult::OK;
+	}
+
+	// Every branch below another is deeper than it, so rebuilding
+	// the deepest first means each side is rebuilt once, from
+	// hashes that are already up to date. Branches that were
+	// merged away are no longer found.
+	auto const deeper = [](const nodeID& a, const nodeID& b) {
+		if (a.depth != b.depth) {
+			return a.depth > b.depth;
+		}
+		return std::memcmp(a.path, b.path, sizeof(a.path)) < 0;
+	};
+	std::sort(dirty.begin(), dirty.end(), deeper);
+	dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+	for (const auto& id : dirty) {
+		auto const it = this->branches.find(id);
+		if (it == this->branches.end()) {
+			continue;
+		}
+
+		branch&	b = it->second;
+		for (uint32_t side = 0; side < 2; side++) {
+			if (b.stale[side]) {
+				this->subtreeHash(b.kids[side], id.depth + 1U, b.hashes[side].d);
+				b.stale[side] = false;
+			}
+		}
+	}
+
+	if (this->values.empty()) {
+		const uint8_t	*empty = EmptyHash(0);
+
+		std::copy(empty, empty + SHA256_HASH_SIZE, this->rootHash.d);
+	} else {
+		this->subtreeHash(this->top, 0, this->rootHash.d);
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+bool
+SparseMerkleTree::Lookup(const uint8_t *key, uint8_t *value) const
+{
+	nodeID	id;
+
+	std::copy(key, key + SHA256_HASH_SIZE, id.path);
+	id.depth = SMT_DEPTH;
+
+	auto const it = this->values.find(id);
+	if (it == this->values.end()) {
+		return false;
+	}
+
+	std::copy(it->second.d, it->second.d + SHA256_HASH_SIZE, value);
+	return true;
+}
+
+
+EMSHAResult
+SparseMerkleTree::Prove(const uint8_t *key, SMTProof& proof) const
+{
+	if (nullptr == key) { return EMSHAResult::NullPointer; }
+
+	std::fill(proof.bitmap, proof.bitmap + sizeof(proof.bitmap), 0);
+	proof.siblings.clear();
+	if (this->values.empty()) {
+		return EMSHAResult::OK;
+	}
+
+	// Only the branches on the key's path, and the subtree the key
+	// leaves the tree beside if it's absent, have non-empty
+	// siblings. They're found from the top down, and the proof
+	// lists them from the bottom up.
+	std::vector<digest>	found;
+	nodeID			cur = this->top;
+	uint32_t		level = 0;
+
+	for (;;) {
+		uint32_t const	depth = cur.depth;
+		uint32_t const	split = firstDiff(key, cur.path, level, depth);
+
+		if (split < depth) {
+			found.emplace_back();
+			this->subtreeHash(cur, split + 1, found.back().d);
+			proof.bitmap[split / 8] |= static_cast<uint8_t>(0x80 >> (split % 8));
+			break;
+		}
+
+		if (depth == SMT_DEPTH) {
+			break;
+		}
+
+		const branch&	b = this->branches.find(cur)->second;
+		uint8_t const	side = pathBit(key, depth);
+
+		found.push_back(b.hashes[side ^ 1]);
+		proof.bitmap[depth / 8] |= static_cast<uint8_t>(0x80 >> (depth % 8));
+		cur   = b.kids[side];
+		level = depth + 1;
+	}
+
+	for (auto it = found.rbegin(); it != found.rend(); ++it) {
+		proof.siblings.insert(proof.siblings.end(), it->d, it->d + SHA256_HASH_SIZE);
+	}
+
+	return EMSHAResult::OK;
+}
+
+
+EMSHAResult
+SMTVerify(const uint8_t *root, const uint8_t *key, const uint8_t *value,
+	  const SMTProof& proof)
+{
+	if ((nullptr == root) || (nullptr == key)) { return EMSHAResult::NullPointer; }
+	if ((proof.siblings.size() % SHA256_HASH_SIZE) != 0) {
+		return EMSHAResult::InvalidState;
+	}
+
+	uint8_t		h[SHA256_HASH_SIZE];
+	std::size_t	next = 0;
+
+	if (nullptr == value) {
+		const uint8_t *empty = SparseMerkleTree::EmptyHash(SMT_DEPTH);
+		std::copy(empty, empty + SHA256_HASH_SIZE, h);
+	} else {
+		sha256_node(leafPrefix, key, value, h);
+	}
+
+	for (uint32_t d = SMT_DEPTH; d > 0; d--) {
+		const uint8_t	*sibling;
+
+		if (pathBit(proof.bitmap, d - 1)) {
+			if ((next + SHA256_HASH_SIZE) > proof.siblings.size()) {
+				return EMSHAResult::InvalidState;
+			}
+			sibling = proof.siblings.data() + next;
+			next += SHA256_HASH_SIZE;
+		} else {
+			sibling = SparseMerkleTree::EmptyHash(d);
+		}
+
+		if (pathBit(key, d - 1)) {
+			sha256_node(nodePrefix, sibling, h, h);
+		} else {
+			sha256_node(nodePrefix, h, sibling, h);
+		}
+	}
+
+	if (next != proof.siblings.size()) {
+		return EMSHAResult::InvalidState;
+	}
+
+	return HashEqual(h, root) ? EMSHAResult::OK : EMSHAResult::VerifyFailed;
+}
+
+
+} // end of namespace emsha
@@ -0,0 +1,170 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstdint>
+
+#ifdef EMSHA_STATS
+#include <mutex>
+#include <vector>
+#endif
+
+#include <emsha/emsha.h>
+#include <emsha/stats.h>
+#include <emsha/internal.h>
+
+
+namespace emsha {
+
+
+#ifdef EMSHA_STATS
+
+
+thread_local statsCounters	*statsLocal = nullptr;
+
+
+namespace {
+
+
+// The registry tracks every live thread's counters, plus the totals
+// left behind by threads that have exited. The lock is only taken
+// when a thread first counts something, when it exits, and when a
+// snapshot is taken; never on the hashing path.
+struct statsRegistry {
+	std::mutex			mtx;
+	std::vector<statsCounters *>	live;
+	std::uint64_t			retired[STATS_COUNTERS];
+};
+
+
+statsRegistry&
+registry()
+{
+	// Deliberately leaked, so that threads exiting during static
+	// destruction can still retire their counters.
+	static statsRegistry	*r = new statsRegistry();
+
+	return *r;
+}
+
+
+// statsOwner retires the thread's counters when the thread exits.
+struct statsOwner {
+	statsCounters	*sc;
+
+	~statsOwner()
+	{
+		statsRegistry&			r = registry();
+		std::lock_guard<std::mutex>	lock(r.mtx);
+
+		for (uint32_t i = 0; i < STATS_COUNTERS; i++) {
+			r.retired[i] += this->sc->c[i].load(std::memory_order_relaxed);
+		}
+		r.live.erase(std::remove(r.live.begin(), r.live.end(), this->sc),
+			     r.live.end());
+
+		statsLocal = nullptr;
+		delete this->sc;
+	}
+};
+
+
+} // anonymous namespace
+
+
+statsCounters *
+statsRegister()
+{
+	static thread_local statsOwner	owner{nullptr};
+	statsCounters			*sc = new statsCounters();
+
+	for (uint32_t i = 0; i < STATS_COUNTERS; i++) {
+		sc->c[i].store(0, std::memory_order_relaxed);
+	}
+
+	{
+		statsRegistry&			r = registry();
+		std::lock_guard<std::mutex>	lock(r.mtx);
+		r.live.push_back(sc);
+	}
+
+	owner.sc   = sc;
+	statsLocal = sc;
+	return sc;
+}
+
+
+bool
+StatsEnabled()
+{
+	return true;
+}
+
+
+void
+StatsSnapshot(Stats& stats)
+{
+	std::uint64_t			totals[STATS_COUNTERS];
+	statsRegistry&			r = registry();
+	std::lock_guard<std::mutex>	lock(r.mtx);
+
+	std::copy(r.retired, r.retired + STATS_COUNTERS, totals);
+	for (auto sc : r.live) {
+		for (uint32_t i = 0; i < STATS_COUNTERS; i++) {
+			totals[i] += sc->c[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	stats.bytesHashed      = totals[StatBytesHashed];
+	stats.blocksCompressed = totals[StatBlocksCompressed];
+	stats.updateCalls      = totals[StatUpdateCalls];
+	stats.finaliseCalls    = totals[StatFinaliseCalls];
+	stats.hmacKeySetups    = totals[StatHMACKeySetups];
+	stats.laneBlocks       = totals[StatLaneBlocks];
+	std::copy(totals + StatResults, totals + STATS_COUNTERS, stats.results);
+}
+
+
+#else // #ifdef EMSHA_STATS
+
+
+bool
+StatsEnabled()
+{
+	return false;
+}
+
+
+void
+StatsSnapshot(Stats& stats)
+{
+	stats = Stats{};
+}
+
+
+#endif // #ifdef EMSHA_STATS
+
+
+} // end of namespace emsha
@@ -0,0 +1,218 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/hmac.h>
+#include <emsha/compact.h>
+#include <emsha/batch.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *area = "batch HMAC";
+
+
+static const uint32_t	keyCount = 4;
+static vector<uint8_t>	rawKeys[keyCount];
+static emsha::HMACMidstate	keys[keyCount];
+
+
+static void
+setupKeys()
+{
+	// Short keys, a block-sized key and a key long enough to be
+	// hashed down.
+	static const uint32_t	lengths[keyCount] = {16, 32, 64, 100};
+
+	for (uint32_t k = 0; k < keyCount; k++) {
+		rawKeys[k].resize(lengths[k]);
+		for (uint32_t i = 0; i < lengths[k]; i++) {
+			rawKeys[k][i] = static_cast<uint8_t>((k * 37) + i);
+		}
+		emsha::HMACPrecompute(rawKeys[k].data(), lengths[k], keys[k]);
+	}
+}
+
+
+static void
+referenceHMAC(uint32_t key, const vector<uint8_t>& m, uint8_t *tag)
+{
+	emsha::HMAC	h(rawKeys[key].data(), static_cast<uint32_t>(rawKeys[key].size()));
+
+	if (!m.empty()) {
+		h.Update(m.data(), static_cast<uint32_t>(m.size()));
+	}
+	h.Finalise(tag);
+}
+
+
+static bool
+bit(const vector<uint64_t>& results, size_t i)
+{
+	return ((results[i / 64] >> (i % 64)) & 1) != 0;
+}
+
+
+static void
+verifyTest()
+{
+	// Lengths around the one and two tail block boundaries, and
+	// enough items to span several result words.
+	const size_t			count = 150;
+	vector<vector<uint8_t>>		messages(count);
+	vector<vector<uint8_t>>		tags(count, vector<uint8_t>(emsha::SHA256_HASH_SIZE));
+	vector<emsha::HMACBatchItem>	items(count);
+	vector<bool>			want(count, true);
+	vector<uint64_t>		results(emsha::HMACBatchResultWords(count));
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t const	length = static_cast<uint32_t>((i * 7) % 200);
+		uint32_t const	key = static_cast<uint32_t>((i * 5) % keyCount);
+
+		messages[i].resize(length);
+		for (uint32_t j = 0; j < length; j++) {
+			messages[i][j] = static_cast<uint8_t>(i + (j * 3));
+		}
+		referenceHMAC(key, messages[i], tags[i].data());
+
+		items[i].key           = key;
+		items[i].message       = messages[i].data();
+		items[i].messageLength = length;
+		items[i].tag           = tags[i].data();
+		items[i].tagLength     = emsha::SHA256_HASH_SIZE - (i % 17);
+	}
+
+	if (emsha::EMSHAResult::OK !=
+	    emsha::HMACVerifyBatch(keys, keyCount, items.data(), count, results.data())) {
+		fail(area, "valid batch rejected");
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (!bit(results, i)) {
+			fail(area, "item " + to_string(i) + " not verified");
+		}
+	}
+
+	// Corrupt the last byte of some tags, point some items at the
+	// wrong key and give some invalid tag lengths.
+	for (size_t i = 0; i < count; i += 3) {
+		tags[i][items[i].tagLength - 1] ^= 0x80;
+		want[i] = false;
+	}
+	items[1].key = (items[1].key + 1) % keyCount;
+	items[4].key = keyCount;
+	items[7].tagLength = emsha::HMAC_MIN_TAG_LENGTH - 1;
+	items[10].tagLength = emsha::SHA256_HASH_SIZE + 1;
+	want[1] = want[4] = want[7] = want[10] = false;
+
+	if (emsha::EMSHAResult::VerifyFailed !=
+	    emsha::HMACVerifyBatch(keys, keyCount, items.data(), count, results.data())) {
+		fail(area, "invalid batch accepted");
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (bit(results, i) != want[i]) {
+			fail(area, "item " + to_string(i) + " has the wrong result");
+		}
+	}
+	for (size_t i = count; i < (results.size() * 64); i++) {
+		if (bit(results, i)) {
+			fail(area, "bit set past the end of the batch");
+		}
+	}
+
+	items[2].tag = nullptr;
+	if (emsha::EMSHAResult::NullPointer !=
+	    emsha::HMACVerifyBatch(keys, keyCount, items.data(), count, results.data())) {
+		fail(area, "nullptr tag accepted");
+	}
+
+	if (emsha::EMSHAResult::OK !=
+	    emsha::HMACVerifyBatch(keys, keyCount, nullptr, 0, nullptr)) {
+		fail(area, "empty batch rejected");
+	}
+
+	cout << "PASSED: batch HMAC verification\n";
+}
+
+
+static void
+signManyTest()
+{
+	// Enough keys to need more than one pass, and messages around
+	// the tail block boundaries.
+	const size_t			count = 150;
+	vector<emsha::HMACMidstate>	many(count);
+	vector<uint8_t>			tags(count * emsha::SHA256_HASH_SIZE);
+	uint8_t				want[emsha::SHA256_HASH_SIZE];
+
+	for (size_t i = 0; i < count; i++) {
+		many[i] = keys[i % keyCount];
+	}
+
+	for (uint32_t length : {0U, 1U, 55U, 56U, 64U, 119U, 120U, 1000U}) {
+		vector<uint8_t>	m(length);
+
+		for (uint32_t j = 0; j < length; j++) {
+			m[j] = static_cast<uint8_t>(j ^ 0x5a);
+		}
+
+		if (emsha::EMSHAResult::OK !=
+		    emsha::HMACSignMany(many.data(), count, m.data(), length, tags.data())) {
+			fail(area, "signing with many keys failed");
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			referenceHMAC(static_cast<uint32_t>(i % keyCount), m, want);
+			if (!emsha::HashEqual(want, tags.data() + (i * emsha::SHA256_HASH_SIZE))) {
+				fail(area, "wrong HMAC for key " + to_string(i) + " over " +
+				     to_string(length) + " bytes");
+			}
+		}
+	}
+
+	if (emsha::EMSHAResult::NullPointer !=
+	    emsha::HMACSignMany(many.data(), count, nullptr, 1, tags.data())) {
+		fail(area, "nullptr message accepted");
+	}
+
+	cout << "PASSED: signing with many keys\n";
+}
+
+
+int
+main()
+{
+	setupKeys();
+	verifyTest();
+	signManyTest();
+	exit(0);
+}
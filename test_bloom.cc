@@ -0,0 +1,244 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/digest.h>
+#include <emsha/bloom.h>
+#include <emsha/internal.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *testPath = "test_bloom.dat";
+
+
+static const char *area = "bloom filter";
+
+
+// queryTest fills a filter at its default 16 bits per digest, where
+// the false positive rate should be about 0.1%.
+static void
+queryTest(const string& label)
+{
+	const uint32_t		count = 32768;
+	const uint32_t		trials = 200000;
+	emsha::BloomFilter	filter(count);
+	vector<emsha::Digest>	queries;
+	uint32_t		positives = 0;
+
+	for (uint32_t i = 0; i < count; i++) {
+		filter.Add(testDigest(i));
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (!filter.MayContain(testDigest(i))) {
+			fail(area, "digest " + to_string(i) + " missing");
+		}
+	}
+
+	for (uint32_t i = count; i < count + trials; i++) {
+		if (filter.MayContain(testDigest(i))) {
+			positives++;
+		}
+	}
+	if (positives > (trials / 500)) {
+		fail(area, "false positive rate too high: " + to_string(positives) +
+		     " of " + to_string(trials));
+	}
+
+	// The batch query agrees with single queries, including in a
+	// partial final group and word.
+	for (uint32_t i = count - 500; i < count + 1000 + 3; i++) {
+		queries.push_back(testDigest(i));
+	}
+
+	vector<uint64_t>	results(emsha::BloomResultWords(queries.size()));
+	size_t			found = filter.MayContainMany(queries.data(), queries.size(),
+							      results.data());
+	size_t			expected = 0;
+
+	for (size_t i = 0; i < queries.size(); i++) {
+		bool const	single = filter.MayContain(queries[i]);
+		bool const	batch = ((results[i / 64] >> (i % 64)) & 1) != 0;
+
+		if (single != batch) {
+			fail(area, "batch result " + to_string(i) + " differs");
+		}
+		expected += single ? 1 : 0;
+	}
+	if (found != expected) {
+		fail(area, "wrong batch count");
+	}
+
+	cout << "PASSED: " << label << " bloom filter queries (" << positives
+	     << " false positives in " << trials << ")\n";
+}
+
+
+// pathTest checks that the scalar probe agrees with the default one,
+// which is the AVX2 probe where the CPU has it, on a filter with
+// both hits and misses.
+static void
+pathTest()
+{
+	emsha::BloomFilter	filter(1000, 4);
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		filter.Add(testDigest(i));
+	}
+
+	for (uint32_t i = 0; i < 20000; i++) {
+		emsha::Digest const	d = testDigest(i);
+		bool const		fast = filter.MayContain(d);
+
+		emsha::bloom_force_scalar(true);
+		bool const		slow = filter.MayContain(d);
+		emsha::bloom_force_scalar(false);
+
+		if (fast != slow) {
+			fail(area, "the scalar probe disagrees on digest " + to_string(i));
+		}
+	}
+
+	cout << "PASSED: bloom filter scalar and default probes agree\n";
+}
+
+
+static void
+mergeTest()
+{
+	emsha::BloomFilter	a(1000);
+	emsha::BloomFilter	b(1000);
+	emsha::BloomFilter	c(100000);
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		a.Add(testDigest(i));
+		b.Add(testDigest(i + 1000));
+	}
+
+	if (emsha::EMSHAResult::InvalidState != a.Merge(c)) {
+		fail(area, "merged filters of different sizes");
+	}
+	if (emsha::EMSHAResult::OK != a.Merge(b)) {
+		fail(area, "couldn't merge filters");
+	}
+	for (uint32_t i = 0; i < 2000; i++) {
+		if (!a.MayContain(testDigest(i))) {
+			fail(area, "merged filter is missing digest " + to_string(i));
+		}
+	}
+
+	a.Clear();
+	for (uint32_t i = 0; i < 2000; i++) {
+		if (a.MayContain(testDigest(i))) {
+			fail(area, "cleared filter still has digest " + to_string(i));
+		}
+	}
+
+	cout << "PASSED: bloom filter merge\n";
+}
+
+
+static void
+serializeTest()
+{
+	emsha::BloomFilter	filter(5000);
+	emsha::BloomFilter	loaded(10);
+	vector<uint8_t>		buf(filter.SerializedSize());
+
+	for (uint32_t i = 0; i < 5000; i++) {
+		filter.Add(testDigest(i));
+	}
+
+	if (emsha::EMSHAResult::NoSpace != filter.Serialize(buf.data(), buf.size() - 1)) {
+		fail(area, "serialised into a short buffer");
+	}
+	if (emsha::EMSHAResult::OK != filter.Serialize(buf.data(), buf.size())) {
+		fail(area, "couldn't serialise");
+	}
+	if (emsha::EMSHAResult::OK != loaded.Deserialize(buf.data(), buf.size())) {
+		fail(area, "couldn't deserialise");
+	}
+	if (loaded.Blocks() != filter.Blocks()) {
+		fail(area, "deserialised filter has the wrong size");
+	}
+	for (uint32_t i = 0; i < 5000; i++) {
+		if (!loaded.MayContain(testDigest(i))) {
+			fail(area, "deserialised filter is missing digest " + to_string(i));
+		}
+	}
+
+	if (emsha::EMSHAResult::InvalidState != loaded.Deserialize(buf.data(), buf.size() - 1)) {
+		fail(area, "deserialised a truncated filter");
+	}
+	buf[emsha::BLOOM_HEADER_SIZE + 5] ^= 0x10;
+	if (emsha::EMSHAResult::VerifyFailed != loaded.Deserialize(buf.data(), buf.size())) {
+		fail(area, "deserialised a damaged filter");
+	}
+
+	if (emsha::EMSHAResult::OK != filter.Save(testPath)) {
+		fail(area, "couldn't save the filter");
+	}
+	emsha::BloomFilter	fromFile(1);
+	if (emsha::EMSHAResult::OK != fromFile.Load(testPath)) {
+		fail(area, "couldn't load the filter");
+	}
+	for (uint32_t i = 0; i < 5000; i++) {
+		if (!fromFile.MayContain(testDigest(i))) {
+			fail(area, "loaded filter is missing digest " + to_string(i));
+		}
+	}
+	if (emsha::EMSHAResult::IOError != fromFile.Load("test_bloom.missing")) {
+		fail(area, "loaded a missing file");
+	}
+	remove(testPath);
+
+	cout << "PASSED: bloom filter serialisation\n";
+}
+
+
+int
+main()
+{
+	queryTest("default");
+
+	emsha::bloom_force_scalar(true);
+	queryTest("scalar");
+	emsha::bloom_force_scalar(false);
+
+	pathTest();
+	mergeTest();
+	serializeTest();
+
+	exit(0);
+}
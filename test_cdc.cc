@@ -0,0 +1,262 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/digest.h>
+#include <emsha/cdc.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *area = "content-defined chunking";
+
+
+static vector<uint8_t>
+testData(size_t length, uint64_t seed)
+{
+	vector<uint8_t>	data(length);
+	uint64_t	x = seed;
+
+	for (size_t i = 0; i < length; i++) {
+		x = (x * 6364136223846793005ULL) + 1442695040888963407ULL;
+		data[i] = static_cast<uint8_t>(x >> 56);
+	}
+	return data;
+}
+
+
+static vector<emsha::CDCChunk>
+chunk(const vector<uint8_t>& data, size_t step, uint32_t threads)
+{
+	emsha::CDCChunker		chunker(emsha::CDC_MIN_SIZE, emsha::CDC_AVG_SIZE,
+						emsha::CDC_MAX_SIZE, threads);
+	vector<emsha::CDCChunk>		chunks;
+
+	for (size_t i = 0; i < data.size(); i += step) {
+		size_t const	n = min(step, data.size() - i);
+
+		if (emsha::EMSHAResult::OK != chunker.Update(data.data() + i, n, chunks)) {
+			fail(area, "update failed");
+		}
+	}
+	if (emsha::EMSHAResult::OK != chunker.Finalise(chunks)) {
+		fail(area, "finalise failed");
+	}
+	return chunks;
+}
+
+
+static void
+checkChunks(const vector<uint8_t>& data, const vector<emsha::CDCChunk>& chunks)
+{
+	uint64_t	offset = 0;
+
+	for (size_t i = 0; i < chunks.size(); i++) {
+		const emsha::CDCChunk&	c = chunks[i];
+
+		if (c.offset != offset) {
+			fail(area, "chunk " + to_string(i) + " isn't contiguous");
+		}
+		if ((c.length > emsha::CDC_MAX_SIZE) ||
+		    ((c.length < emsha::CDC_MIN_SIZE) && (i != (chunks.size() - 1)))) {
+			fail(area, "chunk " + to_string(i) + " has length " + to_string(c.length));
+		}
+		if (c.digest != emsha::SHA256Digest(data.data() + c.offset, c.length)) {
+			fail(area, "chunk " + to_string(i) + " has the wrong digest");
+		}
+		offset += c.length;
+	}
+
+	if (offset != data.size()) {
+		fail(area, "chunks don't cover the data");
+	}
+}
+
+
+static bool
+sameChunks(const vector<emsha::CDCChunk>& a, const vector<emsha::CDCChunk>& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); i++) {
+		if ((a[i].offset != b[i].offset) || (a[i].length != b[i].length) ||
+		    (a[i].digest != b[i].digest)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static void
+chunkTest()
+{
+	vector<uint8_t> const		data = testData(3 * 1024 * 1024 + 123, 1);
+	vector<emsha::CDCChunk> const	chunks = chunk(data, data.size(), 1);
+
+	checkChunks(data, chunks);
+
+	double const	average = static_cast<double>(data.size()) / chunks.size();
+	if ((average < (emsha::CDC_AVG_SIZE / 2)) || (average > (emsha::CDC_AVG_SIZE * 2))) {
+		fail(area, "average chunk size " + to_string(average));
+	}
+
+	// The chunks don't depend on how the data is fed in, or on the
+	// number of threads.
+	for (size_t step : {1000, 65536, 1024 * 1024 + 1}) {
+		if (!sameChunks(chunks, chunk(data, step, 1))) {
+			fail(area, "chunks change with an update size of " + to_string(step));
+		}
+	}
+	if (!sameChunks(chunks, chunk(data, data.size(), 3)) ||
+	    !sameChunks(chunks, chunk(data, 777777, 4))) {
+		fail(area, "chunks change with the number of threads");
+	}
+
+	cout << "PASSED: content-defined chunking (" << chunks.size() << " chunks)\n";
+}
+
+
+static void
+shiftTest()
+{
+	vector<uint8_t>			data = testData(1024 * 1024, 2);
+	vector<emsha::CDCChunk> const	before = chunk(data, data.size(), 1);
+	set<emsha::Digest>		seen;
+	size_t				shared = 0;
+
+	// Inserting bytes near the start should only disturb the
+	// chunks around the insertion.
+	vector<uint8_t> const	insert = testData(100, 3);
+	data.insert(data.begin() + 5000, insert.begin(), insert.end());
+
+	vector<emsha::CDCChunk> const	after = chunk(data, data.size(), 1);
+	checkChunks(data, after);
+
+	for (auto& c : before) {
+		seen.insert(c.digest);
+	}
+	for (auto& c : after) {
+		shared += seen.count(c.digest);
+	}
+	if (shared + 3 < before.size()) {
+		fail(area, "an insertion changed " + to_string(before.size() - shared) + " chunks");
+	}
+
+	cout << "PASSED: content-defined chunking after an insertion\n";
+}
+
+
+static void
+edgeTest()
+{
+	emsha::CDCChunker		chunker;
+	vector<emsha::CDCChunk>		chunks;
+	vector<uint8_t>			zeroes(200000, 0);
+
+	if (emsha::EMSHAResult::NullPointer != chunker.Update(nullptr, 1, chunks)) {
+		fail(area, "chunked a nullptr");
+	}
+	if ((emsha::EMSHAResult::OK != chunker.Finalise(chunks)) || !chunks.empty()) {
+		fail(area, "an empty stream should have no chunks");
+	}
+
+	// Data without boundaries is cut at the maximum size.
+	chunks = chunk(zeroes, zeroes.size(), 1);
+	checkChunks(zeroes, chunks);
+	for (size_t i = 0; i + 1 < chunks.size(); i++) {
+		if (chunks[i].length != emsha::CDC_MAX_SIZE) {
+			fail(area, "constant data wasn't cut at the maximum chunk size");
+		}
+	}
+
+	// A short stream is a single chunk.
+	vector<uint8_t> const	small = testData(100, 4);
+	chunks = chunk(small, 7, 1);
+	checkChunks(small, chunks);
+	if (chunks.size() != 1) {
+		fail(area, "a short stream should be one chunk");
+	}
+
+	// Sizes that can't work are rejected rather than replaced.
+	const uint32_t		bad[][3] = {
+		{0, 0, 0}, {2048, 0, 65536}, {2048, 3000, 65536},
+		{32, 8192, 65536}, {8192, 8192, 65536}, {2048, 8192, 4096},
+	};
+
+	if (!emsha::CDCChunker::ValidSizes(emsha::CDC_MIN_SIZE, emsha::CDC_AVG_SIZE,
+					   emsha::CDC_MAX_SIZE) ||
+	    !emsha::CDCChunker::ValidSizes(64, 128, 129)) {
+		fail(area, "valid sizes were rejected");
+	}
+
+	for (const auto& sizes : bad) {
+		string const	label = to_string(sizes[0]) + "/" +
+					to_string(sizes[1]) + "/" + to_string(sizes[2]);
+
+		if (emsha::CDCChunker::ValidSizes(sizes[0], sizes[1], sizes[2])) {
+			fail(area, "invalid sizes " + label + " were accepted");
+		}
+
+#ifdef NDEBUG
+		// With asserts on, using such a chunker aborts instead.
+		emsha::CDCChunker	odd(sizes[0], sizes[1], sizes[2]);
+		uint8_t const		byte = 0;
+
+		chunks.clear();
+		if ((emsha::EMSHAResult::InvalidState != odd.Update(&byte, 1, chunks)) ||
+		    (emsha::EMSHAResult::InvalidState != odd.Finalise(chunks)) ||
+		    !chunks.empty()) {
+			fail(area, "a chunker with invalid sizes " + label + " was usable");
+		}
+#endif
+	}
+
+	cout << "PASSED: content-defined chunking edge cases\n";
+}
+
+
+int
+main()
+{
+	chunkTest();
+	shiftTest();
+	edgeTest();
+
+	exit(0);
+}
@@ -0,0 +1,245 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/chunked.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const uint8_t	key[] = "chunked stream test key";
+static const uint32_t	chunkSize = 256;
+
+
+static const char *area = "chunked stream";
+
+
+static vector<uint8_t>
+encode(const emsha::ChunkedStream& cs, uint64_t dataLength, uint8_t fill = 13)
+{
+	vector<uint8_t>	data(dataLength);
+	vector<uint8_t>	encoded(cs.EncodedLength(dataLength));
+
+	for (uint64_t i = 0; i < dataLength; i++) {
+		data[i] = static_cast<uint8_t>(i * fill);
+	}
+
+	if (emsha::EMSHAResult::OK != cs.Encode(data.data(), dataLength, encoded.data())) {
+		fail(area, "encode");
+	}
+
+	return encoded;
+}
+
+
+// Every range of the data verifies from just the chunks covering it.
+static void
+rangeTest()
+{
+	emsha::ChunkedStream	cs(key, sizeof(key), chunkSize);
+
+	for (uint64_t dataLength : {0, 1, 255, 256, 257, 1000, 2048}) {
+		vector<uint8_t> const	encoded = encode(cs, dataLength);
+
+		uint64_t	headerLength = 0;
+
+		if ((emsha::EMSHAResult::OK != cs.CheckHeader(encoded.data(), &headerLength)) ||
+		    (headerLength != dataLength)) {
+			fail(area, "header");
+		}
+
+		for (uint64_t offset = 0; offset <= dataLength; offset += 97) {
+			uint64_t const	length = min<uint64_t>(300, dataLength - offset);
+			uint64_t	first, start, end;
+
+			if (emsha::EMSHAResult::OK !=
+			    cs.EncodedRange(dataLength, offset, length, first, start, end)) {
+				fail(area, "range");
+			}
+
+			if (end > encoded.size()) {
+				fail(area, "range extends past the stream");
+			}
+
+			// The data asked for is inside the chunks returned.
+			uint64_t const	chunkData = first * chunkSize;
+			if ((chunkData > offset) ||
+			    ((end - start) < (length + (offset - chunkData)))) {
+				fail(area, "range doesn't cover the data");
+			}
+
+			if (emsha::EMSHAResult::OK !=
+			    cs.VerifyChunks(encoded.data(), first, encoded.data() + start, end - start)) {
+				fail(area, "verifying a range");
+			}
+		}
+	}
+
+	cout << "PASSED: chunked stream ranges\n";
+}
+
+
+static void
+tamperTest()
+{
+	emsha::ChunkedStream	cs(key, sizeof(key), chunkSize);
+	emsha::ChunkedStream	other(key, sizeof(key), chunkSize * 2);
+	uint64_t const		dataLength = 10 * chunkSize + 17;
+	vector<uint8_t>		encoded = encode(cs, dataLength);
+	uint64_t const		body = emsha::CHUNKED_HEADER_SIZE;
+	uint64_t const		bodyLength = encoded.size() - body;
+
+	for (uint32_t threads : {1, 4}) {
+		if (emsha::EMSHAResult::OK !=
+		    cs.VerifyChunks(encoded.data(), 0, encoded.data() + body, bodyLength, threads)) {
+			fail(area, "verifying the whole stream");
+		}
+	}
+
+	// A flipped bit anywhere, header included, is caught, by
+	// however many threads.
+	for (uint64_t pos = 0; pos < encoded.size(); pos += 149) {
+		encoded[pos] ^= 0x10;
+		for (uint32_t threads : {1, 3}) {
+			if (emsha::EMSHAResult::VerifyFailed !=
+			    cs.VerifyChunks(encoded.data(), 0, encoded.data() + body, bodyLength, threads)) {
+				fail(area, "a modified stream verified");
+			}
+		}
+		encoded[pos] ^= 0x10;
+	}
+
+	// Chunks can't be moved to another position.
+	uint64_t const stride = chunkSize + emsha::CHUNKED_TAG_SIZE;
+	if (emsha::EMSHAResult::VerifyFailed !=
+	    cs.VerifyChunks(encoded.data(), 2, encoded.data() + body + stride, stride)) {
+		fail(area, "a moved chunk verified");
+	}
+
+	// Dropping the tail means changing the length in the header,
+	// which every tag covers.
+	vector<uint8_t>	header(encoded.begin(), encoded.begin() + body);
+	uint8_t		streamID[emsha::CHUNKED_STREAM_ID_SIZE];
+
+	copy(header.begin() + 16, header.begin() + 32, streamID);
+	cs.WriteHeader(header.data(), streamID, 9 * chunkSize + 100);
+	if (emsha::EMSHAResult::VerifyFailed !=
+	    cs.VerifyChunks(header.data(), 9, encoded.data() + cs.ChunkOffset(9),
+			    100 + emsha::CHUNKED_TAG_SIZE)) {
+		fail(area, "a truncated stream verified");
+	}
+
+	if (emsha::EMSHAResult::InvalidState !=
+	    cs.VerifyChunks(encoded.data(), 0, encoded.data() + body, bodyLength - 1)) {
+		fail(area, "a partial chunk was accepted");
+	}
+
+	if (emsha::EMSHAResult::VerifyFailed != other.CheckHeader(encoded.data())) {
+		fail(area, "a header with the wrong chunk size was accepted");
+	}
+
+	cout << "PASSED: chunked stream tampering\n";
+}
+
+
+// Streams under the same key and chunk size can't have chunks
+// swapped between them.
+static void
+spliceTest()
+{
+	emsha::ChunkedStream	cs(key, sizeof(key), chunkSize);
+	uint64_t const		dataLength = 6 * chunkSize;
+	vector<uint8_t>		a = encode(cs, dataLength, 13);
+	vector<uint8_t> const	b = encode(cs, dataLength, 29);
+	vector<uint8_t> const	again = encode(cs, dataLength, 13);
+	uint64_t const		stride = chunkSize + emsha::CHUNKED_TAG_SIZE;
+	uint64_t const		body = emsha::CHUNKED_HEADER_SIZE;
+
+	if (equal(a.begin(), a.begin() + body, again.begin())) {
+		fail(area, "two streams have the same header");
+	}
+
+	copy(b.begin() + cs.ChunkOffset(3), b.begin() + cs.ChunkOffset(4),
+	     a.begin() + cs.ChunkOffset(3));
+	if (emsha::EMSHAResult::VerifyFailed !=
+	    cs.VerifyChunks(a.data(), 3, a.data() + cs.ChunkOffset(3), stride)) {
+		fail(area, "a chunk from another stream verified");
+	}
+	if (emsha::EMSHAResult::VerifyFailed !=
+	    cs.VerifyChunks(a.data(), 0, a.data() + body, a.size() - body)) {
+		fail(area, "a stream with a spliced chunk verified");
+	}
+
+	// Nor does the same data under another stream's header.
+	if (emsha::EMSHAResult::VerifyFailed !=
+	    cs.VerifyChunks(again.data(), 0, a.data() + body, stride)) {
+		fail(area, "a chunk verified under another stream's header");
+	}
+
+	cout << "PASSED: chunked stream splicing\n";
+}
+
+
+// A zero chunk size is replaced by the default rather than dividing
+// by zero.
+static void
+chunkSizeTest()
+{
+	emsha::ChunkedStream	cs(key, sizeof(key), 0);
+
+	if ((cs.ChunkSize() != emsha::CHUNKED_CHUNK_SIZE) || (cs.Chunks(0) != 1)) {
+		fail(area, "zero chunk size");
+	}
+
+	vector<uint8_t> const	encoded = encode(cs, 1000);
+	uint64_t const		body = emsha::CHUNKED_HEADER_SIZE;
+
+	if (emsha::EMSHAResult::OK !=
+	    cs.VerifyChunks(encoded.data(), 0, encoded.data() + body, encoded.size() - body)) {
+		fail(area, "default chunk size");
+	}
+
+	cout << "PASSED: chunked stream chunk size\n";
+}
+
+
+int
+main()
+{
+	rangeTest();
+	tamperTest();
+	spliceTest();
+	chunkSizeTest();
+	exit(0);
+}
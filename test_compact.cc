@@ -0,0 +1,197 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/hmac.h>
+#include <emsha/compact.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static constexpr uint32_t	streams = 8;
+static constexpr uint32_t	messageLength = 700;
+
+static uint8_t	message[messageLength];
+
+
+static const char *area = "compact contexts";
+
+
+static void
+expect(emsha::EMSHAResult res, const string& what)
+{
+	if (emsha::EMSHAResult::OK != res) {
+		fail(area, what);
+	}
+}
+
+
+// Interleave several streams over one slab, each written in different
+// step sizes, and check them against the regular contexts.
+static void
+interleavedTest()
+{
+	emsha::BlockSlab	slab(2 * streams);
+	emsha::HMACMidstate	key{};
+	emsha::CompactSHA256	sha[streams];
+	const uint8_t		rawKey[] = "a key that is shared by all of the streams";
+	uint8_t			want[emsha::SHA256_HASH_SIZE];
+	uint8_t			have[emsha::SHA256_HASH_SIZE];
+
+	expect(emsha::HMACPrecompute(rawKey, sizeof(rawKey), key), "precompute");
+
+	emsha::CompactHMAC	hmac[streams] = {
+		{&key, slab}, {&key, slab}, {&key, slab}, {&key, slab},
+		{&key, slab}, {&key, slab}, {&key, slab}, {&key, slab},
+	};
+
+	for (uint32_t off = 0; off < messageLength; off++) {
+		for (uint32_t s = 0; s < streams; s++) {
+			uint32_t const step = (s * 13) + 1;
+
+			if ((off % step) != 0) {
+				continue;
+			}
+
+			uint32_t const n = min(step, messageLength - off);
+			expect(sha[s].Update(slab, message + off, n), "SHA-256 update");
+			expect(hmac[s].Update(slab, message + off, n), "HMAC update");
+		}
+	}
+
+	for (uint32_t s = 0; s < streams; s++) {
+		expect(emsha::SHA256Digest(message, messageLength, want), "reference SHA-256");
+		expect(sha[s].Finalise(slab, have), "SHA-256 finalise");
+		if (!emsha::HashEqual(want, have)) {
+			fail(area, "SHA-256 digest mismatch");
+		}
+
+		expect(emsha::ComputeHMAC(rawKey, sizeof(rawKey), message,
+					  messageLength, want), "reference HMAC");
+		expect(hmac[s].Finalise(slab, have), "HMAC finalise");
+		if (!emsha::HashEqual(want, have)) {
+			fail(area, "HMAC mismatch");
+		}
+
+		expect(emsha::ComputeHMAC(key, message, messageLength, have),
+		       "single-pass HMAC");
+		if (!emsha::HashEqual(want, have)) {
+			fail(area, "single-pass HMAC mismatch");
+		}
+	}
+
+	if (slab.Available() != slab.Capacity()) {
+		fail(area, "blocks were not returned to the slab");
+	}
+
+	emsha::HMACMidstateWipe(key);
+	cout << "PASSED: interleaved compact contexts\n";
+}
+
+
+// Keys longer than a block are hashed down first.
+static void
+longKeyTest()
+{
+	uint8_t			rawKey[131];
+	emsha::HMACMidstate	key{};
+	uint8_t			want[emsha::SHA256_HASH_SIZE];
+	uint8_t			have[emsha::SHA256_HASH_SIZE];
+
+	for (uint32_t i = 0; i < sizeof(rawKey); i++) {
+		rawKey[i] = static_cast<uint8_t>(i);
+	}
+
+	expect(emsha::HMACPrecompute(rawKey, sizeof(rawKey), key), "precompute");
+	expect(emsha::ComputeHMAC(rawKey, sizeof(rawKey), message, 64, want), "reference HMAC");
+	expect(emsha::ComputeHMAC(key, message, 64, have), "single-pass HMAC");
+	if (!emsha::HashEqual(want, have)) {
+		fail(area, "long key HMAC mismatch");
+	}
+
+	cout << "PASSED: long HMAC key\n";
+}
+
+
+static void
+exhaustionTest()
+{
+	uint8_t			storage[emsha::SHA256_MB_SIZE];
+	uint32_t		freeList[1];
+	emsha::BlockSlab	slab(storage, freeList, 1);
+	emsha::CompactSHA256	a;
+	emsha::CompactSHA256	b;
+	uint8_t			want[emsha::SHA256_HASH_SIZE];
+	uint8_t			have[emsha::SHA256_HASH_SIZE];
+
+	expect(a.Update(slab, message, 10), "first stream update");
+	if (emsha::EMSHAResult::NoSpace != b.Update(slab, message, 10)) {
+		fail(area, "an empty slab should refuse a partial block");
+	}
+
+	// Whole blocks don't need a slab block at all.
+	expect(b.Update(slab, message, 128), "block-aligned update");
+
+	// Once a's block is back, b can carry on where it left off.
+	expect(a.Finalise(slab, have), "first stream finalise");
+	expect(b.Update(slab, message + 128, 10), "retried update");
+	expect(b.Finalise(slab, have), "second stream finalise");
+	expect(emsha::SHA256Digest(message, 138, want), "reference SHA-256");
+	if (!emsha::HashEqual(want, have)) {
+		fail(area, "digest mismatch after running out of blocks");
+	}
+
+	cout << "PASSED: slab exhaustion\n";
+}
+
+
+int
+main()
+{
+	for (uint32_t i = 0; i < messageLength; i++) {
+		message[i] = static_cast<uint8_t>(i ^ (i >> 3));
+	}
+
+	interleavedTest();
+	longKeyTest();
+	exhaustionTest();
+
+	cout << "per-stream footprint:\n";
+	cout << "\tSHA256:        " << sizeof(emsha::SHA256) << " bytes\n";
+	cout << "\tCompactSHA256: " << sizeof(emsha::CompactSHA256)
+	     << " bytes (+" << emsha::SHA256_MB_SIZE << " while mid-block)\n";
+	cout << "\tHMAC:          " << sizeof(emsha::HMAC) << " bytes\n";
+	cout << "\tCompactHMAC:   " << sizeof(emsha::CompactHMAC)
+	     << " bytes (+" << emsha::SHA256_MB_SIZE << " while mid-block)\n";
+	exit(0);
+}
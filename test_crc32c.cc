@@ -0,0 +1,214 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/crc32c.h>
+#include <emsha/internal.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *area = "CRC32C";
+
+
+// referenceCRC is the bit-at-a-time definition.
+static uint32_t
+referenceCRC(const uint8_t *p, size_t n)
+{
+	uint32_t	c = 0xffffffff;
+
+	for (size_t i = 0; i < n; i++) {
+		c ^= p[i];
+		for (int j = 0; j < 8; j++) {
+			c = (c >> 1) ^ ((c & 1) ? 0x82f63b78 : 0);
+		}
+	}
+	return ~c;
+}
+
+
+static void
+crcTest(const string& path)
+{
+	const uint8_t	check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+	vector<uint8_t>	zeroes(32, 0);
+	vector<uint8_t>	ones(32, 0xff);
+
+	// The check value, and the iSCSI test vectors from RFC 3720.
+	if (emsha::CRC32C(check, sizeof(check)) != 0xe3069283) {
+		fail(area, "check value");
+	}
+	if ((emsha::CRC32C(zeroes.data(), zeroes.size()) != 0x8a9136aa) ||
+	    (emsha::CRC32C(ones.data(), ones.size()) != 0x62a8ab43)) {
+		fail(area, "RFC 3720 vectors");
+	}
+
+	// Every alignment and tail length, whole and in two pieces.
+	vector<uint8_t>	data(300);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<uint8_t>((i * 37) ^ (i >> 3));
+	}
+
+	for (size_t start = 0; start < 9; start++) {
+		for (size_t n = 0; n + start <= data.size(); n += 7) {
+			uint32_t const	want = referenceCRC(data.data() + start, n);
+			uint32_t const	split = n / 3;
+
+			if (emsha::CRC32C(data.data() + start, n) != want) {
+				fail(area, "offset " + to_string(start) + ", length " + to_string(n));
+			}
+			if (emsha::CRC32C(data.data() + start + split, n - split,
+					  emsha::CRC32C(data.data() + start, split)) != want) {
+				fail(area, "continued CRC at offset " + to_string(start) +
+				     ", length " + to_string(n));
+			}
+		}
+	}
+
+	cout << "PASSED: CRC32C (" << path << ")\n";
+}
+
+
+// The software CRC has to agree with the default path, which is the
+// CRC32C instruction where there is one, at any length and alignment.
+static void
+pathTest()
+{
+	vector<uint8_t>	data(8192 + 16);
+	uint64_t	x = 0x9e3779b97f4a7c15ULL;
+
+	for (auto& b : data) {
+		x = (x * 6364136223846793005ULL) + 1442695040888963407ULL;
+		b = static_cast<uint8_t>(x >> 56);
+	}
+
+	for (int i = 0; i < 2000; i++) {
+		x = (x * 6364136223846793005ULL) + 1442695040888963407ULL;
+
+		size_t const	start = (x >> 33) % 16;
+		size_t const	n = (x >> 13) % 8193;
+		uint32_t const	seed = static_cast<uint32_t>(x);
+		uint32_t const	fast = emsha::CRC32C(data.data() + start, n, seed);
+
+		emsha::crc32c_force_software(true);
+		uint32_t const	slow = emsha::CRC32C(data.data() + start, n, seed);
+		emsha::crc32c_force_software(false);
+
+		if (fast != slow) {
+			fail(area, "the software CRC disagrees at offset " + to_string(start) +
+			     ", length " + to_string(n));
+		}
+	}
+
+	cout << "PASSED: CRC32C software and default paths agree\n";
+}
+
+
+static void
+combinedTest()
+{
+	vector<uint8_t>	data(5000);
+	uint8_t		expected[emsha::SHA256_HASH_SIZE];
+	uint8_t		actual[emsha::SHA256CRC32C_SIZE];
+	uint8_t		again[emsha::SHA256CRC32C_SIZE];
+
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<uint8_t>(i * 11);
+	}
+	emsha::SHA256Digest(data.data(), static_cast<uint32_t>(data.size()), expected);
+	uint32_t const	crc = referenceCRC(data.data(), data.size());
+
+	for (uint32_t step : {1, 63, 1000, 5000}) {
+		emsha::SHA256CRC32C	ctx;
+
+		for (size_t off = 0; off < data.size(); off += step) {
+			uint32_t const	n = static_cast<uint32_t>(min<size_t>(step, data.size() - off));
+
+			if (emsha::EMSHAResult::OK != ctx.Update(data.data() + off, n)) {
+				fail(area, "update");
+			}
+		}
+		if (ctx.CRC() != crc) {
+			fail(area, "running CRC with a step of " + to_string(step));
+		}
+		if ((emsha::EMSHAResult::OK != ctx.Finalise(actual)) ||
+		    (emsha::EMSHAResult::OK != ctx.Result(again))) {
+			fail(area, "finalise");
+		}
+
+		uint32_t const	stored = (static_cast<uint32_t>(actual[32]) << 24) |
+					 (static_cast<uint32_t>(actual[33]) << 16) |
+					 (static_cast<uint32_t>(actual[34]) << 8) | actual[35];
+		if (!emsha::HashEqual(expected, actual) || (stored != crc) ||
+		    !equal(actual, actual + sizeof(actual), again)) {
+			fail(area, "combined result with a step of " + to_string(step));
+		}
+	}
+
+	// It works through the Hash interface, and refuses updates once
+	// finalised.
+	emsha::SHA256CRC32C	ctx;
+	emsha::Hash&		h = ctx;
+
+	if ((h.Size() != emsha::SHA256CRC32C_SIZE) ||
+	    (emsha::EMSHAResult::OK != h.Finalise(actual)) ||
+	    (emsha::EMSHAResult::InvalidState != h.Update(data.data(), 10)) ||
+	    (ctx.CRC() != 0)) {
+		fail(area, "finalised context");
+	}
+	if ((emsha::EMSHAResult::OK != h.Reset()) ||
+	    (emsha::EMSHAResult::OK != h.Update(data.data(), 10)) ||
+	    (ctx.CRC() != referenceCRC(data.data(), 10))) {
+		fail(area, "reset");
+	}
+
+	cout << "PASSED: combined SHA-256 and CRC32C\n";
+}
+
+
+int
+main()
+{
+	crcTest("default");
+	combinedTest();
+
+	emsha::crc32c_force_software(true);
+	crcTest("software");
+	combinedTest();
+	emsha::crc32c_force_software(false);
+
+	pathTest();
+
+	exit(0);
+}
@@ -0,0 +1,321 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/delta.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *area = "delta";
+
+
+static vector<uint8_t>
+randomBytes(size_t n, uint64_t seed, uint8_t mask = 0xff)
+{
+	vector<uint8_t>	out(n);
+
+	for (size_t i = 0; i < n; i++) {
+		uint64_t	z = (seed += 0x9e3779b97f4a7c15ULL);
+
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		out[i] = static_cast<uint8_t>(z ^ (z >> 31)) & mask;
+	}
+	return out;
+}
+
+
+// referenceOps is the plain rsync scan: at each position, look for a
+// block with the same bytes, preferring the one after the last copy.
+static vector<emsha::DeltaOp>
+referenceOps(const vector<uint8_t>& base, const vector<uint8_t>& target, uint32_t bs)
+{
+	emsha::Delta	d;
+	size_t const	full = base.size() / bs;
+	size_t const	tail = base.size() % bs;
+	size_t		done = 0;
+	size_t		pos = 0;
+	size_t		expect = 0;
+
+	auto literal = [&](size_t from, size_t to) {
+		if (from == to) {
+			return;
+		}
+		if (!d.ops.empty() && (d.ops.back().kind == emsha::DeltaOpKind::Literal)) {
+			d.ops.back().length += to - from;
+			return;
+		}
+		d.ops.push_back({emsha::DeltaOpKind::Literal, d.literals.size(), to - from});
+		d.literals.resize(d.literals.size() + (to - from));
+	};
+	auto copy = [&](size_t offset, size_t length) {
+		if (!d.ops.empty() && (d.ops.back().kind == emsha::DeltaOpKind::Copy) &&
+		    ((d.ops.back().offset + d.ops.back().length) == offset)) {
+			d.ops.back().length += length;
+			return;
+		}
+		d.ops.push_back({emsha::DeltaOpKind::Copy, offset, length});
+	};
+
+	while ((full > 0) && ((pos + bs) <= target.size())) {
+		size_t	found = full;
+
+		for (size_t b = 0; b < full; b++) {
+			if (memcmp(&base[b * bs], &target[pos], bs) == 0) {
+				if ((found == full) || (b == expect)) {
+					found = b;
+				}
+			}
+		}
+		if (found == full) {
+			pos++;
+			continue;
+		}
+
+		literal(done, pos);
+		copy(found * bs, bs);
+		pos   += bs;
+		done   = pos;
+		expect = found + 1;
+	}
+
+	if ((tail != 0) && ((target.size() - done) >= tail) &&
+	    (memcmp(&base[full * bs], &target[target.size() - tail], tail) == 0)) {
+		literal(done, target.size() - tail);
+		copy(full * bs, tail);
+		done = target.size();
+	}
+	literal(done, target.size());
+
+	return d.ops;
+}
+
+
+static bool
+sameOps(const vector<emsha::DeltaOp>& a, const vector<emsha::DeltaOp>& b)
+{
+	if (a.size() != b.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); i++) {
+		if ((a[i].kind != b[i].kind) || (a[i].offset != b[i].offset) ||
+		    (a[i].length != b[i].length)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// roundTrip computes and applies a delta, and returns the number of
+// literal bytes it needed.
+static size_t
+roundTrip(const emsha::DeltaSignature& sig, const vector<uint8_t>& base,
+	  const vector<uint8_t>& target, const string& label)
+{
+	emsha::Delta	delta;
+	vector<uint8_t>	rebuilt;
+
+	if (emsha::EMSHAResult::OK !=
+	    emsha::DeltaCompute(sig, target.data(), target.size(), delta)) {
+		fail(area, "compute (" + label + ")");
+	}
+	if (!sameOps(delta.ops, referenceOps(base, target, sig.blockSize))) {
+		fail(area, "ops differ from the reference (" + label + ")");
+	}
+	if ((emsha::EMSHAResult::OK !=
+	     emsha::DeltaApply(base.data(), base.size(), delta, rebuilt)) ||
+	    (rebuilt != target)) {
+		fail(area, "apply (" + label + ")");
+	}
+
+	return delta.literals.size();
+}
+
+
+static void
+signatureTest()
+{
+	vector<uint8_t> const	base = randomBytes(100000, 1);
+	emsha::DeltaSignature	one;
+	emsha::DeltaSignature	many;
+
+	if ((emsha::EMSHAResult::OK != emsha::DeltaSign(base.data(), base.size(), 1000, one)) ||
+	    (emsha::EMSHAResult::OK != emsha::DeltaSign(base.data(), base.size(), 1000, many, 3))) {
+		fail(area, "sign");
+	}
+	if ((one.blocks.size() != 100) || (many.blocks.size() != 100)) {
+		fail(area, "block count");
+	}
+
+	for (size_t i = 0; i < one.blocks.size(); i++) {
+		uint8_t		d[emsha::SHA256_HASH_SIZE];
+		uint32_t	a = 0;
+		uint32_t	b = 0;
+
+		for (size_t j = 0; j < 1000; j++) {
+			a += base[(i * 1000) + j];
+			b += a;
+		}
+		emsha::SHA256Digest(&base[i * 1000], 1000, d);
+		if ((one.blocks[i].weak != ((a & 0xffff) | (b << 16))) ||
+		    !emsha::HashEqual(one.blocks[i].strong.bytes, d) ||
+		    (one.blocks[i].weak != many.blocks[i].weak) ||
+		    !emsha::HashEqual(one.blocks[i].strong.bytes, many.blocks[i].strong.bytes)) {
+			fail(area, "block " + to_string(i));
+		}
+	}
+
+	cout << "PASSED: delta signatures\n";
+}
+
+
+static void
+editTest()
+{
+	vector<uint8_t> const	base = randomBytes(40000 + 123, 2);
+	emsha::DeltaSignature	sig;
+
+	emsha::DeltaSign(base.data(), base.size(), 512, sig, 2);
+
+	if (roundTrip(sig, base, base, "unchanged") != 0) {
+		fail(area, "an unchanged target needs no literals");
+	}
+
+	vector<uint8_t>	target = base;
+	target.insert(target.begin() + 10000, 77, 0xab);
+	target.erase(target.begin() + 30000, target.begin() + 30100);
+	target[20000] ^= 1;
+	if (roundTrip(sig, base, target, "edited") > (77 + 3 * 512)) {
+		fail(area, "too many literals for a few edits");
+	}
+
+	vector<uint8_t>	moved(base.begin() + 20000, base.end());
+	moved.insert(moved.end(), base.begin(), base.begin() + 20000);
+	if (roundTrip(sig, base, moved, "rotated") > 2 * 512) {
+		fail(area, "too many literals for moved blocks");
+	}
+
+	roundTrip(sig, base, randomBytes(5000, 3), "unrelated");
+	roundTrip(sig, base, vector<uint8_t>(), "empty target");
+	roundTrip(sig, base, vector<uint8_t>(base.begin(), base.begin() + 100), "short target");
+
+	// Identical blocks are copied in order, as one op.
+	vector<uint8_t> const	zeroes(4096, 0);
+	emsha::DeltaSign(zeroes.data(), zeroes.size(), 256, sig);
+	emsha::Delta	delta;
+	emsha::DeltaCompute(sig, zeroes.data(), zeroes.size(), delta);
+	if ((delta.ops.size() != 1) || (delta.ops[0].length != zeroes.size())) {
+		fail(area, "repeated blocks");
+	}
+
+	// With a tiny alphabet and blocks, weak checksums collide often,
+	// so many candidates fail and the scan has to back up.
+	vector<uint8_t> const	small = randomBytes(3000, 4, 1);
+	emsha::DeltaSign(small.data(), small.size(), 7, sig);
+	for (uint64_t seed = 5; seed < 10; seed++) {
+		vector<uint8_t>	t = randomBytes(2000, seed, 1);
+
+		t.insert(t.begin() + 500, small.begin() + 100, small.begin() + 400);
+		roundTrip(sig, small, t, "collisions " + to_string(seed));
+	}
+
+	cout << "PASSED: delta round trips\n";
+}
+
+
+static void
+errorTest()
+{
+	vector<uint8_t> const	base = randomBytes(5000, 6);
+	vector<uint8_t>		other = base;
+	vector<uint8_t>		target = base;
+	emsha::DeltaSignature	sig;
+	emsha::Delta		delta;
+	vector<uint8_t>		rebuilt;
+
+	if ((emsha::EMSHAResult::InvalidState !=
+	     emsha::DeltaSign(base.data(), base.size(), 0, sig)) ||
+	    (emsha::EMSHAResult::NullPointer !=
+	     emsha::DeltaSign(nullptr, 10, 64, sig))) {
+		fail(area, "bad signing arguments");
+	}
+
+	emsha::DeltaSign(base.data(), base.size(), 256, sig);
+	target[4000] ^= 0xff;
+	emsha::DeltaCompute(sig, target.data(), target.size(), delta);
+
+	// Applying against a different base is caught by the digest.
+	other[100] ^= 1;
+	if ((emsha::EMSHAResult::VerifyFailed !=
+	     emsha::DeltaApply(other.data(), other.size(), delta, rebuilt)) ||
+	    !rebuilt.empty()) {
+		fail(area, "wrong base");
+	}
+
+	emsha::Delta	bad = delta;
+	bad.ops[0].length += base.size();
+	if (emsha::EMSHAResult::InvalidState !=
+	    emsha::DeltaApply(base.data(), base.size(), bad, rebuilt)) {
+		fail(area, "out of range copy");
+	}
+
+	bad = delta;
+	bad.targetLength++;
+	if (emsha::EMSHAResult::InvalidState !=
+	    emsha::DeltaApply(base.data(), base.size(), bad, rebuilt)) {
+		fail(area, "short delta");
+	}
+
+	sig.blocks.pop_back();
+	if (emsha::EMSHAResult::InvalidState !=
+	    emsha::DeltaCompute(sig, target.data(), target.size(), delta)) {
+		fail(area, "damaged signature");
+	}
+
+	cout << "PASSED: delta errors\n";
+}
+
+
+int
+main()
+{
+	signatureTest();
+	editTest();
+	errorTest();
+
+	exit(0);
+}
@@ -0,0 +1,251 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cctype>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/hmac.h>
+#include <emsha/compact.h>
+#include <emsha/digest.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *area = "Digest";
+
+
+// SHA-256("abc"), usable as a compile-time constant.
+static constexpr emsha::Digest	abcDigest(
+	0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+	0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+	0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+	0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad);
+
+static_assert(abcDigest.bytes[0] == 0xba, "constexpr construction");
+static_assert(sizeof(emsha::Digest) == emsha::SHA256_HASH_SIZE, "no padding");
+
+
+static void
+valueTest()
+{
+	const uint8_t	abc[] = {'a', 'b', 'c'};
+	emsha::Digest	d = emsha::SHA256Digest(abc, sizeof(abc));
+
+	if (d != abcDigest) {
+		fail(area, "SHA256Digest by value");
+	}
+	if (!emsha::HashEqual(d.data(), abcDigest.data())) {
+		fail(area, "data() doesn't match");
+	}
+
+	emsha::Digest	empty = emsha::SHA256Digest(nullptr, 0);
+	emsha::Digest	want;
+	if (!emsha::Digest::FromHex(
+		"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+		64, want) || (empty != want)) {
+		fail(area, "digest of the empty message");
+	}
+
+	// The RFC 4231 test case 2 HMAC.
+	const uint8_t	key[] = {'J', 'e', 'f', 'e'};
+	const char	msg[] = "what do ya want for nothing?";
+	emsha::HMACMidstate	midstate;
+
+	emsha::Digest::FromHex(
+		"5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843",
+		64, want);
+	emsha::Digest	tag = emsha::ComputeHMAC(key, sizeof(key),
+						 reinterpret_cast<const uint8_t *>(msg),
+						 sizeof(msg) - 1);
+	if (tag != want) {
+		fail(area, "ComputeHMAC by value");
+	}
+
+	emsha::HMACPrecompute(key, sizeof(key), midstate);
+	tag = emsha::ComputeHMAC(midstate, reinterpret_cast<const uint8_t *>(msg),
+				 sizeof(msg) - 1);
+	if (tag != want) {
+		fail(area, "ComputeHMAC with a midstate by value");
+	}
+
+	cout << "PASSED: Digest values\n";
+}
+
+
+static void
+hexTest()
+{
+	char		hex[emsha::DIGEST_HEX_SIZE];
+	emsha::Digest	d;
+
+	abcDigest.Hex(hex);
+	if (string(hex) != "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") {
+		fail(area, "Hex: " + string(hex));
+	}
+
+	for (auto& c : hex) {
+		c = static_cast<char>(toupper(c));
+	}
+	if (!emsha::Digest::FromHex(hex, 64, d) || (d != abcDigest)) {
+		fail(area, "FromHex with uppercase digits");
+	}
+
+	hex[10] = 'g';
+	if (emsha::Digest::FromHex(hex, 64, d) || emsha::Digest::FromHex(hex, 63, d)) {
+		fail(area, "FromHex accepted bad input");
+	}
+	if (d != abcDigest) {
+		fail(area, "failed FromHex changed its output");
+	}
+
+	cout << "PASSED: Digest hex\n";
+}
+
+
+static void
+containerTest()
+{
+	vector<emsha::Digest>	digests;
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		uint8_t	m[4] = {
+			static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 0, 1
+		};
+		digests.push_back(emsha::SHA256Digest(m, sizeof(m)));
+	}
+
+	// Ordering must agree with comparing the bytes.
+	vector<emsha::Digest>	sorted(digests);
+	sort(sorted.begin(), sorted.end());
+	for (size_t i = 1; i < sorted.size(); i++) {
+		if (!(sorted[i - 1] < sorted[i]) ||
+		    (memcmp(sorted[i - 1].data(), sorted[i].data(), sorted[i].size()) >= 0)) {
+			fail(area, "ordering doesn't match the bytes");
+		}
+	}
+
+	emsha::Digest	a = sorted[0];
+	emsha::Digest	b = a;
+	b.bytes[31] ^= 1;
+	if (!(a != b) || (a == b) || !((a < b) != (b < a)) || !(a <= a) || !(a >= a)) {
+		fail(area, "comparison operators");
+	}
+
+	unordered_set<emsha::Digest>	set(digests.begin(), digests.end());
+	map<emsha::Digest, uint32_t>	index;
+	for (uint32_t i = 0; i < digests.size(); i++) {
+		index[digests[i]] = i;
+	}
+	if ((set.size() != digests.size()) || (index.size() != digests.size())) {
+		fail(area, "containers lost digests");
+	}
+	for (uint32_t i = 0; i < digests.size(); i++) {
+		if ((set.count(digests[i]) != 1) || (index[digests[i]] != i)) {
+			fail(area, "container lookup");
+		}
+	}
+
+	cout << "PASSED: Digest containers\n";
+}
+
+
+// rejected reports whether a by-value call was refused: with NDEBUG
+// defined it must return an all-zero Digest, and otherwise it must
+// fail an assertion, which is checked in a child process.
+template <typename Call>
+static bool
+rejected(Call call)
+{
+#ifdef NDEBUG
+	return call() == emsha::Digest();
+#else
+	pid_t const	pid = fork();
+	int		status = 0;
+
+	if (pid == 0) {
+		int const	null = open("/dev/null", O_WRONLY);
+
+		if (null >= 0) {
+			dup2(null, STDERR_FILENO);
+		}
+		call();
+		_exit(0);
+	}
+	if ((pid < 0) || (waitpid(pid, &status, 0) != pid)) {
+		return false;
+	}
+	return WIFSIGNALED(status) && (WTERMSIG(status) == SIGABRT);
+#endif
+}
+
+
+static void
+nullMessageTest()
+{
+	const uint8_t		key[] = {'J', 'e', 'f', 'e'};
+	emsha::HMACMidstate	midstate;
+
+	emsha::HMACPrecompute(key, sizeof(key), midstate);
+
+	if (!rejected([]() { return emsha::SHA256Digest(nullptr, 5); })) {
+		fail(area, "SHA256Digest hashed a nullptr");
+	}
+	if (!rejected([&]() { return emsha::ComputeHMAC(key, sizeof(key), nullptr, 5); })) {
+		fail(area, "ComputeHMAC signed a nullptr");
+	}
+	if (!rejected([&]() { return emsha::ComputeHMAC(midstate, nullptr, 5); })) {
+		fail(area, "ComputeHMAC with a midstate signed a nullptr");
+	}
+
+	cout << "PASSED: by-value nullptr messages\n";
+}
+
+
+int
+main()
+{
+	valueTest();
+	hexTest();
+	containerTest();
+	nullMessageTest();
+	exit(0);
+}
@@ -0,0 +1,360 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/digest.h>
+#include <emsha/digestindex.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *testPath = "test_digestindex.idx";
+
+
+static const char *area = "digest index";
+
+
+static emsha::DigestIndexRecord
+testRecord(uint32_t i)
+{
+	emsha::DigestIndexRecord	rec;
+	uint8_t				m[4] = {
+		static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8),
+		static_cast<uint8_t>(i >> 16), static_cast<uint8_t>(i >> 24)
+	};
+
+	emsha::SHA256Digest(m, sizeof(m), rec.digest);
+	rec.offset = static_cast<uint64_t>(i) * 4096;
+	rec.length = i + 1;
+	return rec;
+}
+
+
+static bool
+recordLess(const emsha::DigestIndexRecord& a, const emsha::DigestIndexRecord& b)
+{
+	return memcmp(a.digest, b.digest, emsha::SHA256_HASH_SIZE) < 0;
+}
+
+
+static void
+checkRecord(const emsha::DigestIndex& idx, uint32_t i, const string& label)
+{
+	emsha::DigestIndexRecord const	rec = testRecord(i);
+	uint64_t			offset = 0;
+	uint64_t			length = 0;
+
+	if (!idx.Lookup(rec.digest, offset, length)) {
+		fail(area, label + ": record " + to_string(i) + " missing");
+	}
+	if ((offset != rec.offset) || (length != rec.length)) {
+		fail(area, label + ": record " + to_string(i) + " has the wrong location");
+	}
+}
+
+
+static void
+buildTest()
+{
+	const uint32_t				count = 20000;
+	vector<emsha::DigestIndexRecord>	records;
+	emsha::DigestIndex			idx;
+	uint64_t				offset, length;
+
+	for (uint32_t i = 0; i < count; i++) {
+		records.push_back(testRecord(i));
+	}
+
+	if (emsha::EMSHAResult::InvalidState !=
+	    emsha::DigestIndex::Build(testPath, records.data(), records.size())) {
+		fail(area, "unsorted records accepted");
+	}
+
+	sort(records.begin(), records.end(), recordLess);
+	records.push_back(records.back());
+	if (emsha::EMSHAResult::InvalidState !=
+	    emsha::DigestIndex::Build(testPath, records.data(), records.size())) {
+		fail(area, "duplicate records accepted");
+	}
+	records.pop_back();
+
+	if (emsha::EMSHAResult::OK !=
+	    emsha::DigestIndex::Build(testPath, records.data(), records.size())) {
+		fail(area, "couldn't build the index");
+	}
+
+	if (emsha::EMSHAResult::OK != idx.Open(testPath)) {
+		fail(area, "couldn't open the index");
+	}
+	if (idx.Size() != count) {
+		fail(area, "wrong size");
+	}
+	if (idx.Buckets() * ((emsha::DIGEST_INDEX_BUCKET_RECORDS * 7) / 10) < count) {
+		fail(area, "too few buckets");
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		checkRecord(idx, i, "built index");
+	}
+	for (uint32_t i = count; i < count + 1000; i++) {
+		if (idx.Lookup(testRecord(i).digest, offset, length)) {
+			fail(area, "found a digest that was never added");
+		}
+	}
+
+	if (emsha::EMSHAResult::InvalidState != idx.Append(testRecord(count))) {
+		fail(area, "appended to a read-only index");
+	}
+
+	cout << "PASSED: digest index build and lookup\n";
+}
+
+
+static void
+appendTest()
+{
+	emsha::DigestIndex	idx;
+	emsha::DigestIndex	reader;
+	atomic<bool>		done(false);
+	atomic<bool>		bad(false);
+	uint32_t		added = 0;
+	uint64_t		offset, length;
+
+	// An empty index has a single bucket, so appends go through the
+	// overflow reserve until it runs out.
+	if (emsha::EMSHAResult::OK != emsha::DigestIndex::Build(testPath, nullptr, 0)) {
+		fail(area, "couldn't build an empty index");
+	}
+	if (emsha::EMSHAResult::OK != idx.Open(testPath, true)) {
+		fail(area, "couldn't open the index for writing");
+	}
+	if (emsha::EMSHAResult::OK != reader.Open(testPath)) {
+		fail(area, "couldn't open the index for reading");
+	}
+	if (idx.Buckets() != 1) {
+		fail(area, "an empty index should have one bucket");
+	}
+
+	// A second mapping looks up records while they are appended:
+	// any record it finds must be complete.
+	thread	t([&reader, &done, &bad]() {
+		while (!done.load()) {
+			for (uint32_t i = 0; i < 2000; i++) {
+				emsha::DigestIndexRecord const	rec = testRecord(i);
+				uint64_t			o, l;
+
+				if (reader.Lookup(rec.digest, o, l) &&
+				    ((o != rec.offset) || (l != rec.length))) {
+					bad.store(true);
+				}
+			}
+		}
+	});
+
+	emsha::EMSHAResult	res = emsha::EMSHAResult::OK;
+	for (; added < 10000; added++) {
+		res = idx.Append(testRecord(added));
+		if (res != emsha::EMSHAResult::OK) {
+			break;
+		}
+	}
+	done.store(true);
+	t.join();
+
+	if (res != emsha::EMSHAResult::NoSpace) {
+		fail(area, "appends should run out of overflow pages");
+	}
+	if (added != emsha::DIGEST_INDEX_BUCKET_RECORDS * 17) {
+		fail(area, "wrong number of records appended before running out: " + to_string(added));
+	}
+	if (bad.load()) {
+		fail(area, "a reader saw an incomplete record");
+	}
+
+	// Appending a record that is already present changes nothing.
+	emsha::DigestIndexRecord	dup = testRecord(7);
+	dup.offset = 1;
+	if (emsha::EMSHAResult::OK != idx.Append(dup)) {
+		fail(area, "appending a duplicate failed");
+	}
+	if (idx.Size() != added) {
+		fail(area, "wrong size after appends");
+	}
+	if (emsha::EMSHAResult::OK != idx.Sync()) {
+		fail(area, "couldn't sync the index");
+	}
+	idx.Close();
+	reader.Close();
+
+	if (emsha::EMSHAResult::OK != reader.Open(testPath)) {
+		fail(area, "couldn't reopen the index");
+	}
+	for (uint32_t i = 0; i < added; i++) {
+		checkRecord(reader, i, "reopened index");
+	}
+	if (reader.Lookup(testRecord(added).digest, offset, length)) {
+		fail(area, "found the record that didn't fit");
+	}
+
+	cout << "PASSED: digest index appends\n";
+}
+
+
+static void
+invalidTest()
+{
+	emsha::DigestIndex	idx;
+	uint64_t		offset, length;
+	FILE			*f;
+
+	if (emsha::EMSHAResult::IOError != idx.Open("test_digestindex.missing")) {
+		fail(area, "opened a missing file");
+	}
+	if (idx.Lookup(testRecord(0).digest, offset, length) || (idx.Size() != 0)) {
+		fail(area, "an unopened index isn't empty");
+	}
+
+	if (emsha::EMSHAResult::OK != emsha::DigestIndex::Build(testPath, nullptr, 0)) {
+		fail(area, "couldn't build an empty index");
+	}
+	f = fopen(testPath, "r+b");
+	if (f == nullptr) {
+		fail(area, "couldn't open the index file");
+	}
+	fputc('X', f);
+	fclose(f);
+	if (emsha::EMSHAResult::IOError != idx.Open(testPath)) {
+		fail(area, "opened a damaged index");
+	}
+
+	remove(testPath);
+	cout << "PASSED: digest index invalid files\n";
+}
+
+
+// setPageWord overwrites one of the 32-bit fields at the start of a
+// page of the index file.
+static void
+setPageWord(uint64_t page, size_t field, uint32_t value)
+{
+	FILE	*f = fopen(testPath, "r+b");
+
+	if (f == nullptr) {
+		fail(area, "couldn't open the index file");
+	}
+	if ((fseek(f, static_cast<long>((page * emsha::DIGEST_INDEX_PAGE_SIZE) + field), SEEK_SET) != 0) ||
+	    (fwrite(&value, sizeof(value), 1, f) != 1)) {
+		fail(area, "couldn't write to the index file");
+	}
+	fclose(f);
+}
+
+
+// A damaged chain in a shared file must end lookups and appends
+// rather than send them outside the mapping or round a cycle.
+static void
+corruptTest()
+{
+	const uint32_t				count = 10;
+	const size_t				pageCount = 0;
+	const size_t				pageNext = 4;
+	vector<emsha::DigestIndexRecord>	records;
+	emsha::DigestIndex			idx;
+	uint64_t				offset, length;
+	emsha::DigestIndexRecord const		missing = testRecord(count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		records.push_back(testRecord(i));
+	}
+	sort(records.begin(), records.end(), recordLess);
+
+	// So few records go in a single bucket, in page 1, with the
+	// overflow reserve of 16 pages after it.
+	if ((emsha::EMSHAResult::OK !=
+	     emsha::DigestIndex::Build(testPath, records.data(), records.size())) ||
+	    (emsha::EMSHAResult::OK != idx.Open(testPath)) || (idx.Buckets() != 1)) {
+		fail(area, "couldn't build the index");
+	}
+	idx.Close();
+
+	auto check = [&](const string& what) {
+		if ((emsha::EMSHAResult::OK != idx.Open(testPath, true))) {
+			fail(area, "couldn't reopen the index");
+		}
+		if (idx.Lookup(missing.digest, offset, length)) {
+			fail(area, what + ": found a missing record");
+		}
+		if (emsha::EMSHAResult::IOError != idx.Append(missing)) {
+			fail(area, what + ": appended to a damaged bucket");
+		}
+		idx.Close();
+	};
+
+	setPageWord(1, pageCount, UINT32_MAX);
+	check("an oversized count");
+	if (emsha::EMSHAResult::OK != idx.Open(testPath)) {
+		fail(area, "couldn't reopen the index");
+	}
+	checkRecord(idx, 3, "an oversized count");
+	idx.Close();
+	setPageWord(1, pageCount, count);
+
+	setPageWord(1, pageNext, 17);
+	check("a link past the reserve");
+	setPageWord(1, pageNext, UINT32_MAX);
+	check("a link far past the reserve");
+
+	setPageWord(1, pageNext, 1);
+	setPageWord(2, pageNext, 1);
+	check("a cycle");
+
+	remove(testPath);
+	cout << "PASSED: digest index damaged chains\n";
+}
+
+
+int
+main()
+{
+	buildTest();
+	appendTest();
+	invalidTest();
+	corruptTest();
+
+	exit(0);
+}
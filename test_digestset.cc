@@ -0,0 +1,152 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/digest.h>
+#include <emsha/digestset.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *area = "digest set";
+
+
+static void
+basicTest()
+{
+	// Start small, so that the set resizes several times.
+	emsha::DigestSet	set(8);
+	const uint32_t		count = 5000;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (!set.Insert(testDigest(i))) {
+			fail(area, "new digest " + to_string(i) + " reported as present");
+		}
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		if (set.Insert(testDigest(i))) {
+			fail(area, "duplicate digest " + to_string(i) + " added");
+		}
+	}
+
+	if (set.Size() != count) {
+		fail(area, "size is " + to_string(set.Size()));
+	}
+	if (set.Capacity() < count) {
+		fail(area, "capacity didn't grow");
+	}
+
+	for (uint32_t i = 0; i < (2 * count); i++) {
+		if (set.Contains(testDigest(i)) != (i < count)) {
+			fail(area, "wrong membership for digest " + to_string(i));
+		}
+	}
+
+	// Digests that share their leading bytes all land in the same
+	// bucket, and have to probe past it.
+	emsha::DigestSet	clash(8);
+	emsha::Digest		d;
+	for (uint32_t i = 0; i < 100; i++) {
+		d.bytes[31] = static_cast<uint8_t>(i);
+		clash.Insert(d);
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		d.bytes[31] = static_cast<uint8_t>(i);
+		if (clash.Contains(d) != (i < 100)) {
+			fail(area, "colliding digests");
+		}
+	}
+
+	cout << "PASSED: digest set\n";
+}
+
+
+// concurrentTest has several threads insert overlapping ranges while
+// the set resizes; each digest must be reported as new exactly once.
+static void
+concurrentTest()
+{
+	emsha::DigestSet	set(64);
+	const uint32_t		threads = 4;
+	const uint32_t		perThread = 20000;
+	atomic<uint32_t>	added(0);
+	vector<emsha::Digest>	digests(perThread * 2);
+	vector<thread>		workers;
+
+	for (uint32_t i = 0; i < digests.size(); i++) {
+		digests[i] = testDigest(i);
+	}
+
+	for (uint32_t t = 0; t < threads; t++) {
+		workers.emplace_back([&, t]() {
+			// Thread t covers [t/2 * perThread, ...), so every
+			// digest is inserted by two threads.
+			uint32_t const	first = (t / 2) * perThread;
+
+			for (uint32_t i = 0; i < perThread; i++) {
+				uint32_t const	n = first + ((t % 2) ? (perThread - 1 - i) : i);
+
+				if (set.Insert(digests[n])) {
+					added.fetch_add(1);
+				}
+			}
+		});
+	}
+
+	for (auto& w : workers) {
+		w.join();
+	}
+
+	if ((added.load() != digests.size()) || (set.Size() != digests.size())) {
+		fail(area, "concurrent inserts added " + to_string(added.load()) +
+		     " digests, expected " + to_string(digests.size()));
+	}
+	for (const auto& d : digests) {
+		if (!set.Contains(d)) {
+			fail(area, "digest lost by a concurrent insert");
+		}
+	}
+
+	cout << "PASSED: concurrent digest set\n";
+}
+
+
+int
+main()
+{
+	basicTest();
+	concurrentTest();
+	exit(0);
+}
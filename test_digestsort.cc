@@ -0,0 +1,294 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/digest.h>
+#include <emsha/digestsort.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *pathA = "test_digestsort.a";
+static const char *pathB = "test_digestsort.b";
+static const char *pathOut = "test_digestsort.out";
+
+
+static const char *area = "digest sort";
+
+
+// fakeDigest returns a uniformly distributed stand-in for a digest,
+// which is much cheaper to make than a real one.
+static emsha::Digest
+fakeDigest(uint32_t i)
+{
+	emsha::Digest	d;
+	uint64_t	x = i;
+
+	for (uint32_t w = 0; w < 4; w++) {
+		uint64_t	z = (x += 0x9e3779b97f4a7c15ULL);
+
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		z ^= z >> 31;
+		memcpy(d.bytes + (8 * w), &z, sizeof(z));
+	}
+	return d;
+}
+
+
+// testDigests returns count digests, with every dupEvery'th one a
+// repeat of an earlier one and, if prefix is set, the first three
+// bytes shared.
+static vector<emsha::Digest>
+testDigests(uint32_t count, uint32_t seed, uint32_t dupEvery = 0, bool prefix = false)
+{
+	vector<emsha::Digest>	v;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if ((dupEvery != 0) && (i != 0) && ((i % dupEvery) == 0)) {
+			v.push_back(v[(i * 7919) % i]);
+			continue;
+		}
+
+		v.push_back(fakeDigest(seed + i));
+		if (prefix) {
+			memset(v.back().bytes, 0xa5, 3);
+		}
+	}
+	return v;
+}
+
+
+static void
+writeDigests(const char *path, const vector<emsha::Digest>& v)
+{
+	FILE	*f = fopen(path, "wb");
+
+	if (f == nullptr) {
+		fail(area, string("couldn't create ") + path);
+	}
+	if (!v.empty() && (fwrite(v.data(), sizeof(emsha::Digest), v.size(), f) != v.size())) {
+		fail(area, string("couldn't write ") + path);
+	}
+	fclose(f);
+}
+
+
+static vector<emsha::Digest>
+readDigests(const char *path)
+{
+	vector<emsha::Digest>	v;
+	emsha::Digest		d;
+	FILE			*f = fopen(path, "rb");
+
+	if (f == nullptr) {
+		fail(area, string("couldn't open ") + path);
+	}
+	while (fread(&d, sizeof(d), 1, f) == 1) {
+		v.push_back(d);
+	}
+	fclose(f);
+	return v;
+}
+
+
+static void
+sortTest()
+{
+	const uint32_t	sizes[] = {0, 1, 2, 63, 64, 65, 1000, 150000};
+
+	for (auto size : sizes) {
+		for (uint32_t threads : {1, 4}) {
+			// Random, with duplicates, with a shared prefix, and
+			// all the same.
+			for (uint32_t shape = 0; shape < 4; shape++) {
+				uint32_t const		dups[] = {0, 3, 0, 1};
+				vector<emsha::Digest>	v = testDigests(size, size, dups[shape],
+									shape == 2);
+				vector<emsha::Digest>	want = v;
+
+				sort(want.begin(), want.end());
+				emsha::SortDigests(v.data(), v.size(), threads);
+				if (v != want) {
+					fail(area, "sorting " + to_string(size) + " digests (shape " +
+					     to_string(shape) + ", " + to_string(threads) +
+					     " threads)");
+				}
+
+				size_t const	n = emsha::UniqueDigests(v.data(), v.size());
+				want.erase(unique(want.begin(), want.end()), want.end());
+				if ((n != want.size()) || !equal(want.begin(), want.end(), v.begin())) {
+					fail(area, "deduplicating " + to_string(size) + " digests");
+				}
+			}
+		}
+	}
+
+	cout << "PASSED: digest sort and dedup\n";
+}
+
+
+static void
+setTest()
+{
+	vector<emsha::Digest>	a = testDigests(5000, 0, 4);
+	vector<emsha::Digest>	b = testDigests(5000, 2500, 5);
+	vector<emsha::Digest>	want;
+
+	sort(a.begin(), a.end());
+	sort(b.begin(), b.end());
+
+	set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(want));
+	vector<emsha::Digest>	out(a);
+	size_t			n = emsha::IntersectDigests(out.data(), out.size(),
+							    b.data(), b.size(), out.data());
+	out.resize(n);
+	if (out != want) {
+		fail(area, "intersection");
+	}
+
+	want.clear();
+	set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(want));
+	out = a;
+	n = emsha::DifferenceDigests(out.data(), out.size(), b.data(), b.size(), out.data());
+	out.resize(n);
+	if (out != want) {
+		fail(area, "difference");
+	}
+
+	if ((emsha::DifferenceDigests(a.data(), a.size(), nullptr, 0, out.data()) != a.size()) ||
+	    (emsha::IntersectDigests(a.data(), a.size(), nullptr, 0, out.data()) != 0)) {
+		fail(area, "set operations against an empty array");
+	}
+
+	cout << "PASSED: digest intersection and difference\n";
+}
+
+
+static void
+externalTest()
+{
+	// Small runs force more than one merge pass.
+	const size_t		memory = 2 * 1024 * sizeof(emsha::Digest);
+	vector<emsha::Digest>	a = testDigests(80000, 0, 6);
+	vector<emsha::Digest>	b = testDigests(30000, 60000, 0);
+	vector<emsha::Digest>	want;
+	uint64_t		count = 0;
+
+	for (bool unique : {false, true}) {
+		want = a;
+		sort(want.begin(), want.end());
+		if (unique) {
+			want.erase(std::unique(want.begin(), want.end()), want.end());
+		}
+
+		writeDigests(pathA, a);
+		if (emsha::EMSHAResult::OK != emsha::SortDigestFile(pathA, pathOut, memory, unique, 3)) {
+			fail(area, "external sort");
+		}
+		if (readDigests(pathOut) != want) {
+			fail(area, string("external sort output") + (unique ? " (unique)" : ""));
+		}
+	}
+
+	// Sorting a file in place, and an empty file.
+	writeDigests(pathB, b);
+	if (emsha::EMSHAResult::OK != emsha::SortDigestFile(pathB, pathB, memory)) {
+		fail(area, "sorting a file in place");
+	}
+	vector<emsha::Digest>	sb = readDigests(pathB);
+	if ((sb.size() != b.size()) || !is_sorted(sb.begin(), sb.end())) {
+		fail(area, "sorting a file in place");
+	}
+	writeDigests(pathA, vector<emsha::Digest>());
+	if ((emsha::EMSHAResult::OK != emsha::SortDigestFile(pathA, pathOut, memory)) ||
+	    !readDigests(pathOut).empty()) {
+		fail(area, "sorting an empty file");
+	}
+
+	// Set operations on the sorted files.
+	vector<emsha::Digest>	sa = want;
+	writeDigests(pathA, sa);
+
+	want.clear();
+	set_difference(sa.begin(), sa.end(), sb.begin(), sb.end(), back_inserter(want));
+	if ((emsha::EMSHAResult::OK != emsha::DifferenceDigestFiles(pathA, pathB, pathOut, &count)) ||
+	    (readDigests(pathOut) != want) || (count != want.size())) {
+		fail(area, "file difference");
+	}
+
+	want.clear();
+	set_intersection(sa.begin(), sa.end(), sb.begin(), sb.end(), back_inserter(want));
+	if ((emsha::EMSHAResult::OK != emsha::IntersectDigestFiles(pathA, pathB, pathOut, &count)) ||
+	    (readDigests(pathOut) != want) || (count != want.size())) {
+		fail(area, "file intersection");
+	}
+
+	// Unsorted and truncated inputs are rejected.
+	writeDigests(pathB, b);
+	if (emsha::EMSHAResult::InvalidState !=
+	    emsha::DifferenceDigestFiles(pathA, pathB, pathOut)) {
+		fail(area, "difference with an unsorted file");
+	}
+
+	FILE	*f = fopen(pathA, "ab");
+	fputc(0, f);
+	fclose(f);
+	if (emsha::EMSHAResult::InvalidState != emsha::SortDigestFile(pathA, pathOut, memory)) {
+		fail(area, "sorting a truncated file");
+	}
+	if (emsha::EMSHAResult::IOError !=
+	    emsha::IntersectDigestFiles("test_digestsort.missing", pathB, pathOut)) {
+		fail(area, "intersecting a missing file");
+	}
+
+	remove(pathA);
+	remove(pathB);
+	remove(pathOut);
+	cout << "PASSED: external digest sort and set operations\n";
+}
+
+
+int
+main()
+{
+	sortTest();
+	setTest();
+	externalTest();
+
+	exit(0);
+}
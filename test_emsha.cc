@@ -25,6 +25,8 @@
 
 #include <chrono>
 #include <iostream>
+#include <vector>
+
 #include <emsha/emsha.h>
 
 #include "test_utils.h"
@@ -122,6 +124,93 @@ hashEqualTest()
 		cerr << "\tb <- " << s << std::endl;
 		exit(1);
 	}
+
+	// Adding up the differences in a byte lets them wrap around to
+	// zero; they have to be ORed together instead.
+	for (uint32_t i = 0; i < emsha::SHA256_HASH_SIZE; i++) {
+		a[i] = 0;
+		b[i] = 0;
+	}
+	b[0] = 0x80;
+	b[1] = 0x80;
+	if (emsha::HashEqual(a, b)) {
+		cerr << "FAILED: HashEqual\n";
+		cerr << "\tREGRESSION: differences that add up to 256 compared equal.\n";
+		exit(1);
+	}
+}
+
+
+static void
+constantTimeEqualTest()
+{
+	uint8_t		a[100];
+	uint8_t		b[100];
+
+	for (uint32_t i = 0; i < sizeof(a); i++) {
+		a[i] = static_cast<uint8_t>(i * 7);
+		b[i] = a[i];
+	}
+
+	// Every length up to past a few full steps, with a difference
+	// at each position, including in the byte-at-a-time tail.
+	for (size_t length = 0; length <= sizeof(a); length++) {
+		if (!emsha::ConstantTimeEqual(a, b, length)) {
+			cerr << "FAILED: ConstantTimeEqual: equal " << length
+			     << "-byte strings compared unequal\n";
+			exit(1);
+		}
+
+		for (size_t i = 0; i < length; i++) {
+			b[i] ^= 0x10;
+			if (emsha::ConstantTimeEqual(a, b, length)) {
+				cerr << "FAILED: ConstantTimeEqual: difference at byte "
+				     << i << " of " << length << " missed\n";
+				exit(1);
+			}
+			b[i] = a[i];
+		}
+	}
+
+	for (size_t length : {size_t(emsha::SHA256_HASH_SIZE), size_t(20)}) {
+		const size_t		count = 130;
+		vector<uint8_t>		candidates(count * length);
+		vector<uint64_t>	results((count + 63) / 64, ~0ULL);
+		size_t			want = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			copy(a, a + length, candidates.begin() + (i * length));
+			if ((i % 3) != 0) {
+				candidates[(i * length) + (i % length)] ^= 1;
+			} else {
+				want++;
+			}
+		}
+
+		size_t const	matches = emsha::ConstantTimeEqualMany(a, candidates.data(),
+								      length, count,
+								      results.data());
+		if (matches != want) {
+			cerr << "FAILED: ConstantTimeEqualMany: " << matches
+			     << " matches, expected " << want << "\n";
+			exit(1);
+		}
+
+		for (size_t i = 0; i < (results.size() * 64); i++) {
+			bool const	set = ((results[i / 64] >> (i % 64)) & 1) != 0;
+			if (set != ((i < count) && ((i % 3) == 0))) {
+				cerr << "FAILED: ConstantTimeEqualMany: wrong result for "
+				     << "candidate " << i << "\n";
+				exit(1);
+			}
+		}
+
+		if (emsha::ConstantTimeEqualMany(a, candidates.data(), length, count,
+						 nullptr) != want) {
+			cerr << "FAILED: ConstantTimeEqualMany without a bitmap\n";
+			exit(1);
+		}
+	}
 }
 
 
@@ -140,6 +229,7 @@ main()
 #endif
 		hashEqualTest();
 	}
+	constantTimeEqualTest();
 
 	auto end   = std::chrono::steady_clock::now();
 	auto delta = (end - start);
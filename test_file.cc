@@ -0,0 +1,292 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/file.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *testPath = "test_file.dat";
+static const char *sidecarPath = "test_file.dat.sc";
+
+
+// File sizes around the interesting boundaries: empty, sub-block,
+// block, alignment and read buffer edges.
+static const uint32_t testSizes[] = {
+	0, 1, 55, 64, 65,
+	emsha::FILE_ALIGNMENT - 1,
+	emsha::FILE_ALIGNMENT,
+	emsha::FILE_ALIGNMENT + 1,
+	emsha::FILE_BUFFER_SIZE,
+	(3 * emsha::FILE_BUFFER_SIZE) + 123,
+};
+
+
+static void
+writeTestFile(const vector<uint8_t>& data, const char *how = "wb")
+{
+	FILE	*f = fopen(testPath, how);
+
+	if (f == nullptr) {
+		cerr << "FAILED: couldn't create " << testPath << "\n";
+		exit(1);
+	}
+
+	if (!data.empty()) {
+		if (fwrite(data.data(), 1, data.size(), f) != data.size()) {
+			cerr << "FAILED: couldn't write " << testPath << "\n";
+			exit(1);
+		}
+	}
+	fclose(f);
+}
+
+
+static void
+checkFile(uint32_t size, emsha::FileMode mode, const string& label)
+{
+	vector<uint8_t>	data(size);
+	uint8_t		expected[emsha::SHA256_HASH_SIZE];
+	uint8_t		actual[emsha::SHA256_HASH_SIZE];
+	string		hs;
+
+	for (uint32_t i = 0; i < size; i++) {
+		data[i] = static_cast<uint8_t>((i * 31) + (i >> 8));
+	}
+	writeTestFile(data);
+
+	if (emsha::EMSHAResult::OK != emsha::SHA256Digest(data.data(), size, expected)) {
+		cerr << "FAILED: " << label << " (computing reference digest)\n";
+		exit(1);
+	}
+
+	if (emsha::EMSHAResult::OK != emsha::SHA256File(testPath, actual, mode)) {
+		cerr << "FAILED: " << label << " (hashing " << size << " byte file)\n";
+		exit(1);
+	}
+
+	if (!emsha::HashEqual(expected, actual)) {
+		cerr << "FAILED: " << label << " (" << size << " byte file)\n";
+		DumpHexString(hs, expected, emsha::SHA256_HASH_SIZE);
+		cerr << "\twanted: " << hs << "\n";
+		DumpHexString(hs, actual, emsha::SHA256_HASH_SIZE);
+		cerr << "\thave:   " << hs << "\n";
+		exit(1);
+	}
+}
+
+
+// checkIncremental hashes the test file through its sidecar and
+// checks both the digest, against data (the whole file), and how much
+// of the file had to be read.
+static void
+checkIncremental(const vector<uint8_t>& data, uint64_t wantRead, const string& label)
+{
+	uint8_t		expected[emsha::SHA256_HASH_SIZE];
+	uint8_t		actual[emsha::SHA256_HASH_SIZE];
+	uint64_t	hashed = 0;
+
+	emsha::SHA256Digest(data.data(), static_cast<uint32_t>(data.size()), expected);
+	if (emsha::EMSHAResult::OK !=
+	    emsha::SHA256FileIncremental(testPath, sidecarPath, actual,
+					 emsha::FileMode::Buffered, &hashed)) {
+		cerr << "FAILED: incremental hash (" << label << ")\n";
+		exit(1);
+	}
+
+	if (!emsha::HashEqual(expected, actual)) {
+		cerr << "FAILED: incremental hash (" << label << "): wrong digest\n";
+		exit(1);
+	}
+
+	if (hashed != wantRead) {
+		cerr << "FAILED: incremental hash (" << label << "): read "
+		     << hashed << " bytes, expected " << wantRead << "\n";
+		exit(1);
+	}
+}
+
+
+static void
+incrementalTest()
+{
+	vector<uint8_t>	data(1000);
+	vector<uint8_t>	more(300, 0x5a);
+
+	for (uint32_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<uint8_t>(i);
+	}
+
+	remove(sidecarPath);
+	writeTestFile(data);
+	checkIncremental(data, 1000, "no sidecar");
+
+	// Only the appended bytes and the partial block before them.
+	writeTestFile(more, "ab");
+	data.insert(data.end(), more.begin(), more.end());
+	checkIncremental(data, 340, "append");
+	checkIncremental(data, 1300 % 64, "unchanged");
+
+	// Changing the last block the sidecar covers forces a rehash.
+	data[1279] ^= 1;
+	data.push_back(1);
+	writeTestFile(data);
+	checkIncremental(data, 1301, "rewritten");
+
+	data.resize(100);
+	writeTestFile(data);
+	checkIncremental(data, 100, "truncated");
+
+	// A damaged sidecar is ignored.
+	FILE	*f = fopen(sidecarPath, "r+b");
+	if (f == nullptr) {
+		cerr << "FAILED: couldn't open " << sidecarPath << "\n";
+		exit(1);
+	}
+	fseek(f, 20, SEEK_SET);
+	fputc(0xff, f);
+	fclose(f);
+	checkIncremental(data, 100, "damaged sidecar");
+
+	remove(testPath);
+	remove(sidecarPath);
+	cout << "PASSED: incremental file hashing\n";
+}
+
+
+// offsetTest checks that SHA256FileDescriptor starts from the
+// descriptor's current offset, both aligned (which can still be read
+// directly) and not, and that a pipe, which has no offset, still
+// hashes.
+static void
+offsetTest()
+{
+	vector<uint8_t>	data((2 * emsha::FILE_ALIGNMENT) + 100);
+	uint8_t		expected[emsha::SHA256_HASH_SIZE];
+	uint8_t		actual[emsha::SHA256_HASH_SIZE];
+	const off_t	starts[] = {
+		0, 1, static_cast<off_t>(emsha::FILE_ALIGNMENT),
+	};
+
+	for (uint32_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<uint8_t>((i * 7) + 3);
+	}
+	writeTestFile(data);
+
+	for (auto start : starts) {
+		for (auto mode : {emsha::FileMode::Buffered, emsha::FileMode::Direct}) {
+			int const fd = open(testPath, O_RDONLY);
+			if ((fd == -1) || (start != lseek(fd, start, SEEK_SET))) {
+				cerr << "FAILED: couldn't open and seek " << testPath << "\n";
+				exit(1);
+			}
+
+			emsha::SHA256Digest(data.data() + start,
+					    static_cast<uint32_t>(data.size()) -
+					    static_cast<uint32_t>(start), expected);
+			if (emsha::EMSHAResult::OK !=
+			    emsha::SHA256FileDescriptor(fd, actual, mode)) {
+				cerr << "FAILED: hashing from offset " << start << "\n";
+				exit(1);
+			}
+			close(fd);
+
+			if (!emsha::HashEqual(expected, actual)) {
+				cerr << "FAILED: hashing from offset " << start
+				     << ": wrong digest\n";
+				exit(1);
+			}
+		}
+	}
+	remove(testPath);
+
+	int	fds[2];
+	if (-1 == pipe(fds)) {
+		cerr << "FAILED: couldn't create a pipe\n";
+		exit(1);
+	}
+
+	// Small enough to fit in the pipe's buffer before it's read.
+	if (write(fds[1], data.data(), 100) != 100) {
+		cerr << "FAILED: couldn't write to the pipe\n";
+		exit(1);
+	}
+	close(fds[1]);
+
+	emsha::SHA256Digest(data.data(), 100, expected);
+	if (emsha::EMSHAResult::OK !=
+	    emsha::SHA256FileDescriptor(fds[0], actual, emsha::FileMode::Direct)) {
+		cerr << "FAILED: hashing a pipe\n";
+		exit(1);
+	}
+	close(fds[0]);
+
+	if (!emsha::HashEqual(expected, actual)) {
+		cerr << "FAILED: hashing a pipe: wrong digest\n";
+		exit(1);
+	}
+
+	cout << "PASSED: descriptor offsets\n";
+}
+
+
+int
+main()
+{
+	uint8_t	dig[emsha::SHA256_HASH_SIZE];
+
+	for (auto size : testSizes) {
+		checkFile(size, emsha::FileMode::Buffered, "buffered file hash");
+		checkFile(size, emsha::FileMode::Direct, "direct file hash");
+	}
+	remove(testPath);
+	cout << "PASSED: file hashing\n";
+
+	if (emsha::EMSHAResult::IOError !=
+	    emsha::SHA256File("test_file.missing", dig, emsha::FileMode::Direct)) {
+		cerr << "FAILED: hashing a missing file should fail\n";
+		exit(1);
+	}
+	cout << "PASSED: missing file\n";
+
+	incrementalTest();
+	offsetTest();
+
+	exit(0);
+}
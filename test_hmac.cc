@@ -23,6 +23,7 @@
  */
 
 
+#include <algorithm>
 #include <iostream>
 
 #include <emsha/emsha.h>
@@ -120,6 +121,84 @@ const struct hmacTest rfc4231[] = {
 };
 
 
+// Forking an HMAC after a shared prefix, into a context constructed
+// with a different key, must give the HMAC of the whole message under
+// the parent's key.
+static int
+forkTest()
+{
+	const struct hmacTest	*test = &rfc4231[5];
+	const uint8_t		*msg = reinterpret_cast<const uint8_t *>(test->input.c_str());
+	uint32_t const		 ml = static_cast<uint32_t>(test->input.size());
+	const uint8_t		 otherKey[] = {0x01, 0x02, 0x03};
+	uint8_t			 expected[emsha::SHA256_HASH_SIZE];
+	uint8_t			 actual[emsha::SHA256_HASH_SIZE];
+
+	emsha::HMAC	parent(test->key, test->keylen);
+	emsha::HMAC	child(otherKey, sizeof(otherKey));
+
+	if (emsha::EMSHAResult::OK != emsha::ComputeHMAC(test->key, test->keylen,
+							 msg, ml, expected)) {
+		cerr << "FAILED: HMAC fork (reference)\n";
+		return -1;
+	}
+
+	if ((emsha::EMSHAResult::OK != parent.Update(msg, 70)) ||
+	    (emsha::EMSHAResult::OK != parent.Fork(child)) ||
+	    (emsha::EMSHAResult::OK != child.Update(msg + 70, ml - 70)) ||
+	    (emsha::EMSHAResult::OK != child.Finalise(actual)) ||
+	    !emsha::HashEqual(expected, actual)) {
+		cerr << "FAILED: HMAC fork\n";
+		return -1;
+	}
+
+	// A fork of a finished HMAC carries its result.
+	emsha::HMAC	late(otherKey, sizeof(otherKey));
+	if ((emsha::EMSHAResult::OK != child.Fork(late)) ||
+	    (emsha::EMSHAResult::OK != late.Result(actual)) ||
+	    !emsha::HashEqual(expected, actual)) {
+		cerr << "FAILED: HMAC fork of a finalised context\n";
+		return -1;
+	}
+
+	cout << "PASSED: HMAC fork\n";
+	return 0;
+}
+
+
+// Copying and authenticating in one pass must match a plain HMAC.
+static int
+copyAndUpdateTest()
+{
+	const struct hmacTest	*test = &rfc4231[5];
+	const uint8_t		*msg = reinterpret_cast<const uint8_t *>(test->input.c_str());
+	uint32_t const		 ml = static_cast<uint32_t>(test->input.size());
+	uint8_t			 copy[256] = {0};
+	uint8_t			 expected[emsha::SHA256_HASH_SIZE];
+	uint8_t			 actual[emsha::SHA256_HASH_SIZE];
+
+	emsha::HMAC	h(test->key, test->keylen);
+
+	if ((emsha::EMSHAResult::OK != emsha::ComputeHMAC(test->key, test->keylen,
+							  msg, ml, expected)) ||
+	    (emsha::EMSHAResult::OK != h.CopyAndUpdate(copy, msg, 10)) ||
+	    (emsha::EMSHAResult::OK != h.CopyAndUpdate(copy + 10, msg + 10, ml - 10, true)) ||
+	    (emsha::EMSHAResult::OK != h.Finalise(actual)) ||
+	    !emsha::HashEqual(expected, actual) ||
+	    !std::equal(msg, msg + ml, copy)) {
+		cerr << "FAILED: HMAC copy and update\n";
+		return -1;
+	}
+
+	if (emsha::EMSHAResult::InvalidState != h.CopyAndUpdate(copy, msg, ml)) {
+		cerr << "FAILED: HMAC copy and update after finalising\n";
+		return -1;
+	}
+
+	cout << "PASSED: HMAC copy and update\n";
+	return 0;
+}
+
 
 int
 main()
@@ -133,5 +212,13 @@ main()
 		exit(1);
 	}
 
+	if (-1 == forkTest()) {
+		exit(1);
+	}
+
+	if (-1 == copyAndUpdateTest()) {
+		exit(1);
+	}
+
 	exit(0);
 }
@@ -0,0 +1,401 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/hmac.h>
+#include <emsha/compact.h>
+#include <emsha/keystore.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static const char *area = "key store";
+
+
+static vector<uint8_t>
+testKey(uint64_t id, uint32_t version)
+{
+	// Vary the key length so that some keys are hashed down.
+	vector<uint8_t>	k(16 + ((id * 13) % 100));
+
+	for (size_t i = 0; i < k.size(); i++) {
+		k[i] = static_cast<uint8_t>(id + (version * 31) + i);
+	}
+	return k;
+}
+
+
+static bool
+sameKey(const emsha::HMACMidstate& a, const emsha::HMACMidstate& b)
+{
+	for (uint32_t i = 0; i < 8; i++) {
+		if ((a.inner[i] != b.inner[i]) || (a.outer[i] != b.outer[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static void
+tag(uint64_t id, uint32_t version, const uint8_t *m, uint32_t ml, uint8_t *t)
+{
+	vector<uint8_t>	k = testKey(id, version);
+	emsha::HMAC	h(k.data(), static_cast<uint32_t>(k.size()));
+
+	h.Update(m, ml);
+	h.Finalise(t);
+}
+
+
+static void
+basicTest()
+{
+	const uint32_t		capacity = 100;
+	emsha::KeyStore		store(capacity);
+	emsha::HMACMidstate	key;
+	emsha::HMACMidstate	want;
+
+	for (uint64_t id = 0; id < capacity; id++) {
+		vector<uint8_t>	k = testKey(id * 1000, 0);
+
+		if (emsha::EMSHAResult::OK !=
+		    store.Add(id * 1000, k.data(), static_cast<uint32_t>(k.size()))) {
+			fail(area, "couldn't add key " + to_string(id));
+		}
+	}
+
+	vector<uint8_t>	k = testKey(1, 0);
+	if (emsha::EMSHAResult::NoSpace != store.Add(1, k.data(), static_cast<uint32_t>(k.size()))) {
+		fail(area, "full store accepted a new key");
+	}
+	if (emsha::EMSHAResult::InvalidState !=
+	    store.Add(emsha::KeyStore::NO_KEY_ID, k.data(), static_cast<uint32_t>(k.size()))) {
+		fail(area, "reserved key ID accepted");
+	}
+
+	for (uint64_t id = 0; id < capacity; id++) {
+		k = testKey(id * 1000, 0);
+		emsha::HMACPrecompute(k.data(), static_cast<uint32_t>(k.size()), want);
+		if (!store.Lookup(id * 1000, key) || !sameKey(key, want)) {
+			fail(area, "wrong key for ID " + to_string(id * 1000));
+		}
+	}
+	if (store.Lookup(1, key)) {
+		fail(area, "lookup of a missing ID succeeded");
+	}
+
+	// Removing frees space and leaves the other IDs reachable.
+	for (uint64_t id = 0; id < capacity; id += 2) {
+		if (!store.Remove(id * 1000)) {
+			fail(area, "couldn't remove ID " + to_string(id * 1000));
+		}
+	}
+	if (store.Remove(0) || (store.Size() != (capacity / 2))) {
+		fail(area, "removal bookkeeping is wrong");
+	}
+	for (uint64_t id = 0; id < capacity; id++) {
+		if (store.Lookup(id * 1000, key) != ((id % 2) == 1)) {
+			fail(area, "wrong lookup result after removal for ID " + to_string(id * 1000));
+		}
+	}
+
+	for (uint64_t id = 1; id <= (capacity / 2); id++) {
+		k = testKey(id, 0);
+		if (emsha::EMSHAResult::OK != store.Add(id, k.data(), static_cast<uint32_t>(k.size()))) {
+			fail(area, "couldn't reuse space after removal");
+		}
+	}
+	for (uint64_t id = 1; id <= (capacity / 2); id++) {
+		k = testKey(id, 0);
+		emsha::HMACPrecompute(k.data(), static_cast<uint32_t>(k.size()), want);
+		if (!store.Lookup(id, key) || !sameKey(key, want)) {
+			fail(area, "wrong key for reused slot " + to_string(id));
+		}
+	}
+
+	cout << "PASSED: key store add, lookup and remove\n";
+}
+
+
+static void
+rotationTest()
+{
+	emsha::KeyStore	store(4);
+	uint8_t		m[] = "webhook payload";
+	uint8_t		t0[emsha::SHA256_HASH_SIZE];
+	uint8_t		t1[emsha::SHA256_HASH_SIZE];
+	uint8_t		t2[emsha::SHA256_HASH_SIZE];
+	vector<uint8_t>	k;
+
+	tag(7, 0, m, sizeof(m), t0);
+	tag(7, 1, m, sizeof(m), t1);
+	tag(7, 2, m, sizeof(m), t2);
+
+	k = testKey(7, 0);
+	store.Add(7, k.data(), static_cast<uint32_t>(k.size()));
+	if (emsha::EMSHAResult::OK != store.Verify(7, m, sizeof(m), t0, 16)) {
+		fail(area, "truncated tag under the current key rejected");
+	}
+	if (emsha::EMSHAResult::VerifyFailed != store.Verify(7, m, sizeof(m), t1, 32)) {
+		fail(area, "tag under an unknown key accepted");
+	}
+
+	// During a rotation, tags under either key verify.
+	k = testKey(7, 1);
+	store.Rotate(7, k.data(), static_cast<uint32_t>(k.size()));
+	if ((emsha::EMSHAResult::OK != store.Verify(7, m, sizeof(m), t0, 32)) ||
+	    (emsha::EMSHAResult::OK != store.Verify(7, m, sizeof(m), t1, 32))) {
+		fail(area, "tag rejected during a rotation");
+	}
+
+	// Rotating again drops the oldest key.
+	k = testKey(7, 2);
+	store.Rotate(7, k.data(), static_cast<uint32_t>(k.size()));
+	if ((emsha::EMSHAResult::VerifyFailed != store.Verify(7, m, sizeof(m), t0, 32)) ||
+	    (emsha::EMSHAResult::OK != store.Verify(7, m, sizeof(m), t1, 32)) ||
+	    (emsha::EMSHAResult::OK != store.Verify(7, m, sizeof(m), t2, 32))) {
+		fail(area, "wrong keys after a second rotation");
+	}
+
+	if (!store.Retire(7) || store.Retire(7)) {
+		fail(area, "retiring the previous key");
+	}
+	if ((emsha::EMSHAResult::VerifyFailed != store.Verify(7, m, sizeof(m), t1, 32)) ||
+	    (emsha::EMSHAResult::OK != store.Verify(7, m, sizeof(m), t2, 32))) {
+		fail(area, "wrong keys after retiring");
+	}
+
+	t2[20] ^= 1;
+	if (emsha::EMSHAResult::VerifyFailed != store.Verify(7, m, sizeof(m), t2, 32)) {
+		fail(area, "modified tag accepted");
+	}
+	if (emsha::EMSHAResult::VerifyFailed != store.Verify(7, m, sizeof(m), t2, 8)) {
+		fail(area, "over-truncated tag accepted");
+	}
+	if (emsha::EMSHAResult::VerifyFailed != store.Verify(8, m, sizeof(m), t0, 32)) {
+		fail(area, "tag under a missing ID accepted");
+	}
+
+	cout << "PASSED: key store rotation\n";
+}
+
+
+// concurrencyTest rotates keys while other threads look them up; every
+// key a reader sees must be one of the versions that was written for
+// that ID, never a mix.
+static void
+concurrencyTest()
+{
+	const uint64_t		ids = 16;
+	const uint32_t		versions = 64;
+	emsha::KeyStore		store(ids);
+	vector<emsha::HMACMidstate>	all(ids * versions);
+	atomic<bool>		done(false);
+	atomic<bool>		torn(false);
+
+	for (uint64_t id = 0; id < ids; id++) {
+		for (uint32_t v = 0; v < versions; v++) {
+			vector<uint8_t>	k = testKey(id, v);
+			emsha::HMACPrecompute(k.data(), static_cast<uint32_t>(k.size()),
+					      all[(id * versions) + v]);
+		}
+		vector<uint8_t>	k = testKey(id, 0);
+		store.Add(id, k.data(), static_cast<uint32_t>(k.size()));
+	}
+
+	auto reader = [&]() {
+		emsha::HMACMidstate	key;
+
+		while (!done.load()) {
+			for (uint64_t id = 0; id < ids; id++) {
+				if (!store.Lookup(id, key)) {
+					torn.store(true);
+					continue;
+				}
+
+				bool	known = false;
+				for (uint32_t v = 0; v < versions; v++) {
+					known = known || sameKey(key, all[(id * versions) + v]);
+				}
+				if (!known) {
+					torn.store(true);
+				}
+			}
+		}
+	};
+
+	vector<thread>	readers;
+	for (int i = 0; i < 3; i++) {
+		readers.emplace_back(reader);
+	}
+
+	for (uint32_t round = 0; round < 20; round++) {
+		for (uint32_t v = 1; v < versions; v++) {
+			for (uint64_t id = 0; id < ids; id++) {
+				vector<uint8_t>	k = testKey(id, v);
+				store.Rotate(id, k.data(), static_cast<uint32_t>(k.size()));
+			}
+		}
+	}
+
+	done.store(true);
+	for (auto& t : readers) {
+		t.join();
+	}
+
+	if (torn.load()) {
+		fail(area, "a reader saw a missing or torn key");
+	}
+
+	cout << "PASSED: key store concurrent lookups\n";
+}
+
+
+// Churning through many IDs mustn't leave the table harder to probe:
+// a lookup for an absent ID runs to the end of its cluster, so the
+// clusters must stay as short as the live IDs alone make them.
+static void
+churnTest()
+{
+	const uint32_t		capacity = 1000;
+	const uint64_t		live = 500;
+	emsha::KeyStore		store(capacity);
+	emsha::HMACMidstate	key;
+	vector<uint8_t> const	k = testKey(7, 0);
+	uint32_t const		kl = static_cast<uint32_t>(k.size());
+
+	for (uint64_t id = 0; id < live; id++) {
+		store.Add(id, k.data(), kl);
+	}
+	for (uint64_t id = live; id < 20 * capacity; id++) {
+		if ((emsha::EMSHAResult::OK != store.Add(id, k.data(), kl)) ||
+		    !store.Remove(id - live)) {
+			fail(area, "churn at ID " + to_string(id));
+		}
+	}
+
+	uint64_t const	first = (20 * capacity) - live;
+	if (store.Size() != live) {
+		fail(area, "size after churn");
+	}
+	for (uint64_t id = 0; id < 20 * capacity; id++) {
+		if (store.Lookup(id, key) != (id >= first)) {
+			fail(area, "wrong lookup result after churn for ID " + to_string(id));
+		}
+	}
+
+	uint32_t	longest = 0;
+	for (uint64_t id = 1000000; id < 1010000; id++) {
+		longest = max(longest, store.Probes(id));
+	}
+	if (longest > 32) {
+		fail(area, "probe length " + to_string(longest) + " after churn");
+	}
+
+	emsha::KeyStore	huge(emsha::KeyStore::MAX_CAPACITY + 1);
+	if ((huge.Capacity() != 0) ||
+	    (emsha::EMSHAResult::NoSpace != huge.Add(1, k.data(), kl))) {
+		fail(area, "an oversized capacity was accepted");
+	}
+
+	cout << "PASSED: key store churn\n";
+}
+
+
+// Lookups for IDs that stay put never fail while entries around them
+// are removed and shifted back.
+static void
+removalConcurrencyTest()
+{
+	const uint64_t		stable = 64;
+	emsha::KeyStore		store(256);
+	vector<uint8_t> const	k = testKey(3, 0);
+	uint32_t const		kl = static_cast<uint32_t>(k.size());
+	atomic<bool>		done(false);
+	atomic<bool>		missed(false);
+
+	for (uint64_t id = 0; id < stable; id++) {
+		store.Add(id, k.data(), kl);
+	}
+
+	auto reader = [&]() {
+		emsha::HMACMidstate	key;
+
+		while (!done.load()) {
+			for (uint64_t id = 0; id < stable; id++) {
+				if (!store.Lookup(id, key)) {
+					missed.store(true);
+				}
+			}
+		}
+	};
+
+	vector<thread>	readers;
+	for (int i = 0; i < 3; i++) {
+		readers.emplace_back(reader);
+	}
+
+	for (uint64_t id = 1000; id < 30000; id++) {
+		store.Add(id, k.data(), kl);
+		if (id >= 1100) {
+			store.Remove(id - 100);
+		}
+	}
+
+	done.store(true);
+	for (auto& t : readers) {
+		t.join();
+	}
+
+	if (missed.load()) {
+		fail(area, "a lookup missed an ID while others were removed");
+	}
+
+	cout << "PASSED: key store concurrent removal\n";
+}
+
+
+int
+main()
+{
+	basicTest();
+	rotationTest();
+	concurrencyTest();
+	churnTest();
+	removalConcurrencyTest();
+	exit(0);
+}
@@ -0,0 +1,638 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/lms.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static constexpr uint32_t	n = emsha::SHA256_HASH_SIZE;
+
+
+static const char *area = "LMS";
+
+
+static void
+putU32(vector<uint8_t>& out, uint32_t v)
+{
+	out.push_back(static_cast<uint8_t>(v >> 24));
+	out.push_back(static_cast<uint8_t>(v >> 16));
+	out.push_back(static_cast<uint8_t>(v >> 8));
+	out.push_back(static_cast<uint8_t>(v));
+}
+
+
+static void
+putU16(vector<uint8_t>& out, uint32_t v)
+{
+	out.push_back(static_cast<uint8_t>(v >> 8));
+	out.push_back(static_cast<uint8_t>(v));
+}
+
+
+static vector<uint8_t>
+sha(const vector<uint8_t>& m)
+{
+	vector<uint8_t>	d(n);
+
+	emsha::SHA256Digest(m.data(), static_cast<uint32_t>(m.size()), d.data());
+	return d;
+}
+
+
+// testKey is a straightforward LMS signer following RFC 8554 and its
+// appendix A key generation, written against the generic SHA256
+// context so that it shares nothing with the verifier's fixed-length
+// kernels.
+struct testKey {
+	uint32_t		lmsType;
+	uint32_t		otsType;
+	uint32_t		h;
+	uint32_t		w;
+	uint32_t		p;
+	uint32_t		ls;
+	vector<uint8_t>		I;
+	vector<uint8_t>		seed;
+	vector<vector<uint8_t>>	T;	// Tree nodes, indexed from 1.
+
+	testKey(uint32_t lms, uint32_t ots, uint8_t tag);
+
+	vector<uint8_t>	prefix(uint32_t q) const;
+	vector<uint8_t>	chain(uint32_t q, uint32_t i, vector<uint8_t> tmp,
+			      uint32_t from, uint32_t to) const;
+	vector<uint8_t>	secret(uint32_t q, uint32_t i) const;
+	vector<uint8_t>	Public() const;
+	vector<uint8_t>	Sign(uint32_t q, const vector<uint8_t>& m) const;
+};
+
+
+testKey::testKey(uint32_t lms, uint32_t ots, uint8_t tag)
+    : lmsType(lms), otsType(ots), h(5 * (lms - 4)), w(1U << (ots - 1)),
+      I(16), seed(n)
+{
+	static const uint32_t	ps[] = {265, 133, 67, 34};
+	static const uint32_t	lss[] = {7, 6, 4, 0};
+
+	p  = ps[ots - 1];
+	ls = lss[ots - 1];
+
+	for (uint32_t i = 0; i < I.size(); i++) {
+		I[i] = static_cast<uint8_t>(tag + (i * 7));
+	}
+	for (uint32_t i = 0; i < seed.size(); i++) {
+		seed[i] = static_cast<uint8_t>(tag ^ (i * 13));
+	}
+
+	uint32_t const	leaves = 1U << h;
+
+	T.resize(2 * leaves);
+	for (uint32_t r = (2 * leaves) - 1; r > 0; r--) {
+		vector<uint8_t>	m(I);
+
+		putU32(m, r);
+		if (r >= leaves) {
+			uint32_t const	q = r - leaves;
+			vector<uint8_t>	K = prefix(q);
+
+			putU16(K, 0x8080);
+			for (uint32_t i = 0; i < p; i++) {
+				vector<uint8_t>	y = chain(q, i, secret(q, i), 0, (1U << w) - 1);
+				K.insert(K.end(), y.begin(), y.end());
+			}
+
+			putU16(m, 0x8282);
+			K = sha(K);
+			m.insert(m.end(), K.begin(), K.end());
+		} else {
+			putU16(m, 0x8383);
+			m.insert(m.end(), T[2 * r].begin(), T[2 * r].end());
+			m.insert(m.end(), T[(2 * r) + 1].begin(), T[(2 * r) + 1].end());
+		}
+		T[r] = sha(m);
+	}
+}
+
+
+vector<uint8_t>
+testKey::prefix(uint32_t q) const
+{
+	vector<uint8_t>	m(I);
+
+	putU32(m, q);
+	return m;
+}
+
+
+vector<uint8_t>
+testKey::chain(uint32_t q, uint32_t i, vector<uint8_t> tmp, uint32_t from,
+	       uint32_t to) const
+{
+	vector<uint8_t>	m = prefix(q);
+
+	putU16(m, i);
+	m.push_back(0);
+	m.insert(m.end(), tmp.begin(), tmp.end());
+
+	uint8_t *const	j = m.data() + I.size() + 6;
+	for (uint32_t step = from; step < to; step++) {
+		*j = static_cast<uint8_t>(step);
+		emsha::SHA256Digest(m.data(), static_cast<uint32_t>(m.size()), j + 1);
+	}
+	return vector<uint8_t>(j + 1, j + 1 + n);
+}
+
+
+vector<uint8_t>
+testKey::secret(uint32_t q, uint32_t i) const
+{
+	vector<uint8_t>	m = prefix(q);
+
+	putU16(m, i);
+	m.push_back(0xff);
+	m.insert(m.end(), seed.begin(), seed.end());
+	return sha(m);
+}
+
+
+vector<uint8_t>
+testKey::Public() const
+{
+	vector<uint8_t>	pub;
+
+	putU32(pub, lmsType);
+	putU32(pub, otsType);
+	pub.insert(pub.end(), I.begin(), I.end());
+	pub.insert(pub.end(), T[1].begin(), T[1].end());
+	return pub;
+}
+
+
+vector<uint8_t>
+testKey::Sign(uint32_t q, const vector<uint8_t>& msg) const
+{
+	vector<uint8_t>	C(n);
+	vector<uint8_t>	sig;
+
+	for (uint32_t i = 0; i < n; i++) {
+		C[i] = static_cast<uint8_t>((q * 31) + i);
+	}
+
+	vector<uint8_t>	m = prefix(q);
+	putU16(m, 0x8181);
+	m.insert(m.end(), C.begin(), C.end());
+	m.insert(m.end(), msg.begin(), msg.end());
+	vector<uint8_t>	Q = sha(m);
+
+	uint32_t const	max = (1U << w) - 1;
+	auto coef = [&](uint32_t i) {
+		return (Q[(i * w) / 8] >> (8 - ((w * (i % (8 / w))) + w))) & max;
+	};
+
+	uint32_t	sum = 0;
+	for (uint32_t i = 0; i < (8 * n) / w; i++) {
+		sum += max - coef(i);
+	}
+	putU16(Q, sum << ls);
+
+	putU32(sig, q);
+	putU32(sig, otsType);
+	sig.insert(sig.end(), C.begin(), C.end());
+	for (uint32_t i = 0; i < p; i++) {
+		vector<uint8_t>	y = chain(q, i, secret(q, i), 0, coef(i));
+		sig.insert(sig.end(), y.begin(), y.end());
+	}
+
+	putU32(sig, lmsType);
+	uint32_t	r = (1U << h) + q;
+	for (uint32_t i = 0; i < h; i++, r >>= 1) {
+		sig.insert(sig.end(), T[r ^ 1].begin(), T[r ^ 1].end());
+	}
+	return sig;
+}
+
+
+// Generating a W8 key takes a few hundred thousand hashes, so each
+// key is only generated once.
+static const testKey&
+keyFor(uint32_t ots)
+{
+	static vector<unique_ptr<testKey>>	keys(5);
+
+	if (!keys[ots]) {
+		keys[ots].reset(new testKey(5, ots, static_cast<uint8_t>(ots)));
+	}
+	return *keys[ots];
+}
+
+
+static emsha::EMSHAResult
+verify(const vector<uint8_t>& pub, const vector<uint8_t>& m, const vector<uint8_t>& sig)
+{
+	return emsha::LMSVerify(pub.data(), pub.size(), m.data(), m.size(),
+				sig.data(), sig.size());
+}
+
+
+static void
+lmsTest()
+{
+	vector<uint8_t>	msg(200);
+
+	for (uint32_t i = 0; i < msg.size(); i++) {
+		msg[i] = static_cast<uint8_t>(i * 3);
+	}
+
+	for (uint32_t ots = 1; ots <= 4; ots++) {
+		const testKey&		key = keyFor(ots);
+		vector<uint8_t>		pub = key.Public();
+		string const		label = "W" + to_string(key.w) + ": ";
+
+		for (uint32_t q : {0U, 1U, 17U, 31U}) {
+			vector<uint8_t>	sig = key.Sign(q, msg);
+
+			if (emsha::EMSHAResult::OK != verify(pub, msg, sig)) {
+				fail(area, label + "valid signature rejected at q=" + to_string(q));
+			}
+
+			vector<uint8_t>	bad(msg);
+			bad[q % msg.size()] ^= 1;
+			if (emsha::EMSHAResult::VerifyFailed != verify(pub, bad, sig)) {
+				fail(area, label + "modified message accepted");
+			}
+
+			// Flip a bit in each part of the signature: q, the
+			// OTS type, C, the first and last chain values, the
+			// LMS type and the path.
+			size_t const	yEnd = 8 + (n * (key.p + 1));
+			for (size_t off : {size_t(3), size_t(7), size_t(8), size_t(8 + n),
+					   yEnd - 1, yEnd + 3, sig.size() - 1}) {
+				bad = sig;
+				bad[off] ^= 1;
+				if (emsha::EMSHAResult::VerifyFailed != verify(pub, msg, bad)) {
+					fail(area, label + "modified signature accepted at offset " +
+					     to_string(off));
+				}
+			}
+
+			bad = sig;
+			bad.pop_back();
+			if (emsha::EMSHAResult::VerifyFailed != verify(pub, msg, bad)) {
+				fail(area, label + "truncated signature accepted");
+			}
+		}
+
+		vector<uint8_t>	sig = key.Sign(5, msg);
+		vector<uint8_t>	badPub(pub);
+		badPub.back() ^= 1;
+		if (emsha::EMSHAResult::VerifyFailed != verify(badPub, msg, sig)) {
+			fail(area, label + "wrong public key accepted");
+		}
+	}
+
+	// An empty message is allowed, with or without a pointer.
+	const testKey&	key = keyFor(4);
+	vector<uint8_t>	empty;
+	vector<uint8_t>	sig = key.Sign(3, empty);
+	vector<uint8_t>	pub = key.Public();
+	if (emsha::EMSHAResult::OK !=
+	    emsha::LMSVerify(pub.data(), pub.size(), nullptr, 0, sig.data(), sig.size())) {
+		fail(area, "empty message rejected");
+	}
+
+	if (emsha::EMSHAResult::NullPointer !=
+	    emsha::LMSVerify(pub.data(), pub.size(), nullptr, 1, sig.data(), sig.size())) {
+		fail(area, "null message accepted");
+	}
+
+	cout << "PASSED: LMS verification\n";
+}
+
+
+static void
+hssTest()
+{
+	const testKey&	top = keyFor(4);
+	const testKey&	bottom = keyFor(3);
+	vector<uint8_t>	msg = {'f', 'i', 'r', 'm', 'w', 'a', 'r', 'e'};
+	vector<uint8_t>	pub;
+	vector<uint8_t>	sig;
+
+	putU32(pub, 2);
+	vector<uint8_t>	topPub = top.Public();
+	pub.insert(pub.end(), topPub.begin(), topPub.end());
+
+	vector<uint8_t>	bottomPub = bottom.Public();
+	vector<uint8_t>	signedPub = top.Sign(7, bottomPub);
+	vector<uint8_t>	msgSig = bottom.Sign(12, msg);
+
+	putU32(sig, 1);
+	sig.insert(sig.end(), signedPub.begin(), signedPub.end());
+	sig.insert(sig.end(), bottomPub.begin(), bottomPub.end());
+	sig.insert(sig.end(), msgSig.begin(), msgSig.end());
+
+	auto check = [&](const vector<uint8_t>& p, const vector<uint8_t>& s) {
+		return emsha::HSSVerify(p.data(), p.size(), msg.data(), msg.size(),
+					s.data(), s.size());
+	};
+
+	if (emsha::EMSHAResult::OK != check(pub, sig)) {
+		fail(area, "valid HSS signature rejected");
+	}
+
+	// The bottom key, the message signature, the level count and
+	// the signed public key's signature.
+	size_t const	bottomKeyAt = 4 + signedPub.size() + 20;
+	for (size_t off : {bottomKeyAt, sig.size() - 1, size_t(3), size_t(40)}) {
+		vector<uint8_t>	bad(sig);
+		bad[off] ^= 1;
+		if (emsha::EMSHAResult::VerifyFailed != check(pub, bad)) {
+			fail(area, "modified HSS signature accepted at offset " + to_string(off));
+		}
+	}
+
+	vector<uint8_t>	bad(sig);
+	bad.resize(sig.size() - 1);
+	if (emsha::EMSHAResult::VerifyFailed != check(pub, bad)) {
+		fail(area, "truncated HSS signature accepted");
+	}
+
+	bad = pub;
+	bad[3] = 1;
+	if (emsha::EMSHAResult::VerifyFailed != check(bad, sig)) {
+		fail(area, "HSS signature with the wrong level count accepted");
+	}
+
+	// A one-level HSS signature is just an LMS signature.
+	vector<uint8_t>	one;
+	putU32(one, 0);
+	one.insert(one.end(), msgSig.begin(), msgSig.end());
+	bad = {0, 0, 0, 1};
+	bad.insert(bad.end(), bottomPub.begin(), bottomPub.end());
+	if (emsha::EMSHAResult::OK != check(bad, one)) {
+		fail(area, "single-level HSS signature rejected");
+	}
+
+	cout << "PASSED: HSS verification\n";
+}
+
+
+// RFC 8554 appendix F, test case 2: a two-level HSS key, with an
+// H10/W4 top level and an H5/W8 bottom level, signing the Ninth
+// Amendment. The signature is rebuilt from the seeds the test case
+// gives for each level; the public keys they yield, and the bottom
+// level's signature of the message, are the published ones.
+static const char	*rfcPublicKey =
+	"000000020000000600000003d08fabd4a2091ff0a8cb4ed834e7453432a58885"
+	"cd9ba0431235466bff9651c6c92124404d45fa53cf161c28f1ad5a8e";
+
+static const char	*rfcSignature =
+	// Nspk
+	"00000001"
+	// Top-level signature: q, LMOTS type, C
+	"00000004000000030703c491e7558b35011ece3592eaa5da4d918786771233e8"
+	"353bc4f62323185c"
+	// y[0] to y[66]
+	"28505b7cbcd06139dbd637e87c88245c191e4713a3d13299de511a5c1a4df23d"
+	"19721db3ee604e201d96d36372eac047c1aa5efdf3c9508a64cca2ddb4e35afc"
+	"6babf33d7888c3b3a2c8bb58bd3649a884e9ac3b1daaa7cd7edb34df08f79759"
+	"380b1444885c2165e5987bb43dd6a368718f9eaff7af52da8632470b95b9073e"
+	"793f17761d158b806463205a518dcb4c99b9889980a88f9ab7888aa3fb15040c"
+	"14492ed03658afbeb09d9f9ed175fa76a1250e45a422484c5498304f40d8c08e"
+	"309e0ceda64ee99c092d045fde043b6aff63e4eca31e00d8de471d53d9467ac4"
+	"a56e2d086bf0878679064e9388a54179a9125b55bef80a99396a0fbb3adce663"
+	"03c5b01586286c0128dfbd2ecad9aaa0d5182f3dd52dbe98e69d7b108b347746"
+	"417c276978db4389db715c0e0b30cd1c4b2ddc83a8f6ad530fbf8ccd8dd91db1"
+	"1e491b9d7cfcfea81b367a072027c10516d28d70450c8161ce98f141e8da482c"
+	"91146ad5e824f88593009222c5b55c4547593bbd68b28599875f38fe0d24f5cd"
+	"47b3052c28643ac3a30d513140e2382988a2e5eb6ea6721e2d7baaf8151fd69b"
+	"d5b83f9e7c400a58ec9bffbc285f126f9efd81ad7bf4b7f0f0e892b8de2082a1"
+	"b3db6b30a973e0ee8ab36bd0c817f927c671acc5e4c676b1dd90271310c1d150"
+	"11af116041a24485424bdf328b1ff2103cd593705d923ae25ca59432b529b9ea"
+	"e4d4b8374801aabc9042dc1652af5611579c495c2e1be68c0963169040e41b47"
+	"c589226e6c2fa0ce6e9cee7cf0f12924a574a19306544ac9137a1becef9874de"
+	"f0ee90dc9b099d38beccfbbb09323811e91f12749e85af56bbdd6d5e4800e46d"
+	"fcccdf4786ace7f12b0b21143687b9bdae662f17065a66c1a893dbf364282ea0"
+	"59889570c7e7c50fe0221d1aaeb8731828688c6fdade7ec951fac055c0777c69"
+	"03af20626ac158a226b1c9e726605109ff255bfa80600e2c52b0d8af5a2b1ae0"
+	"4f1ea246b4f88e78f3d4bae86266858993516d4ed6e0e6ed7056a173ca423fcc"
+	"705cb8c9486b686ee3a513d070ddd75e03b1f8ec6e4dc7032c2be55c8ce6957c"
+	"e11b54287ef4a9460829405113c0c62a827a6840d97f87f4f558f28f70673ae1"
+	"dda78d8db05839be4750a10e971244ce0208d9ddcdcf2c24c1e9e8be48b4f9a1"
+	"5388a54208d3f445292af3e97bd53f6bc985b74cabbd70afa6bc88ed6adebd31"
+	"f378822203dd28f987f2f9f9ca585165f5b975cf3dcd08b2c74a9e483758bda3"
+	"d37d77b57ce60d57cf480285d13148145b713678d56f3792228accc9f13217c1"
+	"1dbf511a4db2aed79713bf7bf0587eb0d3b8e840d0f88976f8382d5977f4643f"
+	"bc10a7b8ba90566c7ad7deac5e9fe19fac7970b1178b9a33441591b0c7431ceb"
+	"d96b860791fff854e1a9319ed1f302646fefee3bcaf20a0a0606a88e6f3c1f8d"
+	"a5cab89e3a0ea7d60ad999cc01b0b675e53dc33fdf4b67f235f4cc210557b99f"
+	"38879b58d08caa1ebad8651059b87715d7396f8780384759c033e0dfa634cadb"
+	"7ba3a3fe294b585879300eb705a542595d49820902770bfb2c735a476747969f"
+	"58cdbcaea05b324d532fb7b89d5d24a0b1ca30963b5d7de728bb0ac9537854b9"
+	"6a68f436dc1ae80fafc3c660afdb268b352db0d42764663bb2b074539ae21abb"
+	"75d52c1bc178e38fb63c626c7cea499e3b098e2a7510af49d5bac1d6bdbbcf02"
+	"b1c5dd1dcf79760e78288abbc3573d39f8adba85fd61cef0381a66fb80a4b431"
+	"16c2555a776dde1de79952bf79b2ec5f22404d3b81d6c6dfc6ee277495420507"
+	"0133309b56ac8b691fa1cc6e5ad7e3bf71a12de6e7c8298004d9ece82287ca62"
+	"58dea85b805de68da4b85cfa7860652e63aff8da2379a1ed6c82a515a9ae520e"
+	"f278d14eac745e410cbf15671421ada0d6f094de849bdfb0af5402c97cf5ce32"
+	"c5f2107a8dc6e29f4f4f4ae9d9d77802057de80418543b249e4d803dae7d393d"
+	"d7bb09371e3cc2f6f2c58d085480348fa25b3843cbb970995f134e5e82212f91"
+	"95c445b975069cf9eede335780d1994242c8c30519232eb122880141180b3ab4"
+	"2971ea1e41f1b8716ff6f3421e57312047dc859ef3f5f94a70271d966d23143f"
+	"b7b0cb2409fb8a0753cb1716a9eafb8457ab344c1379e79ce85973588ba2905e"
+	"4d872f31a48e909ed1ec852feb3efb4b11be48865a955d29e9e564669c042a37"
+	"4c86c5a17f9faa2e8201498466c714b85ae095ecccd7d9b8ab93280c6724070b"
+	"ece392fdcc8bbcc42420747c994d9f69b8f88615dbf44b89e5d05c6cab6a5969"
+	"cc34c25dde5cd3dfec84a52dd0704e535dff41caa75d76981208a531b1473124"
+	"77392ee6daaea839255fa5cd9223eccaae7a1812134db92be5da4d61b86bf55d"
+	"8940aaf167f99645b527af4763592f6c1a2e01e79ec4597b8bd36afe353635e7"
+	"439fa5f471d6424ac59d99cd72d6ea6f804491915e113fbc7ec8cfd571612856"
+	"64c3a7759029c87486192fd53cfe851d4419dd379354f15e5ccdd5c2470f3db0"
+	"c21c1acb6f2842b34a376a2d1c63277a0343eaafb989abd1a759003138c9f15e"
+	"b0726c8e6691440a9f1ef1b70c1254ab23539a59669862ba47bcdc5d16551acd"
+	"df9923345a9dd87b2a55062c6bd04d4d075e7252308a705ff169a068a3367566"
+	"741b769c7be3716dab405991a2080f11fdbcd5c83b4c06ed2b2ac9835469a66b"
+	"8ec738226833afa23ac552e52d2dad890c629e96ba00e12a629828c6134aa7a2"
+	"01c5d23451a69ec7c6eb970214454feb755324ea963e8da92ea19708f506e802"
+	"b1a76ea9b266b1ca66f4799cab4b10d2f8cea8eabca3229704d34adefbfe2f90"
+	"c1a300e9b7d1efcdf2796e73ecb3f2df83de615a14808ec5e7f313a19def60dc"
+	"167265ad287a9d506385b90db82c4d46efa9d54976b69e386d39db1e882837b3"
+	"b95f0814842d774a8959984d42e82edb48a77f8d3539ed6e0995cebe58b466d7"
+	"32ddaeee47bfcd9a150759069327efb193863cc0cb6f25ef2fc54616b1c3c80f"
+	// LMS type and path[0] to path[9]
+	"000000066f5ad77d8c9815af8a3acbea93ab024e4482cf8466fb212b7eefa5ae"
+	"81cfdf1fb6b09e79030a9d031991592d1c8b613bf652ff1fe59e857b907ca223"
+	"9bc251e734f9c294aa7f8c4fc0c247dd8b5c96903ae73abc0035b7fb09ebaec2"
+	"35c416c2686d16621a80816bfdb5bdc56211d72ca70b81f1117d129529a7570c"
+	"f79cf52a7028a48538ecdd3b38d3d5d62d26246595c4fb73a525a5ed2c30524e"
+	"bb1d8cc82e0c19bc4977c6898ff95fd3d310b0bae71696cef93c6a552456bf96"
+	"e9d075e383bb7543c675842bafbfc7cdb88483b3276c29d4f0a341c2d406e40d"
+	"4653b7e4d045851acf6a0a0ea9c710b805cced4635ee8c107362f0fc8d80c14d"
+	"0ac49c516703d26d14752f34c1c0d2c4247581c18c2cf4de48e9ce949be7c888"
+	"e9caebe4a415e291fd107d21dc1f084b1158208249f28f4f7c7e931ba7b3bd0d"
+	"824a4570"
+	// Bottom-level public key
+	"0000000500000004215f83b7ccb9acbcd08db97b0d04dc2ba1cd035833e0e900"
+	"59603f26e07ad2aad152338e7a5e5984bcd5f7bb4eba40b7"
+	// Message signature: q, LMOTS type, C
+	"0000000a000000040eb1ed54a2460d512388cad533138d240534e97b1e82d33b"
+	"d927d201dfc24ebb"
+	// y[0] to y[33]
+	"c905a7a07666103d963821960a3c2e3c869b14e62702a4bb38ed1f0dc9e339f0"
+	"de41186f59e84b02dce965b46868fe9889d6cff7d9f66a486b01ac7291be7777"
+	"e7dce5116f67c1d51561428c6b43082d4f0464a6de04810b4a94548a3baacf9d"
+	"a8ba2a4a5b43526d6f8ea65aa439f5045bfcbf22887a526916ce9c3c94537d2d"
+	"c96119ef0de8d32511382d922157e20aae8d10c36cc285e4a222d4d896d28aa2"
+	"d19f7df02fb638ff575934235ea2ce87faa23720f677de01b7c369afc9cb87ae"
+	"b2a29253a96af05c4aeeb403cf50812541067986598a45869fe707277a4d2315"
+	"8f647c463855806f9904b93b04cc72347a48bd00ceec6feede67b5363870411e"
+	"b91479480d889c71214707d1a0e03d84f07f2e4203e70ea34bfea0a3b2220b16"
+	"4c1c16da31aca7192e544445b2be0433fd0d2739269d20726a408eb403240f67"
+	"f96ef56edbff661260b4b55c63183d00e7d428a74600b4918bacd9f57df4705e"
+	"1bc353967607b490972da3d35801f6f3b98ddf60126417c226333de08e7f7dfa"
+	"cb311db9422bf0bfa121e8e5b0947dc59a434fa8d3edb6aa3ece049b7efac520"
+	"a73aff55f8ee8b37cda725da2f2f2118e9a343062346c57eb593e6699d150b71"
+	"3df47b84a7bfdb51a2ed6cb515c796dffc5d1955683258e41776972859042b14"
+	"1bae7916cbf9f528e48be94fed342fd37155946ec2d4f92c75bfcb1550b4c397"
+	"a64a94d04bb22373112c8e01901f495dce58d4780e30ee1e7f046fdc2990082b"
+	"0a463b3efe5ee7aad79c436f5e8cc70467345d6a901fb2cf6b3f1b28bbca57db"
+	"24c869da20a8ae4850b43e1fb2a9630757979a5a1244846d3b5e67341b34194e"
+	"323f3d99cb5a5a575bee3a0302f73464b5d3242d75d10be05b444a0a3f4b49d5"
+	"450bbedb2c2a5109c9ee586054bcb39a9dbf29f1cd54a1baf6741bbc4212e0d8"
+	"9087d89c2746580fa7c7baaa9b2947c1cce6167dc7a817576df6ef7320c8ce7a"
+	"89cfa578aebbd6672cfd4d9ae9558765971d9d3b237a52c665dd218803799ecd"
+	"d652911b718b4249150d549e733ca1ed23dac4a12bf8d2e5736a3c48b3c3a357"
+	"aa89725efb1c102f48cc0afa1c4e3bda5e9600c8311ea5c63db0b8217f339f62"
+	"3f34b483f8e92f0b5faf91a04af3085c05133a4c1923dcb4620f6a7f50d082b8"
+	"9da08411e1860275952b4a6ac3829633b1c8c3acf281ed3c0fc32e1147ef4ad9"
+	"31230e282e7610a70e9b0e5beddde30a97da6e335603add92ae92d2f114dc294"
+	"e8f354bf258128165d27968661044b512f2fa354cbadacc9256b51a01500de62"
+	"e1e8ea011af1be5b2a41197c6368509d49d2f5d721a11d749ba1f0fe6c1f5b16"
+	"e696f332dc2802b0d725b244aa9a0bab8dbb836f83d9ae57de13dcc59bfbfab5"
+	"4c3ac953f86369ea083837a5b31997370d5da3b3248137057ca3a50226de5f63"
+	"9b93507acdd8bc90b10857da5197b57b9679e3377dca0d3cc051aec66b900a71"
+	"0d8e45c86b7c05af5f87e98c00e8df7df6e4b29004e336a738b287ebca90be6a"
+	// LMS type and path[0] to path[4]
+	"000000055656ce83d1191385d9c28095447048b42bf1ecf1610c1616a2c7583d"
+	"728ecd893213f003d5b0c8c6e2697bdb4437f93ee198ae981d5ab0a34ae47bed"
+	"df6e0bbbbcb258c828f34935c26e28890d970519224c703f3734d479660c0bc6"
+	"1decb0d7f5d0b3f687ffc87ed577f3d6b63e22fec28117a07e40d8d4b97da277"
+	"c0eebbc9e4041d95398a6f7f3e0ee97cc1591849d4ed236338b147abde9f51ef"
+	"9fd4e1c1";
+
+static const char	*rfcMessage =
+	"The enumeration in the Constitution, of certain rights, shall "
+	"not be construed to deny or disparage others retained by the "
+	"people.\n";
+
+
+static vector<uint8_t>
+fromHex(const char *s)
+{
+	vector<uint8_t>	out;
+	auto		nibble = [](char c) {
+		return static_cast<uint8_t>((c <= '9') ? (c - '0') : (c - 'a' + 10));
+	};
+
+	for (; (s[0] != 0) && (s[1] != 0); s += 2) {
+		out.push_back(static_cast<uint8_t>((nibble(s[0]) << 4) | nibble(s[1])));
+	}
+	return out;
+}
+
+
+// rfcTest checks the test case against the verifier, and that
+// changing any one byte of the key, message or signature breaks it.
+static void
+rfcTest()
+{
+	vector<uint8_t> const	pub = fromHex(rfcPublicKey);
+	vector<uint8_t> const	sig = fromHex(rfcSignature);
+	string const		msgText(rfcMessage);
+	vector<uint8_t> const	msg(msgText.begin(), msgText.end());
+
+	auto check = [](const vector<uint8_t>& p, const vector<uint8_t>& m,
+			const vector<uint8_t>& s) {
+		return emsha::HSSVerify(p.data(), p.size(), m.data(), m.size(),
+					s.data(), s.size());
+	};
+
+	if ((pub.size() != 60) || (sig.size() != 3860)) {
+		fail(area, "RFC 8554 test case 2 is malformed");
+	}
+	if (emsha::EMSHAResult::OK != check(pub, msg, sig)) {
+		fail(area, "RFC 8554 test case 2 rejected");
+	}
+
+	for (size_t off = 0; off < sig.size(); off += 61) {
+		vector<uint8_t>	bad(sig);
+		bad[off] ^= 0x01;
+		if (emsha::EMSHAResult::VerifyFailed != check(pub, msg, bad)) {
+			fail(area, "RFC 8554 test case 2 accepted with signature byte " +
+			     to_string(off) + " changed");
+		}
+	}
+
+	for (size_t off = 0; off < pub.size(); off++) {
+		vector<uint8_t>	bad(pub);
+		bad[off] ^= 0x80;
+		if (emsha::EMSHAResult::VerifyFailed != check(bad, msg, sig)) {
+			fail(area, "RFC 8554 test case 2 accepted with key byte " +
+			     to_string(off) + " changed");
+		}
+	}
+
+	for (size_t off : {size_t(0), msg.size() / 2, msg.size() - 1}) {
+		vector<uint8_t>	bad(msg);
+		bad[off] ^= 0x20;
+		if (emsha::EMSHAResult::VerifyFailed != check(pub, bad, sig)) {
+			fail(area, "RFC 8554 test case 2 accepted with message byte " +
+			     to_string(off) + " changed");
+		}
+	}
+
+	cout << "PASSED: RFC 8554 test case 2\n";
+}
+
+
+int
+main()
+{
+	lmsTest();
+	hssTest();
+	rfcTest();
+	exit(0);
+}
@@ -0,0 +1,290 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/merkle.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static constexpr uint64_t	maxLeaves = 40;
+
+static vector<uint8_t>		leaves(maxLeaves * emsha::SHA256_HASH_SIZE);
+
+
+static const char *area = "Merkle tree";
+
+
+// referenceRoot is MTH(D[n]) straight from RFC 9162, using the
+// generic SHA256 context.
+static void
+referenceRoot(const uint8_t *hashes, uint64_t n, uint8_t *root)
+{
+	if (n == 1) {
+		copy(hashes, hashes + emsha::SHA256_HASH_SIZE, root);
+		return;
+	}
+
+	uint64_t	k = 1;
+	uint8_t		l[emsha::SHA256_HASH_SIZE];
+	uint8_t		r[emsha::SHA256_HASH_SIZE];
+	uint8_t const	prefix = 1;
+	emsha::SHA256	ctx;
+
+	while ((k << 1) < n) {
+		k <<= 1;
+	}
+
+	referenceRoot(hashes, k, l);
+	referenceRoot(hashes + (k * emsha::SHA256_HASH_SIZE), n - k, r);
+	ctx.Update(&prefix, 1);
+	ctx.Update(l, sizeof(l));
+	ctx.Update(r, sizeof(r));
+	ctx.Finalise(root);
+}
+
+
+// The roots of the first eight trees built from the test leaves used
+// by the Certificate Transparency implementations.
+static void
+knownAnswerTest()
+{
+	const string	data[] = {
+		string(""), string("\x00", 1), string("\x10"), string("\x20\x21"),
+		string("\x30\x31"), string("\x40\x41\x42\x43"),
+		string("\x50\x51\x52\x53\x54\x55\x56\x57"),
+		string("\x60\x61\x62\x63\x64\x65\x66\x67\x68\x69\x6a\x6b\x6c\x6d\x6e\x6f"),
+	};
+	const string	roots[] = {
+		"6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d",
+		"fac54203e7cc696cf0dfcb42c92a1d9dbaf70ad9e621f4bd8d98662f00e3c125",
+		"aeb6bcfe274b70a14fb067a5e5578264db0fa9b51af5e0ba159158f329e06e77",
+		"d37ee418976dd95753c1c73862b9398fa2a2cf9b4ff0fdfe8b30cd95209614b7",
+		"4e3bbb1f7b478dcfe71fb631631519a3bca12c9aefca1612bfce4c13a86264d4",
+		"76e67dadbcdf1e10e1b74ddc608abd2f98dfb16fbce75277b5232a127f2087ef",
+		"ddb89be403809e325750d3d263cd78929c2942b7942a34b77e122c9594a74c8c",
+		"5dc9da79a70659a9ad559cb701ded9a2ab9d823aad2f4960cfe370eff4604328",
+	};
+	uint8_t		hashes[8 * emsha::SHA256_HASH_SIZE];
+	uint8_t		root[emsha::SHA256_HASH_SIZE];
+	string		hs;
+
+	for (uint32_t i = 0; i < 8; i++) {
+		emsha::MerkleLeafHash(reinterpret_cast<const uint8_t *>(data[i].data()),
+				      static_cast<uint32_t>(data[i].size()),
+				      hashes + (i * emsha::SHA256_HASH_SIZE));
+	}
+
+	for (uint32_t n = 1; n <= 8; n++) {
+		emsha::MerkleRoot(hashes, n, root);
+		DumpHexString(hs, root, emsha::SHA256_HASH_SIZE);
+		if (hs != roots[n - 1]) {
+			fail(area, "known answer for " + to_string(n) + " leaves: " + hs);
+		}
+	}
+
+	cout << "PASSED: Merkle tree known answers\n";
+}
+
+
+static void
+rootTest()
+{
+	uint8_t	want[emsha::SHA256_HASH_SIZE];
+	uint8_t	have[emsha::SHA256_HASH_SIZE];
+
+	for (uint64_t n = 1; n <= maxLeaves; n++) {
+		referenceRoot(leaves.data(), n, want);
+		emsha::MerkleRoot(leaves.data(), n, have);
+		if (!emsha::HashEqual(want, have)) {
+			fail(area, "root of " + to_string(n) + " leaves");
+		}
+	}
+
+	cout << "PASSED: Merkle tree roots\n";
+}
+
+
+static void
+inclusionTest()
+{
+	vector<uint8_t>	proof;
+	uint8_t		root[emsha::SHA256_HASH_SIZE];
+
+	for (uint64_t n = 1; n <= maxLeaves; n++) {
+		emsha::MerkleRoot(leaves.data(), n, root);
+
+		for (uint64_t i = 0; i < n; i++) {
+			const uint8_t *leaf = leaves.data() + (i * emsha::SHA256_HASH_SIZE);
+
+			emsha::MerkleInclusionProof(leaves.data(), n, i, proof);
+			if (emsha::EMSHAResult::OK !=
+			    emsha::MerkleVerifyInclusion(leaf, i, n, proof.data(), proof.size(), root)) {
+				fail(area, "inclusion proof");
+			}
+
+			// Wrong position, wrong leaf, modified proof.
+			if (n == 1) {
+				continue;
+			}
+
+			if (emsha::EMSHAResult::VerifyFailed !=
+			    emsha::MerkleVerifyInclusion(leaf, (i + 1) % n, n, proof.data(),
+							 proof.size(), root)) {
+				fail(area, "inclusion proof at the wrong index");
+			}
+			if (emsha::EMSHAResult::VerifyFailed !=
+			    emsha::MerkleVerifyInclusion(root, i, n, proof.data(), proof.size(), root)) {
+				fail(area, "inclusion proof for the wrong leaf");
+			}
+
+			proof[0] ^= 1;
+			if (emsha::EMSHAResult::VerifyFailed !=
+			    emsha::MerkleVerifyInclusion(leaf, i, n, proof.data(), proof.size(), root)) {
+				fail(area, "modified inclusion proof");
+			}
+		}
+	}
+
+	cout << "PASSED: Merkle inclusion proofs\n";
+}
+
+
+static void
+consistencyTest()
+{
+	vector<uint8_t>	proof;
+	uint8_t		oldRoot[emsha::SHA256_HASH_SIZE];
+	uint8_t		root[emsha::SHA256_HASH_SIZE];
+
+	for (uint64_t n = 1; n <= maxLeaves; n++) {
+		emsha::MerkleRoot(leaves.data(), n, root);
+
+		for (uint64_t m = 1; m <= n; m++) {
+			emsha::MerkleRoot(leaves.data(), m, oldRoot);
+			emsha::MerkleConsistencyProof(leaves.data(), n, m, proof);
+
+			if (emsha::EMSHAResult::OK !=
+			    emsha::MerkleVerifyConsistency(m, n, oldRoot, root, proof.data(), proof.size())) {
+				fail(area, "consistency proof " + to_string(m) + " -> " + to_string(n));
+			}
+
+			if (m == n) {
+				continue;
+			}
+
+			if (emsha::EMSHAResult::VerifyFailed !=
+			    emsha::MerkleVerifyConsistency(m, n, root, root, proof.data(), proof.size())) {
+				fail(area, "consistency proof with the wrong old root");
+			}
+
+			if (!proof.empty()) {
+				proof[proof.size() - 1] ^= 1;
+				if (emsha::EMSHAResult::VerifyFailed !=
+				    emsha::MerkleVerifyConsistency(m, n, oldRoot, root, proof.data(),
+								   proof.size())) {
+					fail(area, "modified consistency proof");
+				}
+			}
+		}
+	}
+
+	cout << "PASSED: Merkle consistency proofs\n";
+}
+
+
+static void
+batchTest()
+{
+	uint64_t const			n = maxLeaves - 3;
+	vector<vector<uint8_t>>		proofs(n);
+	vector<emsha::MerkleInclusion>	batch;
+	vector<emsha::EMSHAResult>	results;
+	uint8_t				root[emsha::SHA256_HASH_SIZE];
+	uint8_t				bogus[emsha::SHA256_HASH_SIZE] = {0};
+
+	emsha::MerkleRoot(leaves.data(), n, root);
+
+	// Every leaf, twice, plus a wrong leaf at a shared index.
+	for (uint32_t round = 0; round < 2; round++) {
+		for (uint64_t i = 0; i < n; i++) {
+			emsha::MerkleInclusionProof(leaves.data(), n, i, proofs[i]);
+			batch.push_back({leaves.data() + (i * emsha::SHA256_HASH_SIZE), i,
+					 proofs[i].data(), proofs[i].size()});
+		}
+	}
+	batch.push_back({bogus, 5, proofs[5].data(), proofs[5].size()});
+
+	results.resize(batch.size());
+	if (emsha::EMSHAResult::VerifyFailed !=
+	    emsha::MerkleVerifyInclusionBatch(n, root, batch.data(), batch.size(), results.data())) {
+		fail(area, "batch with a bad proof");
+	}
+
+	for (size_t i = 0; i < batch.size() - 1; i++) {
+		if (emsha::EMSHAResult::OK != results[i]) {
+			fail(area, "batched proof " + to_string(i));
+		}
+	}
+	if (emsha::EMSHAResult::VerifyFailed != results.back()) {
+		fail(area, "the bad proof in a batch verified");
+	}
+
+	batch.pop_back();
+	if (emsha::EMSHAResult::OK !=
+	    emsha::MerkleVerifyInclusionBatch(n, root, batch.data(), batch.size(), nullptr)) {
+		fail(area, "batch of good proofs");
+	}
+
+	cout << "PASSED: Merkle batch verification\n";
+}
+
+
+int
+main()
+{
+	for (uint64_t i = 0; i < maxLeaves; i++) {
+		uint8_t	data[2] = {static_cast<uint8_t>(i), 0x42};
+
+		emsha::MerkleLeafHash(data, sizeof(data),
+				      leaves.data() + (i * emsha::SHA256_HASH_SIZE));
+	}
+
+	knownAnswerTest();
+	rootTest();
+	inclusionTest();
+	consistencyTest();
+	batchTest();
+	exit(0);
+}
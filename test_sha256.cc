@@ -23,7 +23,9 @@
  */
 
 
+#include <algorithm>
 #include <iostream>
+#include <vector>
 #include <emsha/sha256.h>
 #include <cassert>
 
@@ -70,6 +72,169 @@ const struct hashTest goldenTests[] = {
 static constexpr auto numGoldenTests = sizeof goldenTests / sizeof goldenTests[0];
 static const std::string labelGoldenTests = "golden tests";
 
+
+// Writing a message in uneven pieces, so that updates straddle message
+// block boundaries, must give the same digest as writing it all at once.
+static void
+splitUpdateTest()
+{
+	uint8_t	msg[1031];
+	uint8_t	expected[emsha::SHA256_HASH_SIZE];
+	uint8_t	actual[emsha::SHA256_HASH_SIZE];
+
+	for (uint32_t i = 0; i < sizeof(msg); i++) {
+		msg[i] = static_cast<uint8_t>(i * 7);
+	}
+	if (emsha::EMSHAResult::OK != emsha::SHA256Digest(msg, sizeof(msg), expected)) {
+		cerr << "FAILED: split update (single pass)\n";
+		exit(1);
+	}
+
+	for (uint32_t step = 1; step < 150; step += 7) {
+		emsha::SHA256		ctx;
+		emsha::EMSHAResult	res = emsha::EMSHAResult::OK;
+
+		for (uint32_t off = 0; off < sizeof(msg); off += step) {
+			uint32_t const n = std::min(step, static_cast<uint32_t>(sizeof(msg)) - off);
+			if (emsha::EMSHAResult::OK == res) {
+				res = ctx.Update(msg + off, n);
+			}
+		}
+		if (emsha::EMSHAResult::OK == res) {
+			res = ctx.Finalise(actual);
+		}
+
+		if ((emsha::EMSHAResult::OK != res) || !emsha::HashEqual(expected, actual)) {
+			cerr << "FAILED: split update (step " << step << ")\n";
+			exit(1);
+		}
+	}
+
+	cout << "PASSED: split update\n";
+}
+
+
+// A prefix written once and forked must give the same digests as
+// hashing each full message, and the children must not disturb the
+// parent or each other.
+static void
+forkTest()
+{
+	uint8_t			msg[300];
+	uint8_t			expected[emsha::SHA256_HASH_SIZE];
+	uint8_t			actual[emsha::SHA256_HASH_SIZE];
+	emsha::EMSHAResult	res = emsha::EMSHAResult::OK;
+
+	for (uint32_t i = 0; i < sizeof(msg); i++) {
+		msg[i] = static_cast<uint8_t>(i * 11);
+	}
+
+	// Prefix lengths on either side of a block boundary.
+	for (uint32_t prefix : {0, 1, 63, 64, 65, 130}) {
+		emsha::SHA256	parent;
+		emsha::SHA256	child;
+
+		// Dirty the child first; the fork has to replace its state.
+		child.Update(msg, 77);
+
+		if (emsha::EMSHAResult::OK == res) {
+			res = parent.Update(msg, prefix);
+		}
+		if (emsha::EMSHAResult::OK == res) {
+			res = parent.Fork(child);
+		}
+		if (emsha::EMSHAResult::OK == res) {
+			res = child.Update(msg + prefix, sizeof(msg) - prefix);
+		}
+		if (emsha::EMSHAResult::OK == res) {
+			res = child.Finalise(actual);
+		}
+		if (emsha::EMSHAResult::OK == res) {
+			res = emsha::SHA256Digest(msg, sizeof(msg), expected);
+		}
+		if ((emsha::EMSHAResult::OK != res) || !emsha::HashEqual(expected, actual)) {
+			cerr << "FAILED: fork (prefix " << prefix << ", child)\n";
+			exit(1);
+		}
+
+		if (emsha::EMSHAResult::OK == res) {
+			res = parent.Finalise(actual);
+		}
+		if (emsha::EMSHAResult::OK == res) {
+			res = emsha::SHA256Digest(msg, prefix, expected);
+		}
+		if ((emsha::EMSHAResult::OK != res) || !emsha::HashEqual(expected, actual)) {
+			cerr << "FAILED: fork (prefix " << prefix << ", parent)\n";
+			exit(1);
+		}
+	}
+
+	cout << "PASSED: fork\n";
+}
+
+
+// Copying and hashing in one pass must give the same copy and digest
+// as doing them separately, whatever the alignment of the buffers and
+// the state of the pending block, with and without streaming stores.
+static void
+copyAndUpdateTest()
+{
+	std::vector<uint8_t>	src(5000 + 64);
+	std::vector<uint8_t>	dst(5000 + 64);
+	uint8_t			expected[emsha::SHA256_HASH_SIZE];
+	uint8_t			actual[emsha::SHA256_HASH_SIZE];
+
+	for (uint32_t i = 0; i < src.size(); i++) {
+		src[i] = static_cast<uint8_t>((i * 13) + 5);
+	}
+
+	for (bool streaming : {false, true}) {
+		for (uint32_t lead : {0, 1, 63}) {
+			for (uint32_t offset : {0, 3, 16}) {
+				emsha::SHA256		ctx;
+				uint32_t const		length = 5000 - lead;
+				emsha::EMSHAResult	res;
+
+				std::fill(dst.begin(), dst.end(), 0);
+				emsha::SHA256Digest(src.data(), 5000, expected);
+
+				res = ctx.Update(src.data(), lead);
+				if (emsha::EMSHAResult::OK == res) {
+					res = ctx.CopyAndUpdate(dst.data() + offset, src.data() + lead,
+								length, streaming);
+				}
+				if (emsha::EMSHAResult::OK == res) {
+					res = ctx.Finalise(actual);
+				}
+
+				if ((emsha::EMSHAResult::OK != res) ||
+				    !emsha::HashEqual(expected, actual) ||
+				    !std::equal(src.begin() + lead, src.begin() + 5000,
+						dst.begin() + offset) ||
+				    (dst[offset + length] != 0)) {
+					cerr << "FAILED: copy and update (lead " << lead
+					     << ", offset " << offset << ", streaming "
+					     << streaming << ")\n";
+					exit(1);
+				}
+			}
+		}
+	}
+
+	// Nothing is copied once the context is finalised.
+	emsha::SHA256	ctx;
+	ctx.Finalise(actual);
+	std::fill(dst.begin(), dst.end(), 0);
+	if ((emsha::EMSHAResult::InvalidState != ctx.CopyAndUpdate(dst.data(), src.data(), 100)) ||
+	    (dst[0] != 0)) {
+		cerr << "FAILED: copy and update after finalising\n";
+		exit(1);
+	}
+
+	cout << "PASSED: copy and update\n";
+}
+
+
 int
 main()
 {
@@ -107,6 +272,10 @@ main()
 #endif
 
 
+	splitUpdateTest();
+	forkTest();
+	copyAndUpdateTest();
+
 	auto res = runHashTests(static_cast<const hashTest *>(goldenTests),
 				numGoldenTests, labelGoldenTests);
 	if (res == -1) {
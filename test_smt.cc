@@ -0,0 +1,368 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/smt.h>
+
+#include "test_utils.h"
+
+
+using namespace std;
+
+
+static constexpr uint32_t	numKeys = 200;
+
+static uint8_t	keys[numKeys][emsha::SHA256_HASH_SIZE];
+static uint8_t	vals[numKeys][emsha::SHA256_HASH_SIZE];
+
+
+static const char *area = "sparse Merkle tree";
+
+
+// hashNode is the plain SHA256Digest version of a tree node hash.
+static void
+hashNode(uint8_t prefix, const uint8_t *l, const uint8_t *r, uint8_t *d)
+{
+	uint8_t	m[1 + (2 * emsha::SHA256_HASH_SIZE)];
+
+	m[0] = prefix;
+	copy(l, l + emsha::SHA256_HASH_SIZE, m + 1);
+	copy(r, r + emsha::SHA256_HASH_SIZE, m + 1 + emsha::SHA256_HASH_SIZE);
+	emsha::SHA256Digest(m, sizeof(m), d);
+}
+
+
+// A tree with one key can be worked out level by level from the
+// definition, which checks the node hashing and the empty hashes.
+static void
+referenceTest()
+{
+	emsha::SparseMerkleTree	tree;
+	uint8_t			empty[emsha::SHA256_HASH_SIZE] = {0};
+	uint8_t			h[emsha::SHA256_HASH_SIZE];
+	uint8_t			root[emsha::SHA256_HASH_SIZE];
+	vector<vector<uint8_t>>	emptyAt(emsha::SMT_DEPTH + 1);
+
+	emptyAt[emsha::SMT_DEPTH].assign(empty, empty + sizeof(empty));
+	for (uint32_t d = emsha::SMT_DEPTH; d > 0; d--) {
+		emptyAt[d - 1].resize(emsha::SHA256_HASH_SIZE);
+		hashNode(1, emptyAt[d].data(), emptyAt[d].data(), emptyAt[d - 1].data());
+		if (!emsha::HashEqual(emptyAt[d - 1].data(), emsha::SparseMerkleTree::EmptyHash(d - 1))) {
+			fail(area, "empty subtree hash");
+		}
+	}
+
+	tree.Root(root);
+	if (!emsha::HashEqual(root, emptyAt[0].data())) {
+		fail(area, "empty tree root");
+	}
+
+	hashNode(0, keys[0], vals[0], h);
+	for (uint32_t d = emsha::SMT_DEPTH; d > 0; d--) {
+		bool const right = (keys[0][(d - 1) / 8] >> (7 - ((d - 1) % 8))) & 1;
+
+		if (right) {
+			hashNode(1, emptyAt[d].data(), h, h);
+		} else {
+			hashNode(1, h, emptyAt[d].data(), h);
+		}
+	}
+
+	tree.Update(keys[0], vals[0]);
+	tree.Root(root);
+	if (!emsha::HashEqual(root, h)) {
+		fail(area, "single key root");
+	}
+
+	cout << "PASSED: sparse Merkle tree reference\n";
+}
+
+
+typedef map<vector<uint8_t>, vector<uint8_t>>	model;
+
+
+// naiveHash hashes the subtree at depth holding the keys in [first,
+// last) from the definition, one level at a time.
+static void
+naiveHash(model::const_iterator first, model::const_iterator last, uint32_t depth,
+	  uint8_t *h)
+{
+	if (first == last) {
+		const uint8_t	*empty = emsha::SparseMerkleTree::EmptyHash(depth);
+
+		copy(empty, empty + emsha::SHA256_HASH_SIZE, h);
+		return;
+	}
+
+	if (depth == emsha::SMT_DEPTH) {
+		hashNode(0, first->first.data(), first->second.data(), h);
+		return;
+	}
+
+	auto	mid = first;
+	while ((mid != last) && (((mid->first[depth / 8] >> (7 - (depth % 8))) & 1) == 0)) {
+		++mid;
+	}
+
+	uint8_t	l[emsha::SHA256_HASH_SIZE];
+	uint8_t	r[emsha::SHA256_HASH_SIZE];
+
+	naiveHash(first, mid, depth + 1, l);
+	naiveHash(mid, last, depth + 1, r);
+	hashNode(1, l, r, h);
+}
+
+
+// checkModel compares the tree's root with the one worked out from
+// the model, and checks a proof for every key the test uses.
+static void
+checkModel(const emsha::SparseMerkleTree& tree, const model& m,
+	   const vector<vector<uint8_t>>& all, const string& what)
+{
+	uint8_t		want[emsha::SHA256_HASH_SIZE];
+	uint8_t		root[emsha::SHA256_HASH_SIZE];
+	emsha::SMTProof	proof;
+
+	naiveHash(m.begin(), m.end(), 0, want);
+	tree.Root(root);
+	if (!emsha::HashEqual(root, want) || (tree.Size() != m.size())) {
+		fail(area, "wrong root after " + what);
+	}
+
+	for (const auto& k : all) {
+		auto const	it = m.find(k);
+		const uint8_t	*v = (it == m.end()) ? nullptr : it->second.data();
+
+		tree.Prove(k.data(), proof);
+		if (emsha::EMSHAResult::OK != emsha::SMTVerify(root, k.data(), v, proof)) {
+			fail(area, "proof failed after " + what);
+		}
+	}
+}
+
+
+// Keys that agree down to the last bit, or differ only at a byte
+// boundary or at the root, make branches at the edges of the tree,
+// which have to be created and merged away again as keys come and
+// go.
+static void
+structureTest()
+{
+	emsha::SparseMerkleTree	tree;
+	model			m;
+	vector<vector<uint8_t>>	all;
+	vector<uint8_t> const	base(keys[0], keys[0] + emsha::SHA256_HASH_SIZE);
+
+	all.push_back(base);
+	for (uint32_t bit : {255U, 254U, 248U, 247U, 8U, 7U, 1U, 0U}) {
+		vector<uint8_t>	k(base);
+
+		k[bit / 8] ^= static_cast<uint8_t>(0x80 >> (bit % 8));
+		all.push_back(k);
+	}
+	all.push_back(vector<uint8_t>(emsha::SHA256_HASH_SIZE, 0));
+	all.push_back(vector<uint8_t>(emsha::SHA256_HASH_SIZE, 0xff));
+	for (uint32_t i = 1; i < 6; i++) {
+		all.push_back(vector<uint8_t>(keys[i], keys[i] + emsha::SHA256_HASH_SIZE));
+	}
+
+	checkModel(tree, m, all, "nothing");
+
+	for (size_t i = 0; i < all.size(); i++) {
+		tree.Update(all[i].data(), vals[i]);
+		m[all[i]].assign(vals[i], vals[i] + emsha::SHA256_HASH_SIZE);
+		checkModel(tree, m, all, "adding key " + to_string(i));
+	}
+
+	tree.Update(all[1].data(), vals[100]);
+	m[all[1]].assign(vals[100], vals[100] + emsha::SHA256_HASH_SIZE);
+	checkModel(tree, m, all, "changing a value");
+
+	// Remove from the middle outwards, so that branches at every
+	// depth are merged away.
+	for (size_t i = 0; i < all.size(); i++) {
+		size_t const	j = (i + (all.size() / 2)) % all.size();
+
+		tree.Update(all[j].data(), nullptr);
+		m.erase(all[j]);
+		checkModel(tree, m, all, "removing key " + to_string(j));
+	}
+
+	// A batch can add, change and remove the same keys.
+	vector<emsha::SMTUpdate>	updates;
+	for (size_t i = 0; i < all.size(); i++) {
+		updates.push_back({all[i].data(), vals[i]});
+		m[all[i]].assign(vals[i], vals[i] + emsha::SHA256_HASH_SIZE);
+		if ((i % 3) == 0) {
+			updates.push_back({all[i].data(), nullptr});
+			m.erase(all[i]);
+		}
+	}
+	updates.push_back({all[0].data(), vals[50]});
+	m[all[0]].assign(vals[50], vals[50] + emsha::SHA256_HASH_SIZE);
+	updates.push_back({all[1].data(), nullptr});
+	m.erase(all[1]);
+
+	tree.UpdateBatch(updates.data(), updates.size());
+	checkModel(tree, m, all, "a mixed batch");
+
+	cout << "PASSED: sparse Merkle tree structure\n";
+}
+
+
+static void
+updateTest()
+{
+	emsha::SparseMerkleTree	serial;
+	emsha::SparseMerkleTree	batched;
+	vector<emsha::SMTUpdate>	updates;
+	uint8_t			a[emsha::SHA256_HASH_SIZE];
+	uint8_t			b[emsha::SHA256_HASH_SIZE];
+
+	for (uint32_t i = 0; i < numKeys; i++) {
+		serial.Update(keys[i], vals[i]);
+	}
+
+	// In reverse, with a few keys written twice: the order of
+	// updates shouldn't matter, only the last value for a key.
+	for (uint32_t i = numKeys; i > 0; i--) {
+		if ((i % 17) == 0) {
+			updates.push_back({keys[i - 1], vals[0]});
+		}
+		updates.push_back({keys[i - 1], vals[i - 1]});
+	}
+	if (emsha::EMSHAResult::OK != batched.UpdateBatch(updates.data(), updates.size())) {
+		fail(area, "batch update");
+	}
+
+	serial.Root(a);
+	batched.Root(b);
+	if (!emsha::HashEqual(a, b) || (serial.Size() != numKeys) || (batched.Size() != numKeys)) {
+		fail(area, "batched and serial updates disagree");
+	}
+
+	// Removing every key gets back to the empty tree.
+	updates.clear();
+	for (uint32_t i = 0; i < numKeys; i++) {
+		updates.push_back({keys[i], nullptr});
+	}
+	batched.UpdateBatch(updates.data(), updates.size());
+	batched.Root(b);
+	if (!emsha::HashEqual(b, emsha::SparseMerkleTree::EmptyHash(0)) || (batched.Size() != 0)) {
+		fail(area, "removing every key");
+	}
+
+	cout << "PASSED: sparse Merkle tree updates\n";
+}
+
+
+static void
+proofTest()
+{
+	emsha::SparseMerkleTree	tree;
+	emsha::SMTProof		proof;
+	uint8_t			root[emsha::SHA256_HASH_SIZE];
+	uint8_t			value[emsha::SHA256_HASH_SIZE];
+
+	// Only the even keys go in.
+	for (uint32_t i = 0; i < numKeys; i += 2) {
+		tree.Update(keys[i], vals[i]);
+	}
+	tree.Root(root);
+
+	for (uint32_t i = 0; i < numKeys; i++) {
+		bool const present = (i % 2) == 0;
+
+		if (tree.Lookup(keys[i], value) != present) {
+			fail(area, "lookup");
+		}
+
+		tree.Prove(keys[i], proof);
+
+		// With 100 random keys, paths diverge within a few
+		// levels of the root, so proofs should be tiny.
+		if (proof.siblings.size() > (24 * emsha::SHA256_HASH_SIZE)) {
+			fail(area, "proof isn't compressed");
+		}
+
+		const uint8_t *want = present ? vals[i] : nullptr;
+		if (emsha::EMSHAResult::OK != emsha::SMTVerify(root, keys[i], want, proof)) {
+			fail(area, present ? "inclusion proof" : "non-inclusion proof");
+		}
+
+		// The opposite claim must not verify.
+		const uint8_t *wrong = present ? nullptr : vals[i];
+		if (emsha::EMSHAResult::VerifyFailed != emsha::SMTVerify(root, keys[i], wrong, proof)) {
+			fail(area, "a false claim verified");
+		}
+
+		if (present && (emsha::EMSHAResult::VerifyFailed !=
+				emsha::SMTVerify(root, keys[i], vals[i + 1], proof))) {
+			fail(area, "the wrong value verified");
+		}
+	}
+
+	tree.Prove(keys[0], proof);
+	proof.siblings[3] ^= 1;
+	if (emsha::EMSHAResult::VerifyFailed != emsha::SMTVerify(root, keys[0], vals[0], proof)) {
+		fail(area, "a modified proof verified");
+	}
+
+	proof.siblings.resize(proof.siblings.size() - emsha::SHA256_HASH_SIZE);
+	if (emsha::EMSHAResult::InvalidState != emsha::SMTVerify(root, keys[0], vals[0], proof)) {
+		fail(area, "a short proof was accepted");
+	}
+
+	cout << "PASSED: sparse Merkle tree proofs\n";
+}
+
+
+int
+main()
+{
+	for (uint32_t i = 0; i < numKeys; i++) {
+		uint8_t	seed[8] = {'k', 'e', 'y', 0, 0, 0, 0, 0};
+
+		seed[4] = static_cast<uint8_t>(i);
+		seed[5] = static_cast<uint8_t>(i >> 8);
+		emsha::SHA256Digest(seed, sizeof(seed), keys[i]);
+		seed[0] = 'v';
+		emsha::SHA256Digest(seed, sizeof(seed), vals[i]);
+	}
+
+	referenceTest();
+	structureTest();
+	updateTest();
+	proofTest();
+	exit(0);
+}
@@ -0,0 +1,156 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+// test_stack measures the peak stack used by the single-pass SHA-256
+// and HMAC-SHA-256 functions. Each measurement runs on a thread whose
+// stack is a buffer painted with a known pattern; afterwards, the
+// deepest byte that no longer holds the pattern marks the high-water
+// mark. An empty thread is measured the same way to subtract the cost
+// of starting a thread.
+
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <pthread.h>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/hmac.h>
+
+
+using namespace std;
+
+
+static constexpr size_t		stackSize = 256 * 1024;
+static constexpr uint8_t	paint = 0xa5;
+
+static uint8_t	stackArea[stackSize] __attribute__((aligned(4096)));
+
+static const uint8_t	 key[] = "the HMAC key used to measure stack usage";
+static uint8_t		 message[1000];
+static uint8_t		 dig[emsha::SHA256_HASH_SIZE];
+
+
+static void *
+idle(void *)
+{
+	return nullptr;
+}
+
+
+static void *
+hashSHA256(void *)
+{
+	if (emsha::EMSHAResult::OK != emsha::SHA256Digest(message, sizeof(message), dig)) {
+		abort();
+	}
+	return nullptr;
+}
+
+
+static void *
+hashHMAC(void *)
+{
+	if (emsha::EMSHAResult::OK !=
+	    emsha::ComputeHMAC(key, sizeof(key), message, sizeof(message), dig)) {
+		abort();
+	}
+	return nullptr;
+}
+
+
+// measure returns the number of bytes of stackArea touched by fn.
+static size_t
+measure(void *(*fn)(void *))
+{
+	pthread_attr_t	attr;
+	pthread_t	thread;
+
+	memset(stackArea, paint, stackSize);
+	if (pthread_attr_init(&attr) != 0 ||
+	    pthread_attr_setstack(&attr, stackArea, stackSize) != 0 ||
+	    pthread_create(&thread, &attr, fn, nullptr) != 0) {
+		cerr << "FAILED: couldn't start a measurement thread\n";
+		exit(1);
+	}
+	pthread_join(thread, nullptr);
+	pthread_attr_destroy(&attr);
+
+	// The stack grows down from the end of the buffer.
+	size_t i = 0;
+	while (i < stackSize && stackArea[i] == paint) {
+		i++;
+	}
+
+	return stackSize - i;
+}
+
+
+// aboveBaseline returns how much more stack than the idle thread fn
+// used. A thread can come in under the baseline (the idle thread's
+// frame isn't free either), which reads as no extra use rather than
+// wrapping around.
+static size_t
+aboveBaseline(void *(*fn)(void *), size_t baseline)
+{
+	size_t const	used = measure(fn);
+
+	return (used > baseline) ? used - baseline : 0;
+}
+
+
+int
+main()
+{
+	// Run everything once up front, so that one-time costs such as
+	// resolving the library's symbols aren't counted.
+	hashSHA256(nullptr);
+	hashHMAC(nullptr);
+
+	size_t const	baseline = measure(idle);
+	size_t const	sha = aboveBaseline(hashSHA256, baseline);
+	size_t const	hmac = aboveBaseline(hashHMAC, baseline);
+
+#ifdef EMSHA_SMALL_STACK
+	cout << "configuration: small stack (16-word rolling schedule)\n";
+#else
+	cout << "configuration: default (64-word schedule)\n";
+#endif
+	cout << "thread baseline: " << baseline << " bytes\n";
+	cout << "SHA256Digest peak stack: " << sha << " bytes\n";
+	cout << "ComputeHMAC peak stack:  " << hmac << " bytes\n";
+
+	// A generous sanity bound; the interesting output is the numbers
+	// above, which scripts/footprint.sh collects.
+	if (sha > 8192 || hmac > 8192) {
+		cerr << "FAILED: stack usage is unexpectedly large\n";
+		exit(1);
+	}
+
+	cout << "PASSED: stack usage\n";
+	exit(0);
+}
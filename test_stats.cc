@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 K. Isom <coder@kyleisom.net>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * copy of this  software and associated documentation  files (the "Software"),
+ * to deal  in the Software  without restriction, including  without limitation
+ * the rights  to use,  copy, modify,  merge, publish,  distribute, sublicense,
+ * and/or  sell copies  of the  Software,  and to  permit persons  to whom  the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS  PROVIDED "AS IS", WITHOUT WARRANTY OF  ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING  BUT NOT  LIMITED TO  THE WARRANTIES  OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS  OR COPYRIGHT  HOLDERS BE  LIABLE FOR  ANY CLAIM,  DAMAGES OR  OTHER
+ * LIABILITY,  WHETHER IN  AN ACTION  OF CONTRACT,  TORT OR  OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include <emsha/emsha.h>
+#include <emsha/sha256.h>
+#include <emsha/hmac.h>
+#include <emsha/stats.h>
+
+
+using namespace std;
+
+
+static constexpr uint32_t	messageLength = 1000;
+static constexpr uint32_t	iterations = 100;
+
+
+static void
+hashSome()
+{
+	uint8_t	msg[messageLength] = {0};
+	uint8_t	dig[emsha::SHA256_HASH_SIZE];
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		emsha::SHA256Digest(msg, messageLength, dig);
+	}
+}
+
+
+static void
+check(bool cond, const string& what)
+{
+	if (!cond) {
+		cerr << "FAILED: stats: " << what << "\n";
+		exit(1);
+	}
+}
+
+
+int
+main()
+{
+	emsha::Stats	before{};
+	emsha::Stats	after{};
+	emsha::SHA256	ctx;
+	uint8_t		key[16] = {0};
+	uint8_t		dig[emsha::SHA256_HASH_SIZE];
+
+	emsha::StatsSnapshot(before);
+
+	// Counters from threads that have already exited must still
+	// show up in the snapshot.
+	thread	t1(hashSome);
+	thread	t2(hashSome);
+	t1.join();
+	t2.join();
+	hashSome();
+
+	ctx.Update(nullptr, 1);
+	emsha::ComputeHMAC(key, sizeof(key), key, sizeof(key), dig);
+
+	emsha::StatsSnapshot(after);
+
+	if (!emsha::StatsEnabled()) {
+		check(after.bytesHashed == 0, "counters should be zero when disabled");
+		check(after.updateCalls == 0, "counters should be zero when disabled");
+		cout << "PASSED: stats (disabled)\n";
+		exit(0);
+	}
+
+	uint64_t const calls = 3 * iterations;
+	uint64_t const okIndex = static_cast<uint64_t>(emsha::EMSHAResult::OK);
+	uint64_t const nullIndex = static_cast<uint64_t>(emsha::EMSHAResult::NullPointer);
+
+	check(after.bytesHashed - before.bytesHashed >= calls * messageLength,
+	      "bytes hashed");
+	check(after.blocksCompressed - before.blocksCompressed >=
+	      calls * ((messageLength + 9 + 63) / 64), "blocks compressed");
+	check(after.updateCalls - before.updateCalls >= calls + 1, "update calls");
+	check(after.finaliseCalls - before.finaliseCalls >= calls, "finalise calls");
+	check(after.hmacKeySetups - before.hmacKeySetups == 1, "HMAC key setups");
+	check(after.results[okIndex] - before.results[okIndex] >= 2 * calls, "OK results");
+	check(after.results[nullIndex] - before.results[nullIndex] == 1,
+	      "NullPointer results");
+
+	cout << "PASSED: stats\n";
+	exit(0);
+}
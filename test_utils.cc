@@ -24,6 +24,7 @@
 
 
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <string>
@@ -36,6 +37,27 @@ using std::string;
 using std::cout;
 using std::cerr;
 using std::endl;
+using std::exit;
+
+
+void
+fail(const string& area, const string& what)
+{
+	cerr << "FAILED: " << area << ": " << what << "\n";
+	exit(1);
+}
+
+
+emsha::Digest
+testDigest(uint32_t i)
+{
+	uint8_t	m[4] = {
+		static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8),
+		static_cast<uint8_t>(i >> 16), static_cast<uint8_t>(i >> 24)
+	};
+
+	return emsha::SHA256Digest(m, sizeof(m));
+}
 
 
 void
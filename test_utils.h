@@ -33,6 +33,7 @@
 #include <emsha/emsha.h>
 #include <emsha/sha256.h>
 #include <emsha/hmac.h>
+#include <emsha/digest.h>
 
 
 // How many times should a test result be checked? The goal is to
@@ -58,6 +59,16 @@ struct hmacTest {
 };
 
 
+// fail reports a failed check in the named area of the library, and
+// exits.
+[[noreturn]] void	fail(const std::string& area, const std::string& what);
+
+
+// testDigest returns the SHA-256 digest of i's four little-endian
+// bytes, as a stand-in for the digest of some real data.
+emsha::Digest		testDigest(std::uint32_t i);
+
+
 // General-purpose debuggery.
 void	DumpHexString(std::string&, std::uint8_t *, std::uint32_t);
 void	dump_pair(std::uint8_t *, std::uint8_t *);